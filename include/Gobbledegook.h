@@ -33,6 +33,22 @@
 //       methods an application will need to call are `ggkNofifyUpdatedCharacteristic` and `ggkNofifyUpdatedDescriptor`. The other
 //       methods are provided in case an application requies extended functionality.
 //
+//     * Data store
+//
+//       As an alternative to the data delegates, the server provides an optional store for server data. Values are registered
+//       once by name and from then on are read and written by slot, safely from any thread and without locks.
+//
+//     * Server statistics
+//
+//       The server keeps lightweight counters and latency histograms for its hot paths (method calls, the update queue,
+//       notifications and HCI commands), which can be retrieved at any time.
+//
+//     * Adapter events
+//
+//       Applications can subscribe to the events the adapter reports (connections, authentication failures, new keys and
+//       pairing requests) by type, receiving each one as a plain struct, either on the adapter's thread or queued for a thread
+//       of their own.
+//
 //     * Server control
 //
 //       A small set of methods for starting and stopping the server.
@@ -54,6 +70,7 @@
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <map>
+#include <string>
 
 #pragma once
 
@@ -80,6 +97,19 @@ extern "C"
 	void ggkLogRegisterAlways(GGKLogReceiver receiver);
 	void ggkLogRegisterTrace(GGKLogReceiver receiver);
 
+	// Enables (non-zero) or disables (zero) asynchronous log delivery
+	//
+	// By default, log receivers are called on whichever thread is logging, which may be the server's thread or its HCI event
+	// thread. With async delivery, log entries are instead queued (without blocking) and delivered to the receivers from a
+	// background thread, so a slow receiver (such as one writing to flash) can't stall the server. Entries are dropped if the
+	// queue is full; see `ggkLogGetDroppedCount()`.
+	//
+	// Disabling async delivery waits for any queued entries to be delivered. Call this before unregistering your receivers.
+	void ggkLogSetAsync(int enable);
+
+	// Returns the number of log entries dropped because the async delivery queue was full
+	unsigned long ggkLogGetDroppedCount();
+
 	// -----------------------------------------------------------------------------------------------------------------------------
 	// SERVER DATA
 	// -----------------------------------------------------------------------------------------------------------------------------
@@ -88,7 +118,8 @@ extern "C"
 	//
 	// IMPORTANT:
 	//
-	// This will be called from the server's thread. Be careful to ensure your implementation is thread safe.
+	// This will be called from the server's thread (or, if you have enabled worker threads, from a worker thread; see
+	// `ggkEnableMethodWorkers()`.) Be careful to ensure your implementation is thread safe.
 	//
 	// Similarly, the pointer to data returned to the server should point to non-volatile memory so that the server can use it
 	// safely for an indefinite period of time.
@@ -98,7 +129,8 @@ extern "C"
 	//
 	// IMPORTANT:
 	//
-	// This will be called from the server's thread. Be careful to ensure your implementation is thread safe.
+	// This will be called from the server's thread (or, if you have enabled worker threads, from a worker thread; see
+	// `ggkEnableMethodWorkers()`.) Be careful to ensure your implementation is thread safe.
 	//
 	// The data setter uses void* types to allow receipt of unknown data types from the server. Ensure that you do not store these
 	// pointers. Copy the data before returning from your getter delegate.
@@ -113,10 +145,38 @@ extern "C"
 	//   * Any other failure, as deemed by the delegate handler
 	typedef int (*GGKServerDataSetter)(const char *pName, const void *pData);
 
+	// Enables (non-zero) or disables (zero) running method calls on worker threads
+	//
+	// By default, every method call runs on the server's thread, and so do the calls that it makes to the data getter and setter.
+	// With this enabled, characteristics that ask for it in the server description (see `GattCharacteristic::runMethodsOnWorkers()`)
+	// have their method calls run on a pool of worker threads instead, so a slow one doesn't hold up the server. Their callbacks,
+	// and any data getter and setter calls they make, then run concurrently with the server's thread and with each other.
+	//
+	// Only enable this if your data getter and setter are thread safe. Call it before `ggkStart()` or `ggkAttach()`.
+	//
+	// Worker threads are disabled by default.
+	void ggkEnableMethodWorkers(int enable);
+
 	// -----------------------------------------------------------------------------------------------------------------------------
 	// SERVER DATA UPDATE MANAGEMENT
 	// -----------------------------------------------------------------------------------------------------------------------------
 
+	// The priority class of a queued update
+	//
+	// Each pass of the server's main loop processes waiting updates from the highest class first, so an urgent update (such as
+	// an alarm) is never stuck behind a burst of less important ones. To keep the lower classes from starving while the higher
+	// classes are busy, a class that has had updates waiting for several passes without being serviced is moved to the front
+	// for one pass.
+	//
+	// A characteristic's updates use its own class (see `GattCharacteristic::updatePriority()`), which defaults to
+	// EUpdatePriorityNormal.
+	enum GGKUpdatePriority
+	{
+		EUpdatePriorityHigh,
+		EUpdatePriorityNormal,
+		EUpdatePriorityLow
+	};
+
 	// Adds an update to the front of the queue for a characteristic at the given object path
 	//
 	// Returns non-zero value on success or 0 on failure.
@@ -130,10 +190,61 @@ extern "C"
 	// Adds a named update to the front of the queue. Generally, this routine should not be used directly. Instead, use the
 	// `ggkNofifyUpdatedCharacteristic()` instead.
 	//
+	// If coalescing is enabled (see `ggkUpdateQueueSetCoalescing()`) and an identical update is already waiting in the queue, the
+	// new update is dropped. This is still considered a success.
+	//
+	// The update is queued in the priority class of the characteristic at the given path (see `GGKUpdatePriority`), or in
+	// EUpdatePriorityNormal for anything else. Priority classes are learned when the server starts, so updates pushed before
+	// then are queued in EUpdatePriorityNormal.
+	//
 	// Returns non-zero value on success or 0 on failure.
 	int ggkPushUpdateQueue(const char *pObjectPath, const char *pInterfaceName);
 
-	// Get the next update from the back of the queue and returns the element in `element` as a string in the format:
+	// Adds a named update to the front of the queue for the given priority class, regardless of the class of the characteristic
+	//
+	// If coalescing is enabled and an identical update is already waiting in any class, the new update is dropped. This is still
+	// considered a success.
+	//
+	// Returns non-zero value on success or 0 on failure (an invalid priority.)
+	int ggkPushUpdateQueueWithPriority(const char *pObjectPath, const char *pInterfaceName, enum GGKUpdatePriority priority);
+
+	// Registers the characteristic at the given object path for fast updates, returning a handle that can be passed to
+	// `ggkNotifyHandle()`
+	//
+	// The characteristic is located once, here, so that notifying a handle requires no string work, tree searches or memory
+	// allocation. Because of this, the server must have been started (see `ggkStart()`) before handles can be registered.
+	// Registering the same path more than once returns the same handle. Updates to a handle use the priority class the
+	// characteristic had when it was registered (see `GGKUpdatePriority`.)
+	//
+	// Handles do not survive a restart. When the server stops, every handle is released (along with any updates still waiting
+	// on them) and must be registered again once the next `ggkStart()` or `ggkAttach()` has brought the server up.
+	//
+	// This may be called from any thread, once the server has registered its objects (by the time it reaches ERunning.) It
+	// fails for a server that has not got that far, or that has begun to stop.
+	//
+	// Returns a non-negative handle on success or -1 on failure (the server is not started, there is no characteristic at the
+	// path, or the maximum number of handles have been registered.)
+	int ggkRegisterUpdateHandle(const char *pObjectPath);
+
+	// Adds an update for the characteristic registered with `ggkRegisterUpdateHandle()`
+	//
+	// This is the allocation-free alternative to `ggkNofifyUpdatedCharacteristic()` and is safe to call from any thread. If
+	// coalescing is enabled (see `ggkUpdateQueueSetCoalescing()`) and the handle already has an update waiting, the new update
+	// is dropped. This is still considered a success.
+	//
+	// Returns non-zero value on success or 0 on failure (an invalid handle, or too many updates are already waiting.)
+	int ggkNotifyHandle(int handle);
+
+	// Adds an update for each of `count` handles registered with `ggkRegisterUpdateHandle()`, waking the server only once
+	//
+	// Updates added together are processed in the same pass of the server's main loop, and the change notifications they cause
+	// are sent together at the end of that pass (see `GattCharacteristic::NotificationBatch`.) This is safe to call from any
+	// thread.
+	//
+	// Returns the number of updates added, which is less than `count` if any handle is invalid or the updates don't all fit
+	int ggkNotifyHandles(const int *pHandles, int count);
+
+	// Get the next update from the back of the highest priority class that has one and returns the element in `element` as a string in the format:
 	//
 	//     "com/object/path|com.interface.name"
 	//
@@ -148,15 +259,415 @@ extern "C"
 	// Returns 1 on success, 0 if the queue is empty, -1 on error (such as the length too small to store the element)
 	int ggkPopUpdateQueue(char *pElement, int elementLen, int keep);
 
-	// Returns 1 if the queue is empty, otherwise 0
+	// Returns 1 if the queue is empty (in every priority class), otherwise 0
 	int ggkUpdateQueueIsEmpty();
 
-	// Returns the number of entries waiting in the queue
+	// Returns the number of entries waiting in the queue, across all priority classes
 	int ggkUpdateQueueSize();
 
-	// Removes all entries from the queue
+	// Removes all entries from the queue, in every priority class
 	void ggkUpdateQueueClear();
 
+	// Sets the maximum number of queued updates the server will process in a single pass of its main loop
+	//
+	// Larger batches flush bursts of updates more quickly, while smaller batches bound the time the main loop spends on updates
+	// before it returns to servicing incoming requests (such as ReadValue.) Any remaining updates are processed on the next pass.
+	//
+	// A value of 0 (or less) removes the limit, draining the entire queue in each pass. The default is 32.
+	void ggkUpdateQueueSetMaxBatchSize(int maxBatchSize);
+
+	// Enables (non-zero) or disables (0) coalescing of duplicate updates
+	//
+	// When enabled, the queue holds at most one pending update for any given object path and interface. Since the server
+	// retrieves the current data when it processes an update, a burst of updates to the same characteristic collapses into a
+	// single notification carrying the newest data. Likewise, a notification batch sends only the newest value of each
+	// characteristic; without coalescing, every notification is sent, in order.
+	//
+	// Coalescing is disabled by default.
+	void ggkUpdateQueueSetCoalescing(int enable);
+
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// SERVER DATA STORE
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// Registers a named value in the server's data store, able to hold up to `maxSize` bytes (up to 4096)
+	//
+	// The data store is an optional alternative to the `GGKServerDataGetter`/`GGKServerDataSetter` delegates. Storage for each
+	// value is allocated when it is registered. From then on, values are read and written by slot, with no string lookups,
+	// allocations or locks, and it is safe to write a value from any thread while the server reads it.
+	//
+	// Values should be registered before calling `ggkStart()` so that the server description can find them. Registering an
+	// existing name returns the existing slot.
+	//
+	// Returns the value's slot on success, or -1 on failure
+	int ggkDataStoreRegister(const char *pName, int maxSize);
+
+	// Returns the slot for a registered name, or -1 if there is no such slot
+	int ggkDataStoreFind(const char *pName);
+
+	// Associates a slot with an update handle (see `ggkRegisterUpdateHandle()`), so that each write to the slot automatically
+	// notifies the characteristic. Pass -1 as the update handle to remove the association.
+	//
+	// Returns non-zero value on success or 0 on failure
+	int ggkDataStoreSetUpdateHandle(int slot, int updateHandle);
+
+	// Stores a value in a slot, notifying the slot's update handle (if any)
+	//
+	// Returns non-zero value on success or 0 on failure (an invalid slot, `size` is larger than the slot, or a shared slot
+	// is locked by a producer that stopped part way through writing it; see `ggkDataStoreShare()`)
+	int ggkDataStoreSet(int slot, const void *pData, int size);
+
+	// Copies a slot's current value into `pBuffer`, which is `bufferSize` bytes in size
+	//
+	// Returns the size of the value in bytes, or -1 on failure (an invalid slot, or the value will not fit in the buffer)
+	int ggkDataStoreGet(int slot, void *pBuffer, int bufferSize);
+
+	// Moves the data store's slots into shared memory, so that producers in other processes can write them directly
+	//
+	// On success, `pMemFd` receives a memfd holding the slots and `pDoorbellFd` an eventfd that producers signal after writing.
+	// Both remain owned by the server and are close-on-exec; pass them to producer processes however suits the application
+	// (such as over a Unix socket, or by clearing FD_CLOEXEC before exec.) The server watches the doorbell and notifies each
+	// slot's update handle (see `ggkDataStoreSetUpdateHandle()`) when a producer changes it. Calling this again returns the
+	// same descriptors.
+	//
+	// Call this after registering slots and before `ggkStart()`. Slots registered afterwards, and those whose names are 64
+	// characters or longer, are not shared.
+	//
+	// Returns non-zero value on success or 0 on failure
+	int ggkDataStoreShare(int *pMemFd, int *pDoorbellFd);
+
+	// A producer's connection to a shared data store (see `ggkDataStoreShare()`)
+	struct GGKSharedStore;
+
+	// Connects a producer process to a shared data store, given the descriptors from `ggkDataStoreShare()`
+	//
+	// The descriptors are not taken over; the caller may close them once this returns. The producer does not need to start a
+	// server of its own.
+	//
+	// Returns the connection on success, or NULL on failure
+	struct GGKSharedStore *ggkSharedStoreAttach(int memFd, int doorbellFd);
+
+	// Disconnects a producer from a shared data store
+	void ggkSharedStoreDetach(struct GGKSharedStore *pStore);
+
+	// Returns the producer's slot for a shared value's name, or -1 if there is no such shared slot
+	//
+	// A producer's slots need not match the server's slots for the same names.
+	int ggkSharedStoreFind(struct GGKSharedStore *pStore, const char *pName);
+
+	// Stores a value in a shared slot and signals the server
+	//
+	// If another producer stops part way through writing the slot, the slot stays locked (and this fails) until the server
+	// takes the lock back, about a second later.
+	//
+	// Returns non-zero value on success or 0 on failure (an invalid slot, `size` is larger than the slot, or the slot is locked)
+	int ggkSharedStoreSet(struct GGKSharedStore *pStore, int slot, const void *pData, int size);
+
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// SERVER STATISTICS
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// A summary of a latency histogram
+	//
+	// All times are in microseconds. Percentiles are reported as the upper bound of the histogram bucket that holds them, which
+	// is within 25% of the true value.
+	struct GGKLatencyStats
+	{
+		unsigned long long count;
+		unsigned long long meanUS;
+		unsigned long long p50US;
+		unsigned long long p90US;
+		unsigned long long p99US;
+		unsigned long long maxUS;
+	};
+
+	// A snapshot of the server's statistics
+	struct GGKStats
+	{
+		// D-Bus method calls, timed from dispatch until the method's handler returns (for most methods, this includes sending the
+		// reply)
+		unsigned long long methodCalls;
+		struct GGKLatencyStats methodLatency;
+
+		// Method calls run on worker threads (see `ggkEnableMethodWorkers()`), timed from dispatch until the
+		// method's handler returns on its worker, including any time spent waiting for a worker
+		unsigned long long workerMethodCalls;
+		struct GGKLatencyStats workerMethodLatency;
+
+		// D-Bus property gets and sets, timed from dispatch until the property's getter or setter returns
+		unsigned long long propertyCalls;
+		struct GGKLatencyStats propertyLatency;
+
+		// Updates added to the update queue (or through update handles), those dropped as duplicates (see
+		// `ggkUpdateQueueSetCoalescing()`), those rejected because the queue was full and those processed by the server
+		unsigned long long updatesQueued;
+		unsigned long long updatesCoalesced;
+		unsigned long long updatesRejected;
+		unsigned long long updatesProcessed;
+
+		// The number of updates waiting to be processed, and the most that have ever been waiting at once
+		unsigned long long updateQueueDepth;
+		unsigned long long updateQueueMaxDepth;
+
+		// Change notifications sent, those suppressed because nobody was subscribed, updates deferred by a characteristic's
+		// notification rate limit and notifications replaced by a newer value in the same batch (see
+		// `GattCharacteristic::NotificationBatch`), along with the time taken to emit each notification
+		unsigned long long notificationsSent;
+		unsigned long long notificationsSuppressed;
+		unsigned long long notificationsDeferred;
+		unsigned long long notificationsCoalesced;
+		struct GGKLatencyStats notificationLatency;
+
+		// HCI management commands sent to the adapter and those that timed out, along with the time from sending each command
+		// until its response arrived
+		unsigned long long hciCommandsSent;
+		unsigned long long hciCommandTimeouts;
+		struct GGKLatencyStats hciCommandLatency;
+
+		// HCI events received from the adapter and those rejected as malformed, along with the time taken to parse and dispatch
+		// each event (including any call into the data setter)
+		unsigned long long hciEvents;
+		unsigned long long hciEventsRejected;
+		struct GGKLatencyStats hciEventLatency;
+
+		// Adapter events reported through the data setter (such as client connections), along with the time spent in the data
+		// setter for each
+		unsigned long long dataSetterCalls;
+		struct GGKLatencyStats dataSetterLatency;
+
+		// Packets received from clients and sent to them over acquired sockets (see `ggkStreamSend()`), along with those that
+		// could not be sent because the socket was full or had been closed
+		unsigned long long streamPacketsReceived;
+		unsigned long long streamPacketsSent;
+		unsigned long long streamPacketsDropped;
+	};
+
+	// Fills in `pStats` with a snapshot of the server's statistics
+	//
+	// This may be called from any thread, at any time (including before the server is started.) Statistics are gathered
+	// without locks, so the individual values in a snapshot may be very slightly out of step with each other.
+	void ggkGetStats(struct GGKStats *pStats);
+
+	// Resets the server's statistics
+	void ggkResetStats();
+
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// STREAMING
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// Streams `size` bytes to the client holding the notification socket of the characteristic at `pObjectPath`
+	//
+	// This only works for a characteristic that supports `AcquireNotify` (see `GattCharacteristic::acquireNotify()`) while a
+	// client is subscribed to it. BlueZ then delivers notifications written to the socket without any D-Bus traffic. The data is
+	// split into notifications of up to (MTU - 3) bytes each (see `ggkStreamGetMtu()`.)
+	//
+	// This may be called from any thread and never blocks; if the socket is full, the data that doesn't fit is dropped.
+	//
+	// Returns non-zero if all of the data was sent, or 0 if no client holds the socket or some of the data was dropped
+	int ggkStreamSend(const char *pObjectPath, const void *pData, int size);
+
+	// Returns the MTU of the notification socket held for the characteristic at `pObjectPath`, or 0 if no client holds it
+	int ggkStreamGetMtu(const char *pObjectPath);
+
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// SESSIONS
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// A client connected to the server (see `ggkGetSessions()`)
+	//
+	// Sessions are started when the adapter reports a connection (or when a client that connected earlier first calls one of the
+	// server's methods) and end when the client disconnects. The MTU is taken from the options BlueZ passes with each read,
+	// write or acquired socket.
+	struct GGKSession
+	{
+		// The client's address, such as "AA:BB:CC:DD:EE:FF"
+		char address[18];
+
+		// The address type (0 = BR/EDR, 1 = LE public, 2 = LE random) and the index of the controller the client is connected
+		// to, or -1 if the client has only been seen through its method calls
+		int addressType;
+		int controllerIndex;
+
+		// How long ago the client connected (or was first seen), in milliseconds
+		unsigned long long connectedMS;
+
+		// The client's MTU, or 0 if the client hasn't told us yet
+		int mtu;
+
+		// The number of characteristics whose notification sockets the client holds (see `GattCharacteristic::acquireNotify()`)
+		int subscriptionCount;
+	};
+
+	// Fills in up to `maxSessions` entries of `pSessions` with the clients currently connected
+	//
+	// This may be called from any thread, including from within the server's callbacks.
+	//
+	// Returns the number of clients connected, which may be more than `maxSessions`
+	int ggkGetSessions(struct GGKSession *pSessions, int maxSessions);
+
+	// Returns the MTU of the client at `pAddress` (such as "AA:BB:CC:DD:EE:FF"), 0 if the client hasn't told us its MTU, or -1
+	// if there is no such client
+	int ggkGetSessionMtu(const char *pAddress);
+
+	// Returns the most bytes a change notification from the characteristic at `pObjectPath` can carry without being truncated,
+	// or 0 if there is no such characteristic (or the server isn't running)
+	//
+	// This is (MTU - 3) for the smallest MTU among the clients the notification may reach. Sizing notifications (or packing
+	// several small readings into each one) to fit avoids both truncated and under-filled packets.
+	int ggkGetNotificationPayloadSize(const char *pObjectPath);
+
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// ADAPTER EVENTS
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// The events the adapter reports that an application can subscribe to (see `ggkSubscribeAdapterEvents()`)
+	//
+	// Each is a single bit, so that they can be combined into a mask.
+	enum GGKAdapterEventType
+	{
+		EAdapterEventClientConnected                = (1 << 0),
+		EAdapterEventClientDisconnected             = (1 << 1),
+		EAdapterEventAuthenticationFailed           = (1 << 2),
+		EAdapterEventNewLinkKey                     = (1 << 3),
+		EAdapterEventNewLongTermKey                 = (1 << 4),
+		EAdapterEventNewIdentityResolvingKey        = (1 << 5),
+		EAdapterEventNewSignatureResolvingKey       = (1 << 6),
+		EAdapterEventPasskeyNotify                  = (1 << 7),
+		EAdapterEventUserConfirmationRequest        = (1 << 8),
+
+		// Every event above
+		EAdapterEventAll                            = (1 << 9) - 1
+	};
+
+	// An event reported by the adapter
+	//
+	// Only the fields that apply to the event's type are filled in; the rest are zero.
+	struct GGKAdapterEvent
+	{
+		// The type of event and the controller that reported it
+		enum GGKAdapterEventType type;
+		int controllerIndex;
+
+		// When the adapter's event was received, in microseconds (from a monotonic clock)
+		unsigned long long timestampUS;
+
+		// The client's address (such as "AA:BB:CC:DD:EE:FF") and address type (0 = BR/EDR, 1 = LE public, 2 = LE random)
+		char address[18];
+		int addressType;
+
+		// EAdapterEventClientConnected and EAdapterEventClientDisconnected: the number of active connections after the event
+		int activeConnections;
+
+		// EAdapterEventClientDisconnected: the reason for the disconnection
+		// EAdapterEventAuthenticationFailed: the status reported for the failure
+		int reason;
+
+		// EAdapterEventPasskeyNotify and EAdapterEventUserConfirmationRequest: the passkey to display or confirm
+		unsigned int passkey;
+
+		// Key events: whether the key should be stored, its type (for link, long term and signature keys), whether it is a
+		// master key (for long term keys) and the key itself
+		int storeHint;
+		int keyType;
+		int keyMaster;
+		unsigned char key[16];
+	};
+
+	// Type definition for callbacks that receive adapter events
+	//
+	// `pEvent` is only valid for the duration of the call.
+	typedef void (*GGKAdapterEventCallback)(const struct GGKAdapterEvent *pEvent, void *pUserData);
+
+	// How a subscription's events are delivered (see `ggkSubscribeAdapterEvents()`)
+	enum GGKAdapterEventDelivery
+	{
+		// The callback is called on the adapter's event thread as each event arrives. It must be brief, as the adapter reads
+		// nothing else until it returns.
+		EAdapterEventDeliveryInline,
+
+		// Events are placed on a lock-free queue for the subscription, and the callback is called for them on whichever
+		// thread calls `ggkDispatchAdapterEvents()`. If the queue fills, further events are dropped (see
+		// `ggkGetAdapterEventsDropped()`.)
+		EAdapterEventDeliveryQueued
+	};
+
+	// Subscribes to the adapter events in `eventMask` (a combination of `GGKAdapterEventType` values)
+	//
+	// Events that no subscription asks for are never built, so they cost the application nothing. Up to 8 subscriptions may be
+	// active at once. This may be called at any time, from any thread (including before the server is started.)
+	//
+	// For applications written before this interface existed, these events are also reported through the data setter (as
+	// "GGK/EVENT/..." names), but only while no subscription wants them. Once an event type is subscribed to, the adapter
+	// stops passing it to the data setter.
+	//
+	// Returns a subscription id (0 or more) on success, or -1 on failure
+	int ggkSubscribeAdapterEvents(unsigned int eventMask, GGKAdapterEventCallback callback, void *pUserData, enum GGKAdapterEventDelivery delivery);
+
+	// Ends a subscription
+	//
+	// Once this returns, the subscription's callback will not be called again. Any events waiting in its queue are discarded.
+	// This may be called from within the subscription's own inline callback. A queued subscription should be ended on the thread
+	// that dispatches its events.
+	//
+	// Returns non-zero on success, or 0 if there is no such subscription
+	int ggkUnsubscribeAdapterEvents(int subscription);
+
+	// Calls a queued subscription's callback for up to `maxEvents` of its waiting events (or all of them, if `maxEvents` is 0 or
+	// less), on the calling thread
+	//
+	// Returns the number of events delivered, or -1 if there is no such queued subscription
+	int ggkDispatchAdapterEvents(int subscription, int maxEvents);
+
+	// Returns a file descriptor that is readable while a queued subscription has events waiting, or -1 if there is no such
+	// queued subscription
+	//
+	// This allows the application to wait for events with poll() (or add them to its own main loop) and then call
+	// `ggkDispatchAdapterEvents()`. The descriptor is owned by the subscription and is closed when it ends.
+	int ggkGetAdapterEventFd(int subscription);
+
+	// Returns the number of events dropped because a queued subscription's queue was full
+	unsigned long ggkGetAdapterEventsDropped(int subscription);
+
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// ADVERTISING
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// Adds (or replaces) one of the application's own advertising instances, which the controller advertises in rotation with
+	// the server's advertising
+	//
+	// The data is raw AD structures (length, type, data). The controller adds the flags and TX power to the advertising data
+	// itself (3 bytes each), which leaves up to 25 bytes of advertising data; the scan response may be up to 31 bytes.
+	// `instance` must be 2 or more (instance 1 is the server's own) and no more than the number of
+	// instances the controller supports (usually 5). Each instance is advertised for `durationSeconds` at a time before moving on
+	// to the next, or 0 for the controller's default.
+	//
+	// This may be called from any thread, at any time. Only instances that have changed are sent to the controller, without
+	// disturbing the others.
+	//
+	// Returns non-zero on success, otherwise 0
+	int ggkAdvertisingSetInstance(int instance, const void *pAdvertisingData, int advertisingDataLength, const void *pScanResponse, int scanResponseLength, int durationSeconds);
+
+	// Removes one of the application's advertising instances added with `ggkAdvertisingSetInstance()`
+	//
+	// Returns non-zero on success, or 0 if there was no such instance
+	int ggkAdvertisingRemoveInstance(int instance);
+
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// HCI RECORDING
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// Starts recording the raw Bluetooth Management API traffic between the server and the kernel into `pFilename`, with
+	// timestamps, replacing any recording already in progress
+	//
+	// Recordings can be replayed into the server's HCI adapter (without Bluetooth hardware) by the benchmark; see its `-r`
+	// option. To capture the adapter's initialization, start recording before calling `ggkStart()`.
+	//
+	// Returns non-zero on success, otherwise 0
+	int ggkHciStartRecording(const char *pFilename);
+
+	// Finishes the HCI recording in progress, if any
+	void ggkHciStopRecording();
+
 	// -----------------------------------------------------------------------------------------------------------------------------
 	// SERVER CONTROL
 	// -----------------------------------------------------------------------------------------------------------------------------
@@ -164,7 +675,8 @@ extern "C"
 	// Set the server state to 'EInitializing' and then immediately create a server thread and initiate the server's async
 	// processing on the server thread.
 	//
-	// At that point the current thread will block for maxAsyncInitTimeoutMS milliseconds or until initialization completes.
+	// At that point the current thread will block for maxAsyncInitTimeoutMS milliseconds or until initialization completes. A
+	// timeout of zero or less does not wait at all, so initialization fails at once (it never means an indefinite wait.)
 	//
 	// If initialization was successful, the method will return a non-zero value with the server running on its own thread in
 	// 'runServerThread'.
@@ -212,9 +724,32 @@ extern "C"
 	//
 	//     Retrieve this value using the `getAdvertisingShortName()` method
 	//
+	// enableAllAdapters (optional): Set to "true" to configure and publish the server on every Bluetooth adapter, rather than only
+	//     the first. Client connections are counted per controller (see `HciAdapter::getLeastConnectedController()`.)
+	//
 	int ggkStart(const std::map<const std::string, const std::string> &dataMap, 
 		GGKServerDataGetter getter, GGKServerDataSetter setter, int maxAsyncInitTimeoutMS);
 
+	// Starts the server on the application's own GLib main context, rather than on a server thread of its own
+	//
+	// The server's D-Bus callbacks, timers and update processing all run on `pContext` (or the global default context, if
+	// nullptr), which the application must run as the thread-default context of its thread (see
+	// `g_main_context_push_thread_default()`.) This removes the server thread from the data path: data getter and setter calls
+	// happen on the application's thread, and updates pushed from that thread are processed without waking another.
+	//
+	// The parameters are the same as those of `ggkStart()`, but this method does not block. Initialization continues as the
+	// application runs its main loop; use `ggkSetServerStateCallback()` to learn when the server reaches ERunning. If it doesn't
+	// within maxAsyncInitTimeoutMS milliseconds, it is shut down (as with `ggkStart()`, a timeout of zero or less allows no time.)
+	//
+	// To stop an attached server, call `ggkTriggerShutdown()`; the server finishes stopping (reaching EStopped) on a later pass of
+	// the application's main loop. `ggkWait()` never blocks for an attached server, as there is no server thread to wait for;
+	// it returns 0 (doing nothing) until the server has reached EStopped, and should be called once it has. For the same reason,
+	// `ggkShutdownAndWait()` is not supported for an attached server.
+	//
+	// Returns non-zero if initialization has begun, otherwise 0
+	int ggkAttach(struct _GMainContext *pContext, const std::map<const std::string, const std::string> &dataMap,
+		GGKServerDataGetter getter, GGKServerDataSetter setter, int maxAsyncInitTimeoutMS);
+
 	// Blocks for up to maxAsyncInitTimeoutMS milliseconds until the server shuts down.
 	//
 	// If shutdown is successful, this method will return a non-zero value. Otherwise, it will return 0.
@@ -222,6 +757,8 @@ extern "C"
 	// If the server fails to stop for some reason, the thread will be killed.
 	//
 	// Typically, a call to this method would follow `ggkTriggerShutdown()`.
+	//
+	// For an attached server (see `ggkAttach()`), this returns 0 at once until the server has reached EStopped.
 	int ggkWait();
 
 	// Tells the server to begin the shutdown process
@@ -237,6 +774,9 @@ extern "C"
 
 	// Convenience method to trigger a shutdown (via `ggkTriggerShutdown()`) and also waits for shutdown to complete (via
 	// `ggkWait()`)
+	//
+	// This is not supported for an attached server (see `ggkAttach()`), which can only finish stopping on a later pass of the
+	// application's main loop.
 	int ggkShutdownAndWait();
 
 	// -----------------------------------------------------------------------------------------------------------------------------
@@ -274,6 +814,15 @@ extern "C"
 	// Convenience method to check ServerRunState for a running server
 	int ggkIsServerRunning();
 
+	// Blocks until the server's run state reaches at least `state` (in the order shown for `GGKServerRunState`), for up to
+	// `timeoutMS` milliseconds, or indefinitely if `timeoutMS` is negative
+	//
+	// This wakes at the instant of the transition, so there is no need to poll `ggkGetServerRunState()`. For example, use
+	// `ggkWaitForRunState(EStopping, -1)` to block until the server begins shutting down.
+	//
+	// Returns non-zero if the state was reached, or 0 if the timeout expired first
+	int ggkWaitForRunState(enum GGKServerRunState state, int timeoutMS);
+
 	// -----------------------------------------------------------------------------------------------------------------------------
 	// SERVER HEALTH
 	// -----------------------------------------------------------------------------------------------------------------------------
@@ -300,6 +849,21 @@ extern "C"
 	// Convert a `GGKServerHealth` into a human-readable string
 	const char *ggkGetServerHealthString(enum GGKServerHealth state);
 
+	// -----------------------------------------------------------------------------------------------------------------------------
+	// STATE CHANGE NOTIFICATION
+	// -----------------------------------------------------------------------------------------------------------------------------
+
+	// Called whenever the server's run state or health changes, with the new state and health
+	//
+	// The callback is called on whichever thread made the change (usually the server's thread), so it should return quickly. It
+	// must not call `ggkWait()` or `ggkShutdownAndWait()`.
+	typedef void (*GGKServerStateCallback)(enum GGKServerRunState runState, enum GGKServerHealth health, void *pUserData);
+
+	// Registers a callback to be called whenever the server's run state or health changes, replacing any registered before
+	//
+	// Register the callback before calling `ggkStart()` to hear about every transition. Pass nullptr to remove the callback.
+	void ggkSetServerStateCallback(GGKServerStateCallback callback, void *pUserData);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
@@ -0,0 +1,251 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A socket handed to BlueZ through `AcquireWrite` or `AcquireNotify`, carrying a characteristic's values without D-Bus
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Every `WriteValue` call and every change notification is a D-Bus message, marshalled and routed through the bus daemon. For a
+// characteristic that moves a lot of data (such as a firmware upload, or a stream of telemetry) that overhead dwarfs the data.
+//
+// BlueZ offers a way around this. If a characteristic has a `WriteAcquired` property, BlueZ calls its `AcquireWrite` method
+// when a client first writes to it without response, and from then on writes each value into the socket it is given instead
+// of calling `WriteValue`. Likewise, with a `NotifyAcquired` property, BlueZ calls `AcquireNotify` when a client subscribes and
+// sends each packet written to the socket as a notification. In both cases BlueZ closes its end of the socket when it is done
+// (such as when the client disconnects or unsubscribes), and passes the connection's MTU in the method's options.
+//
+// This class manages our end of one of those sockets. It is a SOCK_SEQPACKET socket pair, so packet boundaries are preserved,
+// and it is non-blocking. Incoming packets and BlueZ closing its end are handled by a watch on the server's main context.
+// Outgoing data can be sent from any thread; it is split into MTU-sized packets, and anything that does not fit in the socket
+// is dropped rather than blocking the caller.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <glib-unix.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "AcquiredStream.h"
+#include "Init.h"
+#include "Logger.h"
+#include "Stats.h"
+
+namespace ggk {
+
+// The bytes of each ATT packet taken up by its header (opcode and handle)
+static const size_t kAttHeaderSize = 3;
+
+// Closes our socket without calling our releaser, since whoever owns us is being torn down too
+AcquiredStream::~AcquiredStream()
+{
+	std::lock_guard<std::mutex> lock(fdMutex);
+	releaseLocked();
+}
+
+// Creates a new socket pair for a client, replacing any stream already acquired
+//
+// Packets arriving from the client are passed to `receiver` (if provided) from the server's main loop. The stream is released
+// automatically when BlueZ closes its end, and `newReleaser` (if provided) is called whenever the stream is released, other than
+// by our destructor.
+//
+// Returns BlueZ's end of the socket pair, which the caller must send in its reply and then close, or -1 on failure
+int AcquiredStream::acquire(uint16_t newMtu, Receiver newReceiver, void *pNewContext, Releaser newReleaser)
+{
+	release();
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+	{
+		Logger::error(SSTR << "Unable to create an acquired socket pair: " << strerror(errno));
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(fdMutex);
+	fd = fds[0];
+	receiver = newReceiver;
+	releaser = newReleaser;
+	pContext = pNewContext;
+	GSource *pWatch = g_unix_fd_source_new(fd, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR));
+	// A unix fd source calls back with the fd and condition; casting through a generic function pointer (as G_SOURCE_FUNC()
+	// does) says that this is intended
+	watchId = addServerSource(pWatch, reinterpret_cast<GSourceFunc>(reinterpret_cast<void (*)(void)>(onSocketEvent)), this);
+	mtu.store(newMtu < kDefaultMtu ? kDefaultMtu : newMtu, std::memory_order_release);
+	return fds[1];
+}
+
+// Closes our end of the socket, if we have one, calling our releaser if it was open
+void AcquiredStream::release()
+{
+	Releaser currentReleaser;
+	void *pCurrentContext;
+	{
+		std::lock_guard<std::mutex> lock(fdMutex);
+		if (!releaseLocked())
+		{
+			return;
+		}
+
+		currentReleaser = releaser;
+		pCurrentContext = pContext;
+	}
+
+	if (nullptr != currentReleaser)
+	{
+		currentReleaser(pCurrentContext);
+	}
+}
+
+// Removes our watch and closes our socket; the caller must hold `fdMutex`
+//
+// Returns true if the socket was open
+bool AcquiredStream::releaseLocked()
+{
+	if (0 != watchId)
+	{
+		removeServerSource(watchId);
+		watchId = 0;
+	}
+
+	bool wasOpen = fd >= 0;
+	closeLocked();
+	return wasOpen;
+}
+
+// Closes our socket; the caller must hold `fdMutex`
+void AcquiredStream::closeLocked()
+{
+	mtu.store(0, std::memory_order_release);
+	if (fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+
+// Returns the most bytes of value a single packet can carry (the MTU less the ATT header), or 0 if the stream is not acquired
+size_t AcquiredStream::getMaxPacketSize() const
+{
+	uint16_t currentMtu = getMtu();
+	return currentMtu > kAttHeaderSize ? currentMtu - kAttHeaderSize : 0;
+}
+
+// Sends `size` bytes to the client, split into as many packets as needed
+//
+// This may be called from any thread. The socket is never blocked on; if it is full (or the stream is released part of the way
+// through), the remaining packets are dropped.
+//
+// Returns true if everything was sent, otherwise false
+bool AcquiredStream::send(const void *pData, size_t size)
+{
+	const guint8 *pBytes = static_cast<const guint8 *>(pData);
+
+	std::lock_guard<std::mutex> lock(fdMutex);
+	size_t packetSize = getMaxPacketSize();
+	if (fd < 0 || 0 == packetSize)
+	{
+		Stats::increment(Stats::getInstance().streamPacketsDropped);
+		return false;
+	}
+
+	while (size > 0)
+	{
+		size_t chunk = size < packetSize ? size : packetSize;
+		if (::send(fd, pBytes, chunk, MSG_NOSIGNAL | MSG_DONTWAIT) < 0)
+		{
+			// BlueZ closing its end is reported to our watch, which releases the stream
+			GGK_LOG_DEBUG("Unable to send to an acquired socket: " << strerror(errno));
+			Stats::increment(Stats::getInstance().streamPacketsDropped);
+			return false;
+		}
+
+		Stats::increment(Stats::getInstance().streamPacketsSent);
+		pBytes += chunk;
+		size -= chunk;
+	}
+
+	return true;
+}
+
+// Handles a readable, closed or failed socket (runs on the server's thread)
+gboolean AcquiredStream::onSocketEvent(gint eventFd, GIOCondition condition, gpointer pUserData)
+{
+	AcquiredStream &self = *static_cast<AcquiredStream *>(pUserData);
+
+	guint8 packet[kMaxPacketSize];
+	for (int i = 0; i < kMaxPacketsPerDispatch && (condition & G_IO_IN); ++i)
+	{
+		ssize_t size;
+		Receiver receiver;
+		void *pContext;
+		{
+			std::lock_guard<std::mutex> lock(self.fdMutex);
+			if (self.fd != eventFd)
+			{
+				return FALSE;
+			}
+
+			size = recv(eventFd, packet, sizeof(packet), MSG_DONTWAIT);
+			receiver = self.receiver;
+			pContext = self.pContext;
+		}
+
+		// Nothing more to read for now; BlueZ closing its end also reads as zero bytes
+		if (size < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+		{
+			break;
+		}
+		else if (size <= 0)
+		{
+			condition = static_cast<GIOCondition>(condition | G_IO_HUP);
+			break;
+		}
+
+		Stats::increment(Stats::getInstance().streamPacketsReceived);
+		if (nullptr != receiver)
+		{
+			receiver(packet, static_cast<size_t>(size), pContext);
+		}
+	}
+
+	if (condition & (G_IO_HUP | G_IO_ERR))
+	{
+		Releaser releaser = nullptr;
+		void *pContext = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(self.fdMutex);
+			if (self.fd == eventFd)
+			{
+				GGK_LOG_DEBUG("Acquired socket released by BlueZ");
+
+				// Returning FALSE removes our watch
+				self.watchId = 0;
+				self.closeLocked();
+				releaser = self.releaser;
+				pContext = self.pContext;
+			}
+		}
+
+		if (nullptr != releaser)
+		{
+			releaser(pContext);
+		}
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+}; // namespace ggk
@@ -0,0 +1,109 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A socket handed to BlueZ through `AcquireWrite` or `AcquireNotify`, carrying a characteristic's values without D-Bus
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of AcquiredStream.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+
+namespace ggk {
+
+class AcquiredStream
+{
+public:
+	// Called (on the server's thread) with each packet received from the client
+	typedef void (*Receiver)(const guint8 *pData, size_t size, void *pContext);
+
+	// Called when a stream that was acquired is released, by BlueZ closing its end or by `release()`
+	typedef void (*Releaser)(void *pContext);
+
+	// The MTU we assume when BlueZ doesn't tell us one (the minimum ATT MTU)
+	static const uint16_t kDefaultMtu = 23;
+
+	// The largest packet we'll read from the socket (the largest value an attribute may hold)
+	static const size_t kMaxPacketSize = 512;
+
+	// The most packets we'll read in one pass of the main loop, so a busy client can't starve everything else
+	static const int kMaxPacketsPerDispatch = 32;
+
+	AcquiredStream() : fd(-1), watchId(0), mtu(0), receiver(nullptr), releaser(nullptr), pContext(nullptr) {}
+	~AcquiredStream();
+
+	// Creates a new socket pair for a client, replacing any stream already acquired
+	//
+	// Packets arriving from the client are passed to `receiver` (if provided) from the server's main loop. The stream is released
+	// automatically when BlueZ closes its end, and `releaser` (if provided) is called whenever the stream is released, other than
+	// by our destructor.
+	//
+	// Returns BlueZ's end of the socket pair, which the caller must send in its reply and then close, or -1 on failure
+	int acquire(uint16_t mtu, Receiver receiver, void *pContext, Releaser releaser = nullptr);
+
+	// Closes our end of the socket, if we have one, calling our releaser if it was open
+	void release();
+
+	// Returns true if a client currently holds this stream
+	bool isAcquired() const { return mtu.load(std::memory_order_acquire) != 0; }
+
+	// Returns the MTU agreed with BlueZ, or 0 if the stream is not acquired
+	uint16_t getMtu() const { return mtu.load(std::memory_order_acquire); }
+
+	// Returns the most bytes of value a single packet can carry (the MTU less the ATT header), or 0 if the stream is not acquired
+	size_t getMaxPacketSize() const;
+
+	// Sends `size` bytes to the client, split into as many packets as needed
+	//
+	// This may be called from any thread. The socket is never blocked on; if it is full (or the stream is released part of the
+	// way through), the remaining packets are dropped.
+	//
+	// Returns true if everything was sent, otherwise false
+	bool send(const void *pData, size_t size);
+
+private:
+
+	// Prevent copying
+	AcquiredStream(AcquiredStream const &) = delete;
+	void operator=(AcquiredStream const &) = delete;
+
+	// Handles a readable, closed or failed socket (runs on the server's thread)
+	static gboolean onSocketEvent(gint eventFd, GIOCondition condition, gpointer pUserData);
+
+	// Removes our watch and closes our socket; the caller must hold `fdMutex`
+	//
+	// Returns true if the socket was open
+	bool releaseLocked();
+
+	// Closes our socket; the caller must hold `fdMutex`
+	void closeLocked();
+
+	std::mutex fdMutex;
+	int fd;
+	guint watchId;
+	std::atomic<uint16_t> mtu;
+	Receiver receiver;
+	Releaser releaser;
+	void *pContext;
+};
+
+}; // namespace ggk
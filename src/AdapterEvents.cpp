@@ -0,0 +1,280 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The application's subscriptions to events reported by the adapter
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// The adapter's event thread (see `HciAdapter::runEventThread()`) first reported events to the application by calling the data
+// setter with names like "GGK/EVENT/EClientConnected". That puts every event through the application's string comparisons, and
+// anything slow in the setter holds up the adapter's reads.
+//
+// A subscription instead names the events it wants with a mask, and receives each one as a `GGKAdapterEvent`: a plain struct
+// that can be copied without allocating. The adapter checks `wants()` before building an event, so an event that no
+// subscription asks for is never built. Each subscription chooses how its events are delivered:
+//
+//     * Inline, calling the callback on the adapter's event thread. This is the quickest, but the callback must be brief.
+//
+//     * Queued, pushing the event onto the subscription's lock-free ring buffer and signalling an eventfd. The application
+//       waits on the eventfd on a thread of its choosing and calls `ggkDispatchAdapterEvents()` there, so its callback can take
+//       as long as it likes without the adapter waiting on it. If the queue fills, events are dropped (and counted) rather than
+//       blocking the adapter.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "AdapterEvents.h"
+#include "Logger.h"
+
+namespace ggk {
+
+// Closes the eventfds of any subscriptions still active at exit
+AdapterEvents::~AdapterEvents()
+{
+	for (Subscription &entry : subscriptions)
+	{
+		if (entry.eventFd >= 0)
+		{
+			close(entry.eventFd);
+			entry.eventFd = -1;
+		}
+	}
+}
+
+// Delivers an event to every subscription that wants it (runs on the adapter's event thread)
+void AdapterEvents::publish(const GGKAdapterEvent &event)
+{
+	std::lock_guard<std::recursive_mutex> lock(subscriptionsMutex);
+	for (Subscription &entry : subscriptions)
+	{
+		if (0 == (entry.eventMask.load(std::memory_order_acquire) & event.type))
+		{
+			continue;
+		}
+
+		if (EAdapterEventDeliveryInline == entry.delivery)
+		{
+			entry.callback(&event, entry.pUserData);
+			continue;
+		}
+
+		if (!entry.queue.push(event))
+		{
+			entry.dropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		uint64_t one = 1;
+		if (write(entry.eventFd, &one, sizeof(one)) < 0 && EAGAIN != errno)
+		{
+			GGK_LOG_DEBUG("Unable to signal an adapter event subscription: " << strerror(errno));
+		}
+	}
+}
+
+// Adds a subscription, returning its id, or -1 if the parameters are invalid or all subscriptions are in use
+int AdapterEvents::subscribe(unsigned int eventMask, GGKAdapterEventCallback callback, void *pUserData, GGKAdapterEventDelivery delivery)
+{
+	eventMask &= EAdapterEventAll;
+	if (0 == eventMask || nullptr == callback || (EAdapterEventDeliveryInline != delivery && EAdapterEventDeliveryQueued != delivery))
+	{
+		return -1;
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(subscriptionsMutex);
+	for (int id = 0; id < kMaxSubscriptions; ++id)
+	{
+		// A slot still being dispatched from belongs to the subscription that is ending
+		Subscription &entry = subscriptions[id];
+		if (0 != entry.eventMask.load(std::memory_order_relaxed) || 0 != entry.dispatching)
+		{
+			continue;
+		}
+
+		if (EAdapterEventDeliveryQueued == delivery)
+		{
+			entry.eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (entry.eventFd < 0)
+			{
+				Logger::error(SSTR << "Unable to create an eventfd for an adapter event subscription: " << strerror(errno));
+				return -1;
+			}
+		}
+
+		entry.callback = callback;
+		entry.pUserData = pUserData;
+		entry.delivery = delivery;
+		entry.dropped.store(0, std::memory_order_relaxed);
+		entry.eventMask.store(eventMask, std::memory_order_release);
+		updateCombinedMask();
+		return id;
+	}
+
+	Logger::error(SSTR << "Unable to subscribe to adapter events: all " << kMaxSubscriptions << " subscriptions are in use");
+	return -1;
+}
+
+// Ends a subscription
+//
+// Returns true on success, or false if there is no such subscription
+bool AdapterEvents::unsubscribe(int subscription)
+{
+	std::lock_guard<std::recursive_mutex> lock(subscriptionsMutex);
+	Subscription *pEntry = findLocked(subscription, false);
+	if (nullptr == pEntry)
+	{
+		return false;
+	}
+
+	pEntry->eventMask.store(0, std::memory_order_release);
+	updateCombinedMask();
+
+	// Discard anything left waiting, so the slot starts out empty when it is reused (a dispatch in progress does this itself,
+	// since the queue is its to drain)
+	if (0 == pEntry->dispatching)
+	{
+		GGKAdapterEvent event;
+		while (pEntry->queue.pop(event)) {}
+	}
+
+	if (pEntry->eventFd >= 0)
+	{
+		close(pEntry->eventFd);
+		pEntry->eventFd = -1;
+	}
+
+	pEntry->callback = nullptr;
+	pEntry->pUserData = nullptr;
+	return true;
+}
+
+// Calls a queued subscription's callback for up to `maxEvents` of its waiting events (all of them if `maxEvents` <= 0)
+//
+// The callback is called without our lock held, so that it can take as long as it needs without holding up the adapter. We hold
+// a reference on the slot while we do (see `Subscription::dispatching`), so that if the subscription ends part of the way through,
+// the slot can't be reused and we stop delivering.
+//
+// Returns the number of events delivered, or -1 if there is no such queued subscription
+int AdapterEvents::dispatch(int subscription, int maxEvents)
+{
+	Subscription *pEntry;
+	GGKAdapterEventCallback callback;
+	void *pUserData;
+	{
+		std::lock_guard<std::recursive_mutex> lock(subscriptionsMutex);
+		pEntry = findLocked(subscription, true);
+		if (nullptr == pEntry)
+		{
+			return -1;
+		}
+
+		callback = pEntry->callback;
+		pUserData = pEntry->pUserData;
+		pEntry->dispatching += 1;
+
+		// Reset the eventfd before draining, so that an event arriving from here on signals it again
+		uint64_t count;
+		if (read(pEntry->eventFd, &count, sizeof(count)) < 0 && EAGAIN != errno)
+		{
+			GGK_LOG_DEBUG("Unable to read an adapter event subscription's eventfd: " << strerror(errno));
+		}
+	}
+
+	int delivered = 0;
+	GGKAdapterEvent event;
+	while ((maxEvents <= 0 || delivered < maxEvents) && 0 != pEntry->eventMask.load(std::memory_order_acquire) && pEntry->queue.pop(event))
+	{
+		callback(&event, pUserData);
+		delivered += 1;
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(subscriptionsMutex);
+	pEntry->dispatching -= 1;
+
+	// If the subscription ended while we were delivering, its queue was left for us to empty
+	if (0 == pEntry->eventMask.load(std::memory_order_relaxed))
+	{
+		if (0 == pEntry->dispatching)
+		{
+			while (pEntry->queue.pop(event)) {}
+		}
+
+		return delivered;
+	}
+
+	// Anything we were asked to leave for next time keeps the eventfd readable
+	if (!pEntry->queue.empty() && pEntry->eventFd >= 0)
+	{
+		uint64_t one = 1;
+		if (write(pEntry->eventFd, &one, sizeof(one)) < 0 && EAGAIN != errno)
+		{
+			GGK_LOG_DEBUG("Unable to signal an adapter event subscription: " << strerror(errno));
+		}
+	}
+
+	return delivered;
+}
+
+// Returns the descriptor that is readable while a queued subscription has events waiting, or -1
+int AdapterEvents::getEventFd(int subscription)
+{
+	std::lock_guard<std::recursive_mutex> lock(subscriptionsMutex);
+	Subscription *pEntry = findLocked(subscription, true);
+	return nullptr == pEntry ? -1 : pEntry->eventFd;
+}
+
+// Returns the number of events dropped because a queued subscription's queue was full
+unsigned long AdapterEvents::getDroppedCount(int subscription)
+{
+	std::lock_guard<std::recursive_mutex> lock(subscriptionsMutex);
+	Subscription *pEntry = findLocked(subscription, true);
+	return nullptr == pEntry ? 0 : pEntry->dropped.load(std::memory_order_relaxed);
+}
+
+// Returns the subscription with the given id if it is active (and queued, if `queuedOnly`), otherwise nullptr
+//
+// The caller must hold `subscriptionsMutex`.
+AdapterEvents::Subscription *AdapterEvents::findLocked(int subscription, bool queuedOnly)
+{
+	if (subscription < 0 || subscription >= kMaxSubscriptions)
+	{
+		return nullptr;
+	}
+
+	Subscription &entry = subscriptions[subscription];
+	if (0 == entry.eventMask.load(std::memory_order_relaxed) || (queuedOnly && EAdapterEventDeliveryQueued != entry.delivery))
+	{
+		return nullptr;
+	}
+
+	return &entry;
+}
+
+// Recalculates `combinedMask` from the active subscriptions (the caller must hold `subscriptionsMutex`)
+void AdapterEvents::updateCombinedMask()
+{
+	unsigned int mask = 0;
+	for (const Subscription &entry : subscriptions)
+	{
+		mask |= entry.eventMask.load(std::memory_order_relaxed);
+	}
+
+	combinedMask.store(mask, std::memory_order_release);
+}
+
+}; // namespace ggk
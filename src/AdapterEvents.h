@@ -0,0 +1,121 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The application's subscriptions to events reported by the adapter
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of AdapterEvents.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "../include/Gobbledegook.h"
+#include "RingBuffer.h"
+
+namespace ggk {
+
+struct AdapterEvents
+{
+	// The most subscriptions that can be active at once
+	static const int kMaxSubscriptions = 8;
+
+	// The number of events that can wait in a queued subscription's queue before further events are dropped
+	static const size_t kQueueSize = 128;
+
+	// Retrieve our singleton instance
+	static AdapterEvents &getInstance()
+	{
+		static AdapterEvents instance;
+		return instance;
+	}
+
+	// Returns true if any subscription wants events of the given type
+	//
+	// The adapter checks this before building an event, so that events nobody wants cost nothing more than this check.
+	bool wants(GGKAdapterEventType type) const { return 0 != (combinedMask.load(std::memory_order_acquire) & type); }
+
+	// Delivers an event to every subscription that wants it (runs on the adapter's event thread)
+	void publish(const GGKAdapterEvent &event);
+
+	// Adds a subscription, returning its id, or -1 if the parameters are invalid or all subscriptions are in use
+	int subscribe(unsigned int eventMask, GGKAdapterEventCallback callback, void *pUserData, GGKAdapterEventDelivery delivery);
+
+	// Ends a subscription
+	//
+	// Returns true on success, or false if there is no such subscription
+	bool unsubscribe(int subscription);
+
+	// Calls a queued subscription's callback for up to `maxEvents` of its waiting events (all of them if `maxEvents` <= 0)
+	//
+	// Returns the number of events delivered, or -1 if there is no such queued subscription
+	int dispatch(int subscription, int maxEvents);
+
+	// Returns the descriptor that is readable while a queued subscription has events waiting, or -1
+	int getEventFd(int subscription);
+
+	// Returns the number of events dropped because a queued subscription's queue was full
+	unsigned long getDroppedCount(int subscription);
+
+private:
+
+	AdapterEvents() : combinedMask(0) {}
+	~AdapterEvents();
+
+	// Prevent copying
+	AdapterEvents(AdapterEvents const &) = delete;
+	void operator=(AdapterEvents const &) = delete;
+
+	struct Subscription
+	{
+		// The events this subscription wants, or 0 if the slot is unused
+		std::atomic<unsigned int> eventMask{0};
+
+		GGKAdapterEventCallback callback = nullptr;
+		void *pUserData = nullptr;
+		GGKAdapterEventDelivery delivery = EAdapterEventDeliveryInline;
+
+		// Queued subscriptions only: the waiting events and an eventfd that is readable while there are any
+		RingBuffer<GGKAdapterEvent, kQueueSize> queue;
+		int eventFd = -1;
+		std::atomic<unsigned long> dropped{0};
+
+		// The number of `dispatch()` calls draining the queue right now (protected by `subscriptionsMutex`)
+		//
+		// While this is non-zero, the dispatching thread owns the queue: an ended subscription leaves the queue for it to empty,
+		// and the slot is not reused, so no event for a later subscription can reach this subscription's callback.
+		int dispatching = 0;
+	};
+
+	// Returns the subscription with the given id if it is active (and queued, if `queuedOnly`), otherwise nullptr
+	//
+	// The caller must hold `subscriptionsMutex`.
+	Subscription *findLocked(int subscription, bool queuedOnly);
+
+	// Recalculates `combinedMask` from the active subscriptions (the caller must hold `subscriptionsMutex`)
+	void updateCombinedMask();
+
+	Subscription subscriptions[kMaxSubscriptions];
+	std::atomic<unsigned int> combinedMask;
+
+	// Held while subscriptions change and while inline callbacks run, so that a subscription's callback is never called after
+	// it has ended. It is recursive so that an inline callback may end its own subscription.
+	std::recursive_mutex subscriptionsMutex;
+};
+
+}; // namespace ggk
@@ -91,13 +91,13 @@ DBusObject &DBusInterface::getOwner() const
 }
 
 // Returns the path node of this interface's owner
-DBusObjectPath DBusInterface::getPathNode() const
+const DBusObjectPath &DBusInterface::getPathNode() const
 {
 	return owner.getPathNode();
 }
 
 // Returns the full path of this interface's owner
-DBusObjectPath DBusInterface::getPath() const
+const DBusObjectPath &DBusInterface::getPath() const
 {
 	return owner.getPath();
 }
@@ -115,6 +115,12 @@ DBusInterface &DBusInterface::addMethod(const std::string &name, const char *pIn
 	return *this;
 }
 
+// Returns the list of D-Bus methods on this interface
+const std::vector<DBusMethod> &DBusInterface::getMethods() const
+{
+	return methods;
+}
+
 // Calls a named method on this interface
 //
 // This method returns false if the method could not be found, otherwise it returns true. Note that the return value is not related
@@ -136,6 +142,14 @@ bool DBusInterface::callMethod(const std::string &methodName, GDBusConnection *p
 	return false;
 }
 
+// Invokes a method (which must belong to this interface) that has already been located, such as through the server's index
+//
+// NOTE: Subclasses that override `callMethod()` should also override this method so the callback receives the correct type.
+void DBusInterface::invokeMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
+{
+	method.call<DBusInterface>(pConnection, getPath(), getName(), method.getName(), pParameters, pInvocation, pUserData);
+}
+
 // Add an event to this interface
 //
 // For details on events, see TickEvent.cpp.
@@ -151,6 +165,17 @@ DBusInterface &DBusInterface::onEvent(int tickFrequency, void *pUserData, TickEv
 	return *this;
 }
 
+// Adds an event that fires every `periodMS` milliseconds
+//
+// For details on events, see TickEvent.cpp.
+//
+// This method returns a reference to `this` in order to enable chaining inside the server description.
+DBusInterface &DBusInterface::onEventMS(int periodMS, void *pUserData, TickEvent::Callback callback)
+{
+	events.push_back(TickEvent::fromPeriodMS(this, periodMS, callback, pUserData));
+	return *this;
+}
+
 // Ticks each event within this interface
 //
 // For details on events, see TickEvent.cpp.
@@ -165,6 +190,12 @@ void DBusInterface::tickEvents(GDBusConnection *pConnection, void *pUserData) co
 	}
 }
 
+// Fires one of our events (used by the event timer)
+void DBusInterface::fireEvent(const TickEvent &event, GDBusConnection *pConnection, void *pUserData) const
+{
+	event.fire<DBusInterface>(getPath(), pConnection, pUserData);
+}
+
 // Internal method used to generate introspection XML used to describe our services on D-Bus
 std::string DBusInterface::generateIntrospectionXML(int depth) const
 {
@@ -193,4 +224,13 @@ std::string DBusInterface::generateIntrospectionXML(int depth) const
 	return xml;
 }
 
+// Releases any spare capacity held by the interface once the server description is complete (see `Server::freeze()`)
+//
+// NOTE: Subclasses that store anything of their own should override this method (and call this one.)
+void DBusInterface::shrinkToFit()
+{
+	methods.shrink_to_fit();
+	events.shrink_to_fit();
+}
+
 }; // namespace ggk
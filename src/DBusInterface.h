@@ -24,7 +24,7 @@
 
 #include <gio/gio.h>
 #include <string>
-#include <list>
+#include <vector>
 
 #include "TickEvent.h"
 #include "DBusMethod.h"
@@ -95,8 +95,8 @@ struct DBusInterface
 	//
 
 	DBusObject &getOwner() const;
-	DBusObjectPath getPathNode() const;
-	DBusObjectPath getPath() const;
+	const DBusObjectPath &getPathNode() const;
+	const DBusObjectPath &getPath() const;
 
 	//
 	// D-Bus interface methods
@@ -104,10 +104,18 @@ struct DBusInterface
 
 	DBusInterface &addMethod(const std::string &name, const char *pInArgs[], const char *pOutArgs, DBusMethod::Callback callback);
 
+	// Returns the list of D-Bus methods on this interface
+	const std::vector<DBusMethod> &getMethods() const;
+
 	// NOTE: Subclasses are encouraged to override this method in order to support different callback types that are specific to
 	// their subclass type.
 	virtual bool callMethod(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 
+	// Invokes a method (which must belong to this interface) that has already been located, such as through the server's index
+	//
+	// NOTE: Subclasses that override `callMethod()` should also override this method so the callback receives the correct type.
+	virtual void invokeMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
+
 	//
 	// Interface events (our home-grown poor-mans's method of allowing interfaces to do things periodically)
 	//
@@ -117,18 +125,36 @@ struct DBusInterface
 	// calls to chain.
 	DBusInterface &onEvent(int tickFrequency, void *pUserData, TickEvent::Callback callback);
 
+	// Adds an event that fires every `periodMS` milliseconds
+	//
+	// NOTE: As with `onEvent()`, subclasses are encouraged to overload this method.
+	DBusInterface &onEventMS(int periodMS, void *pUserData, TickEvent::Callback callback);
+
+	// Returns the list of events on this interface
+	const std::vector<TickEvent> &getEvents() const { return events; }
+
 	// NOTE: Subclasses are encouraged to override this method in order to support different callback types that are specific to
 	// their subclass type.
 	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData) const;
 
+	// Fires one of our events (used by the event timer)
+	//
+	// NOTE: Subclasses that override `tickEvents()` should also override this method so the callback receives the correct type.
+	virtual void fireEvent(const TickEvent &event, GDBusConnection *pConnection, void *pUserData) const;
+
 	// Internal method used to generate introspection XML used to describe our services on D-Bus
 	virtual std::string generateIntrospectionXML(int depth) const;
 
+	// Releases any spare capacity held by the interface once the server description is complete (see `Server::freeze()`)
+	//
+	// NOTE: Subclasses that store anything of their own should override this method (and call this one.)
+	virtual void shrinkToFit();
+
 protected:
 	DBusObject &owner;
 	std::string name;
-	std::list<DBusMethod> methods;
-	std::list<TickEvent> events;
+	std::vector<DBusMethod> methods;
+	std::vector<TickEvent> events;
 };
 
 }; // namespace ggk
\ No newline at end of file
@@ -66,12 +66,21 @@ std::string DBusMethod::generateIntrospectionXML(int depth) const
 		xml += prefix + "  </arg>\n";
 	}
 
-	const std::string &outArgs = getOutArgs();
-	if (!outArgs.empty())
+	// Add our output arguments, one per complete type (a method such as `AcquireWrite` returns more than one value: "hq")
+	const gchar *pOutArgs = getOutArgs().c_str();
+	while (*pOutArgs)
 	{
-		xml += prefix + "  <arg type='" + outArgs + "' direction='out'>\n";
+		const gchar *pEnd = nullptr;
+		if (!g_variant_type_string_scan(pOutArgs, nullptr, &pEnd))
+		{
+			Logger::error(SSTR << "Invalid output argument types for method '" << getName() << "': " << getOutArgs());
+			break;
+		}
+
+		xml += prefix + "  <arg type='" + std::string(pOutArgs, pEnd) + "' direction='out'>\n";
 		xml += prefix + "    <annotation name='org.gtk.GDBus.C.ForceGVariant' value='true' />\n";
 		xml += prefix + "  </arg>\n";
+		pOutArgs = pEnd;
 	}
 
 	xml += prefix + "</method>\n";
@@ -52,7 +52,7 @@ namespace ggk {
 //
 // We'll include a publish flag since only root objects can be published
 DBusObject::DBusObject(const DBusObjectPath &path, bool publish)
-: publish(publish), path(path), pParent(nullptr)
+: publish(publish), path(path), fullPath(DBusObjectPath() + path), pParent(nullptr)
 {
 }
 
@@ -60,7 +60,7 @@ DBusObject::DBusObject(const DBusObjectPath &path, bool publish)
 //
 // Nodes inherit their parent's publish path
 DBusObject::DBusObject(DBusObject *pParent, const DBusObjectPath &pathElement)
-: publish(pParent->publish), path(pathElement), pParent(pParent)
+: publish(pParent->publish), path(pathElement), fullPath(pParent->fullPath + pathElement), pParent(pParent)
 {
 }
 
@@ -85,19 +85,11 @@ const DBusObjectPath &DBusObject::getPathNode() const
 // Returns the full path for this object within the hierarchy
 //
 // This method returns the full path. To get the current node, use `getPathNode()`
-DBusObjectPath DBusObject::getPath() const
+//
+// The full path is built once, when the object is created, so this does not allocate.
+const DBusObjectPath &DBusObject::getPath() const
 {
-	DBusObjectPath path = getPathNode();
-	const DBusObject *pCurrent = pParent;
-
-	// Traverse up my chain, adding nodes to the path until we have the full thing
-	while(nullptr != pCurrent)
-	{
-		path = pCurrent->getPathNode() + path;
-		pCurrent = pCurrent->pParent;
-	}
-
-	return path;
+	return fullPath;
 }
 
 // Returns the parent object in the hierarchy
@@ -141,14 +133,21 @@ GattService &DBusObject::gattServiceBegin(const std::string &pathElement, const
 // Helpful routines for searching objects
 //
 
-// Finds an interface by name within this D-Bus object
-std::shared_ptr<const DBusInterface> DBusObject::findInterface(const DBusObjectPath &path, const std::string &interfaceName, const DBusObjectPath &basePath) const
+// Finds an interface by name within this D-Bus object (or its children)
+//
+// Only the branch of the hierarchy that could contain `pPath` is searched, and no paths are built along the way.
+std::shared_ptr<const DBusInterface> DBusObject::findInterface(const char *pPath, const char *pInterfaceName) const
 {
-	if ((basePath + getPathNode()) == path)
+	if (!fullPath.contains(pPath))
 	{
-		for (std::shared_ptr<const DBusInterface> interface : interfaces)
+		return nullptr;
+	}
+
+	if (fullPath == pPath)
+	{
+		for (const std::shared_ptr<DBusInterface> &interface : interfaces)
 		{
-			if (interfaceName == interface->getName())
+			if (interface->getName() == pInterfaceName)
 			{
 				return interface;
 			}
@@ -157,7 +156,7 @@ std::shared_ptr<const DBusInterface> DBusObject::findInterface(const DBusObjectP
 
 	for (const DBusObject &child : getChildren())
 	{
-		std::shared_ptr<const DBusInterface> pInterface = child.findInterface(path, interfaceName, basePath + getPathNode());
+		std::shared_ptr<const DBusInterface> pInterface = child.findInterface(pPath, pInterfaceName);
 		if (nullptr != pInterface)
 		{
 			return pInterface;
@@ -167,16 +166,29 @@ std::shared_ptr<const DBusInterface> DBusObject::findInterface(const DBusObjectP
 	return nullptr;
 }
 
+// Finds an interface by name within this D-Bus object (or its children)
+std::shared_ptr<const DBusInterface> DBusObject::findInterface(const DBusObjectPath &path, const std::string &interfaceName) const
+{
+	return findInterface(path.c_str(), interfaceName.c_str());
+}
+
 // Finds a BlueZ method by name within the specified D-Bus interface
-bool DBusObject::callMethod(const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData, const DBusObjectPath &basePath) const
+//
+// As with `findInterface()`, only the branch of the hierarchy that could contain `pPath` is searched.
+bool DBusObject::callMethod(const char *pPath, const char *pInterfaceName, const char *pMethodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
 {
-	if ((basePath + getPathNode()) == path)
+	if (!fullPath.contains(pPath))
+	{
+		return false;
+	}
+
+	if (fullPath == pPath)
 	{
-		for (std::shared_ptr<const DBusInterface> interface : interfaces)
+		for (const std::shared_ptr<DBusInterface> &interface : interfaces)
 		{
-			if (interfaceName == interface->getName())
+			if (interface->getName() == pInterfaceName)
 			{
-				if (interface->callMethod(methodName, pConnection, pParameters, pInvocation, pUserData))
+				if (interface->callMethod(pMethodName, pConnection, pParameters, pInvocation, pUserData))
 				{
 					return true;
 				}
@@ -186,7 +198,7 @@ bool DBusObject::callMethod(const DBusObjectPath &path, const std::string &inter
 
 	for (const DBusObject &child : getChildren())
 	{
-		if (child.callMethod(path, interfaceName, methodName, pConnection, pParameters, pInvocation, pUserData, basePath + getPathNode()))
+		if (child.callMethod(pPath, pInterfaceName, pMethodName, pConnection, pParameters, pInvocation, pUserData))
 		{
 			return true;
 		}
@@ -195,10 +207,16 @@ bool DBusObject::callMethod(const DBusObjectPath &path, const std::string &inter
 	return false;
 }
 
+// Finds a BlueZ method by name within the specified D-Bus interface
+bool DBusObject::callMethod(const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
+{
+	return callMethod(path.c_str(), interfaceName.c_str(), methodName.c_str(), pConnection, pParameters, pInvocation, pUserData);
+}
+
 // Periodic timer tick propagation
 void DBusObject::tickEvents(GDBusConnection *pConnection, void *pUserData) const
 {
-	for (std::shared_ptr<const DBusInterface> interface : interfaces)
+	for (const std::shared_ptr<DBusInterface> &interface : interfaces)
 	{
 		interface->tickEvents(pConnection, pUserData);
 	}
@@ -209,6 +227,21 @@ void DBusObject::tickEvents(GDBusConnection *pConnection, void *pUserData) const
 	}
 }
 
+// Releases any spare capacity held by this object, its interfaces and its children (see `Server::freeze()`)
+void DBusObject::shrinkToFit()
+{
+	interfaces.shrink_to_fit();
+	for (const std::shared_ptr<DBusInterface> &interface : interfaces)
+	{
+		interface->shrinkToFit();
+	}
+
+	for (DBusObject &child : children)
+	{
+		child.shrinkToFit();
+	}
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // XML generation for a D-Bus introspection
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -230,12 +263,12 @@ std::string DBusObject::generateIntrospectionXML(int depth) const
 	xml += prefix + "<node name='" + getPathNode().toString() + "'>\n";
 	xml += prefix + "  <annotation name='" + TheServer->getServiceName() + ".DBusObject.path' value='" + getPath().toString() + "' />\n";
 
-	for (std::shared_ptr<const DBusInterface> interface : interfaces)
+	for (const std::shared_ptr<DBusInterface> &interface : interfaces)
 	{
 		xml += interface->generateIntrospectionXML(depth + 1);
 	}
 
-	for (DBusObject child : getChildren())
+	for (const DBusObject &child : getChildren())
 	{
 		xml += child.generateIntrospectionXML(depth + 1);
 	}
@@ -256,7 +289,7 @@ std::string DBusObject::generateIntrospectionXML(int depth) const
 // ---------------------------------------------------------------------------------------------------------------------------------
 
 // Emits a signal on the bus from the given path, interface name and signal name, containing a GVariant set of parameters
-void DBusObject::emitSignal(GDBusConnection *pBusConnection, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters)
+void DBusObject::emitSignal(GDBusConnection *pBusConnection, const char *pInterfaceName, const char *pSignalName, GVariant *pParameters) const
 {
 	GError *pError = nullptr;
 	gboolean result = g_dbus_connection_emit_signal
@@ -264,15 +297,16 @@ void DBusObject::emitSignal(GDBusConnection *pBusConnection, const std::string &
 		pBusConnection,          // GDBusConnection *connection
 		NULL,                    // const gchar *destination_bus_name
 		getPath().c_str(),       // const gchar *object_path
-		interfaceName.c_str(),   // const gchar *interface_name
-		signalName.c_str(),      // const gchar *signal_name
+		pInterfaceName,          // const gchar *interface_name
+		pSignalName,             // const gchar *signal_name
 		pParameters,             // GVariant *parameters
 		&pError                  // GError **error
 	);
 
 	if (0 == result)
 	{
-		Logger::error(SSTR << "Failed to emit signal named '" << signalName << "': " << (nullptr == pError ? "Unknown" : pError->message));
+		Logger::error(SSTR << "Failed to emit signal named '" << pSignalName << "': " << (nullptr == pError ? "Unknown" : pError->message));
+		g_clear_error(&pError);
 	}
 }
 
@@ -25,6 +25,7 @@
 #include <gio/gio.h>
 #include <string>
 #include <list>
+#include <vector>
 #include <memory>
 
 #include "DBusObjectPath.h"
@@ -39,7 +40,7 @@ struct DBusInterface;
 struct DBusObject
 {
 	// A convenience typedef for describing our list of interface
-	typedef std::list<std::shared_ptr<DBusInterface> > InterfaceList;
+	typedef std::vector<std::shared_ptr<DBusInterface> > InterfaceList;
 
 	// Construct a root object with no parent
 	//
@@ -66,7 +67,9 @@ struct DBusObject
 	// Returns the full path for this object within the hierarchy
 	//
 	// This method returns the full path. To get the current node, use `getPathNode()`
-	DBusObjectPath getPath() const;
+	//
+	// The full path is built once, when the object is created, so this does not allocate.
+	const DBusObjectPath &getPath() const;
 
 	// Returns the parent object in the hierarchy
 	DBusObject &getParent();
@@ -102,26 +105,46 @@ struct DBusObject
 	// Helpful routines for searching objects
 	//
 
-	// Finds an interface by name within this D-Bus object
-	std::shared_ptr<const DBusInterface> findInterface(const DBusObjectPath &path, const std::string &interfaceName, const DBusObjectPath &basePath = DBusObjectPath()) const;
+	// Finds an interface by name within this D-Bus object (or its children)
+	//
+	// Only the branch of the hierarchy that could contain `pPath` is searched, and no paths are built along the way.
+	std::shared_ptr<const DBusInterface> findInterface(const char *pPath, const char *pInterfaceName) const;
+
+	// Finds an interface by name within this D-Bus object (or its children)
+	std::shared_ptr<const DBusInterface> findInterface(const DBusObjectPath &path, const std::string &interfaceName) const;
 
 	// Finds a BlueZ method by name within the specified D-Bus interface
-	bool callMethod(const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData, const DBusObjectPath &basePath = DBusObjectPath()) const;
+	//
+	// As with `findInterface()`, only the branch of the hierarchy that could contain `pPath` is searched.
+	bool callMethod(const char *pPath, const char *pInterfaceName, const char *pMethodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
+
+	// Finds a BlueZ method by name within the specified D-Bus interface
+	bool callMethod(const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 
 	// Periodic timer tick propagation
 	void tickEvents(GDBusConnection *pConnection, void *pUserData = nullptr) const;
 
+	// Releases any spare capacity held by this object, its interfaces and its children (see `Server::freeze()`)
+	void shrinkToFit();
+
 	// -----------------------------------------------------------------------------------------------------------------------------
 	// D-Bus signals
 	// -----------------------------------------------------------------------------------------------------------------------------
 
 	// Emits a signal on the bus from the given path, interface name and signal name, containing a GVariant set of parameters
-	void emitSignal(GDBusConnection *pBusConnection, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters);
+	//
+	// The names are C strings so that callers emitting signals at a high rate (such as change notifications) don't build strings
+	// for each signal.
+	void emitSignal(GDBusConnection *pBusConnection, const char *pInterfaceName, const char *pSignalName, GVariant *pParameters) const;
 
 private:
 	bool publish;
 	DBusObjectPath path;
+	DBusObjectPath fullPath;
 	InterfaceList interfaces;
+
+	// Children are kept in a list so they stay put as the description grows: interfaces refer to the object that owns them and
+	// children to their parent
 	std::list<DBusObject> children;
 	DBusObject *pParent;
 };
@@ -22,10 +22,15 @@
 //
 // In addition to this functionality, our DBusObjectPath is its own distinct type requiring explicit conversion, providing a level
 // of protection against accidentally using an arbitrary string as an object path.
+//
+// Building a path allocates, so each `DBusObject` builds its full path once, when it is created, and keeps it (see
+// `DBusObject::getPath()`.) The comparisons below (including those against a C string, as D-Bus hands us) never allocate, which
+// keeps path handling on the dispatch path free of heap allocations.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #pragma once
 
+#include <string.h>
 #include <string>
 #include <ostream>
 
@@ -55,6 +60,9 @@ struct DBusObjectPath
 	// Explicit conversion to a C string
 	inline const char *c_str() const { return path.c_str(); }
 
+	// Returns the length of the path, in characters
+	inline size_t length() const { return path.length(); }
+
 	// Assignment
 	inline DBusObjectPath &operator =(const DBusObjectPath &rhs)
 	{
@@ -138,6 +146,44 @@ struct DBusObjectPath
 		return path == rhs.path;
 	}
 
+	// Tests a DBusObjectPath and a C string for equality, returning true of the two strings are identical
+	inline bool operator ==(const char *rhs) const
+	{
+		return nullptr != rhs && 0 == strcmp(path.c_str(), rhs);
+	}
+
+	// Tests two DBusObjectPaths for inequality
+	inline bool operator !=(const DBusObjectPath &rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+	// Tests a DBusObjectPath and a C string for inequality
+	inline bool operator !=(const char *rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+	// Returns true if `pOther` is this path or lies beneath it (for example, "/com/example" contains "/com/example/foo" but not
+	// "/com/examples")
+	inline bool contains(const char *pOther) const
+	{
+		if (nullptr == pOther) { return false; }
+
+		size_t len = path.length();
+		if (0 != strncmp(path.c_str(), pOther, len)) { return false; }
+
+		// The root (or any path ending in a separator) contains everything that starts with it
+		if (0 == len || path.back() == '/') { return true; }
+		return '\0' == pOther[len] || '/' == pOther[len];
+	}
+
+	// Returns true if `other` is this path or lies beneath it
+	inline bool contains(const DBusObjectPath &other) const
+	{
+		return contains(other.c_str());
+	}
+
 private:
 
 	std::string path;
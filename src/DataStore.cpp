@@ -0,0 +1,641 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// An optional, built-in store for server data, shared between the application's threads and the server's thread
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// The traditional way of sharing data with the server is through the application's `GGKServerDataGetter` and
+// `GGKServerDataSetter` delegates. Those are looked up by name on every access, and thread safety is left to the application.
+//
+// The data store is an alternative. Each value is registered once, up front, by name and maximum size. Registration returns an
+// integer slot, and from then on values are read and written by slot with no string work or allocation. Each slot is protected
+// by a sequence lock: a writer bumps the slot's sequence to an odd value, copies the new value in and bumps the sequence again,
+// while a reader copies the value out and retries if the sequence changed (or was odd) while it was copying. Writers never wait
+// on readers and readers never block writers, so an application thread can update values while the server's thread serves
+// them.
+//
+// A slot may also be associated with an update handle (see `ggkRegisterUpdateHandle()`.) Each write to such a slot then
+// schedules the characteristic's update automatically.
+//
+// Slots should be registered before the server is started, so that the server description can find them.
+//
+// Shared slots
+// ------------
+//
+// Producers that live in other processes would otherwise have to pass each value to the server's process over their own IPC,
+// which then writes it here: two copies and two context switches per value. `share()` instead moves the slots' records into a
+// sealed memfd region that producers map (see `DataStoreProducer`). A producer writes a record in place, using the same sequence
+// lock as in-process writers, and then signals an eventfd doorbell. The server's main loop watches the doorbell; when it rings,
+// `serviceDoorbell()` checks each shared record's sequence and notifies the update handle of each one that has changed. The
+// server reads values straight from the region when it builds a notification or answers a read.
+//
+// The region is laid out as a header, a directory of slot names, offsets and capacities, and then the records themselves (see
+// `SharedHeader`.) The region is sealed against resizing, so a producer can't pull pages out from under the server. The server
+// never trusts sizes or offsets it reads back from the region, since any producer can write to it.
+//
+// Readers and writers both give up on a record that stays locked, rather than waiting on it forever. A producer that dies
+// mid-write leaves its record locked for good, so once a record has been stuck on the same sequence for
+// `kStuckRecordTimeoutMS`, the server takes the lock back and discards the (possibly half-written) value. Until then, reads and
+// writes of that slot fail.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <new>
+#include <thread>
+
+#include "DataStore.h"
+#include "Utils.h"
+#include "Logger.h"
+#include "../include/Gobbledegook.h"
+
+namespace ggk {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared data store records require lock-free atomics");
+
+// The number of times a reader or writer retries a record that stays locked before giving up on it
+static const int kMaxLockAttempts = 1000;
+
+// Returns the space taken by a record and the `capacity` bytes of data that follow it, rounded up to keep records aligned
+static size_t recordSize(int capacity)
+{
+	return (sizeof(DataStore::SharedRecord) + capacity + 7) & ~static_cast<size_t>(7);
+}
+
+// Returns a record's data
+static guint8 *recordData(DataStore::SharedRecord *pRecord)
+{
+	return reinterpret_cast<guint8 *>(pRecord + 1);
+}
+
+static const guint8 *recordData(const DataStore::SharedRecord *pRecord)
+{
+	return reinterpret_cast<const guint8 *>(pRecord + 1);
+}
+
+// Closes the shared region, if there is one
+DataStore::~DataStore()
+{
+	if (nullptr != pRegion)
+	{
+		munmap(pRegion, regionSize);
+	}
+
+	if (memFd >= 0) { close(memFd); }
+	if (doorbellFd >= 0) { close(doorbellFd); }
+}
+
+// Registers a named slot able to hold up to `maxSize` bytes, returning its slot index
+//
+// The slot's storage is allocated here, so that reading and writing a slot never allocates. Registering an existing name
+// returns the existing slot (provided it is large enough.)
+//
+// Returns the slot index on success, or -1 on failure (invalid name or size, or the store is full)
+int DataStore::registerSlot(const char *pName, int maxSize)
+{
+	if (nullptr == pName || *pName == 0 || maxSize <= 0 || maxSize > kMaxSlotSize)
+	{
+		Logger::error(SSTR << "Unable to register data store slot: invalid name or size (" << maxSize << ")");
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(registrationMutex);
+
+	auto it = slotNames.find(pName);
+	if (slotNames.end() != it)
+	{
+		if (slots[it->second].capacity < maxSize)
+		{
+			Logger::error(SSTR << "Data store slot '" << pName << "' is already registered with a smaller size");
+			return -1;
+		}
+
+		return it->second;
+	}
+
+	int index = slotCount.load(std::memory_order_relaxed);
+	if (index >= kMaxSlots)
+	{
+		Logger::error(SSTR << "Unable to register data store slot '" << pName << "': the store is full");
+		return -1;
+	}
+
+	Slot &slot = slots[index];
+	slot.pPrivate.reset(new guint8[recordSize(maxSize)]());
+	SharedRecord *pRecord = new (slot.pPrivate.get()) SharedRecord;
+	pRecord->sequence.store(0, std::memory_order_relaxed);
+	pRecord->size.store(0, std::memory_order_relaxed);
+	slot.pRecord.store(pRecord, std::memory_order_relaxed);
+	slot.updateHandle.store(-1, std::memory_order_relaxed);
+	slot.capacity = maxSize;
+	slot.shared = false;
+	slot.notifiedSequence.store(0, std::memory_order_relaxed);
+	slot.stuckSequence.store(0, std::memory_order_relaxed);
+	slot.stuckSinceUS.store(0, std::memory_order_relaxed);
+	slotNames[pName] = index;
+
+	if (nullptr != pRegion)
+	{
+		Logger::warn(SSTR << "Data store slot '" << pName << "' was registered after the store was shared; it will not be shared");
+	}
+
+	// Publish the slot
+	slotCount.store(index + 1, std::memory_order_release);
+	return index;
+}
+
+// Returns the slot index for a registered name, or -1 if there is no such slot
+int DataStore::findSlot(const char *pName) const
+{
+	if (nullptr == pName)
+	{
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(registrationMutex);
+	auto it = slotNames.find(pName);
+	return slotNames.end() == it ? -1 : it->second;
+}
+
+// Associates a slot with an update handle (see `ggkRegisterUpdateHandle()`), so that each write to the slot notifies it
+bool DataStore::setUpdateHandle(int slot, int updateHandle)
+{
+	Slot *pSlot = getSlot(slot);
+	if (nullptr == pSlot)
+	{
+		return false;
+	}
+
+	pSlot->updateHandle.store(updateHandle, std::memory_order_relaxed);
+	return true;
+}
+
+// Stores a value in a slot, then notifies the slot's update handle (if any)
+bool DataStore::set(int slot, const void *pData, int size)
+{
+	Slot *pSlot = getSlot(slot);
+	if (nullptr == pSlot || size < 0 || size > pSlot->capacity || (nullptr == pData && size > 0))
+	{
+		return false;
+	}
+
+	SharedRecord *pRecord = pSlot->pRecord.load(std::memory_order_acquire);
+	if (!writeRecord(pRecord, pData, size) && !(pSlot->shared && recoverStuckRecord(*pSlot) && writeRecord(pRecord, pData, size)))
+	{
+		Logger::warn(SSTR << "Unable to write data store slot " << slot << ": it is locked by another writer");
+		return false;
+	}
+
+	// We notify the update handle ourselves, so the doorbell needn't do it again
+	if (pSlot->shared)
+	{
+		pSlot->notifiedSequence.store(pRecord->sequence.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	int updateHandle = pSlot->updateHandle.load(std::memory_order_relaxed);
+	if (updateHandle >= 0)
+	{
+		ggkNotifyHandle(updateHandle);
+	}
+
+	return true;
+}
+
+// Copies a slot's current value into `pBuffer`
+int DataStore::get(int slot, void *pBuffer, int bufferSize) const
+{
+	const Slot *pSlot = getSlot(slot);
+	if (nullptr == pSlot || nullptr == pBuffer)
+	{
+		return -1;
+	}
+
+	const SharedRecord *pRecord = pSlot->pRecord.load(std::memory_order_acquire);
+	int size = readRecord(pRecord, pSlot->capacity, pBuffer, bufferSize);
+	if (kRecordLocked == size && pSlot->shared && recoverStuckRecord(*pSlot))
+	{
+		size = readRecord(pRecord, pSlot->capacity, pBuffer, bufferSize);
+	}
+
+	return size < 0 ? -1 : size;
+}
+
+// Returns a slot's current value as an array of bytes ("ay"), or nullptr if the slot is invalid
+GVariant *DataStore::getByteArray(int slot) const
+{
+	const Slot *pSlot = getSlot(slot);
+	if (nullptr == pSlot)
+	{
+		return nullptr;
+	}
+
+	// Copy the value out into a buffer that GLib takes ownership of, so that the variant doesn't need another copy
+	guint8 *pBuffer = static_cast<guint8 *>(g_malloc(pSlot->capacity));
+	int size = get(slot, pBuffer, pSlot->capacity);
+	GBytes *pBytes = g_bytes_new_take(pBuffer, size < 0 ? 0 : size);
+	GVariant *pVariant = Utils::gvariantFromByteArray(pBytes);
+	g_bytes_unref(pBytes);
+	return pVariant;
+}
+
+// Moves the registered slots into a shared memory region, so that other processes can write them directly
+bool DataStore::share(int &memFdOut, int &doorbellFdOut)
+{
+	std::lock_guard<std::mutex> lock(registrationMutex);
+
+	if (nullptr == pRegion)
+	{
+		// Lay out the directory (in slot order) and records
+		int count = slotCount.load(std::memory_order_relaxed);
+		std::vector<const std::string *> names(count, nullptr);
+		for (const auto &entry : slotNames)
+		{
+			names[entry.second] = &entry.first;
+		}
+
+		std::vector<SharedDirectoryEntry> directory;
+		std::vector<int> directorySlots;
+		for (int i = 0; i < count; ++i)
+		{
+			if (names[i]->size() >= static_cast<size_t>(kSharedNameSize))
+			{
+				Logger::warn(SSTR << "Data store slot '" << *names[i] << "' has too long a name to be shared");
+				continue;
+			}
+
+			SharedDirectoryEntry directoryEntry;
+			memset(&directoryEntry, 0, sizeof(directoryEntry));
+			memcpy(directoryEntry.name, names[i]->c_str(), names[i]->size());
+			directoryEntry.capacity = static_cast<uint32_t>(slots[i].capacity);
+			directory.push_back(directoryEntry);
+			directorySlots.push_back(i);
+		}
+
+		size_t size = sizeof(SharedHeader) + directory.size() * sizeof(SharedDirectoryEntry);
+		size = (size + 7) & ~static_cast<size_t>(7);
+		for (SharedDirectoryEntry &directoryEntry : directory)
+		{
+			directoryEntry.offset = static_cast<uint32_t>(size);
+			size += recordSize(static_cast<int>(directoryEntry.capacity));
+		}
+
+		int fd = memfd_create("ggk-data-store", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		if (fd < 0)
+		{
+			Logger::error(SSTR << "Unable to create the shared data store: " << strerror(errno));
+			return false;
+		}
+
+		void *pMapped = MAP_FAILED;
+		if (ftruncate(fd, static_cast<off_t>(size)) < 0
+			|| fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0
+			|| MAP_FAILED == (pMapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)))
+		{
+			Logger::error(SSTR << "Unable to map the shared data store: " << strerror(errno));
+			close(fd);
+			return false;
+		}
+
+		int eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (eventFd < 0)
+		{
+			Logger::error(SSTR << "Unable to create the shared data store's doorbell: " << strerror(errno));
+			munmap(pMapped, size);
+			close(fd);
+			return false;
+		}
+
+		// The region starts out zeroed, so only the header, directory and record values need filling in
+		guint8 *pBase = static_cast<guint8 *>(pMapped);
+		SharedHeader *pHeader = reinterpret_cast<SharedHeader *>(pBase);
+		pHeader->magic = kSharedMagic;
+		pHeader->version = kSharedVersion;
+		pHeader->slotCount = static_cast<uint32_t>(directory.size());
+		pHeader->regionSize = static_cast<uint32_t>(size);
+		memcpy(pHeader + 1, directory.data(), directory.size() * sizeof(SharedDirectoryEntry));
+
+		// Carry each slot's current value over to its shared record, then switch the slot to it
+		for (size_t i = 0; i < directory.size(); ++i)
+		{
+			Slot &slot = slots[directorySlots[i]];
+			SharedRecord *pShared = new (pBase + directory[i].offset) SharedRecord;
+			pShared->sequence.store(0, std::memory_order_relaxed);
+			pShared->size.store(0, std::memory_order_relaxed);
+
+			int valueSize = readRecord(slot.pRecord.load(std::memory_order_acquire), slot.capacity, recordData(pShared), slot.capacity);
+			pShared->size.store(valueSize < 0 ? 0 : valueSize, std::memory_order_relaxed);
+
+			slot.notifiedSequence.store(0, std::memory_order_relaxed);
+			slot.shared = true;
+			slot.pRecord.store(pShared, std::memory_order_release);
+		}
+
+		memFd = fd;
+		doorbellFd = eventFd;
+		pRegion = pMapped;
+		regionSize = size;
+
+		Logger::info(SSTR << "Shared " << directory.size() << " of " << count << " data store slots (" << size << " bytes)");
+	}
+
+	memFdOut = memFd;
+	doorbellFdOut = doorbellFd;
+	return true;
+}
+
+// Answers the doorbell, notifying the update handle of each shared slot that has been written since it was last notified
+void DataStore::serviceDoorbell()
+{
+	uint64_t rings;
+	if (read(doorbellFd, &rings, sizeof(rings)) < 0 && EAGAIN != errno)
+	{
+		GGK_LOG_DEBUG("Unable to read the shared data store's doorbell: " << strerror(errno));
+	}
+
+	int count = slotCount.load(std::memory_order_acquire);
+	for (int i = 0; i < count; ++i)
+	{
+		Slot &slot = slots[i];
+		if (!slot.shared)
+		{
+			continue;
+		}
+
+		// A record mid-write will ring the doorbell again when the write completes
+		unsigned int sequence = slot.pRecord.load(std::memory_order_acquire)->sequence.load(std::memory_order_acquire);
+		if ((sequence & 1) != 0 || sequence == slot.notifiedSequence.load(std::memory_order_relaxed))
+		{
+			continue;
+		}
+
+		slot.notifiedSequence.store(sequence, std::memory_order_relaxed);
+		int updateHandle = slot.updateHandle.load(std::memory_order_relaxed);
+		if (updateHandle >= 0)
+		{
+			ggkNotifyHandle(updateHandle);
+		}
+	}
+}
+
+// Unlocks a shared slot's record if it has been locked on the same sequence for `kStuckRecordTimeoutMS`, discarding its value
+bool DataStore::recoverStuckRecord(const Slot &slot) const
+{
+	SharedRecord *pRecord = slot.pRecord.load(std::memory_order_acquire);
+	unsigned int sequence = pRecord->sequence.load(std::memory_order_acquire);
+	if ((sequence & 1) == 0)
+	{
+		return true;
+	}
+
+	// Start the clock the first time we find the record stuck on this sequence (a locked sequence is odd, so never 0)
+	gint64 now = g_get_monotonic_time();
+	if (slot.stuckSequence.exchange(sequence, std::memory_order_relaxed) != sequence)
+	{
+		slot.stuckSinceUS.store(now, std::memory_order_relaxed);
+		return false;
+	}
+
+	if (now - slot.stuckSinceUS.load(std::memory_order_relaxed) < static_cast<gint64>(kStuckRecordTimeoutMS) * 1000)
+	{
+		return false;
+	}
+
+	// Whatever the writer left behind may be half-written, so the value is discarded
+	pRecord->size.store(0, std::memory_order_relaxed);
+	if (pRecord->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_release))
+	{
+		Logger::warn(SSTR << "A shared data store record was locked for over " << kStuckRecordTimeoutMS << "ms; its value has been discarded");
+	}
+
+	return true;
+}
+
+// Writes a value to a record, waiting out any other writer
+bool DataStore::writeRecord(SharedRecord *pRecord, const void *pData, int size)
+{
+	// Take the write side of the lock by moving the sequence from even to odd
+	unsigned int sequence = pRecord->sequence.load(std::memory_order_relaxed);
+	for (int attempt = 0;; ++attempt)
+	{
+		if ((sequence & 1) == 0 && pRecord->sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire))
+		{
+			break;
+		}
+
+		if (attempt >= kMaxLockAttempts)
+		{
+			return false;
+		}
+
+		std::this_thread::yield();
+		sequence = pRecord->sequence.load(std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+
+	memcpy(recordData(pRecord), pData, size);
+	pRecord->size.store(size, std::memory_order_relaxed);
+
+	// Release the lock, publishing the new value
+	pRecord->sequence.store(sequence + 2, std::memory_order_release);
+	return true;
+}
+
+// Copies a record's current value into `pBuffer`
+int DataStore::readRecord(const SharedRecord *pRecord, int capacity, void *pBuffer, int bufferSize)
+{
+	for (int attempt = 0; attempt < kMaxLockAttempts; ++attempt)
+	{
+		unsigned int sequence = pRecord->sequence.load(std::memory_order_acquire);
+		if ((sequence & 1) != 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Shared records can be written by anyone, so the size is checked against what we know the capacity to be
+		//
+		// A size we can't use only counts if no write has come along since we read it, otherwise the value we retry with may fit
+		int size = pRecord->size.load(std::memory_order_relaxed);
+		if (size < 0 || size > capacity || size > bufferSize)
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (pRecord->sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				return -1;
+			}
+
+			continue;
+		}
+
+		memcpy(pBuffer, recordData(pRecord), size);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (pRecord->sequence.load(std::memory_order_relaxed) == sequence)
+		{
+			return size;
+		}
+	}
+
+	GGK_LOG_DEBUG("Gave up reading a data store record that stayed locked");
+	return kRecordLocked;
+}
+
+// Returns the slot at the given index, or nullptr if it has not been registered
+const DataStore::Slot *DataStore::getSlot(int slot) const
+{
+	if (slot < 0 || slot >= slotCount.load(std::memory_order_acquire))
+	{
+		return nullptr;
+	}
+
+	return &slots[slot];
+}
+
+// Returns the slot at the given index, or nullptr if it has not been registered
+DataStore::Slot *DataStore::getSlot(int slot)
+{
+	return const_cast<Slot *>(static_cast<const DataStore *>(this)->getSlot(slot));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Producers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Maps the region described by `memFd` and checks its layout
+DataStoreProducer *DataStoreProducer::attach(int memFd, int doorbellFd)
+{
+	struct stat status;
+	if (fstat(memFd, &status) < 0 || status.st_size < static_cast<off_t>(sizeof(DataStore::SharedHeader)))
+	{
+		Logger::error(SSTR << "Unable to attach to the shared data store: not a data store region");
+		return nullptr;
+	}
+
+	size_t size = static_cast<size_t>(status.st_size);
+	void *pMapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+	if (MAP_FAILED == pMapped)
+	{
+		Logger::error(SSTR << "Unable to map the shared data store: " << strerror(errno));
+		return nullptr;
+	}
+
+	// The server writes the header and directory before handing out the descriptor, and never changes them
+	const guint8 *pBase = static_cast<const guint8 *>(pMapped);
+	const DataStore::SharedHeader *pHeader = reinterpret_cast<const DataStore::SharedHeader *>(pBase);
+	size_t directoryEnd = sizeof(DataStore::SharedHeader) + pHeader->slotCount * sizeof(DataStore::SharedDirectoryEntry);
+	if (DataStore::kSharedMagic != pHeader->magic || DataStore::kSharedVersion != pHeader->version
+		|| pHeader->regionSize != size || directoryEnd > size)
+	{
+		Logger::error(SSTR << "Unable to attach to the shared data store: unrecognized layout");
+		munmap(pMapped, size);
+		return nullptr;
+	}
+
+	const DataStore::SharedDirectoryEntry *pDirectory = reinterpret_cast<const DataStore::SharedDirectoryEntry *>(pHeader + 1);
+	std::vector<DataStore::SharedDirectoryEntry> directory(pDirectory, pDirectory + pHeader->slotCount);
+	for (DataStore::SharedDirectoryEntry &entry : directory)
+	{
+		entry.name[DataStore::kSharedNameSize - 1] = 0;
+		if (entry.offset < directoryEnd || (entry.offset & 7) != 0 || entry.capacity > static_cast<uint32_t>(DataStore::kMaxSlotSize)
+			|| entry.offset + recordSize(static_cast<int>(entry.capacity)) > size)
+		{
+			Logger::error(SSTR << "Unable to attach to the shared data store: slot '" << entry.name << "' is out of bounds");
+			munmap(pMapped, size);
+			return nullptr;
+		}
+	}
+
+	int doorbell = dup(doorbellFd);
+	if (doorbell < 0)
+	{
+		Logger::error(SSTR << "Unable to attach to the shared data store's doorbell: " << strerror(errno));
+		munmap(pMapped, size);
+		return nullptr;
+	}
+
+	DataStoreProducer *pProducer = new DataStoreProducer();
+	pProducer->directory.swap(directory);
+	pProducer->doorbellFd = doorbell;
+	pProducer->pRegion = pMapped;
+	pProducer->regionSize = size;
+	return pProducer;
+}
+
+// Unmaps the region and closes our copy of the doorbell
+DataStoreProducer::~DataStoreProducer()
+{
+	if (nullptr != pRegion)
+	{
+		munmap(pRegion, regionSize);
+	}
+
+	if (doorbellFd >= 0)
+	{
+		close(doorbellFd);
+	}
+}
+
+// Returns the producer's slot index for a name, or -1 if there is no such shared slot
+int DataStoreProducer::findSlot(const char *pName) const
+{
+	if (nullptr == pName)
+	{
+		return -1;
+	}
+
+	for (size_t i = 0; i < directory.size(); ++i)
+	{
+		if (0 == strcmp(directory[i].name, pName))
+		{
+			return static_cast<int>(i);
+		}
+	}
+
+	return -1;
+}
+
+// Stores a value in a shared slot and signals the doorbell
+bool DataStoreProducer::set(int slot, const void *pData, int size)
+{
+	if (slot < 0 || slot >= static_cast<int>(directory.size()) || size < 0 || size > static_cast<int>(directory[slot].capacity)
+		|| (nullptr == pData && size > 0))
+	{
+		return false;
+	}
+
+	// If the slot stays locked, the server will take the lock back once it has been stuck for long enough
+	guint8 *pBase = static_cast<guint8 *>(pRegion);
+	if (!DataStore::writeRecord(reinterpret_cast<DataStore::SharedRecord *>(pBase + directory[slot].offset), pData, size))
+	{
+		return false;
+	}
+
+	// A full counter still wakes the server, so there's nothing to do about EAGAIN
+	uint64_t one = 1;
+	if (write(doorbellFd, &one, sizeof(one)) < 0 && EAGAIN != errno)
+	{
+		GGK_LOG_DEBUG("Unable to signal the shared data store's doorbell: " << strerror(errno));
+	}
+
+	return true;
+}
+
+}; // namespace ggk
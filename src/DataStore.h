@@ -0,0 +1,258 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// An optional, built-in store for server data, shared between the application's threads and the server's thread
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of DataStore.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ggk {
+
+struct DataStore
+{
+	// The maximum number of slots that can be registered
+	static const int kMaxSlots = 128;
+
+	// The largest value (in bytes) a single slot can hold
+	static const int kMaxSlotSize = 4096;
+
+	// How long a shared slot's record may stay locked before the server takes the lock back (see `recoverStuckRecord()`)
+	static const int kStuckRecordTimeoutMS = 1000;
+
+	// Retrieve our singleton instance
+	static DataStore &getInstance()
+	{
+		static DataStore instance;
+		return instance;
+	}
+
+	// Registers a named slot able to hold up to `maxSize` bytes, returning its slot index
+	//
+	// The slot's storage is allocated here, so that reading and writing a slot never allocates. Registering an existing name
+	// returns the existing slot (provided it is large enough.)
+	//
+	// Returns the slot index on success, or -1 on failure (invalid name or size, or the store is full)
+	int registerSlot(const char *pName, int maxSize);
+
+	// Returns the slot index for a registered name, or -1 if there is no such slot
+	//
+	// This is a hashed string lookup. It is intended to be called once (such as from a static initializer in the server
+	// description) with the resulting slot index used from then on.
+	int findSlot(const char *pName) const;
+
+	// Associates a slot with an update handle (see `ggkRegisterUpdateHandle()`), so that each write to the slot notifies it
+	//
+	// Pass -1 to remove the association.
+	//
+	// Returns true on success, or false if the slot is invalid
+	bool setUpdateHandle(int slot, int updateHandle);
+
+	// Stores a value in a slot, then notifies the slot's update handle (if any)
+	//
+	// This is safe to call from any thread, concurrently with readers and other writers.
+	//
+	// Returns true on success, or false if the slot is invalid or `size` exceeds the slot's capacity
+	bool set(int slot, const void *pData, int size);
+
+	// Copies a slot's current value into `pBuffer`
+	//
+	// This is safe to call from any thread without blocking writers.
+	//
+	// Returns the size of the value (in bytes), or -1 if the slot is invalid or the value will not fit in `bufferSize` bytes
+	int get(int slot, void *pBuffer, int bufferSize) const;
+
+	// Returns a slot's current value as an array of bytes ("ay"), or nullptr if the slot is invalid
+	GVariant *getByteArray(int slot) const;
+
+	// Moves the registered slots into a shared memory region, so that other processes can write them directly
+	//
+	// On success, `memFd` receives the region's memfd and `doorbellFd` an eventfd that producers signal after writing. Both
+	// remain owned by the data store; pass them to producer processes (see `DataStoreProducer`) however suits the application.
+	// Calling this again returns the same descriptors.
+	//
+	// This should be called after registering slots and before starting the server (or any writers.) Slots registered
+	// afterwards, and slots whose names are too long for the region's directory, remain private to this process.
+	//
+	// Returns true on success, otherwise false
+	bool share(int &memFd, int &doorbellFd);
+
+	// Returns the eventfd producers signal after writing shared slots, or -1 if the slots are not shared
+	int getDoorbellFd() const { return doorbellFd; }
+
+	// Answers the doorbell, notifying the update handle of each shared slot that has been written since it was last notified
+	//
+	// This is called by the server's main loop when the doorbell is signalled.
+	void serviceDoorbell();
+
+	//
+	// The layout of the shared region
+	//
+	// The region starts with a `SharedHeader`, followed by `slotCount` `SharedDirectoryEntry`s and then the records. Each
+	// record is a `SharedRecord` followed directly by `capacity` bytes of data, starting on an 8-byte boundary.
+	//
+
+	static const uint32_t kSharedMagic = 0x4d534747; // "GGSM"
+	static const uint32_t kSharedVersion = 1;
+	static const int kSharedNameSize = 64;
+
+	struct SharedHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCount;
+		uint32_t regionSize;
+	};
+
+	struct SharedDirectoryEntry
+	{
+		char name[kSharedNameSize];
+		uint32_t offset;
+		uint32_t capacity;
+	};
+
+	// A single value, protected by a sequence lock
+	//
+	// The sequence is odd while a write is in progress. Readers retry until they see the same even sequence before and after
+	// copying the value. Shared records are written by other processes, so these atomics must be lock-free (and so
+	// address-free.)
+	struct SharedRecord
+	{
+		std::atomic<unsigned int> sequence;
+		std::atomic<int> size;
+	};
+
+	// What `readRecord()` returns for a record that stays locked (such as by a producer that died mid-write)
+	static const int kRecordLocked = -2;
+
+	// Writes a value to a record, waiting out any other writer
+	//
+	// Returns false if the record stays locked by another writer (such as a producer that died mid-write)
+	static bool writeRecord(SharedRecord *pRecord, const void *pData, int size);
+
+	// Copies a record's current value into `pBuffer`
+	//
+	// Returns the size of the value, -1 if it will not fit in `bufferSize` bytes or exceeds the record's `capacity`, or
+	// `kRecordLocked` if the record stays locked
+	static int readRecord(const SharedRecord *pRecord, int capacity, void *pBuffer, int bufferSize);
+
+private:
+
+	DataStore() : slotCount(0) {}
+	~DataStore();
+
+	// Prevent copying
+	DataStore(DataStore const &) = delete;
+	void operator=(DataStore const &) = delete;
+
+	// A registered slot
+	//
+	// The slot's record is in `pPrivate` until the slots are shared, and in the shared region after that.
+	struct Slot
+	{
+		std::atomic<SharedRecord *> pRecord;
+		std::atomic<int> updateHandle;
+		int capacity;
+		std::unique_ptr<guint8[]> pPrivate;
+
+		// Whether the record is in the shared region, and its sequence when the update handle was last notified (see
+		// `serviceDoorbell()`)
+		bool shared = false;
+		std::atomic<unsigned int> notifiedSequence;
+
+		// The locked sequence a shared record was last found stuck on, and when (see `recoverStuckRecord()`)
+		mutable std::atomic<unsigned int> stuckSequence;
+		mutable std::atomic<gint64> stuckSinceUS;
+	};
+
+	// Unlocks a shared slot's record if it has been locked on the same sequence for `kStuckRecordTimeoutMS`, discarding its value
+	//
+	// A producer that dies mid-write leaves its record locked. Rather than every later reader and writer of the slot failing,
+	// the first to find it stuck for long enough takes the lock back.
+	//
+	// Returns true if the record is no longer locked (so the caller may try again), otherwise false
+	bool recoverStuckRecord(const Slot &slot) const;
+
+	// Returns the slot at the given index, or nullptr if it has not been registered
+	const Slot *getSlot(int slot) const;
+	Slot *getSlot(int slot);
+
+	Slot slots[kMaxSlots];
+	std::atomic<int> slotCount;
+
+	// Registration (and name lookups) are protected by this mutex; slot reads and writes are not
+	mutable std::mutex registrationMutex;
+	std::unordered_map<std::string, int> slotNames;
+
+	// The shared region (see `share()`)
+	int memFd = -1;
+	int doorbellFd = -1;
+	void *pRegion = nullptr;
+	size_t regionSize = 0;
+};
+
+// A producer's view of a data store shared by the server's process (see `DataStore::share()`)
+//
+// Producers run in other processes. They write slots in place, using the same sequence lock as the server, and signal the
+// doorbell so the server notifies any linked characteristics.
+struct DataStoreProducer
+{
+	// Maps the region described by `memFd` and checks its layout
+	//
+	// The descriptors are not taken over; the caller may close them once this returns. Returns nullptr on failure.
+	static DataStoreProducer *attach(int memFd, int doorbellFd);
+
+	~DataStoreProducer();
+
+	// Returns the producer's slot index for a name, or -1 if there is no such shared slot
+	//
+	// Producer slot indices are positions in the region's directory; they need not match the server's slot indices.
+	int findSlot(const char *pName) const;
+
+	// Stores a value in a shared slot and signals the doorbell
+	//
+	// Returns true on success, or false if the slot is invalid, `size` exceeds the slot's capacity, or the slot stays locked by
+	// another writer
+	bool set(int slot, const void *pData, int size);
+
+private:
+
+	DataStoreProducer() {}
+
+	// Prevent copying
+	DataStoreProducer(DataStoreProducer const &) = delete;
+	void operator=(DataStoreProducer const &) = delete;
+
+	// Our copy of the directory, so that a misbehaving producer can't redirect our writes by changing the shared one
+	std::vector<DataStore::SharedDirectoryEntry> directory;
+
+	int doorbellFd = -1;
+	void *pRegion = nullptr;
+	size_t regionSize = 0;
+};
+
+}; // namespace ggk
@@ -22,6 +22,8 @@
 // in Server.cpp.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+#include <gio/gunixfdlist.h>
+
 #include "GattCharacteristic.h"
 #include "GattDescriptor.h"
 #include "GattProperty.h"
@@ -30,9 +32,24 @@
 #include "GattService.h"
 #include "Utils.h"
 #include "Logger.h"
+#include "WorkerPool.h"
+#include "Sessions.h"
+#include "Init.h"
 
 namespace ggk {
 
+// The bytes of each ATT Prepare Write request taken up by its header (opcode, handle and offset)
+static const size_t kPrepareWriteHeaderSize = 5;
+
+// The bytes of each ATT Write Request or Write Command taken up by its header (opcode and handle)
+static const size_t kWriteHeaderSize = 3;
+
+// The bytes of each ATT Handle Value Notification taken up by its header (opcode and handle)
+static const size_t kAttNotificationHeaderSize = 3;
+
+// Returns true if updates are being coalesced (see `ggkUpdateQueueSetCoalescing()`)
+extern bool updateQueueIsCoalescing();
+
 //
 // Standard constructor
 //
@@ -42,8 +59,17 @@ namespace ggk {
 // Genreally speaking, these objects should not be constructed directly. Rather, use the `gattCharacteristicBegin()` method
 // in `GattService`.
 GattCharacteristic::GattCharacteristic(DBusObject &owner, GattService &service, const std::string &name)
-: GattInterface(owner, name), service(service), pOnUpdatedValueFunc(nullptr)
+: GattInterface(owner, name), service(service), pOnUpdatedValueFunc(nullptr), pOnLongWriteValueFunc(nullptr), longWriteMaxSize(kLongWriteMaxSize), longWriteTimerId(0), notifyIntervalUS(0), notifyLatestOnly(true), priority(EUpdatePriorityNormal), lastUpdateTime(0), deferredUpdates(0), tracksSubscriptions(false), notifying(false), methodsOnWorkers(false), pendingMethodScheduled(false), pOnAcquiredWriteFunc(nullptr), pAcquiredWriteUserData(nullptr)
+{
+}
+
+// Stops our long write timer, which would otherwise outlive us
+GattCharacteristic::~GattCharacteristic()
 {
+	if (0 != longWriteTimerId)
+	{
+		removeServerSource(longWriteTimerId);
+	}
 }
 
 // Returning the owner pops us one level up the hierarchy
@@ -61,7 +87,7 @@ bool GattCharacteristic::callMethod(const std::string &methodName, GDBusConnecti
 	{
 		if (methodName == method.getName())
 		{
-			method.call<GattCharacteristic>(pConnection, getPath(), getName(), methodName, pParameters, pInvocation, pUserData);
+			dispatchMethod(method, pConnection, pParameters, pInvocation, pUserData);
 			return true;
 		}
 	}
@@ -69,16 +95,131 @@ bool GattCharacteristic::callMethod(const std::string &methodName, GDBusConnecti
 	return false;
 }
 
+// Invokes a method (which must belong to this interface) that has already been located, such as through the server's index
+void GattCharacteristic::invokeMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
+{
+	dispatchMethod(method, pConnection, pParameters, pInvocation, pUserData);
+}
+
+// Runs this characteristic's method callbacks (such as `onReadValue` and `onWriteValue`) on the server's worker threads, once the
+// application has enabled them (see `ggkEnableMethodWorkers()`)
+//
+// Calls to the same characteristic are still run one at a time, in the order they arrived, but calls to different
+// characteristics run concurrently. Callbacks (and the data getter and setter they use) must therefore be thread safe.
+GattCharacteristic &GattCharacteristic::runMethodsOnWorkers()
+{
+	methodsOnWorkers = true;
+	return *this;
+}
+
+// Calls a method's callback, or queues it for a worker thread if we run our methods on workers (and they are enabled)
+//
+// A queued call holds references to the connection and parameters until it has run. The invocation itself is owned by the
+// callback, which must reply to it (as it would on the server's thread.)
+void GattCharacteristic::dispatchMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
+{
+	bool runHere = !methodsOnWorkers;
+	if (!runHere && !WorkerPool::getInstance().isEnabled())
+	{
+		// Calls queued before the workers were disabled still run first, which keeps our calls in order
+		std::lock_guard<std::mutex> lock(pendingMethodsMutex);
+		runHere = !pendingMethodScheduled;
+	}
+
+	if (runHere)
+	{
+		method.call<GattCharacteristic>(pConnection, getPath(), getName(), method.getName(), pParameters, pInvocation, pUserData);
+		return;
+	}
+
+	PendingMethod pending;
+	pending.pMethod = &method;
+	pending.pConnection = static_cast<GDBusConnection *>(g_object_ref(pConnection));
+	pending.pParameters = g_variant_ref(pParameters);
+	pending.pInvocation = pInvocation;
+	pending.pUserData = pUserData;
+	pending.queuedUS = Stats::now();
+
+	// Only one worker runs our calls at a time, which keeps them in order
+	bool schedule = false;
+	{
+		std::lock_guard<std::mutex> lock(pendingMethodsMutex);
+		pendingMethods.push_back(pending);
+		schedule = !pendingMethodScheduled;
+		pendingMethodScheduled = true;
+	}
+
+	// This is posted without holding our lock, since a stopped pool runs the job right here
+	if (schedule)
+	{
+		WorkerPool::getInstance().post([this] { runPendingMethod(); });
+	}
+}
+
+// Runs our oldest pending method call (on a worker thread), then hands any others back to the pool
+//
+// Running one call per job (rather than all of them) keeps a busy characteristic from holding on to a worker while other
+// characteristics' calls are waiting.
+void GattCharacteristic::runPendingMethod() const
+{
+	PendingMethod pending;
+	{
+		std::lock_guard<std::mutex> lock(pendingMethodsMutex);
+		pending = pendingMethods.front();
+		pendingMethods.pop_front();
+	}
+
+	GGK_LOG_DEBUG("Running method '" << pending.pMethod->getName() << "' on a worker thread for '" << getPath() << "'");
+	pending.pMethod->call<GattCharacteristic>(pending.pConnection, getPath(), getName(), pending.pMethod->getName(), pending.pParameters, pending.pInvocation, pending.pUserData);
+
+	Stats::increment(Stats::getInstance().workerMethodCalls);
+	Stats::getInstance().workerMethodLatency.record(Stats::now() - pending.queuedUS);
+
+	g_variant_unref(pending.pParameters);
+	g_object_unref(pending.pConnection);
+
+	bool more = false;
+	{
+		std::lock_guard<std::mutex> lock(pendingMethodsMutex);
+		more = !pendingMethods.empty();
+		pendingMethodScheduled = more;
+	}
+
+	if (more)
+	{
+		WorkerPool::getInstance().post([this] { runPendingMethod(); });
+	}
+}
+
 // Adds an event to the characteristic and returns a refereence to 'this` to enable method chaining in the server description
 //
-// NOTE: We specifically overload this method in order to accept our custom EventCallback type and transform it into a
-// TickEvent::Callback type. We also return our own type. This simplifies the server description by allowing call to chain.
+// NOTE: We specifically overload this method in order to accept our custom EventCallback type, which `onTickEvent()` calls
+// on behalf of the TickEvent. We also return our own type. This simplifies the server description by allowing call to chain.
 GattCharacteristic &GattCharacteristic::onEvent(int tickFrequency, void *pUserData, EventCallback callback)
 {
-	events.push_back(TickEvent(this, tickFrequency, reinterpret_cast<TickEvent::Callback>(callback), pUserData));
+	TickEvent event(this, tickFrequency, nullptr != callback ? onTickEvent : nullptr, pUserData);
+	event.setOwnerCallback(reinterpret_cast<TickEvent::OwnerCallback>(callback));
+	events.push_back(event);
+	return *this;
+}
+
+// Adds an event that fires every `periodMS` milliseconds and returns a reference to 'this` to enable method chaining
+GattCharacteristic &GattCharacteristic::onEventMS(int periodMS, void *pUserData, EventCallback callback)
+{
+	TickEvent event = TickEvent::fromPeriodMS(this, periodMS, nullptr != callback ? onTickEvent : nullptr, pUserData);
+	event.setOwnerCallback(reinterpret_cast<TickEvent::OwnerCallback>(callback));
+	events.push_back(event);
 	return *this;
 }
 
+// Calls the EventCallback registered with `onEvent()` or `onEventMS()`, converted back from the generic pointer its TickEvent
+// holds
+void GattCharacteristic::onTickEvent(const DBusInterface &self, const TickEvent &event, GDBusConnection *pConnection, void *pUserData)
+{
+	EventCallback callback = reinterpret_cast<EventCallback>(event.getOwnerCallback());
+	callback(static_cast<const GattCharacteristic &>(self), event, pConnection, pUserData);
+}
+
 // Ticks events within this characteristic
 //
 // Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
@@ -90,6 +231,12 @@ void GattCharacteristic::tickEvents(GDBusConnection *pConnection, void *pUserDat
 	}
 }
 
+// Fires one of our events (used by the event timer), translating the generic TickEvent::Callback into our own EventCallback
+void GattCharacteristic::fireEvent(const TickEvent &event, GDBusConnection *pConnection, void *pUserData) const
+{
+	event.fire<GattCharacteristic>(getPath(), pConnection, pUserData);
+}
+
 // Specialized support for ReadlValue method
 //
 // Defined as: array{byte} ReadValue(dict options)
@@ -122,6 +269,29 @@ GattCharacteristic &GattCharacteristic::onWriteValue(MethodCallback callback)
 	return *this;
 }
 
+// Specialized support for WriteValue method, for values written in chunks
+//
+// Defined as: void WriteValue(array{byte} value, dict options)
+//
+// Each chunk is copied into place in a buffer kept for the writing client, and `callback` is called once the final chunk has
+// arrived. See `receiveLongWrite()` for the details.
+GattCharacteristic &GattCharacteristic::onLongWriteValue(LongWriteValueCallback callback, size_t maxSize)
+{
+	pOnLongWriteValueFunc = callback;
+	longWriteMaxSize = maxSize;
+
+	static const char *inArgs[] = {"ay", "a{sv}", nullptr};
+	addMethod("WriteValue", inArgs, nullptr, onLongWriteMethod);
+
+	return *this;
+}
+
+// The `WriteValue` method registered by `onLongWriteValue()`, which passes each chunk on to `receiveLongWrite()`
+void GattCharacteristic::onLongWriteMethod(const DBusInterface &self, GDBusConnection *pConnection, const std::string &, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData)
+{
+	static_cast<const GattCharacteristic &>(self).receiveLongWrite(pConnection, pParameters, pInvocation, pUserData);
+}
+
 // Custom support for handling updates to our characteristic's value
 //
 // Defined as: (NOT defined by Bluetooth or BlueZ - this method is internal only)
@@ -162,10 +332,521 @@ bool GattCharacteristic::callOnUpdatedValue(GDBusConnection *pConnection, void *
 		return false;
 	}
 
-	Logger::debug(SSTR << "Calling OnUpdatedValue function for interface at path '" << getPath() << "'");
+	GGK_LOG_DEBUG("Calling OnUpdatedValue function for interface at path '" << getPath() << "'");
 	return pOnUpdatedValueFunc(*this, pConnection, pUserData);
 }
 
+// Limits how often the update queue processes updates to this characteristic (and therefore how often it notifies)
+//
+// Updates from the update queue (see `ggkPushUpdateQueue()` and `ggkNotifyHandle()`) are processed at most `maxHz` times per
+// second. An update that arrives too soon is deferred until its turn comes around.
+//
+// If `latestOnly` is true, deferred updates are merged so that only one is processed, which sends the value as it is at that
+// time. If false, each deferred update is processed in turn, spaced out at the given rate.
+//
+// A `maxHz` of zero (the default) removes the limit.
+GattCharacteristic &GattCharacteristic::notifyPolicy(int maxHz, bool latestOnly)
+{
+	notifyIntervalUS = maxHz > 0 ? 1000000 / maxHz : 0;
+	notifyLatestOnly = latestOnly;
+	return *this;
+}
+
+// Sets the priority class of updates to this characteristic from the update queue (see `GGKUpdatePriority`)
+//
+// The default is EUpdatePriorityNormal. This should be set in the server description, before any update handles are registered
+// for this characteristic (see `ggkRegisterUpdateHandle()`.)
+GattCharacteristic &GattCharacteristic::updatePriority(GGKUpdatePriority newPriority)
+{
+	priority = newPriority;
+	return *this;
+}
+
+// Records an update from the update queue at time `now` (in microseconds, see `g_get_monotonic_time()`)
+//
+// Returns true if the update may be processed now. Otherwise, the update is deferred (see `notifyPolicy()`) and this
+// method returns false.
+bool GattCharacteristic::admitUpdate(gint64 now) const
+{
+	// Updates are only processed immediately if none are already waiting their turn, so they stay in order
+	if (0 == notifyIntervalUS || (0 == deferredUpdates && now - lastUpdateTime >= notifyIntervalUS))
+	{
+		lastUpdateTime = now;
+		return true;
+	}
+
+	if (!notifyLatestOnly || 0 == deferredUpdates)
+	{
+		deferredUpdates += 1;
+	}
+
+	return false;
+}
+
+// Returns the time (in microseconds) at which our next deferred update is due, or -1 if we have no deferred updates
+gint64 GattCharacteristic::getDeferredUpdateTime() const
+{
+	return 0 == deferredUpdates ? -1 : lastUpdateTime + notifyIntervalUS;
+}
+
+// Takes our next deferred update if it is due at time `now`
+//
+// Returns true if the caller should now process the update, otherwise false
+bool GattCharacteristic::takeDeferredUpdate(gint64 now) const
+{
+	if (0 == deferredUpdates || now < lastUpdateTime + notifyIntervalUS)
+	{
+		return false;
+	}
+
+	deferredUpdates -= 1;
+	lastUpdateTime = now;
+	return true;
+}
+
+// Tracks whether any client is subscribed to our notifications or indications
+//
+// This adds the `StartNotify` and `StopNotify` methods. BlueZ calls `StartNotify` when the first client subscribes and
+// `StopNotify` when the last one unsubscribes (or disconnects), so from then on `hasSubscribers()` reflects whether a change
+// notification would reach anybody.
+GattCharacteristic &GattCharacteristic::trackSubscriptions()
+{
+	if (tracksSubscriptions)
+	{
+		return *this;
+	}
+
+	tracksSubscriptions = true;
+
+	// void StartNotify()
+	static const char *inArgs[] = {nullptr};
+	addMethod("StartNotify", inArgs, nullptr, onStartNotify);
+
+	// void StopNotify()
+	addMethod("StopNotify", inArgs, nullptr, onStopNotify);
+
+	return *this;
+}
+
+// The `StartNotify` method registered by `trackSubscriptions()`
+void GattCharacteristic::onStartNotify(const DBusInterface &self, GDBusConnection *, const std::string &, GVariant *, GDBusMethodInvocation *pInvocation, void *)
+{
+	const GattCharacteristic &characteristic = static_cast<const GattCharacteristic &>(self);
+	Logger::debug(SSTR << "Client subscribed to '" << characteristic.getPath() << "'");
+	characteristic.notifying.store(true, std::memory_order_relaxed);
+	g_dbus_method_invocation_return_value(pInvocation, nullptr);
+}
+
+// The `StopNotify` method registered by `trackSubscriptions()`
+void GattCharacteristic::onStopNotify(const DBusInterface &self, GDBusConnection *, const std::string &, GVariant *, GDBusMethodInvocation *pInvocation, void *)
+{
+	const GattCharacteristic &characteristic = static_cast<const GattCharacteristic &>(self);
+	Logger::debug(SSTR << "Last client unsubscribed from '" << characteristic.getPath() << "'");
+	characteristic.notifying.store(false, std::memory_order_relaxed);
+	Sessions::getInstance().unsubscribe(characteristic.getPath().toString());
+	g_dbus_method_invocation_return_value(pInvocation, nullptr);
+}
+
+// Receives client writes through a socket rather than through `WriteValue`
+//
+// Defined as: fd, uint16 AcquireWrite(dict options)
+//
+// D-Bus breakdown:
+//
+//     Input args:  options - "a{sv}"
+//     Output args: fd      - "h"
+//                  mtu     - "q"
+//
+// BlueZ only asks for the socket if we have a `WriteAcquired` property. Its value tells BlueZ whether the socket is already held,
+// which BlueZ tracks for itself, so we simply report false.
+GattCharacteristic &GattCharacteristic::onAcquiredWrite(AcquiredWriteCallback callback)
+{
+	pOnAcquiredWriteFunc = callback;
+	addProperty<GattCharacteristic>("WriteAcquired", false);
+
+	static const char *inArgs[] = {"a{sv}", nullptr};
+	addMethod("AcquireWrite", inArgs, "hq", onAcquireWrite);
+
+	return *this;
+}
+
+// The `AcquireWrite` method registered by `onAcquiredWrite()`
+void GattCharacteristic::onAcquireWrite(const DBusInterface &self, GDBusConnection *, const std::string &, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData)
+{
+	const GattCharacteristic &characteristic = static_cast<const GattCharacteristic &>(self);
+	characteristic.pAcquiredWriteUserData = pUserData;
+	characteristic.replyWithAcquiredStream(characteristic.writeStream, receiveAcquiredWrite, pParameters, pInvocation);
+}
+
+// Sends notifications through a socket rather than through `PropertiesChanged`
+//
+// Defined as: fd, uint16 AcquireNotify(dict options)
+//
+// D-Bus breakdown:
+//
+//     Input args:  options - "a{sv}"
+//     Output args: fd      - "h"
+//                  mtu     - "q"
+//
+// As with `onAcquiredWrite()`, the `NotifyAcquired` property only needs to exist.
+GattCharacteristic &GattCharacteristic::acquireNotify()
+{
+	addProperty<GattCharacteristic>("NotifyAcquired", false);
+
+	static const char *inArgs[] = {"a{sv}", nullptr};
+	addMethod("AcquireNotify", inArgs, "hq", onAcquireNotify);
+
+	return *this;
+}
+
+// The `AcquireNotify` method registered by `acquireNotify()`
+void GattCharacteristic::onAcquireNotify(const DBusInterface &self, GDBusConnection *, const std::string &, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *)
+{
+	const GattCharacteristic &characteristic = static_cast<const GattCharacteristic &>(self);
+	characteristic.replyWithAcquiredStream(characteristic.notifyStream, nullptr, pParameters, pInvocation);
+}
+
+// Replies to `AcquireWrite` or `AcquireNotify` with a new socket for `stream`
+//
+// The MTU BlueZ passes in the options is returned in the reply, since we have no reason to ask for anything different.
+void GattCharacteristic::replyWithAcquiredStream(AcquiredStream &stream, AcquiredStream::Receiver receiver, GVariant *pParameters, GDBusMethodInvocation *pInvocation) const
+{
+	guint16 mtu = AcquiredStream::kDefaultMtu;
+	GVariant *pOptions = g_variant_get_child_value(pParameters, 0);
+	GVariant *pMtu = g_variant_lookup_value(pOptions, "mtu", G_VARIANT_TYPE_UINT16);
+	if (nullptr != pMtu)
+	{
+		mtu = g_variant_get_uint16(pMtu);
+		g_variant_unref(pMtu);
+	}
+	g_variant_unref(pOptions);
+
+	AcquiredStream::Releaser releaser = &stream == &notifyStream ? releaseNotifyStream : nullptr;
+	int fd = stream.acquire(mtu, receiver, const_cast<GattCharacteristic *>(this), releaser);
+	if (fd < 0)
+	{
+		g_dbus_method_invocation_return_dbus_error(pInvocation, "org.bluez.Error.Failed", "Unable to create a socket");
+		return;
+	}
+
+	Logger::debug(SSTR << "Client acquired a socket for '" << getPath() << "' with an MTU of " << stream.getMtu());
+
+	// The client's session records the notification sockets it holds, so its MTU governs how our notifications are sized
+	if (&stream == &notifyStream)
+	{
+		Sessions::getInstance().subscribe(Sessions::addressFromParameters(pParameters), getPath().toString());
+	}
+
+	// The fd list takes ownership of BlueZ's end of the socket and closes it once the reply has been sent
+	GUnixFDList *pFdList = g_unix_fd_list_new_from_array(&fd, 1);
+	g_dbus_method_invocation_return_value_with_unix_fd_list(pInvocation, g_variant_new("(hq)", 0, stream.getMtu()), pFdList);
+	g_object_unref(pFdList);
+}
+
+// Copies a chunk written by a client into its long write buffer, calling our `onLongWriteValue()` callback once it is complete
+//
+// BlueZ's `type` option tells us how the client wrote. Ordinary writes ("request" or "command") are complete in themselves and
+// are delivered straight from the message. Prepared writes ("reliable") are copied into place in the client's buffer at the
+// offset BlueZ gives, so rewriting a chunk simply overwrites it. A chunk shorter than the most a Prepare Write request can carry
+// for the client's MTU (or one that fills the buffer) completes the value; without an MTU, we assume the minimum. A value that
+// ends on a full chunk can't be told apart from one with more to come, so our timer delivers it once it has not been written to
+// for `kLongWriteTimeoutMS`.
+//
+// Older versions of BlueZ don't pass `type`. For those, a write at offset 0 that fits in a single ATT write is delivered
+// straight away (and kept, in case it turns out to be the first chunk of a long write), and anything else is buffered.
+void GattCharacteristic::receiveLongWrite(GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData) const
+{
+	// Pull what we need from the options dictionary
+	guint16 offset = 0;
+	guint16 mtu = AcquiredStream::kDefaultMtu;
+	std::string device;
+	std::string type;
+
+	GVariant *pOptions = g_variant_get_child_value(pParameters, 1);
+	GVariant *pOffset = g_variant_lookup_value(pOptions, "offset", G_VARIANT_TYPE_UINT16);
+	if (nullptr != pOffset)
+	{
+		offset = g_variant_get_uint16(pOffset);
+		g_variant_unref(pOffset);
+	}
+	GVariant *pMtu = g_variant_lookup_value(pOptions, "mtu", G_VARIANT_TYPE_UINT16);
+	if (nullptr != pMtu)
+	{
+		mtu = g_variant_get_uint16(pMtu);
+		g_variant_unref(pMtu);
+	}
+	GVariant *pDevice = g_variant_lookup_value(pOptions, "device", G_VARIANT_TYPE_OBJECT_PATH);
+	if (nullptr != pDevice)
+	{
+		device = g_variant_get_string(pDevice, nullptr);
+		g_variant_unref(pDevice);
+	}
+	GVariant *pType = g_variant_lookup_value(pOptions, "type", G_VARIANT_TYPE_STRING);
+	if (nullptr != pType)
+	{
+		type = g_variant_get_string(pType, nullptr);
+		g_variant_unref(pType);
+	}
+	g_variant_unref(pOptions);
+
+	GVariant *pValue = g_variant_get_child_value(pParameters, 0);
+	gsize size = 0;
+	const guint8 *pChunk = static_cast<const guint8 *>(g_variant_get_fixed_array(pValue, &size, 1));
+
+	// An ordinary write is the whole value, so there's nothing to buffer
+	if ("request" == type || "command" == type)
+	{
+		if (size > longWriteMaxSize)
+		{
+			Logger::warn(SSTR << "Write of '" << getPath() << "' exceeds its maximum length of " << longWriteMaxSize);
+			g_variant_unref(pValue);
+			g_dbus_method_invocation_return_dbus_error(pInvocation, "org.bluez.Error.InvalidValueLength", "Invalid value length");
+			return;
+		}
+
+		if (nullptr != pOnLongWriteValueFunc)
+		{
+			pOnLongWriteValueFunc(*this, pConnection, pChunk, size, pUserData);
+		}
+		g_variant_unref(pValue);
+		methodReturnVariant(pInvocation, nullptr);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(longWritesMutex);
+
+	// Discard any buffers that have been abandoned (our timer has already delivered anything they held)
+	gint64 now = g_get_monotonic_time();
+	for (auto it = longWrites.begin(); it != longWrites.end();)
+	{
+		if (!it->second.pending && now - it->second.lastAccessTime > static_cast<gint64>(kLongWriteTimeoutMS) * 1000)
+		{
+			it = longWrites.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	auto it = longWrites.find(device);
+	if (longWrites.end() == it)
+	{
+		it = longWrites.insert(std::make_pair(device, LongWrite())).first;
+		it->second.buffer.reserve(longWriteMaxSize < kLongWriteMaxSize ? longWriteMaxSize : kLongWriteMaxSize);
+	}
+	LongWrite &longWrite = it->second;
+	longWrite.lastAccessTime = now;
+	std::vector<guint8> &buffer = longWrite.buffer;
+
+	// A write at offset 0 starts a new value
+	if (0 == offset)
+	{
+		buffer.clear();
+	}
+
+	if (offset > buffer.size())
+	{
+		Logger::warn(SSTR << "Long write of '" << getPath() << "' at offset " << offset << " is beyond the " << buffer.size() << " bytes written so far");
+		g_variant_unref(pValue);
+		longWrites.erase(it);
+		g_dbus_method_invocation_return_dbus_error(pInvocation, "org.bluez.Error.InvalidOffset", "Invalid offset");
+		return;
+	}
+
+	if (offset + size > longWriteMaxSize)
+	{
+		Logger::warn(SSTR << "Long write of '" << getPath() << "' exceeds its maximum length of " << longWriteMaxSize);
+		g_variant_unref(pValue);
+		longWrites.erase(it);
+		g_dbus_method_invocation_return_dbus_error(pInvocation, "org.bluez.Error.InvalidValueLength", "Invalid value length");
+		return;
+	}
+
+	buffer.resize(offset);
+	buffer.insert(buffer.end(), pChunk, pChunk + size);
+	g_variant_unref(pValue);
+
+	bool singleWrite = type.empty() && 0 == offset && size <= static_cast<gsize>(mtu - kWriteHeaderSize);
+	bool finalChunk = size < static_cast<gsize>(mtu - kPrepareWriteHeaderSize) || buffer.size() == longWriteMaxSize;
+	if (singleWrite || finalChunk)
+	{
+		GGK_LOG_DEBUG("Long write of " << buffer.size() << " bytes to '" << getPath() << "' is complete");
+		if (nullptr != pOnLongWriteValueFunc)
+		{
+			pOnLongWriteValueFunc(*this, pConnection, buffer.data(), buffer.size(), pUserData);
+		}
+
+		// Without a type, what looked like a single write may be continued; otherwise the value is done with
+		longWrite.pending = false;
+		if (!singleWrite)
+		{
+			buffer.clear();
+		}
+	}
+	else
+	{
+		longWrite.pending = true;
+		longWrite.pConnection = pConnection;
+		longWrite.pUserData = pUserData;
+		if (0 == longWriteTimerId)
+		{
+			longWriteTimerId = addServerSource(g_timeout_source_new(kLongWriteTimeoutMS), onLongWriteTimeout, const_cast<GattCharacteristic *>(this));
+		}
+	}
+
+	// Even though WriteValue returns void, a reply is needed, otherwise the client gets an error
+	methodReturnVariant(pInvocation, nullptr);
+}
+
+// Delivers the long writes that have not been written to for `kLongWriteTimeoutMS` (called from our long write timer)
+//
+// These are values that ended on a full chunk (see `receiveLongWrite()`.) The timer keeps running while any value is pending.
+gboolean GattCharacteristic::onLongWriteTimeout(gpointer pContext)
+{
+	const GattCharacteristic &self = *static_cast<const GattCharacteristic *>(pContext);
+
+	std::lock_guard<std::mutex> lock(self.longWritesMutex);
+	gint64 now = g_get_monotonic_time();
+	bool stillPending = false;
+	for (auto &entry : self.longWrites)
+	{
+		LongWrite &longWrite = entry.second;
+		if (!longWrite.pending)
+		{
+			continue;
+		}
+
+		if (now - longWrite.lastAccessTime < static_cast<gint64>(kLongWriteTimeoutMS) * 1000)
+		{
+			stillPending = true;
+			continue;
+		}
+
+		GGK_LOG_DEBUG("Long write of " << longWrite.buffer.size() << " bytes to '" << self.getPath() << "' went idle; delivering it");
+		if (nullptr != self.pOnLongWriteValueFunc)
+		{
+			self.pOnLongWriteValueFunc(self, longWrite.pConnection, longWrite.buffer.data(), longWrite.buffer.size(), longWrite.pUserData);
+		}
+		longWrite.buffer.clear();
+		longWrite.pending = false;
+	}
+
+	if (!stillPending)
+	{
+		self.longWriteTimerId = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+// Passes a packet from our write socket to our `onAcquiredWrite()` callback
+void GattCharacteristic::receiveAcquiredWrite(const guint8 *pData, size_t size, void *pContext)
+{
+	const GattCharacteristic &self = *static_cast<const GattCharacteristic *>(pContext);
+	if (nullptr != self.pOnAcquiredWriteFunc)
+	{
+		self.pOnAcquiredWriteFunc(self, pData, size, self.pAcquiredWriteUserData);
+	}
+}
+
+// Ends the subscription recorded for our notification socket once it has been released (see `replyWithAcquiredStream()`)
+void GattCharacteristic::releaseNotifyStream(void *pContext)
+{
+	const GattCharacteristic &self = *static_cast<const GattCharacteristic *>(pContext);
+	Logger::debug(SSTR << "Client released the notification socket for '" << self.getPath() << "'");
+	Sessions::getInstance().unsubscribe(self.getPath().toString());
+}
+
+// Responds to a ReadValue method with a slice of a (potentially long) value, for clients that read it in MTU-sized chunks
+//
+// Clients read values longer than their MTU using a series of reads with increasing offsets. Rather than fetching and
+// serializing the whole value for each of those reads, this method calls `valueCallback` only for a read at offset 0 (or when
+// it has no snapshot for the client.) It keeps the resulting byte array ("ay") as a snapshot for that client (keyed on the
+// `device` option BlueZ passes with each read) and serves each subsequent offset as a zero-copy slice of it. This also means
+// that a client sees a consistent value across all of its chunks, even if the value changes part-way through.
+//
+// A snapshot is discarded once its final chunk has been served (when BlueZ reports the MTU), when it has not been read from
+// for `kLongReadTimeoutMS`, or when the client starts over at offset 0.
+void GattCharacteristic::methodReturnLongValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters, LongReadValueCallback valueCallback, void *pUserData, bool wrapInTuple) const
+{
+	// Pull what we need from the options dictionary
+	guint16 offset = 0;
+	guint16 mtu = 0;
+	std::string device;
+
+	GVariant *pOptions = g_variant_get_child_value(pParameters, 0);
+	GVariant *pOffset = g_variant_lookup_value(pOptions, "offset", G_VARIANT_TYPE_UINT16);
+	if (nullptr != pOffset)
+	{
+		offset = g_variant_get_uint16(pOffset);
+		g_variant_unref(pOffset);
+	}
+	GVariant *pMtu = g_variant_lookup_value(pOptions, "mtu", G_VARIANT_TYPE_UINT16);
+	if (nullptr != pMtu)
+	{
+		mtu = g_variant_get_uint16(pMtu);
+		g_variant_unref(pMtu);
+	}
+	GVariant *pDevice = g_variant_lookup_value(pOptions, "device", G_VARIANT_TYPE_OBJECT_PATH);
+	if (nullptr != pDevice)
+	{
+		device = g_variant_get_string(pDevice, nullptr);
+		g_variant_unref(pDevice);
+	}
+	g_variant_unref(pOptions);
+
+	// Discard any snapshots that have been abandoned
+	gint64 now = g_get_monotonic_time();
+	for (auto it = longReads.begin(); it != longReads.end();)
+	{
+		if (now - it->second.lastAccessTime > static_cast<gint64>(kLongReadTimeoutMS) * 1000)
+		{
+			it = longReads.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// Take a new snapshot when a read starts over (or we don't have one for this client)
+	auto it = longReads.find(device);
+	if (0 == offset || longReads.end() == it)
+	{
+		GVariant *pValue = g_variant_ref_sink(valueCallback(*this, pUserData));
+		it = longReads.insert(std::make_pair(device, LongRead())).first;
+		it->second.pSnapshot = std::shared_ptr<GBytes>(g_variant_get_data_as_bytes(pValue), g_bytes_unref);
+		g_variant_unref(pValue);
+	}
+	it->second.lastAccessTime = now;
+
+	GBytes *pSnapshot = it->second.pSnapshot.get();
+	gsize size = g_bytes_get_size(pSnapshot);
+	if (offset > size)
+	{
+		Logger::warn(SSTR << "Long read of '" << getPath() << "' at offset " << offset << " is beyond the value's length of " << size);
+		longReads.erase(it);
+		g_dbus_method_invocation_return_dbus_error(pInvocation, "org.bluez.Error.InvalidOffset", "Invalid offset");
+		return;
+	}
+
+	// Serve the remainder of the value from the requested offset (BlueZ trims it to the client's MTU)
+	GBytes *pSlice = g_bytes_new_from_bytes(pSnapshot, offset, size - offset);
+	GVariant *pVariant = Utils::gvariantFromByteArray(pSlice);
+	g_bytes_unref(pSlice);
+
+	// If this read covers the rest of the value, the client is done with the snapshot. A read response carries up to (MTU - 1)
+	// bytes of the value.
+	if (0 != mtu && size - offset <= static_cast<gsize>(mtu - 1))
+	{
+		longReads.erase(it);
+	}
+
+	methodReturnVariant(pInvocation, pVariant, wrapInTuple);
+}
+
 // Convenience functions to add a GATT descriptor to the hierarchy
 //
 // We simply add a new child at the given path and add an interface configured as a GATT descriptor to it. The
@@ -200,15 +881,198 @@ GattDescriptor &GattCharacteristic::gattDescriptorBegin(const std::string &pathE
 // This is a generalized method that accepts a `GVariant *`. A templated version is available that supports common types called
 // `sendChangeNotificationValue()`.
 //
-// The caller may choose to consult HciAdapter::getInstance().getActiveConnectionCount() in order to determine if there are any
-// active connections before sending a change notification.
+// If nobody is subscribed (see `hasSubscribers()`), the notification is dropped without being sent. A floating `pNewValue`
+// is consumed either way.
 void GattCharacteristic::sendChangeNotificationVariant(GDBusConnection *pBusConnection, GVariant *pNewValue) const
 {
-	g_auto(GVariantBuilder) builder;
-	g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add(&builder, "{sv}", "Value", pNewValue);
-	GVariant *pSasv = g_variant_new("(sa{sv})", "org.bluez.GattCharacteristic1", &builder);
-	owner.emitSignal(pBusConnection, "org.freedesktop.DBus.Properties", "PropertiesChanged", pSasv);
+	if (!hasSubscribers())
+	{
+		if (nullptr != pNewValue && g_variant_is_floating(pNewValue))
+		{
+			g_variant_unref(g_variant_ref_sink(pNewValue));
+		}
+
+		Stats::increment(Stats::getInstance().notificationsSuppressed);
+		return;
+	}
+
+	// A client holding our notification socket (see `acquireNotify()`) receives byte arrays through it, without D-Bus
+	if (notifyStream.isAcquired() && nullptr != pNewValue && g_variant_is_of_type(pNewValue, G_VARIANT_TYPE_BYTESTRING))
+	{
+		ScopedLatency latency(Stats::getInstance().notificationLatency);
+		Stats::increment(Stats::getInstance().notificationsSent);
+		g_variant_ref_sink(pNewValue);
+		gsize size = 0;
+		const void *pData = g_variant_get_fixed_array(pNewValue, &size, 1);
+		notifyStream.send(pData, size);
+		g_variant_unref(pNewValue);
+		return;
+	}
+
+	if (nullptr != pCurrentBatch)
+	{
+		pCurrentBatch->add(*this, pBusConnection, g_variant_ref_sink(pNewValue));
+		return;
+	}
+
+	ScopedLatency latency(Stats::getInstance().notificationLatency);
+	emitChangeNotification(pBusConnection, pNewValue);
+}
+
+// Returns the most bytes a change notification from this characteristic can carry without being truncated
+//
+// For a client holding our notification socket, this is (MTU - 3) for the socket. Otherwise, it is (MTU - 3) for the smallest MTU
+// among the connected clients (see `Sessions::getNotificationMtu()`), which is 20 bytes until the clients have told us their MTUs.
+size_t GattCharacteristic::getNotificationPayloadSize() const
+{
+	size_t streamSize = notifyStream.getMaxPacketSize();
+	if (0 != streamSize)
+	{
+		return streamSize;
+	}
+
+	return Sessions::getInstance().getNotificationMtu(getPath().toString()) - kAttNotificationHeaderSize;
+}
+
+// Sends `count` records of `recordSize` bytes each in as few change notifications as possible
+//
+// As many whole records as fit in `getNotificationPayloadSize()` are packed into each notification. Records are never split
+// across notifications; a record larger than the payload size is sent by itself (and will be truncated.)
+//
+// Returns the number of notifications sent
+int GattCharacteristic::sendChangeNotificationPacked(GDBusConnection *pBusConnection, const void *pRecords, size_t recordSize, size_t count) const
+{
+	if (nullptr == pRecords || 0 == recordSize || 0 == count)
+	{
+		return 0;
+	}
+
+	if (!hasSubscribers())
+	{
+		Stats::increment(Stats::getInstance().notificationsSuppressed);
+		return 0;
+	}
+
+	size_t payloadSize = getNotificationPayloadSize();
+	size_t recordsPerNotification = recordSize < payloadSize ? payloadSize / recordSize : 1;
+	if (recordSize > payloadSize)
+	{
+		GGK_LOG_DEBUG("Records of " << recordSize << " bytes for '" << getPath() << "' exceed the notification payload size of " << payloadSize);
+	}
+
+	ScopedLatency latency(Stats::getInstance().notificationLatency);
+
+	const guint8 *pBytes = static_cast<const guint8 *>(pRecords);
+	int sent = 0;
+	while (count > 0)
+	{
+		size_t records = count < recordsPerNotification ? count : recordsPerNotification;
+		size_t size = records * recordSize;
+
+		// A client holding our notification socket receives each packet through it, without D-Bus
+		if (notifyStream.isAcquired())
+		{
+			Stats::increment(Stats::getInstance().notificationsSent);
+			notifyStream.send(pBytes, size);
+		}
+		else
+		{
+			emitChangeNotification(pBusConnection, Utils::gvariantFromByteArray(pBytes, static_cast<int>(size)));
+		}
+
+		pBytes += size;
+		count -= records;
+		sent += 1;
+	}
+
+	return sent;
+}
+
+// Emits a PropertiesChanged signal carrying our new value, consuming a floating `pNewValue`
+//
+// This is called for every notification, so the parts of the signal that never change (the interface name, the property name and
+// the empty list of invalidated properties) are built once and shared by every characteristic. GVariants are immutable, so this
+// is safe from any thread. All that is left for each notification is to wrap the new value and assemble the tuple, without
+// parsing any format strings.
+void GattCharacteristic::emitChangeNotification(GDBusConnection *pBusConnection, GVariant *pNewValue) const
+{
+	static GVariant *pInterfaceName = g_variant_ref_sink(g_variant_new_string("org.bluez.GattCharacteristic1"));
+	static GVariant *pValueName = g_variant_ref_sink(g_variant_new_string("Value"));
+	static GVariant *pInvalidated = g_variant_ref_sink(g_variant_new_array(G_VARIANT_TYPE_STRING, nullptr, 0));
+
+	Stats::increment(Stats::getInstance().notificationsSent);
+
+	GVariant *pEntry = g_variant_new_dict_entry(pValueName, g_variant_new_variant(pNewValue));
+	GVariant *pChanged = g_variant_new_array(G_VARIANT_TYPE("{sv}"), &pEntry, 1);
+	GVariant *pChildren[] = { pInterfaceName, pChanged, pInvalidated };
+	GVariant *pSasvas = g_variant_new_tuple(pChildren, 3);
+	owner.emitSignal(pBusConnection, "org.freedesktop.DBus.Properties", "PropertiesChanged", pSasvas);
+}
+
+//
+// Notification batches
+//
+
+thread_local GattCharacteristic::NotificationBatch *GattCharacteristic::pCurrentBatch = nullptr;
+
+// Starts collecting the change notifications sent on the current thread (unless a batch is already open on it)
+GattCharacteristic::NotificationBatch::NotificationBatch()
+: outermost(nullptr == pCurrentBatch)
+{
+	if (outermost)
+	{
+		pCurrentBatch = this;
+	}
+}
+
+// Sends the collected notifications and closes the batch
+GattCharacteristic::NotificationBatch::~NotificationBatch()
+{
+	if (outermost)
+	{
+		pCurrentBatch = nullptr;
+		flush();
+	}
+}
+
+// Sends the notifications collected so far
+void GattCharacteristic::NotificationBatch::flush()
+{
+	for (Notification &notification : notifications)
+	{
+		// The signal takes its own reference to the value
+		ScopedLatency latency(Stats::getInstance().notificationLatency);
+		notification.pCharacteristic->emitChangeNotification(notification.pBusConnection, notification.pNewValue);
+		g_variant_unref(notification.pNewValue);
+	}
+
+	// Keep our storage for the next batch
+	notifications.clear();
+}
+
+// Adds a notification to the batch, taking over our reference to `pNewValue`
+//
+// Notifications are sent in the order they were added. Only if coalescing is enabled (see `ggkUpdateQueueSetCoalescing()`) does a
+// characteristic already in the batch have its value replaced, so that just its latest value is sent. Batches are small (about
+// the size of one pass of the update queue), so a linear search is all we need.
+void GattCharacteristic::NotificationBatch::add(const GattCharacteristic &characteristic, GDBusConnection *pBusConnection, GVariant *pNewValue)
+{
+	if (updateQueueIsCoalescing())
+	{
+		for (Notification &notification : notifications)
+		{
+			if (notification.pCharacteristic == &characteristic)
+			{
+				g_variant_unref(notification.pNewValue);
+				notification.pBusConnection = pBusConnection;
+				notification.pNewValue = pNewValue;
+				Stats::increment(Stats::getInstance().notificationsCoalesced);
+				return;
+			}
+		}
+	}
+
+	notifications.push_back({&characteristic, pBusConnection, pNewValue});
 }
 
 }; // namespace ggk
\ No newline at end of file
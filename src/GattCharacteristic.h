@@ -26,8 +26,16 @@
 #include <gio/gio.h>
 #include <string>
 #include <list>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
 
 #include "Utils.h"
+#include "Stats.h"
+#include "AcquiredStream.h"
 #include "TickEvent.h"
 #include "GattInterface.h"
 #include "HciAdapter.h"
@@ -64,6 +72,29 @@ struct DBusObject;
 	void *pUserData \
 )
 
+#define CHARACTERISTIC_LONG_READ_VALUE_CALLBACK_LAMBDA [] \
+( \
+	const GattCharacteristic &self, \
+	void *pUserData \
+) -> GVariant *
+
+#define CHARACTERISTIC_LONG_WRITE_VALUE_CALLBACK_LAMBDA [] \
+( \
+	const GattCharacteristic &self, \
+	GDBusConnection *pConnection, \
+	const guint8 *pData, \
+	size_t size, \
+	void *pUserData \
+)
+
+#define CHARACTERISTIC_ACQUIRED_WRITE_CALLBACK_LAMBDA [] \
+( \
+	const GattCharacteristic &self, \
+	const guint8 *pData, \
+	size_t size, \
+	void *pUserData \
+)
+
 #define CHARACTERISTIC_METHOD_CALLBACK_LAMBDA [] \
 ( \
        const GattCharacteristic &self, \
@@ -86,13 +117,25 @@ struct GattCharacteristic : GattInterface
 	typedef void (*MethodCallback)(const GattCharacteristic &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
 	typedef void (*EventCallback)(const GattCharacteristic &self, const TickEvent &event, GDBusConnection *pConnection, void *pUserData);
 	typedef bool (*UpdatedValueCallback)(const GattCharacteristic &self, GDBusConnection *pConnection, void *pUserData);
+	typedef GVariant *(*LongReadValueCallback)(const GattCharacteristic &self, void *pUserData);
+	typedef void (*LongWriteValueCallback)(const GattCharacteristic &self, GDBusConnection *pConnection, const guint8 *pData, size_t size, void *pUserData);
+	typedef void (*AcquiredWriteCallback)(const GattCharacteristic &self, const guint8 *pData, size_t size, void *pUserData);
+
+	// How long a client's long read snapshot is kept without being read from before it is discarded
+	static const int kLongReadTimeoutMS = 5000;
+
+	// How long a client's partly written value is kept without being written to before it is delivered as it stands
+	static const int kLongWriteTimeoutMS = 5000;
+
+	// The largest value a long write accepts by default (the largest value an attribute may hold)
+	static const size_t kLongWriteMaxSize = 512;
 
 	// Construct a GattCharacteristic
 	//
 	// Genreally speaking, these objects should not be constructed directly. Rather, use the `gattCharacteristicBegin()` method
 	// in `GattService`.
 	GattCharacteristic(DBusObject &owner, GattService &service, const std::string &name);
-	virtual ~GattCharacteristic() {}
+	virtual ~GattCharacteristic();
 
 	// Returns a string identifying the type of interface
 	virtual const std::string getInterfaceType() const { return GattCharacteristic::kInterfaceType; }
@@ -105,17 +148,42 @@ struct GattCharacteristic : GattInterface
 	// Locates a D-Bus method within this D-Bus interface and invokes the method
 	virtual bool callMethod(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 
+	// Invokes a method (which must belong to this interface) that has already been located, such as through the server's index
+	virtual void invokeMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
+
+	// Runs this characteristic's method callbacks (such as `onReadValue` and `onWriteValue`) on the server's worker threads
+	//
+	// By default, method callbacks run on the server's thread, so a slow callback holds up every other client request and all
+	// notifications. With this set, and once the application has enabled the workers (see `ggkEnableMethodWorkers()`), each
+	// method call is handed to a worker thread (see WorkerPool.cpp) along with its `GDBusMethodInvocation`, and the callback
+	// replies from there. Calls to the same characteristic are still run one at a time, in the order they arrived, but calls to
+	// different characteristics run concurrently.
+	//
+	// IMPORTANT: Callbacks for this characteristic must be thread safe. Any that use the data getter or setter move those calls
+	// onto the workers too, so prefer this for callbacks that don't call back into the application. Replying to the invocation
+	// and sending change notifications are safe from any thread.
+	GattCharacteristic &runMethodsOnWorkers();
+
 	// Adds an event to the characteristic and returns a refereence to 'this` to enable method chaining in the server description
 	//
-	// NOTE: We specifically overload this method in order to accept our custom EventCallback type and transform it into a
-	// TickEvent::Callback type. We also return our own type. This simplifies the server description by allowing call to chain.
+	// NOTE: We specifically overload this method in order to accept our custom EventCallback type, which `onTickEvent()` calls
+	// on behalf of the TickEvent. We also return our own type. This simplifies the server description by allowing call to chain.
 	GattCharacteristic &onEvent(int tickFrequency, void *pUserData, EventCallback callback);
 
+	// Adds an event that fires every `periodMS` milliseconds and returns a reference to 'this` to enable method chaining
+	GattCharacteristic &onEventMS(int periodMS, void *pUserData, EventCallback callback);
+
 	// Ticks events within this characteristic
 	//
 	// Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
 	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData) const;
 
+	// Fires one of our events (used by the event timer), translating the generic TickEvent::Callback into our own EventCallback
+	virtual void fireEvent(const TickEvent &event, GDBusConnection *pConnection, void *pUserData) const;
+
+	// Calls the EventCallback registered with `onEvent()` or `onEventMS()` (the TickEvent::Callback for each of our events)
+	static void onTickEvent(const DBusInterface &self, const TickEvent &event, GDBusConnection *pConnection, void *pUserData);
+
 	// Specialized support for Characteristic ReadlValue method
 	//
 	// Defined as: array{byte} ReadValue(dict options)
@@ -126,6 +194,22 @@ struct GattCharacteristic : GattInterface
 	//     Output args: value   - "ay"
 	GattCharacteristic &onReadValue(MethodCallback callback);
 
+	// Gives the characteristic a value that never changes, in place of an `onReadValue` callback
+	//
+	// The value is converted to a byte array (see `Utils::gvariantFromByteArray()`) once, here, and every ReadValue is answered
+	// straight from it, at the requested offset, without calling back into the server description or the data getter. An
+	// example usage would be:
+	//
+	//     .gattCharacteristicBegin("mfgr_name", "2A29", {"read"})
+	//         .constantValue("Acme Inc.")
+	//     .gattCharacteristicEnd()
+	template<typename T>
+	GattCharacteristic &constantValue(const T &value)
+	{
+		setConstantValue(Utils::gvariantFromByteArray(value));
+		return *this;
+	}
+
 	// Specialized support for Characteristic WriteValue method
 	//
 	// Defined as: void WriteValue(array{byte} value, dict options)
@@ -137,6 +221,34 @@ struct GattCharacteristic : GattInterface
 	//     Output args: void
 	GattCharacteristic &onWriteValue(MethodCallback callback);
 
+	// Specialized support for Characteristic WriteValue method, for values written in chunks
+	//
+	// Defined as: void WriteValue(array{byte} value, dict options)
+	//
+	// Clients write values longer than their MTU as a series of writes with increasing offsets (a "long write", which BlueZ
+	// delivers to us one prepared chunk at a time.) Rather than each `onWriteValue` callback stitching those chunks together,
+	// this adds a `WriteValue` method that copies each chunk into place in a buffer kept for the writing client (keyed on the
+	// `device` option BlueZ passes with each write) and calls `callback` once, with the whole value, when the final chunk
+	// arrives. Each call is replied to automatically.
+	//
+	// Ordinary writes (BlueZ's `type` option is "request" or "command") are delivered straight away. Prepared writes ("reliable")
+	// are buffered, and a chunk is taken to be the final one if it is shorter than the most a prepared write can carry for the
+	// client's MTU. A value that ends on a full chunk is delivered once it has not been written to for `kLongWriteTimeoutMS`.
+	// Without a `type` option (older versions of BlueZ), a write at offset 0 that fits in a single ATT write is delivered
+	// straight away, and anything else is buffered as a prepared write.
+	//
+	// Values of up to `maxSize` bytes are accepted; a write beyond that (or one that leaves a gap) fails with an ATT error and
+	// discards the buffer. Each client's buffer is reused for its following values, so it is not reallocated for every write.
+	//
+	// An example usage would be:
+	//
+	//     .onLongWriteValue(CHARACTERISTIC_LONG_WRITE_VALUE_CALLBACK_LAMBDA
+	//     {
+	//         self.setDataPointer("text/string", std::string(reinterpret_cast<const char *>(pData), size).c_str());
+	//         self.callOnUpdatedValue(pConnection, pUserData);
+	//     })
+	GattCharacteristic &onLongWriteValue(LongWriteValueCallback callback, size_t maxSize = kLongWriteMaxSize);
+
 	// Custom support for handling updates to our characteristic's value
 	//
 	// Defined as: (NOT defined by Bluetooth or BlueZ - this method is internal only)
@@ -168,6 +280,140 @@ struct GattCharacteristic : GattInterface
 	//      })
 	bool callOnUpdatedValue(GDBusConnection *pConnection, void *pUserData) const;
 
+	// Limits how often the update queue processes updates to this characteristic (and therefore how often it notifies)
+	//
+	// Updates from the update queue (see `ggkPushUpdateQueue()` and `ggkNotifyHandle()`) are processed at most `maxHz` times per
+	// second. An update that arrives too soon is deferred until its turn comes around.
+	//
+	// If `latestOnly` is true, deferred updates are merged so that only one is processed, which sends the value as it is at that
+	// time. Clients then always receive fresh data, no more than (1 / `maxHz`) seconds old, rather than a backlog. If false, each
+	// deferred update is processed in turn, spaced out at the given rate.
+	//
+	// A `maxHz` of zero (the default) removes the limit.
+	//
+	// Note that this does not affect calls to `callOnUpdatedValue()` or `sendChangeNotificationValue()` made directly.
+	GattCharacteristic &notifyPolicy(int maxHz, bool latestOnly = true);
+
+	// Sets the priority class of updates to this characteristic from the update queue (see `GGKUpdatePriority`)
+	//
+	// The default is EUpdatePriorityNormal. This should be set in the server description, before any update handles are
+	// registered for this characteristic (see `ggkRegisterUpdateHandle()`.)
+	GattCharacteristic &updatePriority(GGKUpdatePriority priority);
+
+	// Returns the priority class of updates to this characteristic
+	GGKUpdatePriority getUpdatePriority() const { return priority; }
+
+	// Records an update from the update queue at time `now` (in microseconds, see `g_get_monotonic_time()`)
+	//
+	// Returns true if the update may be processed now. Otherwise, the update is deferred (see `notifyPolicy()`) and this
+	// method returns false.
+	bool admitUpdate(gint64 now) const;
+
+	// Returns the time (in microseconds) at which our next deferred update is due, or -1 if we have no deferred updates
+	gint64 getDeferredUpdateTime() const;
+
+	// Takes our next deferred update if it is due at time `now`
+	//
+	// Returns true if the caller should now process the update, otherwise false
+	bool takeDeferredUpdate(gint64 now) const;
+
+	// Responds to a ReadValue method with a slice of a (potentially long) value, for clients that read it in MTU-sized chunks
+	//
+	// Clients read values longer than their MTU using a series of reads with increasing offsets. Rather than fetching and
+	// serializing the whole value for each of those reads, this method calls `valueCallback` only for a read at offset 0 (or when
+	// it has no snapshot for the client.) It keeps the resulting byte array ("ay") as a snapshot for that client (keyed on the
+	// `device` option BlueZ passes with each read) and serves each subsequent offset as a zero-copy slice of it. This also means
+	// that a client sees a consistent value across all of its chunks, even if the value changes part-way through.
+	//
+	// A snapshot is discarded once its final chunk has been served (when BlueZ reports the MTU), when it has not been read from
+	// for `kLongReadTimeoutMS`, or when the client starts over at offset 0.
+	//
+	// This method is intended to be called from within an `onReadValue` callback. An example usage would be:
+	//
+	//     .onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
+	//     {
+	//         self.methodReturnLongValue(pInvocation, pParameters, CHARACTERISTIC_LONG_READ_VALUE_CALLBACK_LAMBDA
+	//         {
+	//             return Utils::gvariantFromByteArray(self.getDataPointer<const char *>("text/string", ""));
+	//         }, pUserData);
+	//     })
+	void methodReturnLongValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters, LongReadValueCallback valueCallback, void *pUserData, bool wrapInTuple = true) const;
+
+	// Tracks whether any client is subscribed to our notifications or indications
+	//
+	// This adds the `StartNotify` and `StopNotify` methods. BlueZ calls `StartNotify` when the first client subscribes and
+	// `StopNotify` when the last one unsubscribes (or disconnects), so from then on `hasSubscribers()` reflects whether a change
+	// notification would reach anybody.
+	//
+	// This is called automatically by `GattService::gattCharacteristicBegin()` for characteristics with the "notify" or
+	// "indicate" flag.
+	GattCharacteristic &trackSubscriptions();
+
+	// Returns true if a client may be subscribed to our change notifications
+	//
+	// This is always true for a characteristic that doesn't track its subscriptions (see `trackSubscriptions()`), since its
+	// `Value` property changes may be of interest to D-Bus clients. It is also true while a client holds our notification socket
+	// (see `acquireNotify()`.)
+	bool hasSubscribers() const
+	{
+		return !tracksSubscriptions || notifying.load(std::memory_order_relaxed) || notifyStream.isAcquired();
+	}
+
+	// Receives client writes through a socket rather than through `WriteValue`
+	//
+	// Defined as: fd, uint16 AcquireWrite(dict options)
+	//
+	// D-Bus breakdown:
+	//
+	//     Input args:  options - "a{sv}"
+	//     Output args: fd      - "h"
+	//                  mtu     - "q"
+	//
+	// This adds the `AcquireWrite` method and the `WriteAcquired` property. BlueZ then hands writes without response (the
+	// "write-without-response" flag) to us through a socket, bypassing D-Bus, and `callback` is called from the server's thread
+	// with each value written. Writes with response still arrive through `WriteValue`, so a characteristic will usually have both.
+	//
+	// The callback's `pUserData` is the user data the `AcquireWrite` method was called with. See `getAcquiredWriteMtu()` for the
+	// largest value a client can write.
+	GattCharacteristic &onAcquiredWrite(AcquiredWriteCallback callback);
+
+	// Sends notifications through a socket rather than through `PropertiesChanged`
+	//
+	// Defined as: fd, uint16 AcquireNotify(dict options)
+	//
+	// D-Bus breakdown:
+	//
+	//     Input args:  options - "a{sv}"
+	//     Output args: fd      - "h"
+	//                  mtu     - "q"
+	//
+	// This adds the `AcquireNotify` method and the `NotifyAcquired` property. BlueZ calls `AcquireNotify` (instead of
+	// `StartNotify`) when a client subscribes, and closes the socket when the client unsubscribes. While the socket is held,
+	// byte array change notifications (see `sendChangeNotificationValue()`) are written to it rather than signalled over D-Bus,
+	// and `sendStream()` can be used to stream data directly.
+	GattCharacteristic &acquireNotify();
+
+	// Streams `size` bytes to the client holding our notification socket (see `acquireNotify()`)
+	//
+	// The data is split into notifications of at most (MTU - 3) bytes each. This may be called from any thread, and never blocks;
+	// if the socket is full, the remaining data is dropped.
+	//
+	// Returns true if all of the data was sent, or false if no client holds the socket or some of the data was dropped
+	bool sendStream(const void *pData, size_t size) const { return notifyStream.send(pData, size); }
+
+	// Returns the MTU BlueZ gave us for our write socket (see `onAcquiredWrite()`), or 0 if no client holds it
+	uint16_t getAcquiredWriteMtu() const { return writeStream.getMtu(); }
+
+	// Returns the MTU BlueZ gave us for our notification socket (see `acquireNotify()`), or 0 if no client holds it
+	uint16_t getAcquiredNotifyMtu() const { return notifyStream.getMtu(); }
+
+	// Returns the most bytes a change notification from this characteristic can carry without being truncated
+	//
+	// For a client holding our notification socket, this is (MTU - 3) for the socket. Otherwise, it is (MTU - 3) for the
+	// smallest MTU among the connected clients (see `Sessions::getNotificationMtu()`), which is 20 bytes until the clients have
+	// told us their MTUs.
+	size_t getNotificationPayloadSize() const;
+
 	// Convenience functions to add a GATT descriptor to the hierarchy
 	//
 	// We simply add a new child at the given path and add an interface configured as a GATT descriptor to it. The
@@ -188,13 +434,54 @@ struct GattCharacteristic : GattInterface
 	// To end the descriptor, call `gattDescriptorEnd()`
 	GattDescriptor &gattDescriptorBegin(const std::string &pathElement, const GattUuid &uuid, const std::vector<const char *> &flags);
 
+	// Collects the change notifications sent on the current thread while it exists, and sends them together when it is destroyed
+	//
+	// Notifications are sent in the order they were made. If coalescing is enabled (see `ggkUpdateQueueSetCoalescing()`) and a
+	// characteristic changes more than once within the batch, only its latest value is sent. Batches may be nested; the
+	// notifications are sent when the outermost batch ends. The server batches the notifications sent while it processes each
+	// pass of the update queue, so this is only needed for notifications sent from elsewhere (such as an `onEvent` callback that
+	// updates several characteristics.) An example usage would be:
+	//
+	//     GattCharacteristic::NotificationBatch batch;
+	//     pFirst->sendChangeNotificationValue(pConnection, firstValue);
+	//     pSecond->sendChangeNotificationValue(pConnection, secondValue);
+	struct NotificationBatch
+	{
+		NotificationBatch();
+		~NotificationBatch();
+
+		// Sends the notifications collected so far
+		void flush();
+
+	private:
+
+		friend struct GattCharacteristic;
+
+		// Prevent copying
+		NotificationBatch(NotificationBatch const &) = delete;
+		void operator=(NotificationBatch const &) = delete;
+
+		// Adds a notification to the batch, taking over our reference to `pNewValue`
+		void add(const GattCharacteristic &characteristic, GDBusConnection *pBusConnection, GVariant *pNewValue);
+
+		struct Notification
+		{
+			const GattCharacteristic *pCharacteristic;
+			GDBusConnection *pBusConnection;
+			GVariant *pNewValue;
+		};
+
+		std::vector<Notification> notifications;
+		bool outermost;
+	};
+
 	// Sends a change notification to subscribers to this characteristic
 	//
 	// This is a generalized method that accepts a `GVariant *`. A templated version is available that supports common types called
 	// `sendChangeNotificationValue()`.
 	//
-	// The caller may choose to consult HciAdapter::getInstance().getActiveConnectionCount() in order to determine if there are any
-	// active connections before sending a change notification.
+	// If nobody is subscribed (see `hasSubscribers()`), the notification is dropped without being sent. A floating `pNewValue`
+	// is consumed either way. If a `NotificationBatch` is open on this thread, the notification is sent when the batch ends.
 	void sendChangeNotificationVariant(GDBusConnection *pBusConnection, GVariant *pNewValue) const;
 
 	// Sends a change notification to subscribers to this characteristic
@@ -202,19 +489,144 @@ struct GattCharacteristic : GattInterface
 	// This is a helper method that accepts common types. For custom types, there is a form that accepts a `GVariant *`, called
 	// `sendChangeNotificationVariant()`.
 	//
-	// The caller may choose to consult HciAdapter::getInstance().getActiveConnectionCount() in order to determine if there are any
-	// active connections before sending a change notification.
+	// If nobody is subscribed (see `hasSubscribers()`), this returns without serializing the value.
+	//
+	// As with `GattInterface::methodReturnValue()`, a `GBytes *` or `std::shared_ptr<const std::vector<guint8>>` value is sent
+	// without being copied.
 	template<typename T>
-	void sendChangeNotificationValue(GDBusConnection *pBusConnection, T value) const
+	void sendChangeNotificationValue(GDBusConnection *pBusConnection, const T &value) const
 	{
+		if (!hasSubscribers())
+		{
+			Stats::increment(Stats::getInstance().notificationsSuppressed);
+			return;
+		}
+
 		GVariant *pVariant = Utils::gvariantFromByteArray(value);
 		sendChangeNotificationVariant(pBusConnection, pVariant);
 	}
 
+	// Sends `count` records of `recordSize` bytes each in as few change notifications as possible
+	//
+	// As many whole records as fit in `getNotificationPayloadSize()` are packed into each notification, so that small readings
+	// fill packets rather than each taking one of their own. Records are never split across notifications; a record larger than
+	// the payload size is sent by itself (and will be truncated.)
+	//
+	// Each notification is sent immediately, even if a `NotificationBatch` is open, since a coalescing batch would only keep the
+	// last of them.
+	//
+	// Returns the number of notifications sent
+	int sendChangeNotificationPacked(GDBusConnection *pBusConnection, const void *pRecords, size_t recordSize, size_t count) const;
+
 protected:
 
+	// A method call waiting for a worker thread (see `runMethodsOnWorkers()`)
+	struct PendingMethod
+	{
+		const DBusMethod *pMethod;
+		GDBusConnection *pConnection;
+		GVariant *pParameters;
+		GDBusMethodInvocation *pInvocation;
+		void *pUserData;
+		uint64_t queuedUS;
+	};
+
+	// Calls a method's callback, or queues it for a worker thread if we run our methods on workers
+	void dispatchMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
+
+	// Runs our oldest pending method call (on a worker thread), then hands any others back to the pool
+	void runPendingMethod() const;
+
+	// The `StartNotify` and `StopNotify` methods registered by `trackSubscriptions()`
+	static void onStartNotify(const DBusInterface &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+	static void onStopNotify(const DBusInterface &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+
+	// The `AcquireWrite` and `AcquireNotify` methods registered by `onAcquiredWrite()` and `acquireNotify()`
+	static void onAcquireWrite(const DBusInterface &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+	static void onAcquireNotify(const DBusInterface &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+
+	// Replies to `AcquireWrite` or `AcquireNotify` with a new socket for `stream`
+	void replyWithAcquiredStream(AcquiredStream &stream, AcquiredStream::Receiver receiver, GVariant *pParameters, GDBusMethodInvocation *pInvocation) const;
+
+	// Copies a chunk written by a client into its long write buffer, calling our `onLongWriteValue()` callback once it is complete
+	void receiveLongWrite(GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData) const;
+
+	// The `WriteValue` method registered by `onLongWriteValue()`, which passes each chunk on to `receiveLongWrite()`
+	static void onLongWriteMethod(const DBusInterface &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+
+	// Delivers the long writes that have not been written to for `kLongWriteTimeoutMS` (called from our long write timer)
+	static gboolean onLongWriteTimeout(gpointer pContext);
+
+	// Passes a packet from our write socket to our `onAcquiredWrite()` callback
+	static void receiveAcquiredWrite(const guint8 *pData, size_t size, void *pContext);
+
+	// Ends the subscription recorded for our notification socket once it has been released
+	static void releaseNotifyStream(void *pContext);
+
+	// Emits a PropertiesChanged signal carrying our new value, consuming a floating `pNewValue`
+	void emitChangeNotification(GDBusConnection *pBusConnection, GVariant *pNewValue) const;
+
+	// The outermost notification batch open on the current thread, if any (see `NotificationBatch`)
+	static thread_local NotificationBatch *pCurrentBatch;
+
+	// A snapshot of our value, being read by a client in chunks (see `methodReturnLongValue()`)
+	struct LongRead
+	{
+		std::shared_ptr<GBytes> pSnapshot;
+		gint64 lastAccessTime;
+	};
+
+	// A value being written by a client in chunks (see `onLongWriteValue()`)
+	//
+	// `pending` is true while the buffer holds chunks that have not yet been delivered, along with the connection and user data
+	// to deliver them with.
+	struct LongWrite
+	{
+		std::vector<guint8> buffer;
+		gint64 lastAccessTime = 0;
+		bool pending = false;
+		GDBusConnection *pConnection = nullptr;
+		void *pUserData = nullptr;
+	};
+
 	GattService &service;
 	UpdatedValueCallback pOnUpdatedValueFunc;
+
+	// Our active long reads, keyed by the client's device path
+	mutable std::map<std::string, LongRead> longReads;
+
+	// Our long write callback and limit, and the values being written, keyed by the client's device path
+	//
+	// The timer delivers values left pending, from the main loop, so the mutex keeps it from racing a method call running on a
+	// worker thread (see `runMethodsOnWorkers()`.)
+	LongWriteValueCallback pOnLongWriteValueFunc;
+	size_t longWriteMaxSize;
+	mutable std::map<std::string, LongWrite> longWrites;
+	mutable std::mutex longWritesMutex;
+	mutable guint longWriteTimerId;
+
+	// Our notification policy (see `notifyPolicy()`) and update priority, along with the state of any updates the policy has deferred
+	gint64 notifyIntervalUS;
+	bool notifyLatestOnly;
+	GGKUpdatePriority priority;
+	mutable gint64 lastUpdateTime;
+	mutable int deferredUpdates;
+
+	// Subscription state (see `trackSubscriptions()`)
+	bool tracksSubscriptions;
+	mutable std::atomic<bool> notifying;
+
+	// Our method calls waiting for a worker thread (see `runMethodsOnWorkers()`), and whether one is already scheduled to run them
+	bool methodsOnWorkers;
+	mutable std::mutex pendingMethodsMutex;
+	mutable std::deque<PendingMethod> pendingMethods;
+	mutable bool pendingMethodScheduled;
+
+	// Our acquired sockets (see `onAcquiredWrite()` and `acquireNotify()`), and where to send what arrives on the write socket
+	AcquiredWriteCallback pOnAcquiredWriteFunc;
+	mutable void *pAcquiredWriteUserData;
+	mutable AcquiredStream writeStream;
+	mutable AcquiredStream notifyStream;
 };
 
 }; // namespace ggk
\ No newline at end of file
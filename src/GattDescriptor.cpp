@@ -70,16 +70,41 @@ bool GattDescriptor::callMethod(const std::string &methodName, GDBusConnection *
 	return false;
 }
 
+// Invokes a method (which must belong to this interface) that has already been located, such as through the server's index
+void GattDescriptor::invokeMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
+{
+	method.call<GattDescriptor>(pConnection, getPath(), getName(), method.getName(), pParameters, pInvocation, pUserData);
+}
+
 // Adds an event to the descriptor and returns a refereence to 'this` to enable method chaining in the server description
 //
-// NOTE: We specifically overload this method in order to accept our custom EventCallback type and transform it into a
-// TickEvent::Callback type. We also return our own type. This simplifies the server description by allowing call to chain.
+// NOTE: We specifically overload this method in order to accept our custom EventCallback type, which `onTickEvent()` calls
+// on behalf of the TickEvent. We also return our own type. This simplifies the server description by allowing call to chain.
 GattDescriptor &GattDescriptor::onEvent(int tickFrequency, void *pUserData, EventCallback callback)
 {
-	events.push_back(TickEvent(this, tickFrequency, reinterpret_cast<TickEvent::Callback>(callback), pUserData));
+	TickEvent event(this, tickFrequency, nullptr != callback ? onTickEvent : nullptr, pUserData);
+	event.setOwnerCallback(reinterpret_cast<TickEvent::OwnerCallback>(callback));
+	events.push_back(event);
+	return *this;
+}
+
+// Adds an event that fires every `periodMS` milliseconds and returns a reference to 'this` to enable method chaining
+GattDescriptor &GattDescriptor::onEventMS(int periodMS, void *pUserData, EventCallback callback)
+{
+	TickEvent event = TickEvent::fromPeriodMS(this, periodMS, nullptr != callback ? onTickEvent : nullptr, pUserData);
+	event.setOwnerCallback(reinterpret_cast<TickEvent::OwnerCallback>(callback));
+	events.push_back(event);
 	return *this;
 }
 
+// Calls the EventCallback registered with `onEvent()` or `onEventMS()`, converted back from the generic pointer its TickEvent
+// holds
+void GattDescriptor::onTickEvent(const DBusInterface &self, const TickEvent &event, GDBusConnection *pConnection, void *pUserData)
+{
+	EventCallback callback = reinterpret_cast<EventCallback>(event.getOwnerCallback());
+	callback(static_cast<const GattDescriptor &>(self), event, pConnection, pUserData);
+}
+
 // Ticks events within this descriptor
 //
 // Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
@@ -91,6 +116,12 @@ void GattDescriptor::tickEvents(GDBusConnection *pConnection, void *pUserData) c
 	}
 }
 
+// Fires one of our events (used by the event timer), translating the generic TickEvent::Callback into our own EventCallback
+void GattDescriptor::fireEvent(const TickEvent &event, GDBusConnection *pConnection, void *pUserData) const
+{
+	event.fire<GattDescriptor>(getPath(), pConnection, pUserData);
+}
+
 // Specialized support for ReadlValue method
 //
 // Defined as: array{byte} ReadValue(dict options)
@@ -163,7 +194,7 @@ bool GattDescriptor::callOnUpdatedValue(GDBusConnection *pConnection, void *pUse
 		return false;
 	}
 
-	Logger::debug(SSTR << "Calling OnUpdatedValue function for interface at path '" << getPath() << "'");
+	GGK_LOG_DEBUG("Calling OnUpdatedValue function for interface at path '" << getPath() << "'");
 	return pOnUpdatedValueFunc(*this, pConnection, pUserData);
 }
 
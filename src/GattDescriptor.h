@@ -105,17 +105,29 @@ struct GattDescriptor : GattInterface
 	// Locates a D-Bus method within this D-Bus interface and invokes the method
 	virtual bool callMethod(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 
+	// Invokes a method (which must belong to this interface) that has already been located, such as through the server's index
+	virtual void invokeMethod(const DBusMethod &method, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
+
 	// Adds an event to the descriptor and returns a refereence to 'this` to enable method chaining in the server description
 	//
-	// NOTE: We specifically overload this method in order to accept our custom EventCallback type and transform it into a
-	// TickEvent::Callback type. We also return our own type. This simplifies the server description by allowing call to chain.
+	// NOTE: We specifically overload this method in order to accept our custom EventCallback type, which `onTickEvent()` calls
+	// on behalf of the TickEvent. We also return our own type. This simplifies the server description by allowing call to chain.
 	GattDescriptor &onEvent(int tickFrequency, void *pUserData, EventCallback callback);
 
+	// Adds an event that fires every `periodMS` milliseconds and returns a reference to 'this` to enable method chaining
+	GattDescriptor &onEventMS(int periodMS, void *pUserData, EventCallback callback);
+
 	// Ticks events within this descriptor
 	//
 	// Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
 	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData) const;
 
+	// Fires one of our events (used by the event timer), translating the generic TickEvent::Callback into our own EventCallback
+	virtual void fireEvent(const TickEvent &event, GDBusConnection *pConnection, void *pUserData) const;
+
+	// Calls the EventCallback registered with `onEvent()` or `onEventMS()` (the TickEvent::Callback for each of our events)
+	static void onTickEvent(const DBusInterface &self, const TickEvent &event, GDBusConnection *pConnection, void *pUserData);
+
 	// Specialized support for Descriptor ReadlValue method
 	//
 	// Defined as: array{byte} ReadValue(dict options)
@@ -126,6 +138,17 @@ struct GattDescriptor : GattInterface
 	//     Output args: value   - "ay"
 	GattDescriptor &onReadValue(MethodCallback callback);
 
+	// Gives the descriptor a value that never changes, in place of an `onReadValue` callback
+	//
+	// This is ideal for a Characteristic User Description (0x2901). The value is converted to a byte array once, here, and every
+	// ReadValue is answered straight from it (see `GattCharacteristic::constantValue()`.)
+	template<typename T>
+	GattDescriptor &constantValue(const T &value)
+	{
+		setConstantValue(Utils::gvariantFromByteArray(value));
+		return *this;
+	}
+
 	// Specialized support for Descriptor WriteValue method
 	//
 	// Defined as: void WriteValue(array{byte} value, dict options)
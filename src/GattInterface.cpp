@@ -45,7 +45,7 @@ GattInterface::~GattInterface()
 //
 
 // Returns the list of GATT properties
-const std::list<GattProperty> &GattInterface::getProperties() const
+const std::vector<GattProperty> &GattInterface::getProperties() const
 {
 	return properties;
 }
@@ -64,14 +64,71 @@ void GattInterface::methodReturnVariant(GDBusMethodInvocation *pInvocation, GVar
 	g_dbus_method_invocation_return_value(pInvocation, pVariant);
 }
 
+// Stores a constant byte array value ("ay"), taking ownership of `pValue`, and adds a ReadValue method that answers straight from it
+//
+// The value is sunk, so it is never floating; GVariants are immutable, so it can be shared by every reply (from any thread) without
+// copying.
+void GattInterface::setConstantValue(GVariant *pValue)
+{
+	pConstantValue = std::shared_ptr<GVariant>(g_variant_ref_sink(pValue), g_variant_unref);
+
+	// array{byte} ReadValue(dict options)
+	const char *inArgs[] = {"a{sv}", nullptr};
+	addMethod("ReadValue", inArgs, "ay", readConstantValue);
+}
+
+// The ReadValue method added by `setConstantValue()`
+void GattInterface::readConstantValue(const DBusInterface &self, GDBusConnection * /*pConnection*/, const std::string & /*methodName*/, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void * /*pUserData*/)
+{
+	static_cast<const GattInterface &>(self).methodReturnConstantValue(pInvocation, pParameters);
+}
+
+// Responds to a ReadValue method from our constant value (see `setConstantValue()`), starting at the read's offset
+void GattInterface::methodReturnConstantValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters) const
+{
+	GVariant *pValue = pConstantValue.get();
+
+	guint16 offset = 0;
+	GVariant *pOptions = g_variant_get_child_value(pParameters, 0);
+	GVariant *pOffset = g_variant_lookup_value(pOptions, "offset", G_VARIANT_TYPE_UINT16);
+	if (nullptr != pOffset)
+	{
+		offset = g_variant_get_uint16(pOffset);
+		g_variant_unref(pOffset);
+	}
+	g_variant_unref(pOptions);
+
+	// Most reads are of the whole value, which we already have in the form we need
+	if (0 == offset)
+	{
+		methodReturnVariant(pInvocation, pValue, true);
+		return;
+	}
+
+	// A byte array's serialized form is simply its bytes
+	gsize size = g_variant_get_size(pValue);
+	if (offset > size)
+	{
+		Logger::warn(SSTR << "Read of '" << getPath() << "' at offset " << offset << " is beyond the value's length of " << size);
+		g_dbus_method_invocation_return_dbus_error(pInvocation, "org.bluez.Error.InvalidOffset", "Invalid offset");
+		return;
+	}
+
+	GBytes *pBytes = g_variant_get_data_as_bytes(pValue);
+	GBytes *pSlice = g_bytes_new_from_bytes(pBytes, offset, size - offset);
+	methodReturnVariant(pInvocation, Utils::gvariantFromByteArray(pSlice), true);
+	g_bytes_unref(pSlice);
+	g_bytes_unref(pBytes);
+}
+
 // Locates a `GattProperty` within the interface
 //
 // This method returns a pointer to the property or nullptr if not found
-const GattProperty *GattInterface::findProperty(const std::string &name) const
+const GattProperty *GattInterface::findProperty(const char *pName) const
 {
 	for (const GattProperty &property : properties)
 	{
-		if (property.getName() == name)
+		if (property.getName() == pName)
 		{
 			return &property;
 		}
@@ -80,6 +137,14 @@ const GattProperty *GattInterface::findProperty(const std::string &name) const
 	return nullptr;
 }
 
+// Locates a `GattProperty` within the interface
+//
+// This method returns a pointer to the property or nullptr if not found
+const GattProperty *GattInterface::findProperty(const std::string &name) const
+{
+	return findProperty(name.c_str());
+}
+
 // Internal method used to generate introspection XML used to describe our services on D-Bus
 std::string GattInterface::generateIntrospectionXML(int depth) const
 {
@@ -114,4 +179,11 @@ std::string GattInterface::generateIntrospectionXML(int depth) const
 	return xml;
 }
 
+// Releases any spare capacity held by the interface once the server description is complete (see `Server::freeze()`)
+void GattInterface::shrinkToFit()
+{
+	DBusInterface::shrinkToFit();
+	properties.shrink_to_fit();
+}
+
 }; // namespace ggk
\ No newline at end of file
@@ -24,10 +24,12 @@
 
 #include <gio/gio.h>
 #include <string>
-#include <list>
+#include <vector>
+#include <memory>
 
 #include "TickEvent.h"
 #include "DBusInterface.h"
+#include "DataStore.h"
 #include "GattProperty.h"
 #include "GattUuid.h"
 #include "Server.h"
@@ -60,7 +62,7 @@ struct GattInterface : DBusInterface
 	//
 
 	// Returns the list of GATT properties
-	const std::list<GattProperty> &getProperties() const;
+	const std::vector<GattProperty> &getProperties() const;
 
 	// Add a `GattProperty` to the interface
 	//
@@ -87,7 +89,9 @@ struct GattInterface : DBusInterface
 	template<typename T>
 	T &addProperty(const std::string &name, const GattUuid &uuid, GDBusInterfaceGetPropertyFunc getter = nullptr, GDBusInterfaceSetPropertyFunc setter = nullptr)
 	{
-		return addProperty<T>(GattProperty(name, Utils::gvariantFromString(uuid.toString128().c_str()), getter, setter));
+		char uuidString[GattUuid::kStringLength128 + 1];
+		uuid.format(uuidString);
+		return addProperty<T>(GattProperty(name, Utils::gvariantFromString(uuidString), getter, setter));
 	}
 
 	// Helper method for adding a named property with a `DBusObjectPath`
@@ -132,6 +136,29 @@ struct GattInterface : DBusInterface
 		return addProperty<T>(GattProperty(name, Utils::gvariantFromBoolean(value), getter, setter));
 	}
 
+	// Return a data value from the server's data store (see DataStore.cpp)
+	//
+	// This is the slot-based alternative to `getDataValue()`, intended for trivially copyable types. Look up the slot once and
+	// keep it. An example usage would be:
+	//
+	//     static const int kBatterySlot = DataStore::getInstance().findSlot("battery/level");
+	//     uint8_t batteryLevel = self.getStoreValue<uint8_t>(kBatterySlot, 0);
+	template<typename T>
+	T getStoreValue(int slot, const T defaultValue) const
+	{
+		T value;
+		return DataStore::getInstance().get(slot, &value, sizeof(value)) == static_cast<int>(sizeof(value)) ? value : defaultValue;
+	}
+
+	// Return a data value from the server's data store (see DataStore.cpp) as an array of bytes ("ay")
+	//
+	// This is useful for strings and other variable-length values. An empty array is returned if the slot is invalid.
+	GVariant *getStoreByteArray(int slot) const
+	{
+		GVariant *pVariant = DataStore::getInstance().getByteArray(slot);
+		return nullptr == pVariant ? Utils::gvariantFromByteArray(static_cast<const guint8 *>(nullptr), 0) : pVariant;
+	}
+
 	// Return a data value from the server's registered data getter (GGKServerDataGetter)
 	//
 	// This method is for use with non-pointer types. For pointer types, use `getDataPointer()` instead.
@@ -202,24 +229,48 @@ struct GattInterface : DBusInterface
 	//
 	// This is a templated helper method that only works with common types. For a more generic form which can be used for custom
 	// types, see `methodReturnVariant()'.
+	//
+	// To return large values without copying them, pass a `GBytes *` or a `std::shared_ptr<const std::vector<guint8>>`; the
+	// response references the buffer rather than copying it (see `Utils::gvariantFromByteArray()`.)
 	template<typename T>
-	void methodReturnValue(GDBusMethodInvocation *pInvocation, T value, bool wrapInTuple = false) const
+	void methodReturnValue(GDBusMethodInvocation *pInvocation, const T &value, bool wrapInTuple = false) const
 	{
 		GVariant *pVariant = Utils::gvariantFromByteArray(value);
 		methodReturnVariant(pInvocation, pVariant, wrapInTuple);
 	}
 
+	// Responds to a ReadValue method from our constant value (see `setConstantValue()`), starting at the read's offset
+	//
+	// A read from the start of the value replies with the stored GVariant itself; a read at an offset replies with a slice that
+	// shares its memory. Either way, nothing is copied or rebuilt.
+	void methodReturnConstantValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters) const;
+
+	// Returns our constant value (an "ay" GVariant), or nullptr if we don't have one
+	GVariant *getConstantValue() const { return pConstantValue.get(); }
+
 	// Locates a `GattProperty` within the interface
 	//
 	// This method returns a pointer to the property or nullptr if not found
+	const GattProperty *findProperty(const char *pName) const;
 	const GattProperty *findProperty(const std::string &name) const;
 
 	// Internal method used to generate introspection XML used to describe our services on D-Bus
 	virtual std::string generateIntrospectionXML(int depth) const;
 
+	// Releases any spare capacity held by the interface once the server description is complete (see `Server::freeze()`)
+	virtual void shrinkToFit();
+
 protected:
 
-	std::list<GattProperty> properties;
+	// Stores a constant byte array value ("ay"), taking ownership of `pValue`, and adds a ReadValue method that answers straight from
+	// it (see `GattCharacteristic::constantValue()` and `GattDescriptor::constantValue()`)
+	void setConstantValue(GVariant *pValue);
+
+	// The ReadValue method added by `setConstantValue()`
+	static void readConstantValue(const DBusInterface &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+
+	std::vector<GattProperty> properties;
+	std::shared_ptr<GVariant> pConstantValue;
 };
 
 }; // namespace ggk
\ No newline at end of file
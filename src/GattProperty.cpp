@@ -26,6 +26,7 @@
 
 #include "Utils.h"
 #include "GattProperty.h"
+#include "ServerUtils.h"
 
 namespace ggk {
 
@@ -72,9 +73,12 @@ const GVariant *GattProperty::getValue() const
 //
 // In general, this method should not be called directly as properties are typically added to an interface using one of the the
 // interface's `addProperty` methods.
+//
+// Changing a value invalidates the cached response to `GetManagedObjects` (see `ServerUtils::getManagedObjects()`).
 GattProperty &GattProperty::setValue(GVariant *pValue)
 {
 	this->pValue = pValue;
+	ServerUtils::invalidateManagedObjects();
 	return *this;
 }
 
@@ -62,6 +62,8 @@ struct GattProperty
 	//
 	// In general, this method should not be called directly as properties are typically added to an interface using one of the the
 	// interface's `addProperty` methods.
+	//
+	// Changing a value invalidates the cached response to `GetManagedObjects` (see `ServerUtils::getManagedObjects()`).
 	GattProperty &setValue(GVariant *pValue);
 
 	//
@@ -23,6 +23,7 @@
 // description in Server.cpp.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+#include <string.h>
 #include <gio/gio.h>
 #include <string>
 #include <list>
@@ -81,6 +82,17 @@ GattCharacteristic &GattService::gattCharacteristicBegin(const std::string &path
 	characteristic.addProperty<GattCharacteristic>("UUID", uuid);
 	characteristic.addProperty<GattCharacteristic>("Service", owner.getPath());
 	characteristic.addProperty<GattCharacteristic>("Flags", flags);
+
+	// Track subscriptions, so that we don't send change notifications that nobody will receive
+	for (const char *pFlag : flags)
+	{
+		if (0 == strcmp(pFlag, "notify") || 0 == strcmp(pFlag, "indicate"))
+		{
+			characteristic.trackSubscriptions();
+			break;
+		}
+	}
+
 	return characteristic;
 }
 
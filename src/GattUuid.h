@@ -47,12 +47,18 @@
 //
 // By represetng a UUID in a custom class like this, we are able to give a UUID its own type, and use type safety to ensure that we
 // don't confuse regular strings with GATT UUIDs throughout the codebase.
+//
+// Internally, a GattUuid is just its 128-bit value (two 64-bit words) and the bit count it was created with, so it is cheap to
+// copy, compare and hash. Its constructors are `constexpr`, which means a UUID written as a literal (such as "2A19" or a custom
+// 128-bit UUID in Server.cpp) can be parsed entirely at compile time. Its string forms are only produced when they are asked
+// for; `format()` writes the 128-bit form into a caller's buffer without allocating.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #pragma once
 
 #include <string>
 #include <algorithm>
+#include <functional>
 #include <stdint.h>
 #include <ctype.h>
 
@@ -67,60 +73,36 @@ struct GattUuid
 	static constexpr const char *kGattStandardUuidPart1Prefix = "0000";
 	static constexpr const char *kGattStandardUuidSuffix = "-0000-1000-8000-00805f9b34fb";
 
+	// The Bluetooth Base UUID ("00000000-0000-1000-8000-00805f9b34fb"), as its high and low 64-bit words
+	static constexpr uint64_t kBaseUuidHigh = 0x0000000000001000ULL;
+	static constexpr uint64_t kBaseUuidLow = 0x800000805f9b34fbULL;
+
+	// The length of the 128-bit string form, not including the null terminator
+	static const int kStringLength128 = 36;
+
 	// Construct a GattUuid from a partial or complete string UUID
 	//
-	// This constructor will do the best it can with the data it is given. It will first clean the input by removing all non-hex
+	// This constructor will do the best it can with the data it is given. It will first clean the input by ignoring all non-hex
 	// characters (see `clean`) and the remaining characters are processed in the following way:
 	//
 	//     4-character string is treated as a 16-bit UUID
 	//     8-character string is treated as a 32-bit UUID
 	//     32-character string is treated as a 128-bit UUID
 	//
-	// If the input string is not one of the above lengths, the  UUID will be left uninitialized as an empty string with a bit
-	// count of 0.
+	// If the input string is not one of the above lengths, the UUID will be left uninitialized (all zeros) with a bit count of 0.
 	//
-	// Finally, dashes are inserted into the string at the appropriate locations (see `dashify`).
-	GattUuid(const char *strUuid)
+	// This constructor is `constexpr`, so a literal UUID is parsed at compile time.
+	constexpr GattUuid(const char *strUuid)
+	: high(parseHigh(strUuid, countHexDigits(strUuid))), low(parseLow(strUuid, countHexDigits(strUuid))), bitCount(bitCountFor(countHexDigits(strUuid)))
 	{
-		*this = GattUuid(std::string(strUuid));
 	}
 
 	// Construct a GattUuid from a partial or complete string UUID
 	//
-	// This constructor will do the best it can with the data it is given. It will first clean the input by removing all non-hex
-	// characters (see `clean`) and the remaining characters are processed in the following way:
-	//
-	//     4-character string is treated as a 16-bit UUID
-	//     8-character string is treated as a 32-bit UUID
-	//     32-character string is treated as a 128-bit UUID
-	//
-	// If the input string is not one of the above lengths, the  UUID will be left uninitialized as an empty string with a bit
-	// count of 0.
-	//
-	// Finally, dashes are inserted into the string at the appropriate locations (see `dashify`).
-	GattUuid(std::string strUuid)
+	// See the `const char *` form of this constructor for details.
+	GattUuid(const std::string &strUuid)
+	: GattUuid(strUuid.c_str())
 	{
-		// Clean the string
-		strUuid = clean(strUuid);
-
-		// It's hex, so each character represents 4 bits
-		bitCount = strUuid.length() * 4;
-
-		if (bitCount == 16)
-		{
-			strUuid = kGattStandardUuidPart1Prefix + strUuid + kGattStandardUuidSuffix;
-		}
-		else if (bitCount == 32)
-		{
-			strUuid += kGattStandardUuidSuffix;
-		}
-		else if (bitCount != 128)
-		{
-			bitCount = 0;
-			strUuid = "";
-		}
-
-		uuid = dashify(strUuid);
 	}
 
 	// Constructs a GattUuid from a 16-bit Uuid value
@@ -130,12 +112,9 @@ struct GattUuid
 	//     0000????-0000-1000-8000-00805f9b34fb
 	//
 	// ...where "????" is replaced by the 4-digit hex value of `part`
-	GattUuid(const uint16_t part)
+	constexpr GattUuid(const uint16_t part)
+	: high((static_cast<uint64_t>(part) << 32) | kBaseUuidHigh), low(kBaseUuidLow), bitCount(16)
 	{
-		bitCount = 16;
-		char partStr[5];
-		snprintf(partStr, sizeof(partStr), "%04x", part);
-		uuid = std::string(kGattStandardUuidPart1Prefix) + partStr + kGattStandardUuidSuffix;
 	}
 
 	// Constructs a GattUuid from a 32-bit Uuid value
@@ -145,12 +124,9 @@ struct GattUuid
 	//     ????????-0000-1000-8000-00805f9b34fb
 	//
 	// ...where "????????" is replaced by the 8-digit hex value of `part`
-	GattUuid(const uint32_t part)
+	constexpr GattUuid(const uint32_t part)
+	: high((static_cast<uint64_t>(part) << 32) | kBaseUuidHigh), low(kBaseUuidLow), bitCount(32)
 	{
-		bitCount = 32;
-		char partStr[9];
-		snprintf(partStr, sizeof(partStr), "%08x", part);
-		uuid = std::string(partStr) + kGattStandardUuidSuffix;
 	}
 
 	// Constructs a GattUuid from a 5-part set of input values
@@ -163,32 +139,73 @@ struct GattUuid
 	//
 	// Note that `part5` is a 48-bit value and will be masked such that only the lower 48-bits of `part5` are used with all other
 	// bits ignored.
-	GattUuid(const uint32_t part1, const uint16_t part2, const uint16_t part3, const uint16_t part4, const uint64_t part5)
+	constexpr GattUuid(const uint32_t part1, const uint16_t part2, const uint16_t part3, const uint16_t part4, const uint64_t part5)
+	: high((static_cast<uint64_t>(part1) << 32) | (static_cast<uint64_t>(part2) << 16) | part3),
+	  low((static_cast<uint64_t>(part4) << 48) | (part5 & 0xffffffffffffULL)),
+	  bitCount(128)
 	{
-		bitCount = 128;
-		char partsStr[37];
-		uint32_t part5a = (part5 >> 4) & 0xffffffff;
-		uint32_t part5b = part5 & 0xffff;
-		snprintf(partsStr, sizeof(partsStr), "%08x-%04x-%04x-%04x-%08x%04x", part1, part2, part3, part4, part5a, part5b);
-		uuid = std::string(partsStr);
 	}
 
 	// Returns the bit count of the input when the GattUuid was constructed. Valid values are 16, 32, 128.
 	//
 	// If the GattUuid was constructed imporperly, this method will return 0.
-	int getBitCount() const
+	constexpr int getBitCount() const
 	{
 		return bitCount;
 	}
 
+	// Returns the high 64 bits of the 128-bit UUID (the first 16 hex digits of its string form)
+	constexpr uint64_t getHigh() const { return high; }
+
+	// Returns the low 64 bits of the 128-bit UUID (the last 16 hex digits of its string form)
+	constexpr uint64_t getLow() const { return low; }
+
+	// Writes the 16 bytes of the UUID into `pBytes`, most significant byte first (the order of its string form)
+	void getBytes(uint8_t *pBytes) const
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			pBytes[i] = static_cast<uint8_t>(high >> (56 - i * 8));
+			pBytes[8 + i] = static_cast<uint8_t>(low >> (56 - i * 8));
+		}
+	}
+
+	// Writes the full 128-bit GATT UUID ("xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx", in lower case) into `buffer`, null terminated
+	//
+	// This does not allocate. For a GattUuid that was not created correctly, an empty string is written.
+	void format(char (&buffer)[kStringLength128 + 1]) const
+	{
+		static const char kHexDigits[] = "0123456789abcdef";
+
+		if (0 == bitCount)
+		{
+			buffer[0] = '\0';
+			return;
+		}
+
+		int length = 0;
+		for (int digit = 0; digit < 32; ++digit)
+		{
+			if (8 == digit || 12 == digit || 16 == digit || 20 == digit)
+			{
+				buffer[length++] = '-';
+			}
+
+			uint64_t word = digit < 16 ? high : low;
+			buffer[length++] = kHexDigits[(word >> (60 - (digit % 16) * 4)) & 0xf];
+		}
+		buffer[length] = '\0';
+	}
+
 	// Returns the 16-bit portion of the GATT UUID or an empty string if the GattUuid was not created correctly
 	//
 	// Note that a 16-bit GATT UUID is only valid for standarg GATT UUIDs (prefixed with "0000" and ending with
 	// "0000-1000-8000-00805f9b34fb").
 	std::string toString16() const
 	{
-		if (uuid.empty()) { return uuid; }
-		return uuid.substr(4, 4);
+		char buffer[kStringLength128 + 1];
+		format(buffer);
+		return 0 == bitCount ? std::string() : std::string(buffer + 4, 4);
 	}
 
 	// Returns the 32-bit portion of the GATT UUID or an empty string if the GattUuid was not created correctly
@@ -196,14 +213,17 @@ struct GattUuid
 	// Note that a 32-bit GATT UUID is only valid for standarg GATT UUIDs (ending with "0000-1000-8000-00805f9b34fb").
 	std::string toString32() const
 	{
-		if (uuid.empty()) { return uuid; }
-		return uuid.substr(0, 8);
+		char buffer[kStringLength128 + 1];
+		format(buffer);
+		return 0 == bitCount ? std::string() : std::string(buffer, 8);
 	}
 
 	// Returns the full 128-bit GATT UUID or an empty string if the GattUuid was not created correctly
 	std::string toString128() const
 	{
-		return uuid;
+		char buffer[kStringLength128 + 1];
+		format(buffer);
+		return buffer;
 	}
 
 	// Returns a string form of the UUID, based on the bit count used when the UUID was created. A 16-bit UUID will return a
@@ -216,6 +236,17 @@ struct GattUuid
 		return toString128();
 	}
 
+	// UUIDs compare by value: a 16-bit UUID is equal to the same UUID written out in full
+	constexpr bool operator==(const GattUuid &other) const { return high == other.high && low == other.low; }
+	constexpr bool operator!=(const GattUuid &other) const { return !(*this == other); }
+	constexpr bool operator<(const GattUuid &other) const { return high < other.high || (high == other.high && low < other.low); }
+
+	// Returns a hash of the UUID's value
+	constexpr size_t hash() const
+	{
+		return static_cast<size_t>(high ^ (low * 0x9e3779b97f4a7c15ULL));
+	}
+
 	// Returns a new string containing the lower case contents of `strUuid` with all non-hex characters (0-9, A-F) removed
 	static std::string clean(const std::string &strUuid)
 	{
@@ -269,8 +300,70 @@ struct GattUuid
 
 private:
 
-	std::string uuid;
+	//
+	// Compile-time parsing
+	//
+	// These are written as single-expression recursive functions so that they can be evaluated at compile time under C++11.
+	//
+
+	// Returns the value of a hex digit, or -1 if `c` is not a hex digit
+	static constexpr int hexValue(char c)
+	{
+		return (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+	}
+
+	// Returns the number of hex digits in `pStr`
+	static constexpr int countHexDigits(const char *pStr)
+	{
+		return (nullptr == pStr || '\0' == *pStr) ? 0 : (hexValue(*pStr) >= 0 ? 1 : 0) + countHexDigits(pStr + 1);
+	}
+
+	// Returns the value of the hex digits of `pStr` numbered [`first`, `last`), ignoring non-hex characters
+	//
+	// `index` is the number of the next hex digit and `value` is the value accumulated so far.
+	static constexpr uint64_t parseHexDigits(const char *pStr, int first, int last, int index = 0, uint64_t value = 0)
+	{
+		return (nullptr == pStr || '\0' == *pStr || index >= last) ? value
+			: hexValue(*pStr) < 0 ? parseHexDigits(pStr + 1, first, last, index, value)
+			: parseHexDigits(pStr + 1, first, last, index + 1, index >= first ? (value << 4) | static_cast<uint64_t>(hexValue(*pStr)) : value);
+	}
+
+	// Returns the bit count for a string UUID containing `digits` hex digits (or 0 if it isn't a valid length)
+	static constexpr int bitCountFor(int digits)
+	{
+		return (4 == digits || 8 == digits || 32 == digits) ? digits * 4 : 0;
+	}
+
+	// Returns the high 64 bits of a string UUID containing `digits` hex digits
+	static constexpr uint64_t parseHigh(const char *pStr, int digits)
+	{
+		return 32 == digits ? parseHexDigits(pStr, 0, 16)
+			: (4 == digits || 8 == digits) ? (parseHexDigits(pStr, 0, digits) << 32) | kBaseUuidHigh
+			: 0;
+	}
+
+	// Returns the low 64 bits of a string UUID containing `digits` hex digits
+	static constexpr uint64_t parseLow(const char *pStr, int digits)
+	{
+		return 32 == digits ? parseHexDigits(pStr, 16, 32)
+			: (4 == digits || 8 == digits) ? kBaseUuidLow
+			: 0;
+	}
+
+	uint64_t high;
+	uint64_t low;
 	int bitCount;
 };
 
-}; // namespace ggk
\ No newline at end of file
+}; // namespace ggk
+
+namespace std {
+
+// Allows a GattUuid to be used as a key in unordered containers
+template<>
+struct hash<ggk::GattUuid>
+{
+	size_t operator()(const ggk::GattUuid &uuid) const { return uuid.hash(); }
+};
+
+}; // namespace std
@@ -30,185 +30,1202 @@
 //
 //     Log registration - used to register methods that accept all Gobbledegook logs
 //     Update queue management - used for notifying the server that data has been updated
+//     Data store - an optional, thread-safe store for server data
 //     Server state - used to track the server's current running state and health
 //     Server control - running and stopping the server
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+#include <stdio.h>
 #include <string.h>
 #include <string>
 #include <thread>
 #include <memory>
 #include <deque>
+#include <set>
+#include <map>
+#include <vector>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <algorithm>
 
 #include "Init.h"
 #include "Logger.h"
 #include "Server.h"
+#include "GattCharacteristic.h"
+#include "DataStore.h"
+#include "RingBuffer.h"
+#include "Stats.h"
+#include "HciAdapter.h"
+#include "Mgmt.h"
+#include "Sessions.h"
+#include "AdapterEvents.h"
+#include "WorkerPool.h"
 
 namespace ggk
 {
-	// During initialization, we'll check for complation at this interval
-	static const int kMaxAsyncInitCheckIntervalMS = 10;
+	// Our server thread
+	static std::thread serverThread;
+
+	// Held while `TheServer` is replaced, and by application threads while they look through it (see `ggkRegisterUpdateHandle()`)
+	// so that it can't be destroyed from under them
+	static std::mutex serverLifetimeMutex;
+
+	// The current server state
+	static std::atomic<GGKServerRunState> serverRunState(EUninitialized);
+
+	// The current server health
+	static std::atomic<GGKServerHealth> serverHealth(EOk);
+
+	// Signalled on every change to the server's run state or health, so that waiters (see `ggkWaitForRunState()`) wake at the
+	// instant of the transition
+	static std::mutex serverStateMutex;
+	static std::condition_variable cvServerState;
+
+	// The application's state change callback (see `ggkSetServerStateCallback()`), protected by `serverStateMutex`
+	static GGKServerStateCallback serverStateCallback = nullptr;
+	static void *pServerStateCallbackUserData = nullptr;
+
+	// We store the old GLib print handler and error print handler so we can restore if
+	static GPrintFunc printHandlerGLib;
+	static GPrintFunc printerrHandlerGLib;
+	static GLogFunc logHandlerGLib;
+
+	// By default, we'll process at most this many updates from the queue in a single pass of the main loop
+	static const int kDefaultUpdateQueueMaxBatchSize = 32;
+
+	// The number of update priority classes (see `GGKUpdatePriority`)
+	static const int kUpdatePriorityCount = EUpdatePriorityLow + 1;
+
+	// The number of passes a priority class may have updates waiting without being serviced before it is moved to the front
+	static const int kMaxStarvedPasses = 4;
+
+	// Our update queue, with one queue for each priority class
+	typedef std::tuple<std::string, std::string> QueueEntry;
+	std::deque<QueueEntry> updateQueues[kUpdatePriorityCount];
+	std::mutex updateQueueMutex;
+
+	// When coalescing is enabled, this holds the set of entries currently waiting in any of the `updateQueues` so that duplicates
+	// can be dropped. It is protected by `updateQueueMutex`.
+	static std::atomic<bool> updateQueueCoalescing(false);
+	static std::set<QueueEntry> pendingUpdates;
+
+	// The priority class of each characteristic that isn't in EUpdatePriorityNormal, keyed by path and interface name
+	//
+	// This is built by the server thread once the server description is frozen (see `indexUpdatePriorities()`), so that pushing
+	// an update needs neither a search of the server description nor access to `TheServer`. It is protected by `updateQueueMutex`.
+	static std::map<QueueEntry, GGKUpdatePriority> updatePriorities;
+
+	// The maximum number of update handles that can be registered (see `ggkRegisterUpdateHandle()`)
+	static const int kMaxUpdateHandles = 256;
+
+	// The number of updates that can be waiting in the update handle ring before `ggkNotifyHandle()` starts to fail
+	static const size_t kUpdateHandleRingSize = 1024;
+
+	// Registered update handles
+	//
+	// Entries are only ever appended (under `updateHandleMutex`) and are published by incrementing `updateHandleCount`, so readers
+	// never need the lock. The table is emptied when the server is torn down (see `resetUpdateHandles()`). Each handle's `pending` flag is used to coalesce handle updates when coalescing is enabled.
+	struct UpdateHandle
+	{
+		const GattCharacteristic *pCharacteristic;
+		GGKUpdatePriority priority;
+		std::atomic<bool> pending;
+	};
+	static UpdateHandle updateHandles[kMaxUpdateHandles];
+	static std::atomic<int> updateHandleCount(0);
+	static std::mutex updateHandleMutex;
+
+	// Pending handle updates, with one ring for each priority class
+	static RingBuffer<int, kUpdateHandleRingSize> updateHandleRings[kUpdatePriorityCount];
+
+	// The maximum number of updates to process in a single batch (0 = unlimited)
+	static std::atomic<int> updateQueueMaxBatchSize(kDefaultUpdateQueueMaxBatchSize);
+
+	// The combined length of the `updateQueues`, so that the queue's depth can be recorded without taking `updateQueueMutex`
+	static std::atomic<size_t> updateQueueLength(0);
+
+	// The priority scheduler's state, used only by the thread draining the queue (see `beginUpdatePass()`)
+	//
+	// `starvedPasses` counts the consecutive passes that each class has had updates waiting without being serviced.
+	static int starvedPasses[kUpdatePriorityCount];
+	static bool servicedThisPass[kUpdatePriorityCount];
+
+	// Returns true if `priority` is one of our priority classes
+	static bool isValidUpdatePriority(int priority)
+	{
+		return priority >= 0 && priority < kUpdatePriorityCount;
+	}
+
+	// Records the combined depth of the update queue and update handle rings in our statistics
+	//
+	// If the update queue has changed, this must be called with `updateQueueMutex` held.
+	static void recordUpdateQueueDepth(bool updateQueueChanged)
+	{
+		if (updateQueueChanged)
+		{
+			size_t queueLength = 0;
+			for (const std::deque<QueueEntry> &queue : updateQueues) { queueLength += queue.size(); }
+			updateQueueLength.store(queueLength, std::memory_order_relaxed);
+		}
+
+		size_t depth = updateQueueLength.load(std::memory_order_relaxed);
+		for (const RingBuffer<int, kUpdateHandleRingSize> &ring : updateHandleRings) { depth += ring.size(); }
+		Stats::getInstance().recordUpdateQueueDepth(depth);
+	}
+
+	// Wakes anybody waiting on the server's state and calls the application's state change callback, if any
+	//
+	// The callback is called on the thread that changed the state, without any of our locks held.
+	static void signalServerStateChange()
+	{
+		GGKServerStateCallback callback;
+		void *pUserData;
+		{
+			std::lock_guard<std::mutex> lock(serverStateMutex);
+			callback = serverStateCallback;
+			pUserData = pServerStateCallbackUserData;
+		}
+		cvServerState.notify_all();
+
+		if (nullptr != callback)
+		{
+			callback(serverRunState.load(), serverHealth.load(), pUserData);
+		}
+	}
+
+	// Internal method to set the run state of the server
+	void setServerRunState(GGKServerRunState newState)
+	{
+		GGKServerRunState oldState;
+		{
+			// The state is changed under the lock so that a waiter can't miss the notification between checking the state and
+			// waiting
+			std::lock_guard<std::mutex> lock(serverStateMutex);
+			oldState = serverRunState.exchange(newState);
+		}
+
+		Logger::status(SSTR << "** SERVER RUN STATE CHANGED: " << ggkGetServerRunStateString(oldState) << " -> " << ggkGetServerRunStateString(newState));
+		signalServerStateChange();
+	}
+
+	// Internal method to set the health of the server
+	void setServerHealth(GGKServerHealth newHealth)
+	{
+		GGKServerHealth oldHealth;
+		{
+			std::lock_guard<std::mutex> lock(serverStateMutex);
+			oldHealth = serverHealth.exchange(newHealth);
+		}
+
+		Logger::status(SSTR << "** SERVER HEALTH CHANGED: " << ggkGetServerHealthString(oldHealth) << " -> " << ggkGetServerHealthString(newHealth));
+		signalServerStateChange();
+	}
+
+	// Blocks until the server's run state reaches at least `state`, for up to `timeoutMS` milliseconds (or indefinitely if
+	// `timeoutMS` is negative)
+	//
+	// Returns true if the state was reached, otherwise false
+	static bool waitForRunState(GGKServerRunState state, int timeoutMS)
+	{
+		std::unique_lock<std::mutex> lock(serverStateMutex);
+		auto reached = [state]() { return serverRunState.load() >= state; };
+		if (timeoutMS < 0)
+		{
+			cvServerState.wait(lock, reached);
+			return true;
+		}
+
+		return cvServerState.wait_for(lock, std::chrono::milliseconds(timeoutMS), reached);
+	}
+
+	// Internal method to add an update for a registered handle (see `ggkNotifyHandle()`), without waking the main loop
+	//
+	// Returns true if the update was added (or coalesced with one already waiting), otherwise false
+	static bool pushUpdateHandle(int handle)
+	{
+		if (handle < 0 || handle >= updateHandleCount.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		UpdateHandle &entry = updateHandles[handle];
+		if (updateQueueCoalescing && entry.pending.exchange(true, std::memory_order_acq_rel))
+		{
+			Stats::increment(Stats::getInstance().updatesCoalesced);
+			return true;
+		}
+
+		if (!updateHandleRings[entry.priority].push(handle))
+		{
+			entry.pending.store(false, std::memory_order_release);
+			Stats::increment(Stats::getInstance().updatesRejected);
+			return false;
+		}
+
+		Stats::increment(Stats::getInstance().updatesQueued);
+		recordUpdateQueueDepth(false);
+		return true;
+	}
+
+	// Internal method to add an update to the front of the queue for the given priority class, without waking the main loop
+	//
+	// Returns true if the update was added (or coalesced with one already waiting), otherwise false
+	static bool pushUpdateQueue(const char *pObjectPath, const char *pInterfaceName, GGKUpdatePriority priority)
+	{
+		if (!isValidUpdatePriority(priority))
+		{
+			return false;
+		}
+
+		QueueEntry t(pObjectPath, pInterfaceName);
+
+		{
+			std::lock_guard<std::mutex> guard(updateQueueMutex);
+			if (updateQueueCoalescing && !pendingUpdates.insert(t).second)
+			{
+				Stats::increment(Stats::getInstance().updatesCoalesced);
+				return true;
+			}
+
+			updateQueues[priority].push_front(t);
+			recordUpdateQueueDepth(true);
+		}
+
+		Stats::increment(Stats::getInstance().updatesQueued);
+		return true;
+	}
+
+	// Internal method to add an update to the front of the queue for the priority class recorded for its characteristic (see
+	// `indexUpdatePriorities()`), or EUpdatePriorityNormal for anything else, without waking the main loop
+	//
+	// Returns true if the update was added (or coalesced with one already waiting), otherwise false
+	static bool pushUpdateQueue(const char *pObjectPath, const char *pInterfaceName)
+	{
+		QueueEntry t(pObjectPath, pInterfaceName);
+
+		{
+			std::lock_guard<std::mutex> guard(updateQueueMutex);
+			if (updateQueueCoalescing && !pendingUpdates.insert(t).second)
+			{
+				Stats::increment(Stats::getInstance().updatesCoalesced);
+				return true;
+			}
+
+			auto it = updatePriorities.find(t);
+			updateQueues[it == updatePriorities.end() ? EUpdatePriorityNormal : it->second].push_front(t);
+			recordUpdateQueueDepth(true);
+		}
+
+		Stats::increment(Stats::getInstance().updatesQueued);
+		return true;
+	}
+
+	// Internal method to record the priority class of every characteristic in `object` (and its children) in `priorities`
+	static void collectUpdatePriorities(const DBusObject &object, std::map<QueueEntry, GGKUpdatePriority> &priorities)
+	{
+		for (const std::shared_ptr<DBusInterface> &pInterface : object.getInterfaces())
+		{
+			std::shared_ptr<const DBusInterface> pConstInterface = pInterface;
+			if (std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pConstInterface, GattCharacteristic))
+			{
+				GGKUpdatePriority priority = pCharacteristic->getUpdatePriority();
+				if (EUpdatePriorityNormal != priority && isValidUpdatePriority(priority))
+				{
+					priorities[QueueEntry(object.getPath().toString(), pInterface->getName())] = priority;
+				}
+			}
+		}
+
+		for (const DBusObject &child : object.getChildren())
+		{
+			collectUpdatePriorities(child, priorities);
+		}
+	}
+
+	// Internal method to record the priority class of every characteristic in `pServer`'s description, replacing any priorities
+	// recorded before
+	//
+	// This is called from the server's thread once the description is frozen, and with nullptr (to forget them) when the server
+	// is torn down.
+	void indexUpdatePriorities(const Server *pServer)
+	{
+		std::map<QueueEntry, GGKUpdatePriority> priorities;
+		if (nullptr != pServer)
+		{
+			for (const DBusObject &object : pServer->getObjects())
+			{
+				collectUpdatePriorities(object, priorities);
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(updateQueueMutex);
+		updatePriorities.swap(priorities);
+	}
+
+	// Internal method to check whether updates are being coalesced (see `ggkUpdateQueueSetCoalescing()`)
+	bool updateQueueIsCoalescing()
+	{
+		return updateQueueCoalescing;
+	}
+
+	// Internal method to start a pass over the update queue and update handle rings
+	//
+	// Fills `pOrder` with the order in which the priority classes should be serviced this pass: highest first, except that the
+	// class that has gone longest without service is moved to the front once it has waited `kMaxStarvedPasses` passes. This
+	// keeps a steady stream of high priority updates from starving the lower classes, while still servicing them first in any
+	// other pass.
+	//
+	// Returns the most updates that should be processed in this pass (see `ggkUpdateQueueSetMaxBatchSize()`)
+	int beginUpdatePass(GGKUpdatePriority *pOrder)
+	{
+		int starved = -1;
+		for (int i = 0; i < kUpdatePriorityCount; ++i)
+		{
+			servicedThisPass[i] = false;
+			if (starvedPasses[i] >= kMaxStarvedPasses && (starved < 0 || starvedPasses[i] > starvedPasses[starved]))
+			{
+				starved = i;
+			}
+		}
+
+		int count = 0;
+		if (starved >= 0)
+		{
+			pOrder[count++] = static_cast<GGKUpdatePriority>(starved);
+		}
+
+		for (int i = 0; i < kUpdatePriorityCount; ++i)
+		{
+			if (i != starved)
+			{
+				pOrder[count++] = static_cast<GGKUpdatePriority>(i);
+			}
+		}
+
+		int maxBatchSize = updateQueueMaxBatchSize;
+		return maxBatchSize <= 0 ? std::numeric_limits<int>::max() : maxBatchSize;
+	}
+
+	// Internal method to finish a pass started with `beginUpdatePass()`
+	//
+	// Any class that still has updates waiting and was not serviced during the pass has its starvation count increased.
+	void endUpdatePass()
+	{
+		std::lock_guard<std::mutex> guard(updateQueueMutex);
+		for (int i = 0; i < kUpdatePriorityCount; ++i)
+		{
+			bool waiting = !updateQueues[i].empty() || !updateHandleRings[i].empty();
+			starvedPasses[i] = servicedThisPass[i] || !waiting ? 0 : starvedPasses[i] + 1;
+		}
+	}
+
+	// Internal method to remove a batch of updates for one priority class from the back of the queue under a single lock
+	//
+	// Up to `budget` entries are moved into `batch`, and `budget` is reduced by the number moved. If the class's entire queue fits,
+	// it is simply swapped out. As with the queue itself, the oldest entry is at the back of `batch`.
+	//
+	// Returns the number of entries in `batch`.
+	int popUpdateQueueBatch(GGKUpdatePriority priority, std::deque<QueueEntry> &batch, int &budget)
+	{
+		batch.clear();
+		if (budget <= 0)
+		{
+			return 0;
+		}
+
+		std::lock_guard<std::mutex> guard(updateQueueMutex);
+		std::deque<QueueEntry> &updateQueue = updateQueues[priority];
+		if (updateQueue.empty())
+		{
+			return 0;
+		}
+
+		if (updateQueue.size() <= static_cast<size_t>(budget))
+		{
+			batch.swap(updateQueue);
+		}
+		else
+		{
+			auto first = updateQueue.end() - budget;
+			batch.assign(first, updateQueue.end());
+			updateQueue.erase(first, updateQueue.end());
+		}
+
+		if (updateQueueCoalescing)
+		{
+			for (const QueueEntry &entry : batch)
+			{
+				pendingUpdates.erase(entry);
+			}
+		}
+
+		servicedThisPass[priority] = true;
+		budget -= static_cast<int>(batch.size());
+		recordUpdateQueueDepth(true);
+		return batch.size();
+	}
+
+	// Internal method to remove a batch of updates for one priority class from the update handle rings
+	//
+	// Up to `budget` entries are moved into `batch`, oldest first, and `budget` is reduced by the number moved. The caller should
+	// reuse `batch` between calls so that, once it has grown to size, no allocations are made.
+	//
+	// Returns the number of entries in `batch`.
+	int popUpdateHandleBatch(GGKUpdatePriority priority, std::vector<const GattCharacteristic *> &batch, int &budget)
+	{
+		batch.clear();
+
+		int handle;
+		while (static_cast<int>(batch.size()) < budget && updateHandleRings[priority].pop(handle))
+		{
+			// A push that raced with `resetUpdateHandles()` can leave behind a handle that is no longer registered
+			if (handle >= updateHandleCount.load(std::memory_order_acquire) || nullptr == updateHandles[handle].pCharacteristic)
+			{
+				continue;
+			}
+
+			UpdateHandle &entry = updateHandles[handle];
+			entry.pending.store(false, std::memory_order_release);
+			batch.push_back(entry.pCharacteristic);
+		}
+
+		if (!batch.empty())
+		{
+			servicedThisPass[priority] = true;
+			budget -= static_cast<int>(batch.size());
+			recordUpdateQueueDepth(false);
+		}
+
+		return batch.size();
+	}
+
+	// Internal method to forget all registered update handles, along with any of their updates still waiting
+	//
+	// Handles point into the server description, so they can't outlive it. This is called from the server's thread (the only
+	// thread that drains the rings) when the server is torn down; the next server starts with an empty handle table.
+	void resetUpdateHandles()
+	{
+		std::lock_guard<std::mutex> guard(updateHandleMutex);
+		updateHandleCount.store(0, std::memory_order_release);
+
+		int handle;
+		for (RingBuffer<int, kUpdateHandleRingSize> &ring : updateHandleRings)
+		{
+			while (ring.pop(handle)) {}
+		}
+
+		for (UpdateHandle &entry : updateHandles)
+		{
+			entry.pCharacteristic = nullptr;
+			entry.priority = EUpdatePriorityNormal;
+			entry.pending.store(false, std::memory_order_relaxed);
+		}
+
+		recordUpdateQueueDepth(false);
+	}
+
+	// Internal method to check for pending updates in the update handle rings
+	bool updateHandleRingIsEmpty()
+	{
+		for (const RingBuffer<int, kUpdateHandleRingSize> &ring : updateHandleRings)
+		{
+			if (!ring.empty()) { return false; }
+		}
+
+		return true;
+	}
+}; // namespace ggk
+
+using namespace ggk;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  _                                  _     _             _   _
+// | |    ___   __ _    _ __ ___  __ _(_)___| |_ _ __ __ _| |_(_) ___  _ ___
+// | |   / _ \ / _` |  | '__/ _ \/ _` | / __| __| '__/ _` | __| |/ _ \| '_  |
+// | |__| (_) | (_| |  | | |  __/ (_| | \__ \ |_| | | (_| | |_| | (_) | | | |
+// |_____\___/ \__, |  |_|  \___|\__, |_|___/\__|_|  \__,_|\__|_|\___/|_| |_|
+//             |___/             |___/
+//
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+void ggkLogRegisterDebug(GGKLogReceiver receiver) { Logger::registerDebugReceiver(receiver); }
+void ggkLogRegisterInfo(GGKLogReceiver receiver) { Logger::registerInfoReceiver(receiver); }
+void ggkLogRegisterStatus(GGKLogReceiver receiver) { Logger::registerStatusReceiver(receiver); }
+void ggkLogRegisterWarn(GGKLogReceiver receiver) { Logger::registerWarnReceiver(receiver); }
+void ggkLogRegisterError(GGKLogReceiver receiver) { Logger::registerErrorReceiver(receiver); }
+void ggkLogRegisterFatal(GGKLogReceiver receiver) { Logger::registerFatalReceiver(receiver); }
+void ggkLogRegisterTrace(GGKLogReceiver receiver) { Logger::registerTraceReceiver(receiver); }
+void ggkLogRegisterAlways(GGKLogReceiver receiver) { Logger::registerAlwaysReceiver(receiver); }
+void ggkLogSetAsync(int enable) { Logger::setAsync(0 != enable); }
+unsigned long ggkLogGetDroppedCount() { return Logger::getDroppedCount(); }
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  _   _           _       _                                                                                                     _
+// | | | |_ __   __| | __ _| |_ ___     __ _ _   _  ___ _   _  ___    _ __ ___   __ _ _ __   __ _  __ _  ___ _ __ ___   ___ _ __ | |_
+// | | | | '_ \ / _` |/ _` | __/ _ \   / _` | | | |/ _ \ | | |/ _ \  | '_ ` _ \ / _` | '_ \ / _` |/ _` |/ _ \ '_ ` _ \ / _ \ '_ \| __|
+// | |_| | |_) | (_| | (_| | ||  __/  | (_| | |_| |  __/ |_| |  __/  | | | | | | (_| | | | | (_| | (_| |  __/ | | | | |  __/ | | | |_
+//  \___/| .__/ \__,_|\__,_|\__\___|   \__, |\__,_|\___|\__,_|\___|  |_| |_| |_|\__,_|_| |_|\__,_|\__, |\___|_| |_| |_|\___|_| |_|\__|
+//       |_|                              |_|                                                     |___/
+//
+// Push/pop update notifications onto a queue. As these methods are where threads collide (i.e., this is how they communicate),
+// these methods are thread-safe.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Adds an update to the front of the queue for a characteristic at the given object path
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkNofifyUpdatedCharacteristic(const char *pObjectPath)
+{
+	return ggkPushUpdateQueue(pObjectPath, "org.bluez.GattCharacteristic1") != 0;
+}
+
+// Adds an update to the front of the queue for a descriptor at the given object path
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkNofifyUpdatedDescriptor(const char *pObjectPath)
+{
+	return ggkPushUpdateQueue(pObjectPath, "org.bluez.GattDescriptor1") != 0;
+}
+
+// Adds a named update to the front of the queue. Generally, this routine should not be used directly. Instead, use the
+// `ggkNofifyUpdatedCharacteristic()` instead.
+//
+// If coalescing is enabled (see `ggkUpdateQueueSetCoalescing()`) and an identical update is already waiting in the queue, the new
+// update is dropped. This is still considered a success.
+//
+// The update is queued in the priority class of the characteristic at the given path (see `GGKUpdatePriority`), or in
+// EUpdatePriorityNormal for anything else. The classes are recorded once when the server starts, so this doesn't need to search
+// the server description.
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkPushUpdateQueue(const char *pObjectPath, const char *pInterfaceName)
+{
+	if (!pushUpdateQueue(pObjectPath, pInterfaceName))
+	{
+		return 0;
+	}
+
+	// Let the main loop know there's work to do
+	wakeUpdateQueue();
+	return 1;
+}
+
+// Adds a named update to the front of the queue for the given priority class, regardless of the class of the characteristic
+//
+// If coalescing is enabled and an identical update is already waiting in any class, the new update is dropped. This is still
+// considered a success.
+//
+// Returns non-zero value on success or 0 on failure (an invalid priority.)
+int ggkPushUpdateQueueWithPriority(const char *pObjectPath, const char *pInterfaceName, enum GGKUpdatePriority priority)
+{
+	if (!pushUpdateQueue(pObjectPath, pInterfaceName, priority))
+	{
+		return 0;
+	}
+
+	// Let the main loop know there's work to do
+	wakeUpdateQueue();
+	return 1;
+}
+
+// Registers the characteristic at the given object path for fast updates, returning a handle that can be passed to
+// `ggkNotifyHandle()`
+//
+// The characteristic is located once, here, so that notifying a handle requires no string work, tree searches or memory
+// allocation. Because of this, the server must have been started (see `ggkStart()`) before handles can be registered. Registering
+// the same path more than once returns the same handle.
+//
+// Handles belong to the server they were registered with and do not survive a restart: once the server stops, every handle is
+// released and must be registered again after the next `ggkStart()` or `ggkAttach()`.
+//
+// This may be called from any thread. We hold `serverLifetimeMutex` throughout, so the server can't be replaced while we look
+// through it, and only look through a frozen server description (see `Server::freeze()`), which no longer changes. Checking the
+// run state with `updateHandleMutex` held means the handle can't be added after the server has begun to stop, as the handles are
+// released (see `resetUpdateHandles()`) with that lock held once the server has stopped.
+//
+// Returns a non-negative handle on success or -1 on failure (the server is not started, there is no characteristic at the path,
+// or the maximum number of handles have been registered.)
+int ggkRegisterUpdateHandle(const char *pObjectPath)
+{
+	std::lock_guard<std::mutex> lifetimeGuard(serverLifetimeMutex);
+	if (nullptr == TheServer || !TheServer->isFrozen() || nullptr == pObjectPath)
+	{
+		Logger::error("Unable to register an update handle: the server has not been started");
+		return -1;
+	}
+
+	std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(pObjectPath, "org.bluez.GattCharacteristic1");
+	std::shared_ptr<const GattCharacteristic> pCharacteristic = nullptr;
+	if (nullptr != pInterface)
+	{
+		pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic);
+	}
+
+	if (nullptr == pCharacteristic)
+	{
+		Logger::error(SSTR << "Unable to register an update handle: no characteristic found at path '" << pObjectPath << "'");
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> guard(updateHandleMutex);
+	if (ggkGetServerRunState() > ERunning)
+	{
+		Logger::error("Unable to register an update handle: the server is stopping");
+		return -1;
+	}
+
+	// Have we already registered this one?
+	int count = updateHandleCount.load(std::memory_order_relaxed);
+	for (int handle = 0; handle < count; ++handle)
+	{
+		if (updateHandles[handle].pCharacteristic == pCharacteristic.get())
+		{
+			return handle;
+		}
+	}
+
+	if (count >= kMaxUpdateHandles)
+	{
+		Logger::error(SSTR << "Unable to register an update handle for '" << pObjectPath << "': all " << kMaxUpdateHandles << " handles are in use");
+		return -1;
+	}
+
+	// The characteristic is owned by the server; the handle is forgotten when the server is torn down
+	updateHandles[count].pCharacteristic = pCharacteristic.get();
+	updateHandles[count].priority = isValidUpdatePriority(pCharacteristic->getUpdatePriority()) ? pCharacteristic->getUpdatePriority() : EUpdatePriorityNormal;
+	updateHandles[count].pending.store(false, std::memory_order_relaxed);
+	updateHandleCount.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+// Adds an update for the characteristic registered with `ggkRegisterUpdateHandle()`
+//
+// This is the allocation-free alternative to `ggkNofifyUpdatedCharacteristic()`. The handle is pushed onto a lock-free ring buffer
+// that the server drains alongside the update queue. If coalescing is enabled (see `ggkUpdateQueueSetCoalescing()`) and the
+// handle already has an update waiting, the new update is dropped. This is still considered a success.
+//
+// Returns non-zero value on success or 0 on failure (an invalid handle, or the ring buffer is full.)
+int ggkNotifyHandle(int handle)
+{
+	if (!pushUpdateHandle(handle))
+	{
+		return 0;
+	}
+
+	// Let the main loop know there's work to do
+	wakeUpdateQueue();
+	return 1;
+}
+
+// Adds an update for each of `count` handles registered with `ggkRegisterUpdateHandle()`, waking the server only once
+//
+// Returns the number of updates added
+int ggkNotifyHandles(const int *pHandles, int count)
+{
+	if (nullptr == pHandles || count <= 0)
+	{
+		return 0;
+	}
+
+	int added = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		added += pushUpdateHandle(pHandles[i]) ? 1 : 0;
+	}
+
+	if (added > 0)
+	{
+		wakeUpdateQueue();
+	}
+
+	return added;
+}
+
+// Get the next update from the back of the highest priority class that has one and returns the element in `element` as a string in the format:
+//
+//     "com/object/path|com.interface.name"
+//
+// If the queue is empty, this method returns `0` and does nothing.
+//
+// `elementLen` is the size of the `element` buffer in bytes. If the resulting string (including the null terminator) will not
+// fit within `elementLen` bytes, the method returns `-1` and does nothing.
+//
+// If `keep` is set to non-zero, the entry is not removed and will be retrieved again on the next call. Otherwise, the element
+// is removed.
+//
+// Returns 1 on success, 0 if the queue is empty, -1 on error (such as the length too small to store the element)
+int ggkPopUpdateQueue(char *pElementBuffer, int elementLen, int keep)
+{
+	std::string result;
+
+	{
+		std::lock_guard<std::mutex> guard(updateQueueMutex);
+
+		// Find the highest priority class with an update waiting
+		std::deque<QueueEntry> *pUpdateQueue = nullptr;
+		for (std::deque<QueueEntry> &queue : updateQueues)
+		{
+			if (!queue.empty()) { pUpdateQueue = &queue; break; }
+		}
+
+		// Check for an empty queue
+		if (nullptr == pUpdateQueue) { return 0; }
+
+		// Get the last element
+		QueueEntry t = pUpdateQueue->back();
+
+		// Get the result string
+		result = std::get<0>(t) + "|" + std::get<1>(t);
+
+		// Ensure there's enough room for it
+		if (result.length() + 1 > static_cast<size_t>(elementLen)) { return -1; }
+
+		if (keep == 0)
+		{
+			pendingUpdates.erase(t);
+			pUpdateQueue->pop_back();
+			recordUpdateQueueDepth(true);
+		}
+	}
+
+	// Copy the element string
+	memcpy(pElementBuffer, result.c_str(), result.length() + 1);
+
+	return 1;
+}
+
+// Returns 1 if the queue is empty (in every priority class), otherwise 0
+int ggkUpdateQueueIsEmpty()
+{
+	return 0 == ggkUpdateQueueSize() ? 1 : 0;
+}
+
+// Returns the number of entries waiting in the queue, across all priority classes
+int ggkUpdateQueueSize()
+{
+	std::lock_guard<std::mutex> guard(updateQueueMutex);
+	size_t size = 0;
+	for (const std::deque<QueueEntry> &queue : updateQueues) { size += queue.size(); }
+	return size;
+}
+
+// Removes all entries from the queue, in every priority class
+void ggkUpdateQueueClear()
+{
+	std::lock_guard<std::mutex> guard(updateQueueMutex);
+	for (std::deque<QueueEntry> &queue : updateQueues) { queue.clear(); }
+	pendingUpdates.clear();
+	recordUpdateQueueDepth(true);
+}
+
+// Sets the maximum number of queued updates the server will process in a single pass of its main loop
+//
+// Larger batches flush bursts of updates more quickly, while smaller batches bound the time the main loop spends on updates before
+// it returns to servicing incoming requests (such as ReadValue.) Any remaining updates are processed on the next pass.
+//
+// A value of 0 (or less) removes the limit, draining the entire queue in each pass.
+void ggkUpdateQueueSetMaxBatchSize(int maxBatchSize)
+{
+	updateQueueMaxBatchSize = maxBatchSize;
+}
+
+// Enables (non-zero) or disables (0) coalescing of duplicate updates
+//
+// When enabled, the queue holds at most one pending update for any given object path and interface. Since the server retrieves
+// the current data when it processes an update, a burst of updates to the same characteristic collapses into a single
+// notification carrying the newest data.
+//
+// Coalescing is disabled by default.
+void ggkUpdateQueueSetCoalescing(int enable)
+{
+	std::lock_guard<std::mutex> guard(updateQueueMutex);
+
+	updateQueueCoalescing = enable != 0;
+	pendingUpdates.clear();
+
+	// Index anything that is already waiting so that it will coalesce with future updates
+	if (updateQueueCoalescing)
+	{
+		for (const std::deque<QueueEntry> &queue : updateQueues)
+		{
+			pendingUpdates.insert(queue.begin(), queue.end());
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  ____        _              _
+// |  _ \  __ _| |_ __ _   ___| |_ ___  _ __ ___
+// | | | |/ _` | __/ _` | / __| __/ _ \| '__/ _ )
+// | |_| | (_| | || (_| | \__ \ || (_) | | |  __/
+// |____/ \__,_|\__\__,_| |___/\__\___/|_|  \___|
+//
+// An optional, thread-safe store for server data (see DataStore.cpp)
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Registers a named value in the data store, able to hold up to `maxSize` bytes
+//
+// Returns the value's slot on success, or -1 on failure
+int ggkDataStoreRegister(const char *pName, int maxSize)
+{
+	return DataStore::getInstance().registerSlot(pName, maxSize);
+}
+
+// Returns the slot for a registered name, or -1 if there is no such slot
+int ggkDataStoreFind(const char *pName)
+{
+	return DataStore::getInstance().findSlot(pName);
+}
+
+// Associates a slot with an update handle (see `ggkRegisterUpdateHandle()`), so that each write to the slot notifies it
+//
+// Returns non-zero value on success or 0 on failure
+int ggkDataStoreSetUpdateHandle(int slot, int updateHandle)
+{
+	return DataStore::getInstance().setUpdateHandle(slot, updateHandle) ? 1 : 0;
+}
+
+// Stores a value in a slot, notifying the slot's update handle (if any)
+//
+// Returns non-zero value on success or 0 on failure
+int ggkDataStoreSet(int slot, const void *pData, int size)
+{
+	return DataStore::getInstance().set(slot, pData, size) ? 1 : 0;
+}
+
+// Copies a slot's current value into `pBuffer`
+//
+// Returns the size of the value in bytes, or -1 on failure
+int ggkDataStoreGet(int slot, void *pBuffer, int bufferSize)
+{
+	return DataStore::getInstance().get(slot, pBuffer, bufferSize);
+}
+
+// Moves the data store's slots into shared memory, so that producers in other processes can write them directly
+//
+// Returns non-zero value on success or 0 on failure
+int ggkDataStoreShare(int *pMemFd, int *pDoorbellFd)
+{
+	if (nullptr == pMemFd || nullptr == pDoorbellFd)
+	{
+		return 0;
+	}
+
+	return DataStore::getInstance().share(*pMemFd, *pDoorbellFd) ? 1 : 0;
+}
+
+// Connects a producer process to a shared data store, given the descriptors from `ggkDataStoreShare()`
+//
+// The connection handed to the application is simply our `DataStoreProducer`.
+//
+// Returns the connection on success, or NULL on failure
+GGKSharedStore *ggkSharedStoreAttach(int memFd, int doorbellFd)
+{
+	return reinterpret_cast<GGKSharedStore *>(DataStoreProducer::attach(memFd, doorbellFd));
+}
+
+// Disconnects a producer from a shared data store
+void ggkSharedStoreDetach(GGKSharedStore *pStore)
+{
+	delete reinterpret_cast<DataStoreProducer *>(pStore);
+}
 
-	// Our server thread
-	static std::thread serverThread;
+// Returns the producer's slot for a shared value's name, or -1 if there is no such shared slot
+int ggkSharedStoreFind(GGKSharedStore *pStore, const char *pName)
+{
+	return nullptr == pStore ? -1 : reinterpret_cast<DataStoreProducer *>(pStore)->findSlot(pName);
+}
 
-	// The current server state
-	volatile static GGKServerRunState serverRunState = EUninitialized;
+// Stores a value in a shared slot and signals the server
+//
+// Returns non-zero value on success or 0 on failure
+int ggkSharedStoreSet(GGKSharedStore *pStore, int slot, const void *pData, int size)
+{
+	return nullptr != pStore && reinterpret_cast<DataStoreProducer *>(pStore)->set(slot, pData, size) ? 1 : 0;
+}
 
-	// The current server health
-	volatile static GGKServerHealth serverHealth = EOk;
+// ---------------------------------------------------------------------------------------------------------------------------------
+// __        __         _
+// \ \      / /__  _ __| | _____ _ __ ___
+//  \ \ /\ / / _ \| '__| |/ / _ \ '__/ __|
+//   \ V  V / (_) | |  |   <  __/ |  \__ )
+//    \_/\_/ \___/|_|  |_|\_\___|_|  |___/
+//
+// Running method calls off the server's thread (see WorkerPool.cpp)
+// ---------------------------------------------------------------------------------------------------------------------------------
 
-	// We store the old GLib print handler and error print handler so we can restore if
-	static GPrintFunc printHandlerGLib;
-	static GPrintFunc printerrHandlerGLib;
-	static GLogFunc logHandlerGLib;
+// Enables (non-zero) or disables (0) running method calls on worker threads, for characteristics that ask for it (see
+// `GattCharacteristic::runMethodsOnWorkers()`)
+//
+// This moves those characteristics' data getter and setter calls onto the workers, so it is disabled by default.
+void ggkEnableMethodWorkers(int enable)
+{
+	WorkerPool::getInstance().setEnabled(0 != enable);
+}
 
-	// Our update queue
-	typedef std::tuple<std::string, std::string> QueueEntry;
-	std::deque<QueueEntry> updateQueue;
-	std::mutex updateQueueMutex;
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  ____  _        _   _     _   _
+// / ___|| |_ __ _| |_(_)___| |_(_) ___ ___
+// \___ \| __/ _` | __| / __| __| |/ __/ __|
+//  ___) | || (_| | |_| \__ \ |_| | (__\__ )
+// |____/ \__\__,_|\__|_|___/\__|_|\___|___/
+//
+// Counters and latency histograms for the server's hot paths (see Stats.cpp)
+// ---------------------------------------------------------------------------------------------------------------------------------
 
-	// Internal method to set the run state of the server
-	void setServerRunState(GGKServerRunState newState)
+// Fills in `pStats` with a snapshot of the server's statistics
+void ggkGetStats(GGKStats *pStats)
+{
+	if (nullptr != pStats)
 	{
-		Logger::status(SSTR << "** SERVER RUN STATE CHANGED: " << ggkGetServerRunStateString(serverRunState) << " -> " << ggkGetServerRunStateString(newState));
-		serverRunState = newState;
+		Stats::getInstance().snapshot(*pStats);
 	}
+}
 
-	// Internal method to set the health of the server
-	void setServerHealth(GGKServerHealth newHealth)
+// Resets the server's statistics
+void ggkResetStats()
+{
+	Stats::getInstance().reset();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  ____  _                            _
+// / ___|| |_ _ __ ___  __ _ _ __ ___ (_)_ __   __ _
+// \___ \| __| '__/ _ \/ _` | '_ ` _ \| | '_ \ / _` |
+//  ___) | |_| | |  __/ (_| | | | | | | | | | | (_| |
+// |____/ \__|_|  \___|\__,_|_| |_| |_|_|_| |_|\__, |
+//                                             |___/
+//
+// Streaming to clients through sockets acquired by BlueZ (see AcquiredStream.cpp)
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Returns the characteristic at `pObjectPath`, or nullptr if there isn't one (or the server isn't running)
+//
+// Like `ggkRegisterUpdateHandle()`, this may be called from any thread.
+static std::shared_ptr<const GattCharacteristic> findStreamCharacteristic(const char *pObjectPath)
+{
+	std::lock_guard<std::mutex> lifetimeGuard(serverLifetimeMutex);
+	if (nullptr == TheServer || !TheServer->isFrozen() || nullptr == pObjectPath)
 	{
-		Logger::status(SSTR << "** SERVER HEALTH CHANGED: " << ggkGetServerHealthString(serverHealth) << " -> " << ggkGetServerHealthString(newHealth));
-		serverHealth = newHealth;
+		return nullptr;
 	}
-}; // namespace ggk
 
-using namespace ggk;
+	std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(pObjectPath, "org.bluez.GattCharacteristic1");
+	if (nullptr == pInterface)
+	{
+		return nullptr;
+	}
 
-// ---------------------------------------------------------------------------------------------------------------------------------
-//  _                                  _     _             _   _
-// | |    ___   __ _    _ __ ___  __ _(_)___| |_ _ __ __ _| |_(_) ___  _ ___
-// | |   / _ \ / _` |  | '__/ _ \/ _` | / __| __| '__/ _` | __| |/ _ \| '_  |
-// | |__| (_) | (_| |  | | |  __/ (_| | \__ \ |_| | | (_| | |_| | (_) | | | |
-// |_____\___/ \__, |  |_|  \___|\__, |_|___/\__|_|  \__,_|\__|_|\___/|_| |_|
-//             |___/             |___/
+	return TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic);
+}
+
+// Streams `size` bytes to the client holding the notification socket of the characteristic at `pObjectPath`
 //
-// ---------------------------------------------------------------------------------------------------------------------------------
+// Returns non-zero if all of the data was sent, otherwise 0
+int ggkStreamSend(const char *pObjectPath, const void *pData, int size)
+{
+	if (nullptr == pData || size < 0)
+	{
+		return 0;
+	}
 
-void ggkLogRegisterDebug(GGKLogReceiver receiver) { Logger::registerDebugReceiver(receiver); }
-void ggkLogRegisterInfo(GGKLogReceiver receiver) { Logger::registerInfoReceiver(receiver); }
-void ggkLogRegisterStatus(GGKLogReceiver receiver) { Logger::registerStatusReceiver(receiver); }
-void ggkLogRegisterWarn(GGKLogReceiver receiver) { Logger::registerWarnReceiver(receiver); }
-void ggkLogRegisterError(GGKLogReceiver receiver) { Logger::registerErrorReceiver(receiver); }
-void ggkLogRegisterFatal(GGKLogReceiver receiver) { Logger::registerFatalReceiver(receiver); }
-void ggkLogRegisterTrace(GGKLogReceiver receiver) { Logger::registerTraceReceiver(receiver); }
-void ggkLogRegisterAlways(GGKLogReceiver receiver) { Logger::registerAlwaysReceiver(receiver); }
+	std::shared_ptr<const GattCharacteristic> pCharacteristic = findStreamCharacteristic(pObjectPath);
+	return nullptr != pCharacteristic && pCharacteristic->sendStream(pData, static_cast<size_t>(size)) ? 1 : 0;
+}
+
+// Returns the MTU of the notification socket held for the characteristic at `pObjectPath`, or 0 if no client holds it
+int ggkStreamGetMtu(const char *pObjectPath)
+{
+	std::shared_ptr<const GattCharacteristic> pCharacteristic = findStreamCharacteristic(pObjectPath);
+	return nullptr == pCharacteristic ? 0 : pCharacteristic->getAcquiredNotifyMtu();
+}
 
 // ---------------------------------------------------------------------------------------------------------------------------------
-//  _   _           _       _                                                                                                     _
-// | | | |_ __   __| | __ _| |_ ___     __ _ _   _  ___ _   _  ___    _ __ ___   __ _ _ __   __ _  __ _  ___ _ __ ___   ___ _ __ | |_
-// | | | | '_ \ / _` |/ _` | __/ _ \   / _` | | | |/ _ \ | | |/ _ \  | '_ ` _ \ / _` | '_ \ / _` |/ _` |/ _ \ '_ ` _ \ / _ \ '_ \| __|
-// | |_| | |_) | (_| | (_| | ||  __/  | (_| | |_| |  __/ |_| |  __/  | | | | | | (_| | | | | (_| | (_| |  __/ | | | | |  __/ | | | |_
-//  \___/| .__/ \__,_|\__,_|\__\___|   \__, |\__,_|\___|\__,_|\___|  |_| |_| |_|\__,_|_| |_|\__,_|\__, |\___|_| |_| |_|\___|_| |_|\__|
-//       |_|                              |_|                                                     |___/
+//  ____                   _                  _  _       _
+// / ___|   ___  ___  ___ (_)  ___   _ __    | |(_) ___ | |_
+// \___ \  / _ \/ __|/ __|| | / _ \ | '_ \   | || |/ __|| __|
+//  ___) ||  __/\__ \\__ \| || (_) || | | |  | || |\__ \| |_
+// |____/  \___||___/|___/|_| \___/ |_| |_|  |_||_||___/ \__|
 //
-// Push/pop update notifications onto a queue. As these methods are where threads collide (i.e., this is how they communicate),
-// these methods are thread-safe.
+// The clients connected to the server, and what we know about each of them (see Sessions.cpp)
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-// Adds an update to the front of the queue for a characteristic at the given object path
+// Fills in up to `maxSessions` entries of `pSessions` with the clients currently connected
 //
-// Returns non-zero value on success or 0 on failure.
-int ggkNofifyUpdatedCharacteristic(const char *pObjectPath)
+// Returns the number of clients connected, which may be more than `maxSessions`
+int ggkGetSessions(GGKSession *pSessions, int maxSessions)
 {
-	return ggkPushUpdateQueue(pObjectPath, "org.bluez.GattCharacteristic1") != 0;
+	std::vector<Sessions::Session> sessions = Sessions::getInstance().getSessions();
+	gint64 now = g_get_monotonic_time();
+
+	size_t count = nullptr == pSessions || maxSessions <= 0 ? 0 : static_cast<size_t>(maxSessions);
+	for (size_t i = 0; i < sessions.size() && i < count; ++i)
+	{
+		const Sessions::Session &session = sessions[i];
+		GGKSession &entry = pSessions[i];
+		snprintf(entry.address, sizeof(entry.address), "%s", session.address.c_str());
+		entry.addressType = session.addressType;
+		entry.controllerIndex = session.controllerIndex;
+		entry.connectedMS = static_cast<unsigned long long>(now - session.connectTime) / 1000;
+		entry.mtu = session.mtu;
+		entry.subscriptionCount = static_cast<int>(session.subscriptions.size());
+	}
+
+	return static_cast<int>(sessions.size());
 }
 
-// Adds an update to the front of the queue for a descriptor at the given object path
-//
-// Returns non-zero value on success or 0 on failure.
-int ggkNofifyUpdatedDescriptor(const char *pObjectPath)
+// Returns the MTU of the client at `pAddress`, 0 if the client hasn't told us its MTU, or -1 if there is no such client
+int ggkGetSessionMtu(const char *pAddress)
 {
-	return ggkPushUpdateQueue(pObjectPath, "org.bluez.GattDescriptor1") != 0;
+	Sessions::Session session;
+	if (nullptr == pAddress || !Sessions::getInstance().getSession(pAddress, session))
+	{
+		return -1;
+	}
+
+	return session.mtu;
 }
 
-// Adds a named update to the front of the queue. Generally, this routine should not be used directly. Instead, use the
-// `ggkNofifyUpdatedCharacteristic()` instead.
-//
-// Returns non-zero value on success or 0 on failure.
-int ggkPushUpdateQueue(const char *pObjectPath, const char *pInterfaceName)
+// Returns the most bytes a change notification from the characteristic at `pObjectPath` can carry without being truncated, or 0
+// if there is no such characteristic (or the server isn't running)
+int ggkGetNotificationPayloadSize(const char *pObjectPath)
 {
-	QueueEntry t(pObjectPath, pInterfaceName);
-
-	std::lock_guard<std::mutex> guard(updateQueueMutex);
-	updateQueue.push_front(t);
-	return 1;
+	std::shared_ptr<const GattCharacteristic> pCharacteristic = findStreamCharacteristic(pObjectPath);
+	return nullptr == pCharacteristic ? 0 : static_cast<int>(pCharacteristic->getNotificationPayloadSize());
 }
 
-// Get the next update from the back of the queue and returns the element in `element` as a string in the format:
-//
-//     "com/object/path|com.interface.name"
-//
-// If the queue is empty, this method returns `0` and does nothing.
+// ---------------------------------------------------------------------------------------------------------------------------------
+//     _         _                _                                            _
+//    / \     __| |  __ _  _ __  | |_   ___  _ __     ___ __   __  ___  _ __  | |_  ___
+//   / _ \   / _` | / _` || '_ \ | __| / _ \| '__|   / _ \\ \ / / / _ \| '_ \ | __|/ __|
+//  / ___ \ | (_| || (_| || |_) || |_ |  __/| |     |  __/ \ V / |  __/| | | || |_ \__ )
+// /_/   \_\ \__,_| \__,_|| .__/  \__| \___||_|      \___|  \_/   \___||_| |_| \__||___/
+//                        |_|
 //
-// `elementLen` is the size of the `element` buffer in bytes. If the resulting string (including the null terminator) will not
-// fit within `elementLen` bytes, the method returns `-1` and does nothing.
+// Typed subscriptions to the events the adapter reports (see AdapterEvents.cpp)
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Subscribes to the adapter events in `eventMask` (a combination of `GGKAdapterEventType` values)
 //
-// If `keep` is set to non-zero, the entry is not removed and will be retrieved again on the next call. Otherwise, the element
-// is removed.
+// Returns a subscription id (0 or more) on success, or -1 on failure
+int ggkSubscribeAdapterEvents(unsigned int eventMask, GGKAdapterEventCallback callback, void *pUserData, enum GGKAdapterEventDelivery delivery)
+{
+	return AdapterEvents::getInstance().subscribe(eventMask, callback, pUserData, delivery);
+}
+
+// Ends a subscription
 //
-// Returns 1 on success, 0 if the queue is empty, -1 on error (such as the length too small to store the element)
-int ggkPopUpdateQueue(char *pElementBuffer, int elementLen, int keep)
+// Returns non-zero on success, or 0 if there is no such subscription
+int ggkUnsubscribeAdapterEvents(int subscription)
 {
-	std::string result;
+	return AdapterEvents::getInstance().unsubscribe(subscription) ? 1 : 0;
+}
 
-	{
-		std::lock_guard<std::mutex> guard(updateQueueMutex);
+// Calls a queued subscription's callback for up to `maxEvents` of its waiting events (or all of them, if `maxEvents` is 0 or less),
+// on the calling thread
+//
+// Returns the number of events delivered, or -1 if there is no such queued subscription
+int ggkDispatchAdapterEvents(int subscription, int maxEvents)
+{
+	return AdapterEvents::getInstance().dispatch(subscription, maxEvents);
+}
 
-		// Check for an empty queue
-		if (updateQueue.empty()) { return 0; }
+// Returns a file descriptor that is readable while a queued subscription has events waiting, or -1 if there is no such queued
+// subscription
+int ggkGetAdapterEventFd(int subscription)
+{
+	return AdapterEvents::getInstance().getEventFd(subscription);
+}
 
-		// Get the last element
-		QueueEntry t = updateQueue.back();
+// Returns the number of events dropped because a queued subscription's queue was full
+unsigned long ggkGetAdapterEventsDropped(int subscription)
+{
+	return AdapterEvents::getInstance().getDroppedCount(subscription);
+}
 
-		// Get the result string
-		result = std::get<0>(t) + "|" + std::get<1>(t);
+// ---------------------------------------------------------------------------------------------------------------------------------
+//     _       _                _   _     _
+//    / \   __| |_   _____ _ __| |_(_)___(_)_ __   __ _
+//   / _ \ / _` \ \ / / _ \ '__| __| / __| | '_ \ / _` |
+//  / ___ \ (_| |\ V /  __/ |  | |_| \__ \ | | | | (_| |
+// /_/   \_\__,_| \_/ \___|_|   \__|_|___/_|_| |_|\__, |
+//                                                |___/
+//
+// The application's own advertising instances, advertised alongside the server's (see `Mgmt::setApplicationAdvertisingInstance()`)
+// ---------------------------------------------------------------------------------------------------------------------------------
 
-		// Ensure there's enough room for it
-		if (result.length() + 1 > static_cast<size_t>(elementLen)) { return -1; }
+// Adds (or replaces) one of the application's advertising instances
+//
+// Returns non-zero on success, otherwise 0
+int ggkAdvertisingSetInstance(int instance, const void *pAdvertisingData, int advertisingDataLength, const void *pScanResponse, int scanResponseLength, int durationSeconds)
+{
+	if (instance < 0 || instance > 0xff || advertisingDataLength < 0 || scanResponseLength < 0 || durationSeconds < 0 || durationSeconds > 0xffff)
+	{
+		return 0;
+	}
 
-		if (keep == 0)
-		{
-			updateQueue.pop_back();
-		}
+	if ((advertisingDataLength > 0 && nullptr == pAdvertisingData) || (scanResponseLength > 0 && nullptr == pScanResponse))
+	{
+		return 0;
 	}
 
-	// Copy the element string
-	memcpy(pElementBuffer, result.c_str(), result.length() + 1);
+	const uint8_t *pAdvertisingBytes = static_cast<const uint8_t *>(pAdvertisingData);
+	const uint8_t *pScanResponseBytes = static_cast<const uint8_t *>(pScanResponse);
+	std::vector<uint8_t> advertisingData(pAdvertisingBytes, pAdvertisingBytes + advertisingDataLength);
+	std::vector<uint8_t> scanResponse(pScanResponseBytes, pScanResponseBytes + scanResponseLength);
+	if (!Mgmt::setApplicationAdvertisingInstance(static_cast<uint8_t>(instance), advertisingData, scanResponse, static_cast<uint16_t>(durationSeconds)))
+	{
+		return 0;
+	}
 
+	updateAdvertising();
 	return 1;
 }
 
-// Returns 1 if the queue is empty, otherwise 0
-int ggkUpdateQueueIsEmpty()
+// Removes one of the application's advertising instances
+//
+// Returns non-zero on success, or 0 if there was no such instance
+int ggkAdvertisingRemoveInstance(int instance)
 {
-	std::lock_guard<std::mutex> guard(updateQueueMutex);
-	return updateQueue.empty() ? 1 : 0;
+	if (instance < 0 || instance > 0xff || !Mgmt::removeApplicationAdvertisingInstance(static_cast<uint8_t>(instance)))
+	{
+		return 0;
+	}
+
+	updateAdvertising();
+	return 1;
 }
 
-// Returns the number of entries waiting in the queue
-int ggkUpdateQueueSize()
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  _   _  ____ ___   ____                        _ _
+// | | | |/ ___|_ _| |  _ \ ___  ___ ___  _ __ __| (_)_ __   __ _
+// | |_| | |    | |  | |_) / _ \/ __/ _ \| '__/ _` | | '_ \ / _` |
+// |  _  | |___ | |  |  _ <  __/ (_| (_) | | | (_| | | | | | (_| |
+// |_| |_|\____|___| |_| \_\___|\___\___/|_|  \__,_|_|_| |_|\__, |
+//                                                           |___/
+//
+// Recording of the raw Bluetooth Management API stream, for replaying later (see HciRecording.cpp)
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Starts recording the raw Bluetooth Management API traffic between the server and the kernel into `pFilename`
+//
+// Returns non-zero on success, otherwise 0
+int ggkHciStartRecording(const char *pFilename)
 {
-	std::lock_guard<std::mutex> guard(updateQueueMutex);
-	return updateQueue.size();
+	if (nullptr == pFilename)
+	{
+		return 0;
+	}
+
+	return HciAdapter::getInstance().startRecording(pFilename) ? 1 : 0;
 }
 
-// Removes all entries from the queue
-void ggkUpdateQueueClear()
+// Finishes the HCI recording in progress, if any
+void ggkHciStopRecording()
 {
-	std::lock_guard<std::mutex> guard(updateQueueMutex);
-	updateQueue.clear();
+	HciAdapter::getInstance().stopRecording();
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -249,6 +1266,24 @@ int ggkIsServerRunning()
 	return serverRunState <= ERunning ? 1 : 0;
 }
 
+// Blocks until the server's run state reaches at least `state`, for up to `timeoutMS` milliseconds
+//
+// Returns non-zero if the state was reached, or 0 if the timeout expired first
+int ggkWaitForRunState(GGKServerRunState state, int timeoutMS)
+{
+	return waitForRunState(state, timeoutMS) ? 1 : 0;
+}
+
+// Registers a callback to be called whenever the server's run state or health changes, replacing any registered before
+//
+// Pass nullptr to remove the callback.
+void ggkSetServerStateCallback(GGKServerStateCallback callback, void *pUserData)
+{
+	std::lock_guard<std::mutex> lock(serverStateMutex);
+	serverStateCallback = callback;
+	pServerStateCallbackUserData = pUserData;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 //  ____                              _                _ _   _
 // / ___|  ___ _ ____   _____ _ __   | |__   ___  __ _| | |_| |___
@@ -305,6 +1340,8 @@ void ggkTriggerShutdown()
 
 // Convenience method to trigger a shutdown (via `ggkTriggerShutdown()`) and also waits for shutdown to complete (via
 // `ggkWait()`)
+//
+// This is not supported for an attached server, which can only finish stopping once the application's main loop runs again.
 int ggkShutdownAndWait()
 {
 	if (ggkIsServerRunning() != 0)
@@ -333,8 +1370,19 @@ int ggkShutdownAndWait()
 // If the server fails to stop for some reason, the thread will be killed.
 //
 // Typically, a call to this method would follow `ggkTriggerShutdown()`.
+//
+// An attached server (see `ggkAttach()`) has no thread to wait for, so until it reaches EStopped this returns 0 at once.
 int ggkWait()
 {
+	// An attached server has no thread to wait for and stops on a later pass of the application's main loop, which still needs
+	// our GLib output handlers until then
+	GGKServerRunState runState = ggkGetServerRunState();
+	if (!serverThread.joinable() && EUninitialized != runState && EStopped != runState)
+	{
+		Logger::warn("ggkWait() called before the attached server has stopped; keep running the main loop until it reaches EStopped");
+		return 0;
+	}
+
 	int result = 0;
 	try
 	{
@@ -387,10 +1435,49 @@ int ggkWait()
 //
 // ---------------------------------------------------------------------------------------------------------------------------------
 
+// Redirects GLib's output to our logger (`ggkWait()` restores the original handlers)
+static void captureGLibOutput()
+{
+	// Redirect GLib output to this log method
+	printHandlerGLib = g_set_print_handler([](const gchar *string)
+	{
+		Logger::info(string);
+	});
+	printerrHandlerGLib = g_set_printerr_handler([](const gchar *string)
+	{
+		Logger::error(string);
+	});
+	logHandlerGLib = g_log_set_default_handler([](const gchar *log_domain, GLogLevelFlags log_levels, const gchar *message, gpointer /*user_data*/)
+	{
+		std::string str = std::string(log_domain) + ": " + message;
+		if ((log_levels & (G_LOG_FLAG_RECURSION|G_LOG_FLAG_FATAL)) != 0)
+		{
+			Logger::fatal(str);
+		}
+		else if ((log_levels & (G_LOG_LEVEL_CRITICAL|G_LOG_LEVEL_ERROR)) != 0)
+		{
+			Logger::error(str);
+		}
+		else if ((log_levels & G_LOG_LEVEL_WARNING) != 0)
+		{
+			Logger::warn(str);
+		}
+		else if ((log_levels & G_LOG_LEVEL_DEBUG) != 0)
+		{
+			Logger::debug(str);
+		}
+		else
+		{
+			Logger::info(str);
+		}
+	}, nullptr);
+}
+
 // Set the server state to 'EInitializing' and then immediately create a server thread and initiate the server's async
 // processing on the server thread.
 //
-// At that point the current thread will block for maxAsyncInitTimeoutMS milliseconds or until initialization completes.
+// At that point the current thread will block for maxAsyncInitTimeoutMS milliseconds or until initialization completes. A
+// timeout of zero or less does not wait at all, so initialization fails at once.
 //
 // If initialization was successful, the method will return a non-zero value with the server running on its own thread in
 // 'runServerThread'.
@@ -443,49 +1530,29 @@ int ggkStart(const std::map<const std::string, const std::string> &dataMap,
 {
 	try
 	{
-		//
-		// Start by capturing the GLib output
-		//
-
-		// Redirect GLib output to this log method
-		printHandlerGLib = g_set_print_handler([](const gchar *string)
-		{
-			Logger::info(string);
-		});
-		printerrHandlerGLib = g_set_printerr_handler([](const gchar *string)
+		// A timeout of zero or less has always meant that initialization fails at once, without waiting. We keep it that way
+		// (rather than passing a negative timeout on as an indefinite wait to `waitForRunState()`), and without starting a server
+		// thread only to stop it again.
+		if (maxAsyncInitTimeoutMS <= 0)
 		{
-			Logger::error(string);
-		});
-		logHandlerGLib = g_log_set_default_handler([](const gchar *log_domain, GLogLevelFlags log_levels, const gchar *message, gpointer /*user_data*/)
-		{
-			std::string str = std::string(log_domain) + ": " + message;
-			if ((log_levels & (G_LOG_FLAG_RECURSION|G_LOG_FLAG_FATAL)) != 0)
-			{
-				Logger::fatal(str);
-			}
-			else if ((log_levels & (G_LOG_LEVEL_CRITICAL|G_LOG_LEVEL_ERROR)) != 0)
-			{
-				Logger::error(str);
-			}
-			else if ((log_levels & G_LOG_LEVEL_WARNING) != 0)
-			{
-				Logger::warn(str);
-			}
-			else if ((log_levels & G_LOG_LEVEL_DEBUG) != 0)
-			{
-				Logger::debug(str);
-			}
-			else
-			{
-				Logger::info(str);
-			}
-		}, nullptr);
+			Logger::error("GGK server initialization timed out");
+			setServerHealth(EFailedInit);
+			setServerRunState(EStopped);
+			return 0;
+		}
+
+		// Start by capturing the GLib output
+		captureGLibOutput();
 
         std::string servName = dataMap.at("advertisingName");
 		Logger::info(SSTR << "Starting GGK server '" << servName << "'");
 
-		// Allocate our server
-		TheServer = std::make_shared<Server>(dataMap, getter, setter);
+		// Allocate our server (the one it replaces is destroyed once we let go of the lock)
+		std::shared_ptr<Server> pServer = std::make_shared<Server>(dataMap, getter, setter);
+		{
+			std::lock_guard<std::mutex> lock(serverLifetimeMutex);
+			TheServer.swap(pServer);
+		}
 
 		// Start our server thread
 		try
@@ -504,15 +1571,7 @@ int ggkStart(const std::map<const std::string, const std::string> &dataMap,
 		}
 
 		// Waits for the server to pass the EInitializing state
-		int retryTimeMS = 0;
-		while (retryTimeMS < maxAsyncInitTimeoutMS && ggkGetServerRunState() <= EInitializing)
-		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(kMaxAsyncInitCheckIntervalMS));
-			retryTimeMS += kMaxAsyncInitCheckIntervalMS;
-		}
-
-		// If something went wrong, shut down
-		if (retryTimeMS >= maxAsyncInitTimeoutMS)
+		if (!waitForRunState(ERunning, maxAsyncInitTimeoutMS))
 		{
 			Logger::error("GGK server initialization timed out");
 
@@ -543,3 +1602,51 @@ int ggkStart(const std::map<const std::string, const std::string> &dataMap,
 		return 0;
 	}
 }
+
+// Starts the server on the application's own GLib main context, rather than on a server thread of its own
+//
+// The server's D-Bus callbacks, timers and update processing all run on `pContext` (or the global default context, if nullptr),
+// which the application must run as the thread-default context of its thread. Data getter and setter calls happen on that
+// thread too, so they need no locking against the application's own use of that context.
+//
+// This method does not block. Initialization continues as the application runs its main loop; watch for ERunning with
+// `ggkSetServerStateCallback()`. If the server isn't running within maxAsyncInitTimeoutMS milliseconds, it is shut down.
+//
+// Returns non-zero if initialization has begun, otherwise 0
+int ggkAttach(GMainContext *pContext, const std::map<const std::string, const std::string> &dataMap,
+	GGKServerDataGetter getter, GGKServerDataSetter setter, int maxAsyncInitTimeoutMS)
+{
+	try
+	{
+		GGKServerRunState state = ggkGetServerRunState();
+		if (serverThread.joinable() || (state >= EInitializing && state <= EStopping))
+		{
+			Logger::error("Unable to attach the GGK server while it is already running");
+			return 0;
+		}
+
+		// Start by capturing the GLib output
+		captureGLibOutput();
+
+		std::string servName = dataMap.at("advertisingName");
+		Logger::info(SSTR << "Attaching GGK server '" << servName << "' to the application's main context");
+
+		// Allocate our server (the one it replaces is destroyed once we let go of the lock)
+		std::shared_ptr<Server> pServer = std::make_shared<Server>(dataMap, getter, setter);
+		{
+			std::lock_guard<std::mutex> lock(serverLifetimeMutex);
+			TheServer.swap(pServer);
+		}
+
+		setServerRunState(EUninitialized);
+		attachServer(pContext, std::max(maxAsyncInitTimeoutMS, 0));
+
+		// Initialization may have failed before it had a chance to wait for the main loop
+		return ggkGetServerRunState() == EStopped ? 0 : 1;
+	}
+	catch(...)
+	{
+		Logger::error(SSTR << "Unknown exception during ggkAttach()");
+		return 0;
+	}
+}
@@ -42,15 +42,20 @@
 // do use this with caution.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+#include <stdio.h>
 #include <string.h>
+#include <stddef.h>
+#include <algorithm>
 #include <chrono>
-#include <future>
 
 #include "HciAdapter.h"
 #include "HciSocket.h"
 #include "Utils.h"
 #include "Mgmt.h"
 #include "Logger.h"
+#include "Stats.h"
+#include "Sessions.h"
+#include "AdapterEvents.h"
 
 namespace ggk {
 
@@ -133,6 +138,14 @@ const char * const HciAdapter::kCommandCodeNames[kMaxCommandCode + 1] =
 	"Set Appearance Command"                             // 0x0043
 };
 
+// Returns the name of `commandCode`, or "Unknown" for a code outside of `kCommandCodeNames`
+const char *HciAdapter::getCommandCodeName(uint16_t commandCode)
+{
+	return commandCode <= kMaxCommandCode ? kCommandCodeNames[commandCode] : "Unknown";
+}
+
+static_assert(Stats::kMaxHciEventCode == HciAdapter::kMaxEventType, "Stats must track every HCI event type");
+
 const char * const HciAdapter::kEventTypeNames[kMaxEventType + 1] =
 {
 	"Invalid Event",                                     // 0x0000
@@ -206,6 +219,19 @@ void runEventThread()
 	HciAdapter::getInstance().runEventThread();
 }
 
+// Starts an event for the application's subscriptions (see AdapterEvents.cpp), filling in the fields common to every event type
+static GGKAdapterEvent makeAdapterEvent(GGKAdapterEventType type, uint16_t controllerIndex, const uint8_t *pAddress, uint8_t addressType)
+{
+	GGKAdapterEvent event;
+	memset(&event, 0, sizeof(event));
+	event.type = type;
+	event.controllerIndex = controllerIndex;
+	event.timestampUS = Stats::now();
+	snprintf(event.address, sizeof(event.address), "%s", Utils::kernelBluetoothAddressString(pAddress).c_str());
+	event.addressType = addressType;
+	return event;
+}
+
 // Event processor, responsible for receiving events from the HCI socket
 //
 // This mehtod should not be called directly. Rather, it runs continuously on a thread until the server shuts down
@@ -215,29 +241,36 @@ void HciAdapter::runEventThread()
 {
 	Logger::trace("Entering the HciAdapter event thread");
 
+	// Each event is parsed in place, in the socket's receive buffer
+	HciPacket responsePacket;
+
 	while (ggkGetServerRunState() <= ERunning && hciSocket.isConnected())
 	{
 		// Read the next event, waiting until one arrives
-		std::vector<uint8_t> responsePacket = std::vector<uint8_t>();
 		if (!hciSocket.read(responsePacket))
 		{
 			break;
 		}
 
+		// Parsing and dispatch is timed from here
+		uint64_t eventStartUS = Stats::now();
+
 		// Do we have enough to check the event code?
-		if (responsePacket.size() < 2)
+		if (responsePacket.size < 2)
 		{
 			Logger::error(SSTR << "Invalid command response: too short");
+			Stats::increment(Stats::getInstance().hciEventsRejected);
 			continue;
 		}
 
 		// Our response, as a usable object type
-		uint16_t eventCode = Utils::endianToHost(*reinterpret_cast<uint16_t *>(responsePacket.data()));
+		uint16_t eventCode = Utils::endianToHost(*responsePacket.overlay<uint16_t>());
 
 		// Ensure our event code is valid
 		if (eventCode < HciAdapter::kMinEventType || eventCode > HciAdapter::kMaxEventType)
 		{
 			Logger::error(SSTR << "Invalid command response: event code (" << eventCode << ") out of range");
+			Stats::increment(Stats::getInstance().hciEventsRejected);
 			continue;
 		}
 
@@ -246,14 +279,23 @@ void HciAdapter::runEventThread()
 			// Command complete event
 			case Mgmt::ECommandCompleteEvent:
 			{
-				// Extract our event
-				CommandCompleteEvent event(responsePacket);
+				// View our event in place
+				const CommandCompleteEvent *pEvent = overlayEvent<CommandCompleteEvent>(responsePacket);
+				if (nullptr == pEvent)
+				{
+					break;
+				}
+
+				// The data following the event
+				HciPacket payload = responsePacket.from(sizeof(CommandCompleteEvent));
+				const uint8_t *data = payload.pData;
+				size_t dataLen = payload.size;
 
-				// Point to the data following the event
-				uint8_t *data = responsePacket.data() + sizeof(CommandCompleteEvent);
-				size_t dataLen = responsePacket.size() - sizeof(CommandCompleteEvent);
+				// The controller this response is for
+				std::unique_lock<std::mutex> controllersLock(controllersMutex);
+				ControllerState &controller = controllerState(pEvent->header.getControllerId());
 
-				switch(event.commandCode)
+				switch(pEvent->getCommandCode())
 				{
 					// We just log the version/revision info
 					case Mgmt::EReadVersionInformationCommand:
@@ -262,19 +304,53 @@ void HciAdapter::runEventThread()
 						if (dataLen != sizeof(VersionInformation))
 						{
 							Logger::error("Invalid data length");
-							return;
+							break;
 						}
 
-						versionInformation = *reinterpret_cast<VersionInformation *>(data);
+						versionInformation = *payload.overlay<VersionInformation>();
 						versionInformation.toHost();
-						Logger::info(versionInformation.debugText());
+						GGK_LOG_INFO(versionInformation.debugText());
+						break;
+					}
+					case Mgmt::EReadControllerIndexListCommand:
+					{
+						if (dataLen < sizeof(uint16_t))
+						{
+							Logger::error("Invalid data length");
+							break;
+						}
+
+						uint16_t count = Utils::endianToHost(*payload.overlay<uint16_t>());
+						if (dataLen < sizeof(uint16_t) * (1 + count))
+						{
+							Logger::error("Invalid data length");
+							break;
+						}
+
+						controllerIndexList.clear();
+						for (uint16_t i = 0; i < count; ++i)
+						{
+							uint16_t index = Utils::endianToHost(*payload.overlay<uint16_t>(sizeof(uint16_t) * (1 + i)));
+							controllerIndexList.push_back(index);
+							controllerState(index);
+						}
+
+						Logger::info(SSTR << "> Controller index list: " << count << " controller(s)");
 						break;
 					}
 					case Mgmt::EReadAdvertisingFeaturesCommand:
 					{
-					    advertisingFeatures = *reinterpret_cast<AdvertisingFeatures *>(data);
-					    advertisingFeatures.toHost();
-					    Logger::info(advertisingFeatures.debugText());
+						// The reply only includes as many instances as are in use
+						if (dataLen < offsetof(AdvertisingFeatures, instanceRef))
+						{
+							Logger::error("Invalid data length");
+							break;
+						}
+
+						controller.advertisingFeatures = AdvertisingFeatures();
+						memcpy(&controller.advertisingFeatures, data, std::min(dataLen, sizeof(AdvertisingFeatures)));
+					    controller.advertisingFeatures.toHost();
+					    GGK_LOG_INFO(controller.advertisingFeatures.debugText());
 					    break;
 					}
 					case Mgmt::EReadControllerInformationCommand:
@@ -282,12 +358,12 @@ void HciAdapter::runEventThread()
 						if (dataLen != sizeof(ControllerInformation))
 						{
 							Logger::error("Invalid data length");
-							return;
+							break;
 						}
 
-						controllerInformation = *reinterpret_cast<ControllerInformation *>(data);
-						controllerInformation.toHost();
-						Logger::info(controllerInformation.debugText());
+						controller.controllerInformation = *payload.overlay<ControllerInformation>();
+						controller.controllerInformation.toHost();
+						GGK_LOG_INFO(controller.controllerInformation.debugText());
 						break;
 					}
 					case Mgmt::ESetLocalNameCommand:
@@ -295,11 +371,11 @@ void HciAdapter::runEventThread()
 						if (dataLen != sizeof(LocalName))
 						{
 							Logger::error("Invalid data length");
-							return;
+							break;
 						}
 
-						localName = *reinterpret_cast<LocalName *>(data);
-						Logger::info(localName.debugText());
+						controller.localName = *payload.overlay<LocalName>();
+						GGK_LOG_INFO(controller.localName.debugText());
 						break;
 					}
 					case Mgmt::ESetPoweredCommand:
@@ -313,37 +389,78 @@ void HciAdapter::runEventThread()
 						if (dataLen != sizeof(AdapterSettings))
 						{
 							Logger::error("Invalid data length");
-							return;
+							break;
 						}
 
-						adapterSettings = *reinterpret_cast<AdapterSettings *>(data);
-						adapterSettings.toHost();
+						controller.adapterSettings = *payload.overlay<AdapterSettings>();
+						controller.adapterSettings.toHost();
 
-						Logger::info(adapterSettings.debugText());
+						GGK_LOG_INFO(controller.adapterSettings.debugText());
 						break;
 					}
 				}
 
+				controllersLock.unlock();
+
 				// Notify anybody waiting that we received a response to their command code
-				setCommandResponse(event.commandCode);
+				setCommandResponse(pEvent->getCommandCode(), pEvent->header.getControllerId(), pEvent->status);
 
 				break;
 			}
 			// Command status event
 			case Mgmt::ECommandStatusEvent:
 			{
-				CommandStatusEvent event(responsePacket);
+				const CommandStatusEvent *pEvent = overlayEvent<CommandStatusEvent>(responsePacket, false);
+				if (nullptr == pEvent)
+				{
+					break;
+				}
+
+				// Failures are always logged
+				if (0 != pEvent->status)
+				{
+					Logger::error(pEvent->debugText());
+				}
+				else
+				{
+					GGK_LOG_INFO(pEvent->debugText());
+				}
 
 				// Notify anybody waiting that we received a response to their command code
-				setCommandResponse(event.commandCode);
+				setCommandResponse(pEvent->getCommandCode(), pEvent->header.getControllerId(), pEvent->status);
 				break;
 			}
 			// Device connected event
 			case Mgmt::EDeviceConnectedEvent:
 			{
-				DeviceConnectedEvent event(responsePacket);
-				activeConnections += 1;
-				Logger::info(SSTR << "  > Connection count incremented to " << activeConnections);
+				// The event is followed by its EIR data, which must also be present before we can log it
+				const DeviceConnectedEvent *pEvent = overlayEvent<DeviceConnectedEvent>(responsePacket, false);
+				if (nullptr == pEvent)
+				{
+					break;
+				}
+				else if (responsePacket.size - sizeof(DeviceConnectedEvent) < pEvent->getEirDataLength())
+				{
+					Logger::error("Invalid DeviceConnected event: EIR data is truncated");
+					Stats::increment(Stats::getInstance().hciEventsRejected);
+					break;
+				}
+				GGK_LOG_INFO(pEvent->debugText());
+
+				uint16_t controllerId = pEvent->header.getControllerId();
+				{
+					std::lock_guard<std::mutex> lock(controllersMutex);
+					activeConnections += 1;
+					controllerState(controllerId).activeConnections += 1;
+				}
+				Sessions::getInstance().connected(controllerId, pEvent->address, pEvent->addressType);
+				if (AdapterEvents::getInstance().wants(EAdapterEventClientConnected))
+				{
+					GGKAdapterEvent event = makeAdapterEvent(EAdapterEventClientConnected, controllerId, pEvent->address, pEvent->addressType);
+					event.activeConnections = getActiveConnectionCount();
+					AdapterEvents::getInstance().publish(event);
+				}
+				Logger::info(SSTR << "  > Connection count incremented to " << activeConnections << " (controller " << controllerId << ": " << getActiveConnectionCount(controllerId) << ")");
 		                // TODO: fix this hack
                 		/**
                  		* To anyone reading this, the proper thing to do here is probably register a callback into HciAdapter
@@ -353,7 +470,7 @@ void HciAdapter::runEventThread()
                  		* wont be used to listen to in my GATT profile.
 				* ... and i did it again here to see connecting/disconnecting devices for a test.
                  		*/
-                		if( (hackCallback)("GGK/EVENT/EClientConnected", static_cast<const void *>(&activeConnections)) == 0 ) {
+                		if( notifyEventListener(EAdapterEventClientConnected, "GGK/EVENT/EClientConnected", static_cast<const void *>(&activeConnections)) == 0 ) {
                     			Logger::error(SSTR << "Unable to update EClientConnected on data setter");
                 		}
 				break;
@@ -361,10 +478,25 @@ void HciAdapter::runEventThread()
 			// Device disconnected event
 			case Mgmt::EDeviceDisconnectedEvent:
 			{
-				DeviceDisconnectedEvent event(responsePacket);
+				const DeviceDisconnectedEvent *pEvent = overlayEvent<DeviceDisconnectedEvent>(responsePacket);
+				if (nullptr == pEvent)
+				{
+					break;
+				}
+
+				Sessions::getInstance().disconnected(pEvent->address);
+
 				if (activeConnections > 0)
 				{
-					activeConnections -= 1;
+					{
+						std::lock_guard<std::mutex> lock(controllersMutex);
+						activeConnections -= 1;
+						ControllerState &controller = controllerState(pEvent->header.getControllerId());
+						if (controller.activeConnections > 0)
+						{
+							controller.activeConnections -= 1;
+						}
+					}
 					if( activeConnections == 0) {
 				                // TODO: fix this hack
        			         		/**
@@ -375,7 +507,7 @@ void HciAdapter::runEventThread()
         		         		* wont be used to listen to in my GATT profile.
 						* ... and i did it again here to see connecting/disconnecting devices for a test.
                  				*/
-                				if( (hackCallback)("GGK/EVENT/EClientDisconnected", static_cast<const void *>(&activeConnections)) == 0 ) {
+                				if( notifyEventListener(EAdapterEventClientDisconnected, "GGK/EVENT/EClientDisconnected", static_cast<const void *>(&activeConnections)) == 0 ) {
                     					Logger::error(SSTR << "Unable to update EClientDisconnected on data setter");
                 				}
 					}
@@ -386,12 +518,30 @@ void HciAdapter::runEventThread()
 				{
 					Logger::info(SSTR << "  > Connection count already at zero, ignoring non-connected disconnect event");
 				}
+
+				if (AdapterEvents::getInstance().wants(EAdapterEventClientDisconnected))
+				{
+					GGKAdapterEvent event = makeAdapterEvent(EAdapterEventClientDisconnected, pEvent->header.getControllerId(), pEvent->address, pEvent->addressType);
+					event.activeConnections = getActiveConnectionCount();
+					event.reason = pEvent->reason;
+					AdapterEvents::getInstance().publish(event);
+				}
 				break;
 			}
 			case Mgmt::EAuthenticationFailedEvent:
 			{
-			    AuthenticationFailedEvent event(responsePacket);
-			    if( event.reason == Mgmt::EMGMT_STATUS_AUTH_FAILED ) {
+			    const AuthenticationFailedEvent *pEvent = overlayEvent<AuthenticationFailedEvent>(responsePacket);
+			    if (nullptr == pEvent)
+			    {
+			        break;
+			    }
+			    if (AdapterEvents::getInstance().wants(EAdapterEventAuthenticationFailed))
+			    {
+			        GGKAdapterEvent event = makeAdapterEvent(EAdapterEventAuthenticationFailed, pEvent->header.getControllerId(), pEvent->address, pEvent->addressType);
+			        event.reason = pEvent->reason;
+			        AdapterEvents::getInstance().publish(event);
+			    }
+			    if( pEvent->reason == Mgmt::EMGMT_STATUS_AUTH_FAILED ) {
 			        Logger::info(SSTR << "Authentication failed (from remote)");
 	                // TODO: fix this hack
 	                /**
@@ -401,7 +551,7 @@ void HciAdapter::runEventThread()
 	                 * communication method (our dataSetter for GATT services) down here and hacking a string value that
 	                 * wont be used to listen to in my GATT profile.
 	                 */
-	                if( (hackCallback)("GGK/EVENT/EAuthenticationFailedEvent", static_cast<const void *>(event.address)) == 0 ) {
+	                if( notifyEventListener(EAdapterEventAuthenticationFailed, "GGK/EVENT/EAuthenticationFailedEvent", static_cast<const void *>(pEvent->address)) == 0 ) {
 	                    Logger::error(SSTR << "Unable to update EAuthenticationFailedEvent on data setter");
 	                }
 	                break;
@@ -412,28 +562,64 @@ void HciAdapter::runEventThread()
 			// Class of Device Changed event
 			case Mgmt::EClassOfDeviceChangedEvent:
 			{
-			    ClassOfDeviceChangedEvent event(responsePacket);
-			    // Just logging that we changed our Class of Device (during event construction)
+			    // Just logging that we changed our Class of Device
+			    overlayEvent<ClassOfDeviceChangedEvent>(responsePacket);
 			    break;
 			}
 			case Mgmt::ENewLinkKeyEvent:
 			{
-			    NewLinkKeyEvent event(responsePacket);
+			    const NewLinkKeyEvent *pEvent = overlayEvent<NewLinkKeyEvent>(responsePacket);
+			    if (nullptr != pEvent && AdapterEvents::getInstance().wants(EAdapterEventNewLinkKey))
+			    {
+			        GGKAdapterEvent event = makeAdapterEvent(EAdapterEventNewLinkKey, pEvent->header.getControllerId(), pEvent->key_address, pEvent->key_addressType);
+			        event.storeHint = pEvent->store_hint;
+			        event.keyType = pEvent->key_type;
+			        memcpy(event.key, pEvent->key_data, sizeof(event.key));
+			        AdapterEvents::getInstance().publish(event);
+			    }
 			    break;
 			}
 			case Mgmt::ENewIdentityResolvingKeyEvent:
             {
-                NewIdenityResolvingKeyEvent event(responsePacket);
+                const NewIdenityResolvingKeyEvent *pEvent = overlayEvent<NewIdenityResolvingKeyEvent>(responsePacket);
+                if (nullptr != pEvent && AdapterEvents::getInstance().wants(EAdapterEventNewIdentityResolvingKey))
+                {
+                    GGKAdapterEvent event = makeAdapterEvent(EAdapterEventNewIdentityResolvingKey, pEvent->header.getControllerId(), pEvent->key_address, pEvent->key_addressType);
+                    event.storeHint = pEvent->store_hint;
+                    memcpy(event.key, pEvent->key_data, sizeof(event.key));
+                    AdapterEvents::getInstance().publish(event);
+                }
                 break;
             }
 			case Mgmt::ENewSignatureResolvingKeyEvent:
             {
-                NewSignatureResolvingKeyEvent event(responsePacket);
+                const NewSignatureResolvingKeyEvent *pEvent = overlayEvent<NewSignatureResolvingKeyEvent>(responsePacket);
+                if (nullptr != pEvent && AdapterEvents::getInstance().wants(EAdapterEventNewSignatureResolvingKey))
+                {
+                    GGKAdapterEvent event = makeAdapterEvent(EAdapterEventNewSignatureResolvingKey, pEvent->header.getControllerId(), pEvent->key_address, pEvent->key_addressType);
+                    event.storeHint = pEvent->store_hint;
+                    event.keyType = pEvent->key_type;
+                    memcpy(event.key, pEvent->key_data, sizeof(event.key));
+                    AdapterEvents::getInstance().publish(event);
+                }
                 break;
             }
 			case Mgmt::ENewLongTermKeyEvent:
             {
-                NewLongTermKeyEvent event(responsePacket);
+                const NewLongTermKeyEvent *pEvent = overlayEvent<NewLongTermKeyEvent>(responsePacket);
+                if (nullptr == pEvent)
+                {
+                    break;
+                }
+                if (AdapterEvents::getInstance().wants(EAdapterEventNewLongTermKey))
+                {
+                    GGKAdapterEvent event = makeAdapterEvent(EAdapterEventNewLongTermKey, pEvent->header.getControllerId(), pEvent->key_address, pEvent->key_addressType);
+                    event.storeHint = pEvent->store_hint;
+                    event.keyType = pEvent->key_type;
+                    event.keyMaster = pEvent->key_master;
+                    memcpy(event.key, pEvent->key_data, sizeof(event.key));
+                    AdapterEvents::getInstance().publish(event);
+                }
                 // TODO: fix this hack
                 /**
                  * To anyone reading this, the proper thing to do here is probably register a callback into HciAdapter
@@ -442,19 +628,31 @@ void HciAdapter::runEventThread()
                  * communication method (our dataSetter for GATT services) down here and hacking a string value that
                  * wont be used to listen to in my GATT profile.
                  */
-                if( (hackCallback)("GGK/EVENT/ENewLongTermKeyEvent", static_cast<const void *>(&event.key_master)) == 0 ) {
+                if( notifyEventListener(EAdapterEventNewLongTermKey, "GGK/EVENT/ENewLongTermKeyEvent", static_cast<const void *>(&pEvent->key_master)) == 0 ) {
                     Logger::error(SSTR << "Unable to update ENewLongTermKeyEvent on data setter");
                 }
                 break;
             }
 			case Mgmt::EPasskeyNotifyEvent:
 			{
-			    PasskeyNotifyEvent event(responsePacket);
+			    const PasskeyNotifyEvent *pEvent = overlayEvent<PasskeyNotifyEvent>(responsePacket);
+			    if (nullptr != pEvent && AdapterEvents::getInstance().wants(EAdapterEventPasskeyNotify))
+			    {
+			        GGKAdapterEvent event = makeAdapterEvent(EAdapterEventPasskeyNotify, pEvent->header.getControllerId(), pEvent->address, pEvent->addressType);
+			        event.passkey = pEvent->getPasskey();
+			        AdapterEvents::getInstance().publish(event);
+			    }
 			    break;
 		    }
 			case Mgmt::EUserConfirmationRequestEvent:
 			{
-			    UserConfirmationRequestEvent event(responsePacket);
+			    const UserConfirmationRequestEvent *pEvent = overlayEvent<UserConfirmationRequestEvent>(responsePacket);
+			    if (nullptr != pEvent && AdapterEvents::getInstance().wants(EAdapterEventUserConfirmationRequest))
+			    {
+			        GGKAdapterEvent event = makeAdapterEvent(EAdapterEventUserConfirmationRequest, pEvent->header.getControllerId(), pEvent->address, pEvent->addressType);
+			        event.passkey = pEvent->getPasskey();
+			        AdapterEvents::getInstance().publish(event);
+			    }
 			    break;
 		    }
 			// Unsupported
@@ -470,6 +668,8 @@ void HciAdapter::runEventThread()
 				}
 			}
 		}
+
+		Stats::getInstance().recordHciEvent(eventCode, Stats::now() - eventStartUS);
 	}
 
 	// Make sure we're disconnected before we leave
@@ -508,6 +708,98 @@ void HciAdapter::sync(uint16_t controllerIndex)
 	}
 }
 
+// Requests the list of controllers from the kernel (see `getControllerIndexList()`)
+//
+// Returns true on success, otherwise false
+bool HciAdapter::readControllerIndexList()
+{
+	Logger::info("Reading controller index list");
+
+	HciAdapter::HciHeader request;
+	request.code = Mgmt::EReadControllerIndexListCommand;
+	request.controllerId = HciAdapter::kNonController;
+	request.dataSize = 0;
+
+	if (!sendCommand(request))
+	{
+		Logger::error("Failed to read the controller index list");
+		return false;
+	}
+
+	return true;
+}
+
+HciAdapter::AdapterSettings HciAdapter::getAdapterSettings(uint16_t controllerIndex) const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+	auto it = controllers.find(controllerIndex);
+	return controllers.end() == it ? AdapterSettings() : it->second.adapterSettings;
+}
+
+HciAdapter::ControllerInformation HciAdapter::getControllerInformation(uint16_t controllerIndex) const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+	auto it = controllers.find(controllerIndex);
+	return controllers.end() == it ? ControllerInformation() : it->second.controllerInformation;
+}
+
+HciAdapter::AdvertisingFeatures HciAdapter::getAdvertisingFeatures(uint16_t controllerIndex) const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+	auto it = controllers.find(controllerIndex);
+	return controllers.end() == it ? AdvertisingFeatures() : it->second.advertisingFeatures;
+}
+
+HciAdapter::LocalName HciAdapter::getLocalName(uint16_t controllerIndex) const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+	auto it = controllers.find(controllerIndex);
+	return controllers.end() == it ? LocalName() : it->second.localName;
+}
+
+// Returns the number of active connections across all controllers
+int HciAdapter::getActiveConnectionCount() const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+	return activeConnections;
+}
+
+// Returns the number of active connections on the given controller
+int HciAdapter::getActiveConnectionCount(uint16_t controllerIndex) const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+	auto it = controllers.find(controllerIndex);
+	return controllers.end() == it ? 0 : it->second.activeConnections;
+}
+
+// Returns the indices of the controllers reported by the most recent call to `readControllerIndexList()`
+std::vector<uint16_t> HciAdapter::getControllerIndexList() const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+	return controllerIndexList;
+}
+
+// Returns the controller (from `getControllerIndexList()`) with the fewest active connections
+uint16_t HciAdapter::getLeastConnectedController() const
+{
+	std::lock_guard<std::mutex> lock(controllersMutex);
+
+	uint16_t best = kDefaultControllerIndex;
+	int bestCount = -1;
+	for (uint16_t index : controllerIndexList)
+	{
+		auto it = controllers.find(index);
+		int count = controllers.end() == it ? 0 : it->second.activeConnections;
+		if (bestCount < 0 || count < bestCount)
+		{
+			best = index;
+			bestCount = count;
+		}
+	}
+
+	return best;
+}
+
 // Connects the HCI socket if a connection does not already exist and starts the run thread
 //
 // If the thread is already running, this method will fail
@@ -534,10 +826,16 @@ bool HciAdapter::start()
 		}
 	}
 
-	// Create a thread to read the data from the socket
+	// Create a thread to read the data from the socket, along with the worker that times out unanswered commands
 	try
 	{
 		eventThread = std::thread(ggk::runEventThread);
+
+		if (!commandTimeoutThread.joinable())
+		{
+			stopCommandTimeoutThread = false;
+			commandTimeoutThread = std::thread(&HciAdapter::runCommandTimeoutThread, this);
+		}
 	}
 	catch(std::system_error &ex)
 	{
@@ -548,13 +846,39 @@ bool HciAdapter::start()
 	return true;
 }
 
-// Waits for the HciAdapter run thread to join
+// Starts the run thread on an already-connected socket, rather than the kernel's HCI control socket
+//
+// This is intended for driving the adapter with a simulated controller (see `HciSocket::connect(int)`.) The adapter takes
+// ownership of the socket.
+//
+// Returns true on success, otherwise false
+bool HciAdapter::start(int fdSocket)
+{
+	if (eventThread.joinable())
+	{
+		Logger::warn(SSTR << "HciAdapter already on eventThread (double start() call?)");
+		close(fdSocket);
+		return false;
+	}
+
+	if (!hciSocket.connect(fdSocket))
+	{
+		return false;
+	}
+
+	return start();
+}
+
+// Wakes the HciAdapter run thread and waits for it to join
 //
 // This method will block until the thread joins
 void HciAdapter::stop()
 {
 	Logger::trace("HciAdapter waiting for thread termination");
 
+	// Wake the event thread so it notices we're shutting down
+	hciSocket.requestShutdown();
+
 	try
 	{
 		if (eventThread.joinable())
@@ -587,6 +911,18 @@ void HciAdapter::stop()
 			Logger::warn(SSTR << "Unknown system_error code (" << ex.code() << ") during HciAdapter::wait(): " << ex.what());
 		}
 	}
+
+	// Stop our timeout worker, failing any commands that are still waiting
+	{
+		std::lock_guard<std::mutex> lock(pendingCommandsMutex);
+		stopCommandTimeoutThread = true;
+	}
+	cvPendingCommands.notify_all();
+
+	if (commandTimeoutThread.joinable() && commandTimeoutThread.get_id() != std::this_thread::get_id())
+	{
+		commandTimeoutThread.join();
+	}
 }
 
 // Sends a command over the HCI socket
@@ -597,70 +933,173 @@ void HciAdapter::stop()
 // Returns true on success, otherwise false
 bool HciAdapter::sendCommand(HciHeader &request)
 {
+	return sendCommandAsync(request).get().responded;
+}
+
+// Sends a command over the HCI socket without waiting for the response
+//
+// Any number of commands may be in flight at once. Each is matched to its response by command code and controller index
+// (in the order they were sent), at which point the returned future becomes ready and `callback` (if any) is called. If no
+// response arrives within `kMaxEventWaitTimeMS`, the command times out with `responded` set to false.
+//
+// If the HCI socket is not connected, it will auto-connect prior to sending the command. If the command cannot be sent, the
+// returned future is ready immediately (and the callback has been called) with `responded` set to false.
+std::future<HciAdapter::CommandResult> HciAdapter::sendCommandAsync(HciHeader &request, CommandCallback callback)
+{
+	PendingCommand command;
+	command.commandCode = request.code;
+	command.controllerId = request.controllerId;
+	command.sentUS = Stats::now();
+	command.pPromise = std::make_shared<std::promise<CommandResult>>();
+	command.callback = callback;
+	std::future<CommandResult> future = command.pPromise->get_future();
+
 	// Auto-connect
 	if (!eventThread.joinable() && !start())
 	{
 		Logger::error("HciAdapter failed to start");
-		return false;
+		completeCommand(command, false, 0);
+		return future;
 	}
 
-	uint16_t code = request.code;
 	uint16_t dataSize = request.dataSize;
+	Stats::increment(Stats::getInstance().hciCommandsSent);
 
-	conditionalValue = -1;
-	std::future<bool> fut = std::async(std::launch::async,
-	[&]() mutable
+	// Register the command before sending it, so that we can't miss its response
+	std::list<PendingCommand>::iterator it;
 	{
-		return waitForCommandResponse(code, kMaxEventWaitTimeMS);
-	});
+		std::lock_guard<std::mutex> lock(pendingCommandsMutex);
+		command.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kMaxEventWaitTimeMS);
+		it = pendingCommands.insert(pendingCommands.end(), command);
+	}
+	cvPendingCommands.notify_all();
+
+	GGK_LOG_INFO("  + Sending command code " << Utils::hex(command.commandCode) << " (" << getCommandCodeName(command.commandCode) << ")");
 
 	// Prepare the request to be sent (endianness correction)
 	request.toNetwork();
 	uint8_t *pRequest = reinterpret_cast<uint8_t *>(&request);
 
-	std::vector<uint8_t> requestPacket = std::vector<uint8_t>(pRequest, pRequest + sizeof(request) + dataSize);
-	if (!hciSocket.write(requestPacket))
+	if (!hciSocket.write(pRequest, sizeof(request) + dataSize))
 	{
-		return false;
+		// The command never went out, so nothing will answer it (unless it already timed out)
+		std::unique_lock<std::mutex> lock(pendingCommandsMutex);
+		for (auto pending = pendingCommands.begin(); pending != pendingCommands.end(); ++pending)
+		{
+			if (pending == it)
+			{
+				PendingCommand failed = *pending;
+				pendingCommands.erase(pending);
+				lock.unlock();
+				completeCommand(failed, false, 0);
+				break;
+			}
+		}
 	}
 
-	return fut.get();
+	return future;
 }
 
-// Uses a std::condition_variable to wait for a response event for the given `commandCode` or `timeoutMS` milliseconds.
-//
-// Returns true if the response event was received for `commandCode` or false if the timeout expired.
-//
-// Command responses are set via `setCommandResponse()`
-bool HciAdapter::waitForCommandResponse(uint16_t commandCode, int timeoutMS)
+// Completes the oldest pending command matching `commandCode` and `controllerId` with the given status
+void HciAdapter::setCommandResponse(uint16_t commandCode, uint16_t controllerId, uint8_t status)
 {
-	Logger::info(SSTR << "  + Waiting on command code " << commandCode << " for up to " << timeoutMS << "ms");
-
-	bool success = cvCommandResponse.wait_for(commandResponseLock, std::chrono::milliseconds(timeoutMS),
-		[&]
+	std::unique_lock<std::mutex> lock(pendingCommandsMutex);
+	for (auto it = pendingCommands.begin(); it != pendingCommands.end(); ++it)
+	{
+		if (it->commandCode == commandCode && it->controllerId == controllerId)
 		{
-			return conditionalValue == commandCode;
+			PendingCommand command = *it;
+			pendingCommands.erase(it);
+			lock.unlock();
+
+			GGK_LOG_INFO("  + Recieved the command code we were waiting for: " << Utils::hex(commandCode) << " (" << getCommandCodeName(commandCode) << ")");
+			completeCommand(command, true, status);
+			return;
 		}
-	);
+	}
+}
+
+// Delivers a result to a pending command's future and callback
+void HciAdapter::completeCommand(PendingCommand &command, bool responded, uint8_t status)
+{
+	CommandResult result;
+	result.commandCode = command.commandCode;
+	result.controllerId = command.controllerId;
+	result.responded = responded;
+	result.status = status;
 
-	if (!success)
+	if (responded)
 	{
-		Logger::warn(SSTR << "  + Timed out waiting on command code " << Utils::hex(commandCode) << " (" << kCommandCodeNames[commandCode] << ")");
+		Stats::getInstance().hciCommandLatency.record(Stats::now() - command.sentUS);
 	}
-	else
+
+	if (command.callback)
 	{
-		Logger::info(SSTR << "  + Recieved the command code we were waiting for: " << Utils::hex(commandCode) << " (" << kCommandCodeNames[commandCode] << ")");
+		command.callback(result);
 	}
 
-	return success;
+	command.pPromise->set_value(result);
 }
 
-// Sets the command response and notifies the waiting std::condition_variable (see `waitForCommandResponse`)
-void HciAdapter::setCommandResponse(uint16_t commandCode)
+// Our timeout worker, which expires pending commands that never receive a response
+//
+// This is a single long-lived thread (rather than a thread per command) that sleeps until the earliest deadline of any
+// pending command.
+void HciAdapter::runCommandTimeoutThread()
 {
-	std::lock_guard<std::mutex> lk(commandResponseMutex);
-	conditionalValue = commandCode;
-	cvCommandResponse.notify_one();
+	std::unique_lock<std::mutex> lock(pendingCommandsMutex);
+	while (!stopCommandTimeoutThread)
+	{
+		if (pendingCommands.empty())
+		{
+			cvPendingCommands.wait(lock);
+			continue;
+		}
+
+		// Pending commands all share the same timeout, so the oldest is always the first to expire
+		auto deadline = pendingCommands.front().deadline;
+		if (std::chrono::steady_clock::now() < deadline)
+		{
+			cvPendingCommands.wait_until(lock, deadline);
+			continue;
+		}
+
+		PendingCommand command = pendingCommands.front();
+		pendingCommands.pop_front();
+		lock.unlock();
+
+		Logger::warn(SSTR << "  + Timed out waiting on command code " << Utils::hex(command.commandCode) << " (" << getCommandCodeName(command.commandCode) << ")");
+		Stats::increment(Stats::getInstance().hciCommandTimeouts);
+		completeCommand(command, false, 0);
+
+		lock.lock();
+	}
+
+	// Anything left will never be answered
+	std::list<PendingCommand> abandoned;
+	abandoned.swap(pendingCommands);
+	lock.unlock();
+
+	for (PendingCommand &command : abandoned)
+	{
+		completeCommand(command, false, 0);
+	}
+}
+
+// Reports an event to the registered event listener (see `registerEventListener()`), timing the call
+//
+// Returns the listener's result, or non-zero if no listener is registered
+int HciAdapter::notifyEventListener(GGKAdapterEventType type, const char *pName, const void *pData)
+{
+	// An application that subscribes to the event (see AdapterEvents.cpp) has it already, without the string comparisons
+	if (nullptr == hackCallback || AdapterEvents::getInstance().wants(type))
+	{
+		return 1;
+	}
+
+	Stats::increment(Stats::getInstance().dataSetterCalls);
+	ScopedLatency latency(Stats::getInstance().dataSetterLatency);
+	return hackCallback(pName, pData);
 }
 
 }; // namespace ggk
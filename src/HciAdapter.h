@@ -26,15 +26,21 @@
 
 #include <stdint.h>
 #include <vector>
+#include <list>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
 
 #include <iomanip>
 
 #include "HciSocket.h"
 #include "Utils.h"
 #include "Logger.h"
+#include "Stats.h"
 
 namespace ggk {
 
@@ -52,11 +58,17 @@ public:
 	// A constant referring to a 'non-controller' (for commands that do not require a controller index)
 	static const uint16_t kNonController = 0xffff;
 
+	// The index of the first controller, used when no controller index is given
+	static const uint16_t kDefaultControllerIndex = 0;
+
 	// Command code names
 	static const int kMinCommandCode = 0x0001;
 	static const int kMaxCommandCode = 0x0043;
 	static const char * const kCommandCodeNames[kMaxCommandCode + 1];
 
+	// Returns the name of `commandCode`, or "Unknown" for a code outside of `kCommandCodeNames`
+	static const char *getCommandCodeName(uint16_t commandCode);
+
 	// Event type names
 	static const int kMinEventType = 0x0001;
 	static const int kMaxEventType = 0x0025;
@@ -159,11 +171,16 @@ public:
 			dataSize = Utils::endianToHost(dataSize);
 		}
 
+		// Host-order accessors, for a header still in HCI order (such as one at the front of a received event)
+		uint16_t getCode() const { return Utils::endianToHost(code); }
+		uint16_t getControllerId() const { return Utils::endianToHost(controllerId); }
+		uint16_t getDataSize() const { return Utils::endianToHost(dataSize); }
+
 		std::string debugText()
 		{
 			std::string text = "";
 			text += "> Request header\n";
-			text += "  + Command code       : " + Utils::hex(code) + " (" + HciAdapter::kCommandCodeNames[code] + ")\n";
+			text += "  + Command code       : " + Utils::hex(code) + " (" + HciAdapter::getCommandCodeName(code) + ")\n";
 			text += "  + Controller Id      : " + Utils::hex(controllerId) + "\n";
 			text += "  + Data size          : " + std::to_string(dataSize) + " bytes";
 			return text;
@@ -314,41 +331,27 @@ public:
         return text;
 	}
 
+	// Events received from the adapter
+	//
+	// These are laid out exactly as they arrive and are never copied out of the packet they arrive in. Rather, each is overlaid
+	// on the received packet (see `HciPacket::overlay()`), which checks that the packet is long enough to hold it, and fields
+	// wider than a byte are left in HCI order and converted only when read through their accessors.
 	struct CommandCompleteEvent
 	{
 		HciHeader header;
 		uint16_t commandCode;
 		uint8_t status;
 
-		CommandCompleteEvent(const std::vector<uint8_t> &data)
-		{
-			*this = *reinterpret_cast<const CommandCompleteEvent *>(data.data());
-			toHost();
-
-			// Log it
-			Logger::info(debugText());
-		}
-
-		void toNetwork()
-		{
-			header.toNetwork();
-			commandCode = Utils::endianToHci(commandCode);
-		}
-
-		void toHost()
-		{
-			header.toHost();
-			commandCode = Utils::endianToHost(commandCode);
-		}
+		uint16_t getCommandCode() const { return Utils::endianToHost(commandCode); }
 
-		std::string debugText()
+		std::string debugText() const
 		{
 			std::string text = "";
 			text += "> Command complete event\n";
-			text += "  + Event code         : " + Utils::hex(header.code) + " (" + HciAdapter::kEventTypeNames[header.code] + ")\n";
-			text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-			text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
-			text += "  + Command code       : " + Utils::hex(commandCode) + " (" + HciAdapter::kCommandCodeNames[commandCode] + ")\n";
+			text += "  + Event code         : " + Utils::hex(header.getCode()) + " (" + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+			text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+			text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
+			text += "  + Command code       : " + Utils::hex(getCommandCode()) + " (" + HciAdapter::getCommandCodeName(getCommandCode()) + ")\n";
 			text += "  + Status             : " + Utils::hex(status);
 			return text;
 		}
@@ -360,39 +363,16 @@ public:
 		uint16_t commandCode;
 		uint8_t status;
 
-		CommandStatusEvent(const std::vector<uint8_t> &data)
-		{
-			*this = *reinterpret_cast<const CommandStatusEvent *>(data.data());
-			toHost();
-
-			// Log it
-			if( status ) {
-			    Logger::error(debugText());
-			} else {
-			    Logger::info(debugText());
-			}
-		}
-
-		void toNetwork()
-		{
-			header.toNetwork();
-			commandCode = Utils::endianToHci(commandCode);
-		}
+		uint16_t getCommandCode() const { return Utils::endianToHost(commandCode); }
 
-		void toHost()
-		{
-			header.toHost();
-			commandCode = Utils::endianToHost(commandCode);
-		}
-
-		std::string debugText()
+		std::string debugText() const
 		{
 			std::string text = "";
 			text += "> Command status event\n";
-			text += "  + Event code         : " + Utils::hex(header.code) + " (" + HciAdapter::kEventTypeNames[header.code] + ")\n";
-			text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-			text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
-			text += "  + Command code       : " + Utils::hex(commandCode) + " (" + HciAdapter::kCommandCodeNames[commandCode] + ")\n";
+			text += "  + Event code         : " + Utils::hex(header.getCode()) + " (" + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+			text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+			text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
+			text += "  + Command code       : " + Utils::hex(getCommandCode()) + " (" + HciAdapter::getCommandCodeName(getCommandCode()) + ")\n";
 			text += "  + Status             : " + Utils::hex(status) + " (" + HciAdapter::kStatusCodes[status] + ")";
 			return text;
 		}
@@ -406,44 +386,24 @@ public:
 		uint32_t flags;
 		uint16_t eirDataLength;
 
-		DeviceConnectedEvent(const std::vector<uint8_t> &data)
-		{
-			*this = *reinterpret_cast<const DeviceConnectedEvent *>(data.data());
-			toHost();
-
-			// Log it
-			Logger::info(debugText());
-		}
-
-		void toNetwork()
-		{
-			header.toNetwork();
-			flags = Utils::endianToHci(flags);
-			eirDataLength = Utils::endianToHci(eirDataLength);
-		}
+		uint32_t getFlags() const { return Utils::endianToHost(flags); }
+		uint16_t getEirDataLength() const { return Utils::endianToHost(eirDataLength); }
 
-		void toHost()
-		{
-			header.toHost();
-			flags = Utils::endianToHost(flags);
-			eirDataLength = Utils::endianToHost(eirDataLength);
-		}
-
-		std::string debugText()
+		std::string debugText() const
 		{
 			std::string text = "";
 			text += "> DeviceConnected event\n";
-			text += "  + Event code         : " + Utils::hex(header.code) + " (" + HciAdapter::kEventTypeNames[header.code] + ")\n";
-			text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-			text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+			text += "  + Event code         : " + Utils::hex(header.getCode()) + " (" + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+			text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+			text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
 			text += "  + Address            : " + Utils::bluetoothAddressString(address) + "\n";
 			text += "  + Address type       : " + Utils::hex(addressType) + "\n";
-			text += "  + Flags              : " + Utils::hex(flags) + "\n";
-			text += "  + EIR Data Length    : " + Utils::hex(eirDataLength);
-			if (eirDataLength > 0)
+			text += "  + Flags              : " + Utils::hex(getFlags()) + "\n";
+			text += "  + EIR Data Length    : " + Utils::hex(getEirDataLength());
+			if (getEirDataLength() > 0)
 			{
 				text += "\n";
-				text += "  + EIR Data           : " + Utils::hex(reinterpret_cast<uint8_t *>(&eirDataLength) + 2, eirDataLength);
+				text += "  + EIR Data           : " + Utils::hex(reinterpret_cast<const uint8_t *>(this + 1), getEirDataLength());
 			}
 			return text;
 		}
@@ -456,32 +416,13 @@ public:
 		uint8_t addressType;
 		uint8_t reason;
 
-		DeviceDisconnectedEvent(const std::vector<uint8_t> &data)
-		{
-			*this = *reinterpret_cast<const DeviceDisconnectedEvent *>(data.data());
-			toHost();
-
-			// Log it
-			Logger::info(debugText());
-		}
-
-		void toNetwork()
-		{
-			header.toNetwork();
-		}
-
-		void toHost()
-		{
-			header.toHost();
-		}
-
-		std::string debugText()
+		std::string debugText() const
 		{
 			std::string text = "";
 			text += "> DeviceDisconnected event\n";
-			text += "  + Event code         : " + Utils::hex(header.code) + " (" + HciAdapter::kEventTypeNames[header.code] + ")\n";
-			text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-			text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+			text += "  + Event code         : " + Utils::hex(header.getCode()) + " (" + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+			text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+			text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
 			text += "  + Address            : " + Utils::bluetoothAddressString(address) + "\n";
 			text += "  + Address type       : " + Utils::hex(addressType) + "\n";
 			text += "  + Reason             : " + Utils::hex(reason);
@@ -496,32 +437,13 @@ public:
         uint8_t addressType;
         uint8_t reason;
 
-        AuthenticationFailedEvent(const std::vector<uint8_t> &data)
-        {
-            *this = *reinterpret_cast<const AuthenticationFailedEvent *>(data.data());
-            toHost();
-
-            // Log it
-            Logger::info(debugText());
-        }
-
-        void toNetwork()
-        {
-            header.toNetwork();
-        }
-
-        void toHost()
-        {
-            header.toHost();
-        }
-
-        std::string debugText()
+        std::string debugText() const
         {
             std::string text = "";
             text += "> DeviceDisconnected event\n";
-            text += "  + Event code         : " + Utils::hex(header.code) + " (" + HciAdapter::kEventTypeNames[header.code] + ")\n";
-            text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-            text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+            text += "  + Event code         : " + Utils::hex(header.getCode()) + " (" + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+            text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+            text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
             text += "  + Address            : " + Utils::bluetoothAddressString(address) + "\n";
             text += "  + Address type       : " + Utils::hex(addressType) + "\n";
             text += "  + Reason             : " + Utils::hex(reason);
@@ -534,33 +456,14 @@ public:
         HciHeader header;
         uint8_t classOfDevice[3];
 
-        ClassOfDeviceChangedEvent(const std::vector<uint8_t> &data)
-        {
-            *this = *reinterpret_cast<const ClassOfDeviceChangedEvent *>(data.data());
-            toHost();
-
-            // Log it
-            Logger::info(debugText());
-        }
-
-        void toNetwork()
-        {
-            header.toNetwork();
-        }
-
-        void toHost()
-        {
-            header.toHost();
-        }
-
-        std::string debugText()
+        std::string debugText() const
         {
             uint32_t bitfield = (((uint32_t)classOfDevice[0]) << 16) + (((uint32_t)classOfDevice[1]) << 8) + (uint32_t)classOfDevice[2];
             std::string text = "";
             text += "> Class of Device Changed event\n";
-            text += "  + Event code         : " + Utils::hex(header.code) + " (" + HciAdapter::kEventTypeNames[header.code] + ")\n";
-            text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-            text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+            text += "  + Event code         : " + Utils::hex(header.getCode()) + " (" + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+            text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+            text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
             text += printClassOfDevice(bitfield);
             return text;
         }
@@ -575,23 +478,7 @@ public:
             uint8_t key_data[16];
             uint8_t key_pinLength;
 
-            NewLinkKeyEvent(const std::vector<uint8_t> &data) {
-                *this = *reinterpret_cast<const NewLinkKeyEvent *>(data.data());
-                toHost();
-
-                // Log it
-                Logger::info(debugText());
-            }
-
-            void toNetwork() {
-                header.toNetwork();
-            }
-
-            void toHost() {
-                header.toHost();
-            }
-
-            std::string debugText() {
+            std::string debugText() const {
                 std::string text = "";
                 std::string addieType;
                 std::string keyTypeString;
@@ -631,10 +518,10 @@ public:
                     keyTypeString = "Unsupported value";
                 }
                 text += "> New Link Key event\n";
-                text += "  + Event code         : " + Utils::hex(header.code) + " ("
-                        + HciAdapter::kEventTypeNames[header.code] + ")\n";
-                text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-                text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+                text += "  + Event code         : " + Utils::hex(header.getCode()) + " ("
+                        + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+                text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+                text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
                 text += "  + Store Hint         : " + Utils::hex(store_hint) + "\n";
                 text += "  - Key                :\n";
                 text += "    + Address          : " + Utils::bluetoothAddressString(key_address) + "\n";
@@ -653,29 +540,13 @@ public:
             uint32_t passkey;
             uint8_t entered;
 
-            PasskeyNotifyEvent(const std::vector<uint8_t> &data) {
-                *this = *reinterpret_cast<const PasskeyNotifyEvent *>(data.data());
-                toHost();
-
-                // Log it
-                Logger::info(debugText());
-            }
+            uint32_t getPasskey() const { return Utils::endianToHost(passkey); }
 
-            void toNetwork() {
-                header.toNetwork();
-                passkey = Utils::endianToHci(passkey);
-            }
-
-            void toHost() {
-                header.toHost();
-                passkey = Utils::endianToHost(passkey);
-            }
-
-            std::string debugText() {
+            std::string debugText() const {
                 std::string text = "";
                 std::string addieType;
                 std::ostringstream ss;
-                ss << std::setw( 6 ) << std::setfill( '0' ) << passkey;
+                ss << std::setw( 6 ) << std::setfill( '0' ) << getPasskey();
                 std::string passkeyString = ss.str();
                 switch( addressType ) {
                     case 0x00:
@@ -691,10 +562,10 @@ public:
                         addieType = "Unsupported value";
                 }
                 text += "> New Passkey Notify event\n";
-                text += "  + Event code         : " + Utils::hex(header.code) + " ("
-                        + HciAdapter::kEventTypeNames[header.code] + ")\n";
-                text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-                text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+                text += "  + Event code         : " + Utils::hex(header.getCode()) + " ("
+                        + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+                text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+                text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
                 text += "  + Address            : " + Utils::bluetoothAddressString(address) + "\n";
                 text += "  + Address type       : " + addieType + "\n";
                 text += "  + Key                : " + passkeyString + "\n";
@@ -710,29 +581,13 @@ public:
         uint8_t confirm_hint;
         uint32_t passkey;
 
-        UserConfirmationRequestEvent(const std::vector<uint8_t> &data) {
-            *this = *reinterpret_cast<const UserConfirmationRequestEvent *>(data.data());
-            toHost();
-
-            // Log it
-            Logger::info(debugText());
-        }
-
-        void toNetwork() {
-            header.toNetwork();
-            passkey = Utils::endianToHci(passkey);
-        }
-
-        void toHost() {
-            header.toHost();
-            passkey = Utils::endianToHost(passkey);
-        }
+        uint32_t getPasskey() const { return Utils::endianToHost(passkey); }
 
-        std::string debugText() {
+        std::string debugText() const {
             std::string text = "";
             std::string addieType;
             std::ostringstream ss;
-            ss << std::setw( 6 ) << std::setfill( '0' ) << passkey;
+            ss << std::setw( 6 ) << std::setfill( '0' ) << getPasskey();
             std::string passkeyString = ss.str();
             switch( addressType ) {
                 case 0x00:
@@ -748,10 +603,10 @@ public:
                     addieType = "Unsupported value";
             }
             text += "> New User Confirmation Request event\n";
-            text += "  + Event code         : " + Utils::hex(header.code) + " ("
-                    + HciAdapter::kEventTypeNames[header.code] + ")\n";
-            text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-            text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+            text += "  + Event code         : " + Utils::hex(header.getCode()) + " ("
+                    + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+            text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+            text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
             text += "  + Address            : " + Utils::bluetoothAddressString(address) + "\n";
             text += "  + Address type       : " + addieType + "\n";
             text += "  + Confirm Hint       : " + Utils::hex(confirm_hint) + "\n";
@@ -768,23 +623,7 @@ public:
         uint8_t key_addressType;
         uint8_t key_data[16];
 
-        NewIdenityResolvingKeyEvent(const std::vector<uint8_t> &data) {
-            *this = *reinterpret_cast<const NewIdenityResolvingKeyEvent *>(data.data());
-            toHost();
-
-            // Log it
-            Logger::info(debugText());
-        }
-
-        void toNetwork() {
-            header.toNetwork();
-        }
-
-        void toHost() {
-            header.toHost();
-        }
-
-        std::string debugText() {
+        std::string debugText() const {
             std::string text = "";
             std::string addieType;
             switch( key_addressType ) {
@@ -801,10 +640,10 @@ public:
                     addieType = "Unsupported value";
             }
             text += "> New Identity Resolving Key event\n";
-            text += "  + Event code         : " + Utils::hex(header.code) + " ("
-                    + HciAdapter::kEventTypeNames[header.code] + ")\n";
-            text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-            text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+            text += "  + Event code         : " + Utils::hex(header.getCode()) + " ("
+                    + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+            text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+            text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
             text += "  + Store Hint         : " + Utils::hex(store_hint) + "\n";
             text += "  + Random Address     : " + Utils::bluetoothAddressString(random_address) + "\n";
             text += "  - Key                :\n";
@@ -823,23 +662,7 @@ public:
         uint8_t key_type;
         uint8_t key_data[16];
 
-        NewSignatureResolvingKeyEvent(const std::vector<uint8_t> &data) {
-            *this = *reinterpret_cast<const NewSignatureResolvingKeyEvent *>(data.data());
-            toHost();
-
-            // Log it
-            Logger::info(debugText());
-        }
-
-        void toNetwork() {
-            header.toNetwork();
-        }
-
-        void toHost() {
-            header.toHost();
-        }
-
-        std::string debugText() {
+        std::string debugText() const {
             std::string text = "";
             std::string addieType;
             std::string keyTypeString;
@@ -866,10 +689,10 @@ public:
                 keyTypeString = "Unsupported value";
             }
             text += "> New Signature Resolving Key event\n";
-            text += "  + Event code         : " + Utils::hex(header.code) + " ("
-                    + HciAdapter::kEventTypeNames[header.code] + ")\n";
-            text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-            text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+            text += "  + Event code         : " + Utils::hex(header.getCode()) + " ("
+                    + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+            text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+            text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
             text += "  + Store Hint         : " + Utils::hex(store_hint) + "\n";
             text += "  - Key                :\n";
             text += "    + Address          : " + Utils::bluetoothAddressString(key_address) + "\n";
@@ -892,25 +715,9 @@ public:
         uint8_t key_randomID[8];
         uint8_t key_data[16];
 
-        NewLongTermKeyEvent(const std::vector<uint8_t> &data) {
-            *this = *reinterpret_cast<const NewLongTermKeyEvent *>(data.data());
-            toHost();
-
-            // Log it
-            Logger::info(debugText());
-        }
+        uint16_t getEncryptedDiversifier() const { return Utils::endianToHost(key_encryptedDiversifier); }
 
-        void toNetwork() {
-            header.toNetwork();
-            key_encryptedDiversifier = Utils::endianToHci(key_encryptedDiversifier);
-        }
-
-        void toHost() {
-            header.toHost();
-            key_encryptedDiversifier = Utils::endianToHost(key_encryptedDiversifier);
-        }
-
-        std::string debugText() {
+        std::string debugText() const {
             std::string text = "";
             std::string addieType;
             std::string keyTypeString;
@@ -943,10 +750,10 @@ public:
                 keyTypeString = "Unsupported value";
             }
             text += "> New Long Term Key event (Pairing/Bonding complete)\n";
-            text += "  + Event code         : " + Utils::hex(header.code) + " ("
-                    + HciAdapter::kEventTypeNames[header.code] + ")\n";
-            text += "  + Controller Id      : " + Utils::hex(header.controllerId) + "\n";
-            text += "  + Data size          : " + std::to_string(header.dataSize) + " bytes\n";
+            text += "  + Event code         : " + Utils::hex(header.getCode()) + " ("
+                    + HciAdapter::kEventTypeNames[header.getCode()] + ")\n";
+            text += "  + Controller Id      : " + Utils::hex(header.getControllerId()) + "\n";
+            text += "  + Data size          : " + std::to_string(header.getDataSize()) + " bytes\n";
             text += "  + Store Hint         : " + Utils::hex(store_hint) + "\n";
             text += "  - Key                :\n";
             text += "    + Address          : " + Utils::bluetoothAddressString(key_address) + "\n";
@@ -954,7 +761,7 @@ public:
             text += "    + Type             : " + keyTypeString + "\n";
             text += "    + Master           : " + masterString + "\n";
             text += "    + Encryption Size  : " + Utils::hex(key_encryptionSize) + "\n";
-            text += "    + Enc. Diversifier : " + Utils::hex(key_encryptedDiversifier) + "\n";
+            text += "    + Enc. Diversifier : " + Utils::hex(getEncryptedDiversifier()) + "\n";
             text += "    + Random ID        : " + Utils::hex(key_randomID, 8) + "\n";
             text += "    + Data             : " + Utils::hex(key_data, 16) + "\n";
             return text;
@@ -1187,6 +994,27 @@ public:
 		}
 	} __attribute__((packed));
 
+	// The outcome of a command sent to the adapter (see `sendCommandAsync()`)
+	struct CommandResult
+	{
+		// The command code and controller the result is for
+		uint16_t commandCode;
+		uint16_t controllerId;
+
+		// True if the adapter responded (with either a Command Complete or Command Status event), false if we timed out or the
+		// command could not be sent
+		bool responded;
+
+		// The status returned by the adapter (0 = success), only meaningful if `responded` is true
+		uint8_t status;
+	};
+
+	// A callback delegate that receives the result of a command sent via `sendCommandAsync()`
+	//
+	// Callbacks are called from the HciAdapter's event thread (or its timeout worker), so they should be brief and must not send
+	// commands synchronously.
+	typedef std::function<void(const CommandResult &result)> CommandCallback;
+
 	//
 	// Accessors
 	//
@@ -1198,12 +1026,27 @@ public:
 		return instance;
 	}
 
-	inline AdapterSettings getAdapterSettings() { return adapterSettings; }
-	inline ControllerInformation getControllerInformation() { return controllerInformation; }
-	inline VersionInformation getVersionInformation() { return versionInformation; }
-	inline AdvertisingFeatures getAdvertisingFeatures() { return advertisingFeatures; }
-	inline LocalName getLocalName() { return localName; }
-	inline int getActiveConnectionCount() { return activeConnections; }
+	// Each controller's information is tracked separately, as reported by the adapter's responses and events for that controller
+	AdapterSettings getAdapterSettings(uint16_t controllerIndex = kDefaultControllerIndex) const;
+	ControllerInformation getControllerInformation(uint16_t controllerIndex = kDefaultControllerIndex) const;
+	AdvertisingFeatures getAdvertisingFeatures(uint16_t controllerIndex = kDefaultControllerIndex) const;
+	LocalName getLocalName(uint16_t controllerIndex = kDefaultControllerIndex) const;
+	inline VersionInformation getVersionInformation() const { return versionInformation; }
+
+	// Returns the number of active connections across all controllers
+	int getActiveConnectionCount() const;
+
+	// Returns the number of active connections on the given controller
+	int getActiveConnectionCount(uint16_t controllerIndex) const;
+
+	// Returns the indices of the controllers reported by the most recent call to `readControllerIndexList()`
+	std::vector<uint16_t> getControllerIndexList() const;
+
+	// Returns the controller (from `getControllerIndexList()`) with the fewest active connections
+	//
+	// This is useful for spreading clients across multiple controllers. If no controllers are known, the default controller
+	// index is returned.
+	uint16_t getLeastConnectedController() const;
 
 	//
 	// Disallow copies of our singleton (c++11)
@@ -1218,6 +1061,11 @@ public:
 	// milliseconds. Therefore, it is not recommended attempt to retrieve the results from their accessors immediately.
 	void sync(uint16_t controllerIndex);
 
+	// Requests the list of controllers from the kernel (see `getControllerIndexList()`)
+	//
+	// Returns true on success, otherwise false
+	bool readControllerIndexList();
+
 	// Connects the HCI socket if a connection does not already exist and starts the run thread
 	//
 	// If a connection already exists, this method will fail
@@ -1227,12 +1075,20 @@ public:
 	// Returns true if the HCI socket is connected (either via a new connection or an existing one), otherwise false
 	bool start();
 
-	// Waits for the HciAdapter run thread to join
+	// Starts the run thread on an already-connected socket, rather than the kernel's HCI control socket
+	//
+	// This is intended for driving the adapter with a simulated controller (see `HciSocket::connect(int)`.) The adapter takes
+	// ownership of the socket.
+	//
+	// Returns true on success, otherwise false
+	bool start(int fdSocket);
+
+	// Wakes the HciAdapter run thread and waits for it to join
 	//
 	// This method will block until the thread joins
 	void stop();
 
-	// Sends a command over the HCI socket
+	// Sends a command over the HCI socket and waits for the response
 	//
 	// If the HCI socket is not connected, it will auto-connect prior to sending the command. In the case of a failed auto-connect,
 	// a failure is returned.
@@ -1240,6 +1096,19 @@ public:
 	// Returns true on success, otherwise false
 	bool sendCommand(HciHeader &request);
 
+	// Sends a command over the HCI socket without waiting for the response
+	//
+	// Any number of commands may be in flight at once. Each is matched to its response by command code and controller index
+	// (in the order they were sent), at which point the returned future becomes ready and `callback` (if any) is called. If no
+	// response arrives within `kMaxEventWaitTimeMS`, the command times out with `responded` set to false.
+	//
+	// The adapter processes commands in the order they are sent, so commands that depend on earlier ones may be sent without
+	// waiting for those to complete.
+	//
+	// If the HCI socket is not connected, it will auto-connect prior to sending the command. If the command cannot be sent, the
+	// returned future is ready immediately (and the callback has been called) with `responded` set to false.
+	std::future<CommandResult> sendCommandAsync(HciHeader &request, CommandCallback callback = nullptr);
+
 	// Event processor, responsible for receiving events from the HCI socket
 	//
 	// This mehtod should not be called directly. Rather, it runs continuously on a thread until the server shuts down
@@ -1248,42 +1117,122 @@ public:
 	// TODO: this should register a callback (and deregister during cleanup), for now just give it a way of notifying
 	bool registerEventListener(GGKServerDataSetter const &hack) {hackCallback = hack; return true;}
 
+	// Starts recording the raw traffic on our HCI socket into `pFilename` (see HciRecording.cpp)
+	//
+	// Returns true on success, otherwise false
+	bool startRecording(const char *pFilename) { return hciSocket.startRecording(pFilename); }
+
+	// Finishes the recording in progress, if any
+	void stopRecording() { hciSocket.stopRecording(); }
+
 private:
 	// Private constructor for our Singleton
-	HciAdapter() : commandResponseLock(commandResponseMutex), conditionalValue(-1), activeConnections(0) {}
+	HciAdapter() {}
 
-	// Uses a std::condition_variable to wait for a response event for the given `commandCode` or `timeoutMS` milliseconds.
-	//
-	// Returns true if the response event was received for `commandCode` or false if the timeout expired.
+	// Make sure our timeout worker isn't left running at exit
+	~HciAdapter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(pendingCommandsMutex);
+			stopCommandTimeoutThread = true;
+		}
+		cvPendingCommands.notify_all();
+
+		if (commandTimeoutThread.joinable())
+		{
+			commandTimeoutThread.join();
+		}
+	}
+
+	// A command that has been sent, but has not yet received a response
+	struct PendingCommand
+	{
+		uint16_t commandCode;
+		uint16_t controllerId;
+		uint64_t sentUS;
+		std::chrono::steady_clock::time_point deadline;
+		std::shared_ptr<std::promise<CommandResult>> pPromise;
+		CommandCallback callback;
+	};
+
+	// Completes the oldest pending command matching `commandCode` and `controllerId` with the given status
+	void setCommandResponse(uint16_t commandCode, uint16_t controllerId, uint8_t status);
+
+	// Delivers a result to a pending command's future and callback
+	static void completeCommand(PendingCommand &command, bool responded, uint8_t status);
+
+	// Our timeout worker, which expires pending commands that never receive a response
+	void runCommandTimeoutThread();
+
+	// Views an event of type `T` in place at the front of `packet`, logging it unless `log` is false
 	//
-	// Command responses are set via `setCommandResponse()`
-	bool waitForCommandResponse(uint16_t commandCode, int timeoutMS);
+	// Returns nullptr (after logging an error and counting the event as rejected) if the packet is too short to hold the event
+	template<typename T>
+	static const T *overlayEvent(const HciPacket &packet, bool log = true)
+	{
+		const T *pEvent = packet.overlay<T>();
+		if (nullptr == pEvent)
+		{
+			Logger::error(SSTR << "Invalid event: " << packet.size << " bytes is too short for its type");
+			Stats::increment(Stats::getInstance().hciEventsRejected);
+		}
+		else if (log)
+		{
+			GGK_LOG_INFO(pEvent->debugText());
+		}
+		return pEvent;
+	}
 
-	// Sets the command response and notifies the waiting std::condition_variable (see `waitForCommandResponse`)
-	void setCommandResponse(uint16_t commandCode);
+	// Reports an event to the registered event listener (see `registerEventListener()`), timing the call
+	//
+	// Events of a `type` that an adapter event subscription wants are delivered to it instead, and not reported here.
+	//
+	// Returns the listener's result, or non-zero if no listener is registered (or the event went to a subscription)
+	int notifyEventListener(GGKAdapterEventType type, const char *pName, const void *pData);
 
 	// Our HCI Socket, which allows us to talk directly to the kernel
 	HciSocket hciSocket;
 
 	// Our event thread listens for events coming from the adapter and deals with them appropriately
+	//
+	// There is only one HCI socket (and event thread) for all controllers; each event carries the index of the controller it
+	// is for.
 	static std::thread eventThread;
 
-	// Our adapter information
-	AdapterSettings adapterSettings;
-	ControllerInformation controllerInformation;
+	// The information we track for each controller
+	struct ControllerState
+	{
+		AdapterSettings adapterSettings;
+		ControllerInformation controllerInformation;
+		AdvertisingFeatures advertisingFeatures;
+		LocalName localName;
+		int activeConnections;
+	};
+
+	// Returns the state for a controller, creating it if needed (the caller must hold `controllersMutex`)
+	ControllerState &controllerState(uint16_t controllerIndex) { return controllers[controllerIndex]; }
+
+	// Our controllers, by index
+	std::map<uint16_t, ControllerState> controllers;
+	std::vector<uint16_t> controllerIndexList;
+	mutable std::mutex controllersMutex;
+
+	// Version information isn't specific to a controller
 	VersionInformation versionInformation;
-	AdvertisingFeatures advertisingFeatures;
-	LocalName localName;
 
-	std::condition_variable cvCommandResponse;
-	std::mutex commandResponseMutex;
-	std::unique_lock<std::mutex> commandResponseLock;
-	int conditionalValue;
+	// Our pending commands, in the order they were sent
+	std::list<PendingCommand> pendingCommands;
+	std::mutex pendingCommandsMutex;
+	std::condition_variable cvPendingCommands;
+
+	// Our timeout worker (see `runCommandTimeoutThread()`) runs alongside the event thread
+	std::thread commandTimeoutThread;
+	bool stopCommandTimeoutThread = false;
 
 	GGKServerDataSetter hackCallback = NULL;
 
-	// Our active connection count
-	int activeConnections;
+	// Our active connection count across all controllers
+	int activeConnections = 0;
 };
 
 }; // namespace ggk
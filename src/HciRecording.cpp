@@ -0,0 +1,280 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Recording of the raw Bluetooth Management API stream, and replaying it into HciAdapter
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Event storms seen in the field (such as every client reconnecting at once after a power failure) are hard to reproduce on the
+// bench, which makes the adapter's event thread hard to profile. These classes let us capture the real thing and play it back.
+//
+// `HciRecorder` sits inside `HciSocket` and, while a recording is in progress, writes every packet read from or written to the
+// kernel to a file along with a timestamp. Recording is started with `ggkHciStartRecording()` (or the standalone server's `-r`
+// option.) When no recording is in progress, the cost to the socket is a single relaxed atomic load per packet.
+//
+// `HciReplayer` loads the events from a recording and feeds them to `HciAdapter` through a socket pair, using the adapter's
+// ability to run on an already-connected socket (see `HciAdapter::start(int)`.) Events can be replayed with their original
+// timing, or at maximum speed to find the adapter's throughput. The adapter's event thread times the parsing and dispatch of
+// every event, and every call into the application's data setter, into the server's statistics (see Stats.h); the benchmark's
+// `-r` option replays a recording and reports those costs per event type.
+//
+// The format is deliberately simple (see `HciRecordHeader`) and is written in host byte order, so a recording is intended to be
+// replayed on the same kind of machine it was captured on.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+
+#include "HciRecording.h"
+#include "Logger.h"
+#include "Stats.h"
+
+namespace ggk {
+
+const char HciRecordFormat::kMagic[8] = { 'G', 'G', 'K', 'H', 'C', 'I', 'R', '1' };
+
+// The largest packet we'll accept from a recording (matches the HciSocket's receive buffer)
+static const uint32_t kMaxPacketSize = 64 * 1024;
+
+//
+// HciRecorder
+//
+
+// Starts a new recording in `pFilename`, replacing any recording already in progress
+//
+// Returns true on success, otherwise false
+bool HciRecorder::open(const char *pFilename)
+{
+	close();
+
+	FILE *pNewFile = fopen(pFilename, "wb");
+	if (nullptr == pNewFile)
+	{
+		Logger::error(SSTR << "Unable to create HCI recording '" << pFilename << "': " << strerror(errno));
+		return false;
+	}
+
+	if (fwrite(HciRecordFormat::kMagic, sizeof(HciRecordFormat::kMagic), 1, pNewFile) != 1)
+	{
+		Logger::error(SSTR << "Unable to write HCI recording '" << pFilename << "'");
+		fclose(pNewFile);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(fileMutex);
+	pFile = pNewFile;
+	startUS = Stats::now();
+	recording = true;
+
+	Logger::status(SSTR << "Recording HCI traffic to '" << pFilename << "'");
+	return true;
+}
+
+// Finishes the recording (if any), flushing it to disk
+void HciRecorder::close()
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+	recording = false;
+
+	if (nullptr != pFile)
+	{
+		fclose(pFile);
+		pFile = nullptr;
+		Logger::status("HCI recording finished");
+	}
+}
+
+// Appends a packet to the recording
+void HciRecorder::record(HciRecordFormat::Direction direction, const uint8_t *pData, size_t size)
+{
+	HciRecordHeader header;
+	header.direction = static_cast<uint16_t>(direction);
+	header.reserved = 0;
+	header.length = static_cast<uint32_t>(size);
+
+	std::lock_guard<std::mutex> lock(fileMutex);
+	if (nullptr == pFile)
+	{
+		return;
+	}
+
+	header.timestampUS = Stats::now() - startUS;
+	if (fwrite(&header, sizeof(header), 1, pFile) != 1 || fwrite(pData, 1, size, pFile) != size)
+	{
+		Logger::error("Unable to write to the HCI recording; recording stopped");
+		fclose(pFile);
+		pFile = nullptr;
+		recording = false;
+	}
+}
+
+//
+// HciReplayer
+//
+
+// Loads the events (packets from the controller) from the recording in `pFilename`
+//
+// Returns true on success, otherwise false
+bool HciReplayer::load(const char *pFilename)
+{
+	packets.clear();
+
+	FILE *pFile = fopen(pFilename, "rb");
+	if (nullptr == pFile)
+	{
+		Logger::error(SSTR << "Unable to open HCI recording '" << pFilename << "': " << strerror(errno));
+		return false;
+	}
+
+	char magic[sizeof(HciRecordFormat::kMagic)];
+	if (fread(magic, sizeof(magic), 1, pFile) != 1 || memcmp(magic, HciRecordFormat::kMagic, sizeof(magic)) != 0)
+	{
+		Logger::error(SSTR << "'" << pFilename << "' is not an HCI recording");
+		fclose(pFile);
+		return false;
+	}
+
+	bool result = true;
+	HciRecordHeader header;
+	while (fread(&header, sizeof(header), 1, pFile) == 1)
+	{
+		if (header.length > kMaxPacketSize)
+		{
+			Logger::error(SSTR << "HCI recording '" << pFilename << "' contains an oversized packet (" << header.length << " bytes)");
+			result = false;
+			break;
+		}
+
+		std::vector<uint8_t> data(header.length);
+		if (header.length > 0 && fread(data.data(), header.length, 1, pFile) != 1)
+		{
+			Logger::error(SSTR << "HCI recording '" << pFilename << "' is truncated");
+			result = false;
+			break;
+		}
+
+		// Commands were sent by the adapter; it will send its own when replaying
+		if (header.direction != HciRecordFormat::EFromController)
+		{
+			continue;
+		}
+
+		Packet packet;
+		packet.timestampUS = header.timestampUS;
+		packet.data.swap(data);
+		packets.push_back(std::move(packet));
+	}
+
+	fclose(pFile);
+	return result;
+}
+
+// Starts replaying the loaded events
+//
+// If `maxSpeed` is true, events are sent back-to-back; otherwise the gaps between them are reproduced.
+//
+// Returns the adapter's end of the socket pair, or -1 on failure
+int HciReplayer::start(bool maxSpeed)
+{
+	stop();
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+	{
+		Logger::error(SSTR << "Unable to create the HCI replay socket pair: " << strerror(errno));
+		return -1;
+	}
+
+	fdReplay = fds[1];
+	finished = false;
+	stopping = false;
+	thread = std::thread(&HciReplayer::run, this, maxSpeed);
+	return fds[0];
+}
+
+// Stops replaying and closes our end of the socket pair
+void HciReplayer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(stopMutex);
+		stopping = true;
+	}
+	cvStop.notify_all();
+
+	if (fdReplay >= 0)
+	{
+		shutdown(fdReplay, SHUT_RDWR);
+	}
+
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+
+	if (fdReplay >= 0)
+	{
+		close(fdReplay);
+		fdReplay = -1;
+	}
+}
+
+// Sends the loaded events (runs on our thread)
+void HciReplayer::run(bool maxSpeed)
+{
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	uint64_t firstUS = packets.empty() ? 0 : packets.front().timestampUS;
+
+	for (const Packet &packet : packets)
+	{
+		// Wait for the event's time to come (`stop()` cuts the wait short)
+		if (!maxSpeed)
+		{
+			std::unique_lock<std::mutex> lock(stopMutex);
+			cvStop.wait_until(lock, startTime + std::chrono::microseconds(packet.timestampUS - firstUS), [this] { return stopping.load(); });
+		}
+
+		if (stopping)
+		{
+			break;
+		}
+
+		discardCommands();
+
+		if (send(fdReplay, packet.data.data(), packet.data.size(), 0) < 0)
+		{
+			if (!stopping)
+			{
+				Logger::error(SSTR << "HCI replay stopped: " << strerror(errno));
+			}
+			break;
+		}
+	}
+
+	finished = true;
+}
+
+// Reads and discards anything the adapter has sent us
+void HciReplayer::discardCommands()
+{
+	uint8_t packet[1024];
+	while (recv(fdReplay, packet, sizeof(packet), MSG_DONTWAIT) > 0)
+	{
+	}
+}
+
+}; // namespace ggk
@@ -0,0 +1,154 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Recording of the raw Bluetooth Management API stream, and replaying it into HciAdapter
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of HciRecording.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace ggk {
+
+// The file format shared by the recorder and the replayer
+//
+// A recording starts with `kMagic` and is followed by one record per packet: an `HciRecordHeader` and then the packet's bytes,
+// exactly as they crossed the socket. Header fields are in host byte order.
+struct HciRecordFormat
+{
+	// Identifies a recording (and its version)
+	static const char kMagic[8];
+
+	// Which way a packet was travelling
+	enum Direction
+	{
+		EFromController = 0,
+		EToController = 1
+	};
+};
+
+// The header that precedes each packet in a recording
+struct HciRecordHeader
+{
+	// Microseconds since the recording started
+	uint64_t timestampUS;
+
+	// An `HciRecordFormat::Direction`
+	uint16_t direction;
+	uint16_t reserved;
+
+	// The number of bytes of packet data that follow
+	uint32_t length;
+};
+
+// Writes the packets passing through an HciSocket to a recording
+//
+// Packets may be recorded from any thread; the event thread records what it reads while commands are recorded from whichever
+// thread sends them.
+class HciRecorder
+{
+public:
+	~HciRecorder() { close(); }
+
+	// Starts a new recording in `pFilename`, replacing any recording already in progress
+	//
+	// Returns true on success, otherwise false
+	bool open(const char *pFilename);
+
+	// Finishes the recording (if any), flushing it to disk
+	void close();
+
+	// Returns true if a recording is in progress
+	//
+	// This is a single relaxed load, so callers can cheaply skip `record()` when nothing is being recorded.
+	bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+	// Appends a packet to the recording
+	void record(HciRecordFormat::Direction direction, const uint8_t *pData, size_t size);
+
+private:
+
+	std::atomic<bool> recording{false};
+	std::mutex fileMutex;
+	FILE *pFile = nullptr;
+	uint64_t startUS = 0;
+};
+
+// Replays the controller's side of a recording into HciAdapter
+//
+// The replayer stands in for the kernel's HCI control socket: `start()` returns one end of a socket pair to be passed to
+// `HciAdapter::start(int)`, and a thread writes the recorded events into the other end, either with their original timing or
+// as fast as the adapter will take them. Anything the adapter sends is read and discarded.
+class HciReplayer
+{
+public:
+	// A recorded packet
+	struct Packet
+	{
+		uint64_t timestampUS;
+		std::vector<uint8_t> data;
+	};
+
+	~HciReplayer() { stop(); }
+
+	// Loads the events (packets from the controller) from the recording in `pFilename`
+	//
+	// Returns true on success, otherwise false
+	bool load(const char *pFilename);
+
+	// Returns the loaded events, in the order they were recorded
+	const std::vector<Packet> &getPackets() const { return packets; }
+
+	// Starts replaying the loaded events
+	//
+	// If `maxSpeed` is true, events are sent back-to-back; otherwise the gaps between them are reproduced.
+	//
+	// Returns the adapter's end of the socket pair, or -1 on failure
+	int start(bool maxSpeed);
+
+	// Returns true once every event has been sent (or the replay was stopped)
+	bool isFinished() const { return finished.load(); }
+
+	// Stops replaying and closes our end of the socket pair
+	void stop();
+
+private:
+
+	// Sends the loaded events (runs on our thread)
+	void run(bool maxSpeed);
+
+	// Reads and discards anything the adapter has sent us
+	void discardCommands();
+
+	std::vector<Packet> packets;
+	std::atomic<bool> finished{false};
+	std::atomic<bool> stopping{false};
+	std::mutex stopMutex;
+	std::condition_variable cvStop;
+	int fdReplay = -1;
+	std::thread thread;
+};
+
+}; // namespace ggk
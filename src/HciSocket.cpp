@@ -34,6 +34,8 @@
 #include <bluetooth/hci.h>
 #include <thread>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include "HciSocket.h"
 #include "Logger.h"
@@ -43,8 +45,14 @@ namespace ggk {
 
 // Initializes an unconnected socket
 HciSocket::HciSocket()
-: fdSocket(-1)
+: fdSocket(-1), fdEpoll(-1), fdShutdown(-1)
 {
+	// Our shutdown event lives as long as we do, so that it can be signalled safely at any time
+	fdShutdown = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fdShutdown < 0)
+	{
+		logErrno("HciSocket(eventfd)");
+	}
 }
 
 // Socket destructor
@@ -53,6 +61,12 @@ HciSocket::HciSocket()
 HciSocket::~HciSocket()
 {
 	disconnect();
+
+	if (fdShutdown >= 0)
+	{
+		close(fdShutdown);
+		fdShutdown = -1;
+	}
 }
 
 // Connects to an HCI socket using the Bluetooth Management API protocol
@@ -82,6 +96,83 @@ bool HciSocket::connect()
 		return false;
 	}
 
+	return prepareConnection();
+}
+
+// Takes ownership of an already-connected socket in place of the kernel's HCI control socket
+//
+// The socket must deliver one complete Management API packet per read (such as one end of a `SOCK_SEQPACKET` socket pair.) This
+// allows the adapter to be driven by a simulated controller, for benchmarking and testing without Bluetooth hardware.
+//
+// Returns true on success, otherwise false (in which case the socket is closed)
+bool HciSocket::connect(int fd)
+{
+	disconnect();
+
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// We wait with epoll and expect reads to never block
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+	{
+		logErrno("Connect(fcntl)");
+		close(fd);
+		return false;
+	}
+
+	fdSocket = fd;
+	return prepareConnection();
+}
+
+// Completes a connection to `fdSocket`, preparing to wait on it for data
+//
+// Returns true on success, otherwise false (in which case we are disconnected)
+bool HciSocket::prepareConnection()
+{
+	// Clear any previous shutdown request
+	if (fdShutdown >= 0)
+	{
+		eventfd_t value;
+		eventfd_read(fdShutdown, &value);
+	}
+
+	// Build our epoll set, so that we can sleep until there is data or a shutdown request
+	fdEpoll = epoll_create1(EPOLL_CLOEXEC);
+	if (fdEpoll < 0)
+	{
+		logErrno("Connect(epoll_create1)");
+		disconnect();
+		return false;
+	}
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fdSocket;
+	if (epoll_ctl(fdEpoll, EPOLL_CTL_ADD, fdSocket, &event) < 0)
+	{
+		logErrno("Connect(epoll_ctl socket)");
+		disconnect();
+		return false;
+	}
+
+	if (fdShutdown >= 0)
+	{
+		event.data.fd = fdShutdown;
+		if (epoll_ctl(fdEpoll, EPOLL_CTL_ADD, fdShutdown, &event) < 0)
+		{
+			logErrno("Connect(epoll_ctl eventfd)");
+			disconnect();
+			return false;
+		}
+	}
+
+	// Allocate our receive buffer once, up front
+	receiveBuffer.resize(kResponseMaxSize);
+
 	Logger::info(SSTR << "Connected to HCI control socket (fd = " << fdSocket << ")");
 
 	return true;
@@ -108,27 +199,49 @@ void HciSocket::disconnect()
 		fdSocket = -1;
 		Logger::trace("HciSocket closed");
 	}
+
+	if (fdEpoll >= 0)
+	{
+		close(fdEpoll);
+		fdEpoll = -1;
+	}
+}
+
+// Wakes any thread waiting in `read()`, causing it to return false immediately
+//
+// This is safe to call from any thread. The request remains in effect until the next call to `connect()`, so a reader that
+// has not yet started waiting will return immediately as well.
+void HciSocket::requestShutdown() const
+{
+	if (fdShutdown >= 0 && eventfd_write(fdShutdown, 1) < 0)
+	{
+		logErrno("requestShutdown(eventfd_write)");
+	}
 }
 
 // Reads data from the HCI socket
 //
-// Raw data is read and returned in `response`.
+// Raw data is read into our receive buffer, and `packet` is set to view it in place (until the next read.)
 //
 // Returns true if data was read successfully, otherwise false is returned. A false return code does not necessarily depict
 // an error, as this can arise from expected conditions (such as an interrupt.)
-bool HciSocket::read(std::vector<uint8_t> &response) const
+bool HciSocket::read(HciPacket &packet) const
 {
-	// Fill our response with empty data
-	response.resize(kResponseMaxSize, 0);
+	packet = HciPacket();
 
-	// Wait for data or a cancellation
-	if (!waitForDataOrShutdown())
+	ssize_t bytesRead;
+	do
 	{
-		return false;
-	}
+		// Wait for data or a cancellation
+		if (!waitForDataOrShutdown())
+		{
+			return false;
+		}
 
-	// Block until we receive data, a disconnect, or a signal
-	ssize_t bytesRead = ::recv(fdSocket, &response[0], kResponseMaxSize, MSG_WAITALL);
+		// Receive the packet (the socket is non-blocking, and the mgmt channel delivers one complete packet per call.) If the
+		// data was already consumed, we simply go back to waiting.
+		bytesRead = ::recv(fdSocket, receiveBuffer.data(), receiveBuffer.size(), 0);
+	} while (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
 
 	// If there was an error, wipe the data and return an error condition
 	if (bytesRead < 0)
@@ -141,31 +254,33 @@ bool HciSocket::read(std::vector<uint8_t> &response) const
 		{
 			logErrno("recv");
 		}
-		response.resize(0);
 		return false;
 	}
 	else if (bytesRead == 0)
 	{
 		Logger::error("Peer closed the socket");
-		response.resize(0);
 		return false;
 	}
 
-	// We have data
-	response.resize(bytesRead);
+	// We have data, which stays right where we received it
+	packet = HciPacket(receiveBuffer.data(), static_cast<size_t>(bytesRead));
 
-	std::string dump = "";
-	dump += "  > Read " + std::to_string(response.size()) + " bytes\n";
-	// dump += Utils::hex(response.data(), response.size());
-	Logger::info(dump);
+	if (recorder.isRecording())
+	{
+		recorder.record(HciRecordFormat::EFromController, packet.pData, packet.size);
+	}
+
+	GGK_LOG_INFO("  > Read " << packet.size << " bytes");
 
 	return true;
 }
 
 // Writes the array of bytes of a given count
 //
+// The buffer is written directly from the caller's vector, without being copied.
+//
 // This method returns true if the bytes were written successfully, otherwise false
-bool HciSocket::write(std::vector<uint8_t> buffer) const
+bool HciSocket::write(const std::vector<uint8_t> &buffer) const
 {
 	return write(buffer.data(), buffer.size());
 }
@@ -175,10 +290,7 @@ bool HciSocket::write(std::vector<uint8_t> buffer) const
 // This method returns true if the bytes were written successfully, otherwise false
 bool HciSocket::write(const uint8_t *pBuffer, size_t count) const
 {
-	std::string dump = "";
-	dump += "  > Writing " + std::to_string(count) + " bytes\n";
-	// dump += Utils::hex(pBuffer, count);
-	Logger::info(dump);
+	GGK_LOG_INFO("  > Writing " << count << " bytes");
 
 	size_t len = ::write(fdSocket, pBuffer, count);
 
@@ -188,34 +300,72 @@ bool HciSocket::write(const uint8_t *pBuffer, size_t count) const
 		return false;
 	}
 
+	if (recorder.isRecording())
+	{
+		recorder.record(HciRecordFormat::EToController, pBuffer, count);
+	}
+
 	return true;
 }
 
+// Starts recording every packet read from or written to the socket into `pFilename` (see HciRecording.cpp)
+//
+// A recording may be started before connecting and continues across reconnections until `stopRecording()` is called.
+//
+// Returns true on success, otherwise false
+bool HciSocket::startRecording(const char *pFilename)
+{
+	return recorder.open(pFilename);
+}
+
+// Finishes the recording in progress, if any
+void HciSocket::stopRecording()
+{
+	recorder.close();
+}
+
 // Wait for data to arrive, or for a shutdown event
 //
 // Returns true if data is available, false if we are shutting down
+//
+// We sleep in epoll_wait() with no timeout; a shutdown request (see `requestShutdown()`) wakes us immediately.
 bool HciSocket::waitForDataOrShutdown() const
 {
-	while(ggkIsServerRunning())
+	while(ggkIsServerRunning() && fdEpoll >= 0)
 	{
-		fd_set rfds;
-		FD_ZERO(&rfds);
-		FD_SET(fdSocket, &rfds);
-
-		struct timeval tv;
-		tv.tv_sec = 0;
-		tv.tv_usec = kDataWaitTimeMS * 1000;
-
-		int retval = select(fdSocket+1, &rfds, NULL, NULL, &tv);
+		struct epoll_event events[2];
+		int count = epoll_wait(fdEpoll, events, 2, -1);
 
-		// Do we have data?
-		if (retval > 0) { return true; }
+		// Interrupted by a signal; check our state and keep waiting
+		if (count < 0 && errno == EINTR) { continue; }
 
 		// We have an error
-		if (retval < 0) { return false; }
+		if (count < 0)
+		{
+			logErrno("epoll_wait");
+			return false;
+		}
+
+		bool dataReady = false;
+		for (int i = 0; i < count; ++i)
+		{
+			// A shutdown request takes priority over any data
+			if (events[i].data.fd == fdShutdown) { return false; }
+
+			if (events[i].data.fd == fdSocket)
+			{
+				// The socket was closed or has an error
+				if ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0 && (events[i].events & EPOLLIN) == 0)
+				{
+					Logger::error("HciSocket error or hang-up while waiting for data");
+					return false;
+				}
+
+				dataReady = true;
+			}
+		}
 
-		// No data; keep waiting
-		continue;
+		if (dataReady) { return true; }
 	}
 
 	return false;
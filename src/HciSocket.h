@@ -26,8 +26,35 @@
 #include <stdint.h>
 #include <vector>
 
+#include "HciRecording.h"
+
 namespace ggk {
 
+// A non-owning view of a packet received from the HCI socket (see `HciSocket::read()`)
+//
+// The bytes belong to the socket's receive buffer, so a packet is only valid until the next read.
+struct HciPacket
+{
+	const uint8_t *pData;
+	size_t size;
+
+	HciPacket() : pData(nullptr), size(0) {}
+	HciPacket(const uint8_t *pData, size_t size) : pData(pData), size(size) {}
+
+	// Returns the bytes at `offset` viewed in place as a (packed) `T`, or nullptr if the packet is too short to hold one
+	template<typename T>
+	const T *overlay(size_t offset = 0) const
+	{
+		return offset <= size && size - offset >= sizeof(T) ? reinterpret_cast<const T *>(pData + offset) : nullptr;
+	}
+
+	// Returns a view of the bytes following the first `offset` (which is empty if the packet is no longer than `offset`)
+	HciPacket from(size_t offset) const
+	{
+		return offset < size ? HciPacket(pData + offset, size - offset) : HciPacket(pData + size, 0);
+	}
+};
+
 class HciSocket
 {
 public:
@@ -44,32 +71,63 @@ public:
 	// Returns true on success, otherwise false
 	bool connect();
 
+	// Takes ownership of an already-connected socket in place of the kernel's HCI control socket
+	//
+	// The socket must deliver one complete Management API packet per read (such as one end of a `SOCK_SEQPACKET` socket pair.)
+	// This allows the adapter to be driven by a simulated controller, for benchmarking and testing without Bluetooth hardware.
+	//
+	// Returns true on success, otherwise false (in which case the socket is closed)
+	bool connect(int fd);
+
 	// Returns true if the socket is currently connected, otherwise false
 	bool isConnected() const;
 
 	// Disconnects from the HCI socket
 	void disconnect();
 
+	// Wakes any thread waiting in `read()`, causing it to return false immediately
+	//
+	// This is safe to call from any thread. The request remains in effect until the next call to `connect()`, so a reader that
+	// has not yet started waiting will return immediately as well.
+	void requestShutdown() const;
+
 	// Reads data from the HCI socket
 	//
-	// Raw data is read until no more data is available. If no data is available when this method initially starts to read, it will
-	// retry for a maximum timeout defined by `kMaxRetryTimeMS`.
+	// This method sleeps until data arrives or a shutdown is requested (see `requestShutdown()`.) Data is received into a buffer
+	// that is allocated once, and `packet` is set to view the bytes received in place. The packet is valid until the next read.
 	//
-	// Returns true if any data was read successfully, otherwise false is returned in the case of an error or a timeout.
-	bool read(std::vector<uint8_t> &response) const;
+	// Returns true if any data was read successfully, otherwise false is returned in the case of an error or a shutdown.
+	bool read(HciPacket &packet) const;
 
 	// Writes the array of bytes of a given count
 	//
+	// The buffer is written directly from the caller's vector, without being copied.
+	//
 	// This method returns true if the bytes were written successfully, otherwise false
-	bool write(std::vector<uint8_t> buffer) const;
+	bool write(const std::vector<uint8_t> &buffer) const;
 
 	// Writes the array of bytes of a given count
 	//
 	// This method returns true if the bytes were written successfully, otherwise false
 	bool write(const uint8_t *pBuffer, size_t count) const;
 
+	// Starts recording every packet read from or written to the socket into `pFilename` (see HciRecording.cpp)
+	//
+	// A recording may be started before connecting and continues across reconnections until `stopRecording()` is called.
+	//
+	// Returns true on success, otherwise false
+	bool startRecording(const char *pFilename);
+
+	// Finishes the recording in progress, if any
+	void stopRecording();
+
 private:
 
+	// Completes a connection to `fdSocket`, preparing to wait on it for data
+	//
+	// Returns true on success, otherwise false (in which case we are disconnected)
+	bool prepareConnection();
+
 	// Wait for data to arrive, or for a shutdown event
 	//
 	// Returns true if data is available, false if we are shutting down
@@ -80,8 +138,17 @@ private:
 
 	int	fdSocket;
 
+	// We wait on an epoll set containing the socket and an eventfd that is signalled to request a shutdown
+	int fdEpoll;
+	int fdShutdown;
+
 	const size_t kResponseMaxSize = 64 * 1024;
-	const int kDataWaitTimeMS = 10;
+
+	// The buffer we receive into, allocated once (at `kResponseMaxSize`) when we connect
+	mutable std::vector<uint8_t> receiveBuffer;
+
+	// Records our traffic when requested (see `startRecording()`)
+	mutable HciRecorder recorder;
 };
 
 }; // namespace ggk
\ No newline at end of file
@@ -33,11 +33,14 @@
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <gio/gio.h>
+#include <glib-unix.h>
 #include <string>
 #include <vector>
+#include <deque>
+#include <tuple>
 #include <atomic>
-#include <chrono>
-#include <thread>
+#include <mutex>
+#include <algorithm>
 
 #include "Server.h"
 #include "Globals.h"
@@ -47,7 +50,12 @@
 #include "DBusInterface.h"
 #include "GattCharacteristic.h"
 #include "GattProperty.h"
+#include "ServerUtils.h"
 #include "Logger.h"
+#include "Stats.h"
+#include "WorkerPool.h"
+#include "Sessions.h"
+#include "DataStore.h"
 #include "Init.h"
 
 namespace ggk {
@@ -58,7 +66,6 @@ namespace ggk {
 
 static const int kPeriodicTimerFrequencySeconds = 1;
 static const int kRetryDelaySeconds = 2;
-static const int kIdleFrequencyMS = 10;
 
 //
 // Retries
@@ -66,6 +73,28 @@ static const int kIdleFrequencyMS = 10;
 
 static time_t retryTimeStart = 0;
 
+//
+// Startup timing
+//
+
+static gint64 startupTimeStart = 0;
+
+//
+// Introspection
+//
+
+// A root object's introspection XML along with its parsed node info
+//
+// These are generated the first time we register with D-Bus and kept across retries and restarts (see `registerObjects()`.)
+struct IntrospectionCacheEntry
+{
+	std::string xml;
+	GDBusNodeInfo *pNode;
+};
+
+static std::vector<IntrospectionCacheEntry> introspectionCache;
+static std::weak_ptr<Server> introspectedServer;
+
 //
 // Adapter configuration
 //
@@ -73,12 +102,24 @@ static time_t retryTimeStart = 0;
 GDBusConnection *pBusConnection = nullptr;
 static guint ownedNameId = 0;
 static guint periodicTimeoutId = 0;
+static guint eventTimeoutId = 0;
 static std::vector<guint> registeredObjectIds;
 static std::atomic<GMainLoop *> pMainLoop(nullptr);
+
+// The main context the server runs on, holding a reference while the server is started
+//
+// Other threads wake this context and add sources to it (see `wakeUpdateQueue()` and `addServerSource()`) while the server may be
+// releasing it, so they only use it with `serverContextMutex` held. The server's own thread, which is the only one to set it, may
+// read it without the lock.
+static GMainContext *pServerContext = nullptr;
+static std::mutex serverContextMutex;
+static bool bServerAttached = false;
+static guint attachedInitTimeoutId = 0;
+static GSource *pUpdateQueueSource = nullptr;
+static guint dataStoreDoorbellId = 0;
 static GDBusObjectManager *pBluezObjectManager = nullptr;
 static GDBusObject *pBluezAdapterObject = nullptr;
 static GDBusObject *pBluezDeviceObject = nullptr;
-static GDBusProxy *pBluezGattManagerProxy = nullptr;
 //static GDBusProxy *pBluezAdapterInterfaceProxy = nullptr;
 static GDBusProxy *pBluezDeviceInterfaceProxy = nullptr;
 static GDBusProxy *pBluezAdapterPropertiesInterfaceProxy = nullptr;
@@ -87,12 +128,40 @@ static bool bAdapterConfigured = false;
 static bool bApplicationRegistered = false;
 static std::string bluezGattManagerInterfaceName = "";
 
+// A BlueZ adapter (controller) that we configure and publish our GATT application on
+//
+// The first adapter found is always used. If the server enables all adapters (see `Server::getEnableAllAdapters()`), every
+// adapter with a GATT manager is used.
+struct BluezAdapter
+{
+	std::string objectPath;
+	uint16_t controllerIndex;
+	GDBusProxy *pGattManagerProxy;
+	bool bConfigured;
+	bool bRegistrationPending;
+	bool bApplicationRegistered;
+
+	// The advertising we last configured (see `configureController()`), so that we don't re-send it unnecessarily
+	bool bAdvertisingApplied;
+	bool bAppliedAdvertisingState;
+	std::string appliedAdvertisingName;
+	std::string appliedAdvertisingShortName;
+};
+static std::vector<BluezAdapter> bluezAdapters;
+
 //
 // Externs
 //
 
 extern void setServerRunState(enum GGKServerRunState newState);
 extern void setServerHealth(enum GGKServerHealth newHealth);
+extern int beginUpdatePass(GGKUpdatePriority *pOrder);
+extern void endUpdatePass();
+extern int popUpdateQueueBatch(GGKUpdatePriority priority, std::deque<std::tuple<std::string, std::string>> &batch, int &budget);
+extern int popUpdateHandleBatch(GGKUpdatePriority priority, std::vector<const GattCharacteristic *> &batch, int &budget);
+extern bool updateHandleRingIsEmpty();
+extern void resetUpdateHandles();
+extern void indexUpdatePriorities(const Server *pServer);
 
 //
 // Forward declarations
@@ -100,6 +169,7 @@ extern void setServerHealth(enum GGKServerHealth newHealth);
 
 static void initializationStateProcessor();
 static void unConfigureAdapter();
+static void stopEventTimer();
 // ---------------------------------------------------------------------------------------------------------------------------------
 //  ___    _ _           __      _       _                                             _
 // |_ _|__| | | ___     / /   __| | __ _| |_ __ _    _ __  _ __ ___   ___ ___  ___ ___(_)_ __   __ _
@@ -116,48 +186,110 @@ static void unConfigureAdapter();
 // entry represents an interface that needs to be updated. The idleFunc calls the interface's `onUpdatedValue` method for each
 // update.
 //
-// The idle processor will perform one update per idle tick, however, it will notify that there is more data so the idle ticks
-// do not lag behind.
+// Rather than polling the queue from an idle callback, we attach a custom GSource to the main context. The source only reports
+// itself as ready when the server is running and the queue has entries. `ggkPushUpdateQueue` wakes the main context after adding
+// an entry (see `wakeUpdateQueue()`) so updates are dispatched immediately, while an empty queue leaves the main loop sleeping in
+// poll() rather than spinning.
+//
+// Updates can also arrive through registered update handles (see `ggkRegisterUpdateHandle()`), which are pushed onto a lock-free
+// ring buffer as integers. These have their characteristic resolved at registration time, so there's nothing to look up here.
+//
+// Each dispatch drains a batch of updates, taken from the queue under a single lock (see `ggkUpdateQueueSetMaxBatchSize()` to
+// bound the batch size.) If entries remain, the source stays ready, so the main loop keeps dispatching without lagging behind,
+// but other sources (D-Bus, timers) still get their turn between batches.
+//
+// Updates are queued in priority classes (see `GGKUpdatePriority`). Each batch is filled from the highest class first, taking
+// that class's handle updates and then its queued updates before moving on to the next, so urgent updates are never stuck
+// behind a burst of less important ones. A class left waiting for several passes is serviced first (see `beginUpdatePass()`.)
+//
+// Characteristics may limit how often their updates are processed (see `GattCharacteristic::notifyPolicy()`.) Updates that
+// arrive too soon are deferred, and the source's timeout is set to wake the main loop when the earliest of them is due.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-// Our idle function
+// Characteristics that have deferred updates (see `GattCharacteristic::notifyPolicy()`), each listed once
 //
-// This method is used to process data on the same thread as our main loop. This allows us to communicate with our service from
-// the outside.
-//
-// IMPORTANT: This method must return 'true' if any work was performed, otherwise it must return 'false'. Returning 'true' will
-// cause the idle loop to continue to call this method to process data at the maximum rate (which can peg the CPU at 100%.) By
-// returning false when there is no work to do, we are nicer to the system.
-bool idleFunc(void *pUserData)
+// This is only accessed from the main loop's thread.
+static std::vector<const GattCharacteristic *> deferredUpdateCharacteristics;
+
+// Process an update for a characteristic, honoring its notification policy
+static void processCharacteristicUpdate(const GattCharacteristic &characteristic, void *pUserData)
 {
+	Stats::increment(Stats::getInstance().updatesProcessed);
 
-	// Don't do anything unless we're running
-	if (ggkGetServerRunState() != ERunning)
+	if (characteristic.admitUpdate(g_get_monotonic_time()))
 	{
-		return false;
+		characteristic.callOnUpdatedValue(pBusConnection, pUserData);
+		return;
 	}
 
-	// Try to get an update
-	const int kQueueEntryLen = 1024;
-	char queueEntry[kQueueEntryLen];
-	if (ggkPopUpdateQueue(queueEntry, kQueueEntryLen, 0) != 1)
+	Stats::increment(Stats::getInstance().notificationsDeferred);
+
+	// Deferred - make sure we'll come back for it
+	if (std::find(deferredUpdateCharacteristics.begin(), deferredUpdateCharacteristics.end(), &characteristic) == deferredUpdateCharacteristics.end())
 	{
-		return false;
+		deferredUpdateCharacteristics.push_back(&characteristic);
 	}
+}
 
-	std::string entryString = queueEntry;
-	auto token = entryString.find('|');
-	if (token == std::string::npos)
+// Process any deferred updates that are now due
+//
+// Returns 'true' if any updates were processed, otherwise 'false'.
+static bool processDeferredUpdates(void *pUserData)
+{
+	bool processed = false;
+	gint64 now = g_get_monotonic_time();
+	for (auto it = deferredUpdateCharacteristics.begin(); it != deferredUpdateCharacteristics.end();)
 	{
-		Logger::error("Queue entry was not formatted properly - could not find separating token");
-		return false;
+		const GattCharacteristic *pCharacteristic = *it;
+		if (pCharacteristic->takeDeferredUpdate(now))
+		{
+			pCharacteristic->callOnUpdatedValue(pBusConnection, pUserData);
+			processed = true;
+		}
+
+		if (pCharacteristic->getDeferredUpdateTime() < 0)
+		{
+			it = deferredUpdateCharacteristics.erase(it);
+		}
+		else
+		{
+			++it;
+		}
 	}
 
-	DBusObjectPath objectPath = DBusObjectPath(entryString.substr(0, token));
-	std::string interfaceName = entryString.substr(token+1);
+	return processed;
+}
+
+// Returns the number of milliseconds until the earliest deferred update is due (0 if one is due now), or -1 if there are none
+static gint deferredUpdateTimeoutMS()
+{
+	gint64 earliest = -1;
+	for (const GattCharacteristic *pCharacteristic : deferredUpdateCharacteristics)
+	{
+		gint64 due = pCharacteristic->getDeferredUpdateTime();
+		if (due >= 0 && (earliest < 0 || due < earliest))
+		{
+			earliest = due;
+		}
+	}
+
+	if (earliest < 0)
+	{
+		return -1;
+	}
 
+	// Round up, so we don't wake just before it's due
+	gint64 remainingUS = earliest - g_get_monotonic_time();
+	return remainingUS <= 0 ? 0 : static_cast<gint>((remainingUS + 999) / 1000);
+}
+
+// Process a single update for the interface at the given path
+//
+// Returns 'true' if the update was processed, otherwise 'false'.
+static bool processUpdate(const std::string &objectPath, const std::string &interfaceName, void *pUserData)
+{
 	// We have an update - call the onUpdatedValue method on the interface
-	std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(objectPath, interfaceName);
+	std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(objectPath.c_str(), interfaceName.c_str());
 	if (nullptr == pInterface)
 	{
 		Logger::warn(SSTR << "Unable to find interface for update: path[" << objectPath << "], name[" << interfaceName << "]");
@@ -167,8 +299,8 @@ bool idleFunc(void *pUserData)
 		// Is it a characteristic?
 		if (std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic))
 		{
-			Logger::info(SSTR << "Processing updated value for interface '" << interfaceName << "' at path '" << objectPath << "'");
-			pCharacteristic->callOnUpdatedValue(pBusConnection, pUserData);
+			GGK_LOG_INFO("Processing updated value for interface '" << interfaceName << "' at path '" << objectPath << "'");
+			processCharacteristicUpdate(*pCharacteristic, pUserData);
 			return true;
 		}
 	}
@@ -176,6 +308,181 @@ bool idleFunc(void *pUserData)
 	return false;
 }
 
+// Our idle function
+//
+// This method is used to process data on the same thread as our main loop. This allows us to communicate with our service from
+// the outside.
+//
+// Returns 'true' if any updates were processed, otherwise 'false'.
+bool idleFunc(void *pUserData)
+{
+	// Don't do anything unless we're running
+	if (ggkGetServerRunState() != ERunning)
+	{
+		return false;
+	}
+
+	bool processed = false;
+
+	// Every change notification sent during this pass is sent together at the end of it, with only the latest value of each
+	// characteristic
+	GattCharacteristic::NotificationBatch notificationBatch;
+
+	// Process a batch of updates, one priority class at a time
+	//
+	// The batches are kept between calls so that their storage is reused (the queue's batch is swapped with the queue) rather
+	// than reallocated
+	static std::vector<const GattCharacteristic *> handleBatch;
+	static std::deque<std::tuple<std::string, std::string>> batch;
+	GGKUpdatePriority order[EUpdatePriorityLow + 1];
+	int budget = beginUpdatePass(order);
+	for (GGKUpdatePriority priority : order)
+	{
+		// Updates from registered update handles
+		if (popUpdateHandleBatch(priority, handleBatch, budget) != 0)
+		{
+			for (const GattCharacteristic *pCharacteristic : handleBatch)
+			{
+				processCharacteristicUpdate(*pCharacteristic, pUserData);
+			}
+
+			processed = true;
+		}
+
+		// Updates from the update queue
+		if (popUpdateQueueBatch(priority, batch, budget) != 0)
+		{
+			// The oldest entry is at the back
+			for (auto it = batch.rbegin(); it != batch.rend(); ++it)
+			{
+				processed = processUpdate(std::get<0>(*it), std::get<1>(*it), pUserData) || processed;
+			}
+
+			batch.clear();
+		}
+	}
+	endUpdatePass();
+
+	// Catch up on any deferred updates that have come due
+	if (!deferredUpdateCharacteristics.empty())
+	{
+		processed = processDeferredUpdates(pUserData) || processed;
+	}
+
+	return processed;
+}
+
+// Returns true if the update queue source has work to dispatch
+static bool updateQueueSourceReady()
+{
+	return ggkGetServerRunState() == ERunning && (!updateHandleRingIsEmpty() || ggkUpdateQueueIsEmpty() == 0 || 0 == deferredUpdateTimeoutMS());
+}
+
+// The GSource callbacks for our update queue source
+//
+// The source is woken explicitly by `wakeUpdateQueue()` whenever an entry is pushed. The only timeout we need is for deferred
+// updates.
+static GSourceFuncs updateQueueSourceFuncs =
+{
+	// gboolean (*prepare)(GSource *source, gint *timeout_)
+	[](GSource * /*pSource*/, gint *pTimeout) -> gboolean
+	{
+		*pTimeout = ggkGetServerRunState() == ERunning ? deferredUpdateTimeoutMS() : -1;
+		return updateQueueSourceReady() ? TRUE : FALSE;
+	},
+
+	// gboolean (*check)(GSource *source)
+	[](GSource * /*pSource*/) -> gboolean
+	{
+		return updateQueueSourceReady() ? TRUE : FALSE;
+	},
+
+	// gboolean (*dispatch)(GSource *source, GSourceFunc callback, gpointer user_data)
+	[](GSource * /*pSource*/, GSourceFunc /*callback*/, gpointer pUserData) -> gboolean
+	{
+		idleFunc(pUserData);
+
+		// Always continue so our source remains in tact
+		return G_SOURCE_CONTINUE;
+	},
+
+	nullptr,                            // void (*finalize)(GSource *source)
+	nullptr,                            // GSourceFunc closure_callback
+	nullptr                             // GSourceDummyMarshal closure_marshal
+};
+
+// Answers the shared data store's doorbell, scheduling updates for the slots producers have written (see DataStore.cpp)
+static gboolean onDataStoreDoorbell(gint /*doorbellFd*/, GIOCondition /*condition*/, gpointer /*pUserData*/)
+{
+	DataStore::getInstance().serviceDoorbell();
+	return G_SOURCE_CONTINUE;
+}
+
+// Sets the main context the server runs on, taking a reference to it, or releases it if `pContext` is nullptr
+//
+// This must only be called from the server's thread.
+static void setServerContext(GMainContext *pContext)
+{
+	GMainContext *pOldContext = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(serverContextMutex);
+		pOldContext = pServerContext;
+		pServerContext = nullptr != pContext ? g_main_context_ref(pContext) : nullptr;
+	}
+
+	if (nullptr != pOldContext)
+	{
+		g_main_context_unref(pOldContext);
+	}
+}
+
+// Wakes the main loop so that any newly queued updates are dispatched immediately
+//
+// This method is thread-safe and is called by `ggkPushUpdateQueue()` and `ggkNotifyHandle()` after adding an entry. If the server
+// isn't started, there is no main loop to wake and this does nothing (the update queue source looks at the queue once it's added.)
+void wakeUpdateQueue()
+{
+	std::lock_guard<std::mutex> lock(serverContextMutex);
+	if (nullptr != pServerContext)
+	{
+		g_main_context_wakeup(pServerContext);
+	}
+}
+
+// Attaches `pSource` to the server's main context, calling `func` when it is dispatched, and returns its ID
+//
+// The context takes over our reference to the source. This method is thread-safe. If the server isn't started, the source is
+// released without being attached and 0 is returned.
+guint addServerSource(GSource *pSource, GSourceFunc func, gpointer pUserData)
+{
+	g_source_set_callback(pSource, func, pUserData, nullptr);
+
+	guint id = 0;
+	{
+		std::lock_guard<std::mutex> lock(serverContextMutex);
+		if (nullptr != pServerContext)
+		{
+			id = g_source_attach(pSource, pServerContext);
+		}
+	}
+
+	g_source_unref(pSource);
+	return id;
+}
+
+// Removes a source added with `addServerSource()`
+//
+// Unlike `g_source_remove()`, this finds the source in the server's main context rather than the global default context.
+void removeServerSource(guint id)
+{
+	std::lock_guard<std::mutex> lock(serverContextMutex);
+	GSource *pSource = nullptr != pServerContext ? g_main_context_find_source_by_id(pServerContext, id) : nullptr;
+	if (nullptr != pSource)
+	{
+		g_source_destroy(pSource);
+	}
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 //  ____       _       _ _   _       _ _          _   _
 // |  _ \  ___(_)_ __ (_) |_(_) __ _| (_)______ _| |_(_) ___  _ ___
@@ -189,6 +496,9 @@ bool idleFunc(void *pUserData)
 // Perform final cleanup of various resources that were allocated while the server was initialized and/or running
 void uninit()
 {
+	// Let any method calls still waiting on worker threads run (and reply) while our objects are still registered
+	WorkerPool::getInstance().stop();
+
 	if (nullptr != pBluezAdapterObject)
 	{
 		g_object_unref(pBluezAdapterObject);
@@ -219,11 +529,14 @@ void uninit()
 		pBluezAdapterPropertiesInterfaceProxy = nullptr;
 	}
 
-	if (nullptr != pBluezGattManagerProxy)
+	for (BluezAdapter &adapter : bluezAdapters)
 	{
-		g_object_unref(pBluezGattManagerProxy);
-		pBluezGattManagerProxy = nullptr;
+		if (nullptr != adapter.pGattManagerProxy)
+		{
+			g_object_unref(adapter.pGattManagerProxy);
+		}
 	}
+	bluezAdapters.clear();
 
 	if (nullptr != pBluezObjectManager)
 	{
@@ -242,10 +555,37 @@ void uninit()
 
 	if (0 != periodicTimeoutId)
 	{
-		g_source_remove(periodicTimeoutId);
+		removeServerSource(periodicTimeoutId);
 		periodicTimeoutId = 0;
 	}
 
+	stopEventTimer();
+
+	if (0 != attachedInitTimeoutId)
+	{
+		removeServerSource(attachedInitTimeoutId);
+		attachedInitTimeoutId = 0;
+	}
+
+	// Our server description may be different next time around
+	ServerUtils::invalidateManagedObjects();
+	deferredUpdateCharacteristics.clear();
+	resetUpdateHandles();
+	indexUpdatePriorities(nullptr);
+
+	if (nullptr != pUpdateQueueSource)
+	{
+		g_source_destroy(pUpdateQueueSource);
+		g_source_unref(pUpdateQueueSource);
+		pUpdateQueueSource = nullptr;
+	}
+
+	if (0 != dataStoreDoorbellId)
+	{
+		removeServerSource(dataStoreDoorbellId);
+		dataStoreDoorbellId = 0;
+	}
+
   	if (ownedNameId > 0)
   	{
 		g_bus_unown_name(ownedNameId);
@@ -263,6 +603,23 @@ void uninit()
 		g_main_loop_unref(pMainLoop);
 		pMainLoop = nullptr;
 	}
+
+	// Let go of our main context (the application's, if we were attached to it.) From here on, updates pushed by other threads
+	// no longer wake it, nor can sources be added to it.
+	setServerContext(nullptr);
+	bServerAttached = false;
+}
+
+// Finishes stopping a server that is attached to the application's main context (see `shutdown()`)
+static gboolean onStopAttachedServer(gpointer /*pUserData*/)
+{
+	// We have stopped
+	setServerRunState(EStopped);
+	Logger::info("GGK server stopped");
+
+	// Cleanup
+	uninit();
+	return FALSE;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -301,6 +658,13 @@ void shutdown()
 	{
 		g_main_loop_quit(pMainLoop);
 	}
+
+	// If we're attached to the application's main context, there's no loop of ours to leave. Instead, we finish stopping on the
+	// next pass of the application's loop, so that none of our objects are cleaned up from under a callback that's still running.
+	else if (bServerAttached)
+	{
+		addServerSource(g_idle_source_new(), onStopAttachedServer, nullptr);
+	}
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -315,8 +679,8 @@ void shutdown()
 // Periodic timer handler
 //
 // A periodic timer is a timer fires every so often (see kPeriodicTimerFrequencySeconds.) This is used for our initialization
-// failure retries, but custom code can also be added to a server description (see `onEvent()`)
-gboolean onPeriodicTimer(gpointer pUserData)
+// failure retries. Events added to the server description (see `onEvent()`) are driven by the event timer, below.
+gboolean onPeriodicTimer(gpointer /*pUserData*/)
 {
 	// If we're shutting down, don't do anything and stop the periodic timer
 	if (ggkGetServerRunState() > ERunning)
@@ -338,23 +702,141 @@ gboolean onPeriodicTimer(gpointer pUserData)
 		}
 	}
 
-	// If we're registered, then go ahead and emit signals
-	if (bApplicationRegistered)
+	return TRUE;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  _____                 _     _   _
+// | ____|_   _____ _ __ | |_  | |_(_)_ __ ___   ___ _ __
+// |  _| \ \ / / _ \ '_ \| __| | __| | '_ ` _ \ / _ \ '__|
+// | |___ \ V /  __/ | | | |_  | |_| | | | | | |  __/ |
+// |_____| \_/ \___|_| |_|\__|  \__|_|_| |_| |_|\___|_|
+//
+// Events added to the server description (see `onEvent()` and `onEventMS()`) are kept in a min-heap, ordered by the time each
+// is next due. A single GLib timeout is armed for the earliest deadline; when it fires, every event that has come due is fired
+// and rescheduled, and the timeout is re-armed for the new earliest deadline. There's no walk of the server description and no
+// timer at all if there are no events.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// An event in our schedule, along with the time (in microseconds, see `g_get_monotonic_time()`) it is next due
+struct ScheduledEvent
+{
+	gint64 deadline;
+	const TickEvent *pEvent;
+
+	// The heap functions build a max-heap, so we order by the latest deadline to get the earliest at the top
+	bool operator<(const ScheduledEvent &other) const { return deadline > other.deadline; }
+};
+
+static std::vector<ScheduledEvent> eventSchedule;
+
+// Adds the events of an object (and its children) to our schedule
+static void scheduleObjectEvents(const DBusObject &object, gint64 now)
+{
+	for (const std::shared_ptr<DBusInterface> &pInterface : object.getInterfaces())
 	{
-		// Tick the object hierarchy
-		//
-		// The real goal here is to have the objects tick their interfaces (see `onEvent()` method when adding interfaces inside
-		// 'Server::Server()'
-		for (const DBusObject &object : TheServer->getObjects())
+		for (const TickEvent &event : pInterface->getEvents())
 		{
-			if (object.isPublished())
+			if (event.getPeriodMS() <= 0)
 			{
-				object.tickEvents(pBusConnection, pUserData);
+				Logger::warn(SSTR << "Ignoring event with a period of " << event.getPeriodMS() << "ms at path '" << pInterface->getPath() << "'");
+				continue;
 			}
+
+			ScheduledEvent scheduled;
+			scheduled.deadline = now + static_cast<gint64>(event.getPeriodMS()) * 1000;
+			scheduled.pEvent = &event;
+			eventSchedule.push_back(scheduled);
 		}
 	}
 
-	return TRUE;
+	for (const DBusObject &child : object.getChildren())
+	{
+		scheduleObjectEvents(child, now);
+	}
+}
+
+// Arms our timeout for the earliest deadline in the schedule
+static void armEventTimer();
+
+// Event timer handler, which fires each event that has come due
+static gboolean onEventTimer(gpointer pUserData)
+{
+	eventTimeoutId = 0;
+
+	// If we're shutting down, don't do anything (and don't re-arm the timer)
+	if (ggkGetServerRunState() > ERunning)
+	{
+		return FALSE;
+	}
+
+	gint64 now = g_get_monotonic_time();
+	while (!eventSchedule.empty() && eventSchedule.front().deadline <= now)
+	{
+		std::pop_heap(eventSchedule.begin(), eventSchedule.end());
+		ScheduledEvent &scheduled = eventSchedule.back();
+
+		scheduled.pEvent->getOwner()->fireEvent(*scheduled.pEvent, pBusConnection, pUserData);
+
+		// Keep to the event's period, but if we've fallen more than a full period behind, don't try to catch up with a burst
+		gint64 periodUS = static_cast<gint64>(scheduled.pEvent->getPeriodMS()) * 1000;
+		scheduled.deadline += periodUS;
+		if (scheduled.deadline <= now)
+		{
+			scheduled.deadline = now + periodUS;
+		}
+
+		std::push_heap(eventSchedule.begin(), eventSchedule.end());
+	}
+
+	armEventTimer();
+	return FALSE;
+}
+
+// Arms our timeout for the earliest deadline in the schedule
+static void armEventTimer()
+{
+	if (eventSchedule.empty())
+	{
+		return;
+	}
+
+	// Round up, so we don't wake just before the event is due
+	gint64 remainingUS = eventSchedule.front().deadline - g_get_monotonic_time();
+	guint intervalMS = remainingUS <= 0 ? 0 : static_cast<guint>((remainingUS + 999) / 1000);
+	eventTimeoutId = addServerSource(g_timeout_source_new(intervalMS), onEventTimer, pBusConnection);
+}
+
+// Builds our schedule from the published objects in the server description and starts the event timer
+static void startEventTimer()
+{
+	stopEventTimer();
+
+	gint64 now = g_get_monotonic_time();
+	for (const DBusObject &object : TheServer->getObjects())
+	{
+		if (object.isPublished())
+		{
+			scheduleObjectEvents(object, now);
+		}
+	}
+
+	std::make_heap(eventSchedule.begin(), eventSchedule.end());
+	Logger::debug(SSTR << "Scheduled " << eventSchedule.size() << " event(s)");
+
+	armEventTimer();
+}
+
+// Stops the event timer and clears our schedule
+static void stopEventTimer()
+{
+	if (0 != eventTimeoutId)
+	{
+		removeServerSource(eventTimeoutId);
+		eventTimeoutId = 0;
+	}
+
+	eventSchedule.clear();
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -381,12 +863,16 @@ void onMethodCall
 	gpointer pUserData
 )
 {
-	// Convert our input path into our custom type for path management
-	DBusObjectPath objectPath(pObjectPath);
+	Stats::increment(Stats::getInstance().methodCalls);
+	ScopedLatency latency(Stats::getInstance().methodLatency);
 
-	if (!TheServer->callMethod(objectPath, pInterfaceName, pMethodName, pConnection, pParameters, pInvocation, pUserData))
+	// Keep the calling client's session (see Sessions.cpp) up to date with the options BlueZ passes
+	Sessions::getInstance().observeMethodCall(pParameters);
+
+	// The path, interface and method names are looked up as-is, without copying them
+	if (!TheServer->callMethod(pObjectPath, pInterfaceName, pMethodName, pConnection, pParameters, pInvocation, pUserData))
 	{
-		Logger::error(SSTR << " + Method not found: [" << pSender << "]:[" << objectPath << "]:[" << pInterfaceName << "]:[" << pMethodName << "]");
+		Logger::error(SSTR << " + Method not found: [" << pSender << "]:[" << pObjectPath << "]:[" << pInterfaceName << "]:[" << pMethodName << "]");
 		g_dbus_method_invocation_return_dbus_error(pInvocation, kErrorNotImplemented.c_str(), "This method is not implemented");
 		return;
 	}
@@ -406,32 +892,34 @@ GVariant *onGetProperty
 	gpointer         pUserData
 )
 {
-	// Convert our input path into our custom type for path management
-	DBusObjectPath objectPath(pObjectPath);
+	Stats::increment(Stats::getInstance().propertyCalls);
+	ScopedLatency latency(Stats::getInstance().propertyLatency);
 
-	const GattProperty *pProperty = TheServer->findProperty(objectPath, pInterfaceName, pPropertyName);
+	// The path, interface and property names are looked up as-is, without copying them
+	const GattProperty *pProperty = TheServer->findProperty(pObjectPath, pInterfaceName, pPropertyName);
 
-	std::string propertyPath = std::string("[") + pSender + "]:[" + objectPath.toString() + "]:[" + pInterfaceName + "]:[" + pPropertyName + "]";
+	// The property's full path, for logging (only built when it's needed)
+	auto propertyPath = [&]() { return std::string("[") + pSender + "]:[" + pObjectPath + "]:[" + pInterfaceName + "]:[" + pPropertyName + "]"; };
 	if (!pProperty)
 	{
-		Logger::error(SSTR << "Property(get) not found: " << propertyPath);
-	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(get) not found: " + propertyPath).c_str(), pSender);
+		Logger::error(SSTR << "Property(get) not found: " << propertyPath());
+	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(get) not found: " + propertyPath()).c_str(), pSender);
 		return nullptr;
 	}
 
 	if (!pProperty->getGetterFunc())
 	{
-		Logger::error(SSTR << "Property(get) func not found: " << propertyPath);
-	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(get) func not found: " + propertyPath).c_str(), pSender);
+		Logger::error(SSTR << "Property(get) func not found: " << propertyPath());
+	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(get) func not found: " + propertyPath()).c_str(), pSender);
 		return nullptr;
 	}
 
-	Logger::info(SSTR << "Calling property getter: " << propertyPath);
-	GVariant *pResult = pProperty->getGetterFunc()(pConnection, pSender, objectPath.c_str(), pInterfaceName, pPropertyName, ppError, pUserData);
+	GGK_LOG_INFO("Calling property getter: " << propertyPath());
+	GVariant *pResult = pProperty->getGetterFunc()(pConnection, pSender, pObjectPath, pInterfaceName, pPropertyName, ppError, pUserData);
 
 	if (nullptr == pResult)
 	{
-	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(get) failed: " + propertyPath).c_str(), pSender);
+	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(get) failed: " + propertyPath()).c_str(), pSender);
 	    return nullptr;
 	}
 
@@ -451,30 +939,32 @@ gboolean onSetProperty
 	gpointer         pUserData
 )
 {
-	// Convert our input path into our custom type for path management
-	DBusObjectPath objectPath(pObjectPath);
+	Stats::increment(Stats::getInstance().propertyCalls);
+	ScopedLatency latency(Stats::getInstance().propertyLatency);
 
-	const GattProperty *pProperty = TheServer->findProperty(objectPath, pInterfaceName, pPropertyName);
+	// The path, interface and property names are looked up as-is, without copying them
+	const GattProperty *pProperty = TheServer->findProperty(pObjectPath, pInterfaceName, pPropertyName);
 
-	std::string propertyPath = std::string("[") + pSender + "]:[" + objectPath.toString() + "]:[" + pInterfaceName + "]:[" + pPropertyName + "]";
+	// The property's full path, for logging (only built when it's needed)
+	auto propertyPath = [&]() { return std::string("[") + pSender + "]:[" + pObjectPath + "]:[" + pInterfaceName + "]:[" + pPropertyName + "]"; };
 	if (!pProperty)
 	{
-		Logger::error(SSTR << "Property(set) not found: " << propertyPath);
-	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(set) not found: " + propertyPath).c_str(), pSender);
+		Logger::error(SSTR << "Property(set) not found: " << propertyPath());
+	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(set) not found: " + propertyPath()).c_str(), pSender);
 		return false;
 	}
 
 	if (!pProperty->getSetterFunc())
 	{
-		Logger::error(SSTR << "Property(set) func not found: " << propertyPath);
-	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(set) func not found: " + propertyPath).c_str(), pSender);
+		Logger::error(SSTR << "Property(set) func not found: " << propertyPath());
+	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(set) func not found: " + propertyPath()).c_str(), pSender);
 		return false;
 	}
 
-	Logger::info(SSTR << "Calling property getter: " << propertyPath);
-	if (!pProperty->getSetterFunc()(pConnection, pSender, objectPath.c_str(), pInterfaceName, pPropertyName, pValue, ppError, pUserData))
+	GGK_LOG_INFO("Calling property getter: " << propertyPath());
+	if (!pProperty->getSetterFunc()(pConnection, pSender, pObjectPath, pInterfaceName, pPropertyName, pValue, ppError, pUserData))
 	{
-	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(set) failed: " + propertyPath).c_str(), pSender);
+	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(set) failed: " + propertyPath()).c_str(), pSender);
 	    return false;
 	}
 
@@ -515,45 +1005,85 @@ void setRetryFailure()
 //
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-// Use the BlueZ GATT Manager proxy to register our GATT application with BlueZ
+// Use the BlueZ GATT Manager proxy of each of our adapters to register our GATT application with BlueZ
+//
+// The registrations are made in parallel. Once the last of them completes, we move on to the next initialization step.
 void doRegisterApplication()
 {
-	g_auto(GVariantBuilder) builder;
-	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
-	GVariant *pParams = g_variant_new("(oa{sv})", "/", &builder);
-
-	g_dbus_proxy_call
-	(
-		pBluezGattManagerProxy,         // GDBusProxy *proxy
-		"RegisterApplication",          // const gchar *method_name   (ex: "GetManagedObjects")
-		pParams,                        // GVariant *parameters
-		G_DBUS_CALL_FLAGS_NONE,         // GDBusCallFlags flags
-		-1,                             // gint timeout_msec
-		nullptr,                        // GCancellable *cancellable
-
-		// GAsyncReadyCallback callback
-		[] (GObject * /*pSourceObject*/, GAsyncResult *pAsyncResult, gpointer /*pUserData*/)
+	for (size_t i = 0; i < bluezAdapters.size(); ++i)
+	{
+		BluezAdapter &adapter = bluezAdapters[i];
+		if (adapter.bApplicationRegistered || adapter.bRegistrationPending)
 		{
-			GError *pError = nullptr;
-			GVariant *pVariant = g_dbus_proxy_call_finish(pBluezGattManagerProxy, pAsyncResult, &pError);
-			if (nullptr == pVariant)
-			{
-				Logger::error(SSTR << "Failed to register application: " << (nullptr == pError ? "Unknown" : pError->message));
-				setRetryFailure();
-			}
-			else
-			{
-				g_variant_unref(pVariant);
-				Logger::info(SSTR << "GATT application registered with BlueZ");
-				bApplicationRegistered = true;
-			}
+			continue;
+		}
 
-			// Keep going...
-			initializationStateProcessor();
-		},
+		g_auto(GVariantBuilder) builder;
+		g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+		GVariant *pParams = g_variant_new("(oa{sv})", "/", &builder);
 
-		nullptr                         // gpointer user_data
-	);
+		adapter.bRegistrationPending = true;
+		g_dbus_proxy_call
+		(
+			adapter.pGattManagerProxy,      // GDBusProxy *proxy
+			"RegisterApplication",          // const gchar *method_name   (ex: "GetManagedObjects")
+			pParams,                        // GVariant *parameters
+			G_DBUS_CALL_FLAGS_NONE,         // GDBusCallFlags flags
+			-1,                             // gint timeout_msec
+			nullptr,                        // GCancellable *cancellable
+
+			// GAsyncReadyCallback callback
+			[] (GObject * /*pSourceObject*/, GAsyncResult *pAsyncResult, gpointer pUserData)
+			{
+				size_t index = GPOINTER_TO_UINT(pUserData);
+				if (index >= bluezAdapters.size())
+				{
+					return;
+				}
+
+				BluezAdapter &adapter = bluezAdapters[index];
+				adapter.bRegistrationPending = false;
+
+				GError *pError = nullptr;
+				GVariant *pVariant = g_dbus_proxy_call_finish(adapter.pGattManagerProxy, pAsyncResult, &pError);
+				if (nullptr == pVariant)
+				{
+					Logger::error(SSTR << "Failed to register application on '" << adapter.objectPath << "': " << (nullptr == pError ? "Unknown" : pError->message));
+					setRetryFailure();
+				}
+				else
+				{
+					g_variant_unref(pVariant);
+					Logger::info(SSTR << "GATT application registered with BlueZ on '" << adapter.objectPath << "'");
+					adapter.bApplicationRegistered = true;
+				}
+
+				if (nullptr != pError)
+				{
+					g_error_free(pError);
+				}
+
+				// Wait for the rest of our registrations
+				bool allRegistered = true;
+				for (const BluezAdapter &other : bluezAdapters)
+				{
+					if (other.bRegistrationPending)
+					{
+						return;
+					}
+
+					allRegistered = allRegistered && other.bApplicationRegistered;
+				}
+
+				bApplicationRegistered = allRegistered;
+
+				// Keep going...
+				initializationStateProcessor();
+			},
+
+			GUINT_TO_POINTER(i)             // gpointer user_data
+		);
+	}
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -568,7 +1098,10 @@ void doRegisterApplication()
 // use an XML description of our D-Bus objects.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-void registerNodeHierarchy(GDBusNodeInfo *pNode, const DBusObjectPath &basePath = DBusObjectPath(), int depth = 1)
+// Registers each interface of a node (and its children) with D-Bus
+//
+// Returns true on success, otherwise false (in which case any registrations made so far are undone and a retry is scheduled)
+bool registerNodeHierarchy(GDBusNodeInfo *pNode, const DBusObjectPath &basePath = DBusObjectPath(), int depth = 1)
 {
 	std::string prefix;
 	prefix.insert(0, depth * 2, ' ');
@@ -602,12 +1135,17 @@ void registerNodeHierarchy(GDBusNodeInfo *pNode, const DBusObjectPath &basePath
 			Logger::error(SSTR << "Failed to register object: " << (nullptr == pError ? "Unknown" : pError->message));
 
 			// Cleanup and pretend like we were never here
-			g_dbus_node_info_unref(pNode);
+			//
+			// Note that the node belongs to our introspection cache, so we leave it alone
+			for (guint id : registeredObjectIds)
+			{
+				g_dbus_connection_unregister_object(pBusConnection, id);
+			}
 			registeredObjectIds.clear();
 
 			// Try again later
 			setRetryFailure();
-			return;
+			return false;
 		}
 
 		// Save the registered object Id so we can clean it up later
@@ -619,35 +1157,140 @@ void registerNodeHierarchy(GDBusNodeInfo *pNode, const DBusObjectPath &basePath
 	GDBusNodeInfo **ppChild = pNode->nodes;
 	while(nullptr != *ppChild)
 	{
-		registerNodeHierarchy(*ppChild, basePath + (*ppChild)->path, depth + 1);
+		if (!registerNodeHierarchy(*ppChild, basePath + (*ppChild)->path, depth + 1))
+		{
+			return false;
+		}
 
 		++ppChild;
 	}
+
+	return true;
 }
 
-void registerObjects()
+// Releases our cached introspection data
+static void clearIntrospectionCache()
 {
-	// Parse each object into an XML interface tree
+	for (IntrospectionCacheEntry &entry : introspectionCache)
+	{
+		if (nullptr != entry.pNode)
+		{
+			g_dbus_node_info_unref(entry.pNode);
+		}
+	}
+
+	introspectionCache.clear();
+	introspectedServer.reset();
+}
+
+// Ensures our introspection cache describes the current server
+//
+// The XML is generated only once per server description, so retries of the registration don't regenerate it. It is parsed only
+// when it differs from what we parsed before, so a restart with the same server description reuses the previous node info.
+//
+// Returns true on success, otherwise false (in which case the cache is left empty.)
+static bool updateIntrospectionCache(gint64 &generateTimeUS, gint64 &parseTimeUS, int &parsedCount)
+{
+	generateTimeUS = 0;
+	parseTimeUS = 0;
+	parsedCount = 0;
+
+	// Already up to date for this server?
+	if (introspectedServer.lock() == TheServer && introspectionCache.size() == TheServer->getObjects().size())
+	{
+		return true;
+	}
+
+	gint64 startTime = g_get_monotonic_time();
+	std::vector<std::string> xmlStrings;
+	xmlStrings.reserve(TheServer->getObjects().size());
 	for (const DBusObject &object : TheServer->getObjects())
 	{
+		xmlStrings.push_back(object.generateIntrospectionXML());
+	}
+	generateTimeUS = g_get_monotonic_time() - startTime;
+
+	// If the server description's shape changed, start over
+	if (introspectionCache.size() != xmlStrings.size())
+	{
+		clearIntrospectionCache();
+		introspectionCache.resize(xmlStrings.size(), IntrospectionCacheEntry{std::string(), nullptr});
+	}
+
+	startTime = g_get_monotonic_time();
+	for (size_t i = 0; i < xmlStrings.size(); ++i)
+	{
+		IntrospectionCacheEntry &entry = introspectionCache[i];
+		if (nullptr != entry.pNode && entry.xml == xmlStrings[i])
+		{
+			continue;
+		}
+
 		GError *pError = nullptr;
-		std::string xmlString = object.generateIntrospectionXML();
-		GDBusNodeInfo *pNode = g_dbus_node_info_new_for_xml(xmlString.c_str(), &pError);
+		GDBusNodeInfo *pNode = g_dbus_node_info_new_for_xml(xmlStrings[i].c_str(), &pError);
 		if (nullptr == pNode)
 		{
 			Logger::error(SSTR << "Failed to introspect XML: " << (nullptr == pError ? "Unknown" : pError->message));
-			setRetryFailure();
-			return;
+			if (nullptr != pError)
+			{
+				g_error_free(pError);
+			}
+			clearIntrospectionCache();
+			return false;
 		}
 
-		Logger::info(SSTR << "Registering object hierarchy with D-Bus hierarchy");
+		if (nullptr != entry.pNode)
+		{
+			g_dbus_node_info_unref(entry.pNode);
+		}
 
-		// Register the node hierarchy
-		registerNodeHierarchy(pNode, DBusObjectPath(pNode->path));
+		entry.xml = std::move(xmlStrings[i]);
+		entry.pNode = pNode;
+		++parsedCount;
+	}
+	parseTimeUS = g_get_monotonic_time() - startTime;
 
-		// Cleanup the node
-		g_dbus_node_info_unref(pNode);
+	introspectedServer = TheServer;
+	return true;
+}
+
+void registerObjects()
+{
+	gint64 startTime = g_get_monotonic_time();
+
+	// Freeze and index our server description so that method calls, property requests and updates can find their targets
+	// without walking the object tree
+	TheServer->freeze();
+	indexUpdatePriorities(TheServer.get());
+	gint64 indexTimeUS = g_get_monotonic_time() - startTime;
+
+	// Generate and parse our XML interface trees (or reuse the ones we have)
+	gint64 generateTimeUS, parseTimeUS;
+	int parsedCount;
+	if (!updateIntrospectionCache(generateTimeUS, parseTimeUS, parsedCount))
+	{
+		setRetryFailure();
+		return;
+	}
+
+	Logger::info(SSTR << "Registering object hierarchy with D-Bus hierarchy");
+
+	// Register each node hierarchy
+	gint64 registerStartTime = g_get_monotonic_time();
+	for (const IntrospectionCacheEntry &entry : introspectionCache)
+	{
+		if (!registerNodeHierarchy(entry.pNode, DBusObjectPath(entry.pNode->path)))
+		{
+			return;
+		}
 	}
+	gint64 registerTimeUS = g_get_monotonic_time() - registerStartTime;
+
+	Logger::debug(SSTR << "Object registration took " << (g_get_monotonic_time() - startTime) << "us"
+		<< " (index: " << indexTimeUS << "us"
+		<< ", generate XML: " << generateTimeUS << "us"
+		<< ", parse XML: " << parseTimeUS << "us for " << parsedCount << " of " << introspectionCache.size() << " object(s)"
+		<< ", register: " << registerTimeUS << "us)");
 
 	// Keep going
 	initializationStateProcessor();
@@ -666,19 +1309,19 @@ void registerObjects()
 // Configure an adapter to ensure it is setup the way we need. We turn things on that we need and turn everything else off
 // (to maximize security.)
 //
-// Note that this only works for the first adapter (index 0). Search for kControllerIndex for information.
-//
 // See also: https://git.kernel.org/pub/scm/bluetooth/bluez.git/tree/doc/mgmt-api.txt
-void configureAdapter()
+//
+// Returns true on success, otherwise false
+static bool configureController(BluezAdapter &adapter)
 {
-	Mgmt mgmt;
+	Mgmt mgmt(adapter.controllerIndex);
 
 	// Get our properly truncated advertising names
 	std::string advertisingName = Mgmt::truncateName(TheServer->getAdvertisingName());
 	std::string advertisingShortName = Mgmt::truncateShortName(TheServer->getAdvertisingShortName());
 
 	// Find out what our current settings are
-	HciAdapter::ControllerInformation info = HciAdapter::getInstance().getControllerInformation();
+	HciAdapter::ControllerInformation info = HciAdapter::getInstance().getControllerInformation(adapter.controllerIndex);
 
 	// Are all of our settings the way we want them?
 	bool pwFlag = info.currentSettings.isSet(HciAdapter::EHciPowered) == true;
@@ -689,27 +1332,43 @@ void configureAdapter()
 	bool bnFlag = info.currentSettings.isSet(HciAdapter::EHciBondable) == TheServer->getEnableBondable();
 	bool cnFlag = info.currentSettings.isSet(HciAdapter::EHciConnectable) == TheServer->getEnableConnectable();
 	bool diFlag = info.currentSettings.isSet(HciAdapter::EHciDiscoverable) == TheServer->getEnableDiscoverable();
-	bool adFlag = info.currentSettings.isSet(HciAdapter::EHciAdvertising) == TheServer->getEnableAdvertising();
 	bool sspFlag = info.currentSettings.isSet(HciAdapter::EHciSecureSimplePairing) == TheServer->getEnableSecureSimplePairing();
 	bool hcFlag = info.currentSettings.isSet(HciAdapter::EHciHighSpeed) == TheServer->getEnableHighspeedConnect();
 	bool fcFlag = info.currentSettings.isSet(HciAdapter::EHciFastConnectable) == TheServer->getEnableFastConnect();
 	bool anFlag = (advertisingName.length() == 0 || advertisingName == info.name) && (advertisingShortName.length() == 0 || advertisingShortName == info.shortName);
 
+	// Our advertising is added as a custom advertising instance (with the adapter's own advertising setting turned off), so the
+	// adapter's settings can't tell us whether it is configured. Instead, we compare against what we last applied.
+	bool advFlag = adapter.bAdvertisingApplied && adapter.bAppliedAdvertisingState == TheServer->getEnableAdvertising() &&
+		adapter.appliedAdvertisingName == advertisingName && adapter.appliedAdvertisingShortName == advertisingShortName;
+
+	// Changes to the controller's basic configuration require it to be powered off; everything else can be changed while it is
+	// powered, so we avoid the power cycle (and the outage it causes for clients) unless we need it
+	bool powerCycle = !leFlag || !brFlag || !sspFlag || !hcFlag;
+
 	// If everything is setup already, we're done
-	if (true || !pwFlag || !leFlag || !brFlag || !scFlag || !llsFlag || !bnFlag || !cnFlag || !diFlag || !adFlag || !anFlag || !sspFlag || !hcFlag || !fcFlag)
+	if (!pwFlag || !leFlag || !brFlag || !scFlag || !llsFlag || !bnFlag || !cnFlag || !diFlag || !advFlag || !anFlag || !sspFlag || !hcFlag || !fcFlag)
 	{
-		// We need it off to start with
-		if (pwFlag)
+		// We need it off to start with (if we're changing its configuration)
+		//
+		// The kernel rejects other settings while a power change is pending, so we wait for this to complete before sending them
+		if (pwFlag && powerCycle)
 		{
 			Logger::info("Powering off");
-			if (!mgmt.setPowered(false)) { setRetry(); return; }
+			if (!mgmt.setPowered(false)) { return false; }
+
+			// Our advertising instance doesn't survive the power cycle
+			advFlag = false;
 		}
 
+		// Send the rest of our settings without waiting on each one, collecting all of the results at the end
+		mgmt.beginPipeline();
+
 		// Enable the LE state (we always set this state if it's not set)
 		if (!leFlag)
 		{
 			Logger::info("Enabling LE");
-			if (!mgmt.setLE(true)) { setRetry(); return; }
+			if (!mgmt.setLE(true)) { return false; }
 		}
 
 		// Change the Br/Edr state?
@@ -718,7 +1377,7 @@ void configureAdapter()
 		if (!brFlag)
 		{
 			Logger::info(SSTR << (TheServer->getEnableBREDR() ? "Enabling":"Disabling") << " BR/EDR");
-			if (!mgmt.setBredr(TheServer->getEnableBREDR())) { setRetry(); return; }
+			if (!mgmt.setBredr(TheServer->getEnableBREDR())) { return false; }
 		}
 
 		if( !sspFlag )
@@ -728,7 +1387,7 @@ void configureAdapter()
 		    {
 		        Logger::warn(SSTR << "Not enabling SSP without BR/EDR");
 		    } else {
-		        if (!mgmt.setSSP(TheServer->getEnableSecureSimplePairing())) { setRetry(); return; }
+		        if (!mgmt.setSSP(TheServer->getEnableSecureSimplePairing())) { return false; }
 		    }
 		}
 
@@ -739,7 +1398,7 @@ void configureAdapter()
             {
                 Logger::warn(SSTR << "Not enabling Highspeed Connect without SSP");
             } else {
-                if (!mgmt.setHC(TheServer->getEnableHighspeedConnect())) { setRetry(); return; }
+                if (!mgmt.setHC(TheServer->getEnableHighspeedConnect())) { return false; }
             }
         }
 
@@ -750,7 +1409,7 @@ void configureAdapter()
             {
                 Logger::warn(SSTR << "Not enabling Fast Connect without BR/EDR");
             } else {
-                if (!mgmt.setFC(TheServer->getEnableFastConnect())) { setRetry(); return; }
+                if (!mgmt.setFC(TheServer->getEnableFastConnect())) { return false; }
             }
         }
 
@@ -760,28 +1419,28 @@ void configureAdapter()
 			Logger::info(SSTR << (TheServer->getEnableSecureConnection() ? "Enabling":"Disabling") << " Secure Connections");
 			// 0x01 enables secure connections, which may represent Security Mode 2
 			// 0x02 is secure connections only mode (Security Level 4, Security Mode 1)
-			if (!mgmt.setSecureConnections(TheServer->getEnableSecureConnection() ? 1 : 0)) { setRetry(); return; }
+			if (!mgmt.setSecureConnections(TheServer->getEnableSecureConnection() ? 1 : 0)) { return false; }
 		}
 
 		// Change the Bondable state?
         if (!llsFlag)
         {
             Logger::info(SSTR << (TheServer->getEnableLinkLayerSecurity() ? "Enabling":"Disabling") << " Link Level Security");
-            if (!mgmt.setLLS(TheServer->getEnableLinkLayerSecurity())) { setRetry(); return; }
+            if (!mgmt.setLLS(TheServer->getEnableLinkLayerSecurity())) { return false; }
         }
 
 		// Change the Bondable state?
 		if (!bnFlag)
 		{
 			Logger::info(SSTR << (TheServer->getEnableBondable() ? "Enabling":"Disabling") << " Bondable");
-			if (!mgmt.setBondable(TheServer->getEnableBondable())) { setRetry(); return; }
+			if (!mgmt.setBondable(TheServer->getEnableBondable())) { return false; }
 		}
 
 		// Change the Connectable state?
 		if (!cnFlag)
 		{
 			Logger::info(SSTR << (TheServer->getEnableConnectable() ? "Enabling":"Disabling") << " Connectable");
-			if (!mgmt.setConnectable(TheServer->getEnableConnectable())) { setRetry(); return; }
+			if (!mgmt.setConnectable(TheServer->getEnableConnectable())) { return false; }
 		}
 
 		// Change the Discoverable state?
@@ -789,27 +1448,68 @@ void configureAdapter()
 		{
 			Logger::debug(SSTR << (TheServer->getEnableDiscoverable() ? "Enabling":"Disabling") << " Discoverable");
 			// 0x01 is general discoverable, putting 0 as timeout means indefinite.
-			if (!mgmt.setDiscoverable(TheServer->getEnableDiscoverable() ? 1 : 0, 0)) { setRetry(); return; }
+			if (!mgmt.setDiscoverable(TheServer->getEnableDiscoverable() ? 1 : 0, 0)) { return false; }
 		}
 
 		// Change the Advertising state?
-//		if (!adFlag)
-//		{
+		if (!advFlag)
+		{
 			Logger::info(SSTR << (TheServer->getEnableAdvertising() ? "Enabling":"Disabling") << " Advertising");
 			// Turn on advertising with setting "0x02" which will advertise regardless of connectable setting
-			if (!mgmt.setAdvertising(TheServer->getEnableAdvertising() ? true : false, advertisingName, advertisingShortName)) { Logger::error(SSTR << "Failed to setAdvertising"); setRetry(); return; }
-//		}
+			adapter.bAdvertisingApplied = false;
+			if (!mgmt.setAdvertising(TheServer->getEnableAdvertising() ? true : false, advertisingName, advertisingShortName)) { Logger::error(SSTR << "Failed to setAdvertising"); return false; }
+			adapter.bAdvertisingApplied = true;
+			adapter.bAppliedAdvertisingState = TheServer->getEnableAdvertising();
+			adapter.appliedAdvertisingName = advertisingName;
+			adapter.appliedAdvertisingShortName = advertisingShortName;
+		}
 
 		// Set the name?
 		if (!anFlag)
 		{
 			Logger::info(SSTR << "Setting advertising name to '" << advertisingName << "' (with short name: '" << advertisingShortName << "')");
-			if (!mgmt.setName(advertisingName.c_str(), advertisingShortName.c_str())) { setRetry(); return; }
+			if (!mgmt.setName(advertisingName.c_str(), advertisingShortName.c_str())) { return false; }
 		}
 
-		// Turn it back on
-		Logger::info("Powering on");
-		if (!mgmt.setPowered(true)) { setRetry(); return; }
+		// Wait for all of our settings to be applied
+		if (!mgmt.endPipeline()) { adapter.bAdvertisingApplied = false; return false; }
+
+		// Turn it back on (or on for the first time), once everything else has been applied
+		if (!pwFlag || powerCycle)
+		{
+			Logger::info("Powering on");
+			if (!mgmt.setPowered(true)) { adapter.bAdvertisingApplied = false; return false; }
+		}
+	}
+	else
+	{
+		Logger::info(SSTR << "Controller " << adapter.controllerIndex << " is already configured; no changes needed");
+	}
+
+	return true;
+}
+
+// Configure each of our adapters (see `configureController()`)
+void configureAdapter()
+{
+	// Learn which controllers the kernel knows about, so that connections can be tracked (and balanced) across them
+	HciAdapter::getInstance().readControllerIndexList();
+
+	for (BluezAdapter &adapter : bluezAdapters)
+	{
+		if (adapter.bConfigured)
+		{
+			continue;
+		}
+
+		Logger::info(SSTR << "Configuring controller " << adapter.controllerIndex << " ('" << adapter.objectPath << "')");
+		if (!configureController(adapter))
+		{
+			setRetry();
+			return;
+		}
+
+		adapter.bConfigured = true;
 	}
 
 	// register an hci event listener from the Server
@@ -822,11 +1522,51 @@ void configureAdapter()
 	initializationStateProcessor();
 }
 
+// Sends any changes to the application's advertising instances to each of our configured controllers (runs on the server's thread)
+static gboolean onAdvertisingUpdate(gpointer /*pUserData*/)
+{
+	if (!bAdapterConfigured || nullptr == TheServer || !TheServer->getEnableAdvertising())
+	{
+		return FALSE;
+	}
 
-void unConfigureAdapter()
+	for (BluezAdapter &adapter : bluezAdapters)
+	{
+		if (!adapter.bConfigured)
+		{
+			continue;
+		}
+
+		Mgmt mgmt(adapter.controllerIndex, false);
+		mgmt.beginPipeline();
+		mgmt.applyApplicationAdvertising();
+		if (!mgmt.endPipeline())
+		{
+			Logger::warn(SSTR << "Failed to update the advertising on controller " << adapter.controllerIndex);
+		}
+	}
+
+	return FALSE;
+}
+
+// Applies changes to the application's advertising instances (see `Mgmt::setApplicationAdvertisingInstance()`)
+//
+// This method is thread-safe; the changes are sent from the server's thread. If no adapter is configured yet, they are sent when
+// one is.
+void updateAdvertising()
+{
+	addServerSource(g_idle_source_new(), onAdvertisingUpdate, nullptr);
+}
+
+
+// Restores a controller to its BR/EDR configuration
+static void unConfigureController(BluezAdapter &adapter)
 {
-    Mgmt mgmt;
+    Mgmt mgmt(adapter.controllerIndex);
 
+    // We're about to replace our advertising, so we'll need to configure it again next time
+    adapter.bAdvertisingApplied = false;
+    adapter.bConfigured = false;
 
     // Get our properly truncated advertising names
     std::string advertisingName = Mgmt::truncateName(std::string("Doppler"));
@@ -908,8 +1648,28 @@ void unConfigureAdapter()
     Logger::info("Powering on");
     if (!mgmt.setPowered(true)) { setRetry(); return; }
 
-    Logger::info("The Bluetooth adapter is fully unconfigured for BR/EDR use");
+    Logger::info(SSTR << "Controller " << adapter.controllerIndex << " is fully unconfigured for BR/EDR use");
+}
 
+// Restores each of our adapters to its BR/EDR configuration
+//
+// If we haven't found our adapters yet, the first controller is restored.
+void unConfigureAdapter()
+{
+    if (bluezAdapters.empty())
+    {
+        BluezAdapter adapter = BluezAdapter();
+        adapter.controllerIndex = HciAdapter::kDefaultControllerIndex;
+        unConfigureController(adapter);
+        return;
+    }
+
+    for (BluezAdapter &adapter : bluezAdapters)
+    {
+        unConfigureController(adapter);
+    }
+
+    bAdapterConfigured = false;
 }
 
 
@@ -924,8 +1684,20 @@ void unConfigureAdapter()
 //
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-// Find the BlueZ's GATT Manager interface for the *first* Bluetooth adapter provided by BlueZ. We'll need this to register our
-// GATT server with BlueZ.
+// Returns the controller index for a BlueZ adapter's object path (such as 1 for "/org/bluez/hci1")
+static uint16_t controllerIndexFromPath(const std::string &objectPath)
+{
+	size_t pos = objectPath.rfind("/hci");
+	if (std::string::npos == pos || pos + 4 >= objectPath.length())
+	{
+		return HciAdapter::kDefaultControllerIndex;
+	}
+
+	return static_cast<uint16_t>(strtoul(objectPath.c_str() + pos + 4, nullptr, 10));
+}
+
+// Find the BlueZ's GATT Manager interface for the *first* Bluetooth adapter provided by BlueZ (or for every adapter, if the server
+// enables all adapters.) We'll need these to register our GATT server with BlueZ.
 void findAdapterInterface()
 {
 	// Get a list of the BlueZ's D-Bus objects
@@ -937,59 +1709,71 @@ void findAdapterInterface()
 		return;
 	}
 
-	// Scan the list of objects we find one with a GATT manager interface
-	//
-	// Note that if there are multiple interfaces, we will only find the first
-	for (guint i = 0; i < g_list_length(pObjects) && bluezGattManagerInterfaceName.empty(); ++i)
+	// Scan the list of objects for those with a GATT manager interface
+	std::string primaryObjectPath;
+	for (GList *pItem = pObjects; nullptr != pItem; pItem = pItem->next)
 	{
 		// Current object in question
-		pBluezAdapterObject = static_cast<GDBusObject *>(g_list_nth_data(pObjects, i));
-		if (nullptr == pBluezAdapterObject) { continue; }
+		GDBusObject *pObject = static_cast<GDBusObject *>(pItem->data);
+		if (nullptr == pObject) { continue; }
 
 		// See if it has a GATT manager interface
-		pBluezGattManagerProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pBluezAdapterObject, "org.bluez.GattManager1"));
-		if (nullptr == pBluezGattManagerProxy) { continue; }
-
-		// Get the interface proxy for this adapter - this will come in handy later
-//		pBluezAdapterInterfaceProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pBluezAdapterObject, "org.bluez.Adapter1"));
-//		if (nullptr == pBluezAdapterInterfaceProxy)
-//		{
-//			Logger::warn(SSTR << "Failed to get adapter proxy for interface 'org.bluez.Adapter1'");
-//			continue;
-//		}
-
-		// Get the interface proxy for this adapter's properties - this will come in handy later
-		pBluezAdapterPropertiesInterfaceProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pBluezAdapterObject, "org.freedesktop.DBus.Properties"));
-		if (nullptr == pBluezAdapterPropertiesInterfaceProxy)
+		GDBusProxy *pGattManagerProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pObject, "org.bluez.GattManager1"));
+		if (nullptr == pGattManagerProxy) { continue; }
+
+		// The first adapter is our primary one - get the interface proxy for its properties, as this will come in handy later
+		if (bluezAdapters.empty())
 		{
-			Logger::warn(SSTR << "Failed to get adapter properties proxy for interface 'org.freedesktop.DBus.Properties'");
-			continue;
+			pBluezAdapterPropertiesInterfaceProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pObject, "org.freedesktop.DBus.Properties"));
+			if (nullptr == pBluezAdapterPropertiesInterfaceProxy)
+			{
+				Logger::warn(SSTR << "Failed to get adapter properties proxy for interface 'org.freedesktop.DBus.Properties'");
+				g_object_unref(pGattManagerProxy);
+				continue;
+			}
+
+			primaryObjectPath = g_dbus_object_get_object_path(pObject);
 		}
 
-		// Finally, save off the interface name, we're done!
-		bluezGattManagerInterfaceName = g_dbus_proxy_get_object_path(pBluezGattManagerProxy);
-		break;
-	}
+		BluezAdapter adapter = BluezAdapter();
+		adapter.objectPath = g_dbus_proxy_get_object_path(pGattManagerProxy);
+		adapter.controllerIndex = controllerIndexFromPath(adapter.objectPath);
+		adapter.pGattManagerProxy = pGattManagerProxy;
+		bluezAdapters.push_back(adapter);
 
-	// Get a fresh copy of our objects so we can release the entire list
-	pBluezAdapterObject = g_dbus_object_manager_get_object(pBluezObjectManager, g_dbus_object_get_object_path(pBluezAdapterObject));
+		Logger::info(SSTR << "Found adapter '" << adapter.objectPath << "' (controller " << adapter.controllerIndex << ")");
 
-	// We'll need access to the device object so we can set properties on it
-	pBluezDeviceObject = g_dbus_object_manager_get_object(pBluezObjectManager, g_dbus_object_get_object_path(pBluezAdapterObject));
+		if (!TheServer->getEnableAllAdapters())
+		{
+			break;
+		}
+	}
 
 	// Cleanup the list
-	for (guint i = 0; i < g_list_length(pObjects) && bluezGattManagerInterfaceName.empty(); ++i)
+	g_list_free_full(pObjects, g_object_unref);
+
+	if (!bluezAdapters.empty())
 	{
-		g_object_unref(g_list_nth_data(pObjects, i));
-	}
+		// Get a fresh copy of our primary adapter's object
+		pBluezAdapterObject = g_dbus_object_manager_get_object(pBluezObjectManager, primaryObjectPath.c_str());
 
-	g_list_free(pObjects);
+		// We'll need access to the device object so we can set properties on it
+		pBluezDeviceObject = g_dbus_object_manager_get_object(pBluezObjectManager, primaryObjectPath.c_str());
+
+		bluezGattManagerInterfaceName = bluezAdapters.front().objectPath;
+	}
 
 	// If we didn't find the adapter object, reset things and we'll try again later
 	if (nullptr == pBluezAdapterObject || nullptr == pBluezDeviceObject)
 	{
 		Logger::warn(SSTR << "Unable to find BlueZ objects outside of object list");
 		bluezGattManagerInterfaceName.clear();
+
+		for (BluezAdapter &adapter : bluezAdapters)
+		{
+			g_object_unref(adapter.pGattManagerProxy);
+		}
+		bluezAdapters.clear();
 	}
 
 	// If we never ended up with an interface name, bail now
@@ -1082,7 +1866,7 @@ void doOwnedNameAcquire()
 		[](GDBusConnection *, const gchar *, gpointer)
 		{
 			// Handy way to get periodic activity
-			periodicTimeoutId = g_timeout_add_seconds(kPeriodicTimerFrequencySeconds, onPeriodicTimer, pBusConnection);
+			periodicTimeoutId = addServerSource(g_timeout_source_new_seconds(kPeriodicTimerFrequencySeconds), onPeriodicTimer, pBusConnection);
 			if (periodicTimeoutId <= 0)
 			{
 				Logger::fatal(SSTR << "Failed to add a periodic timer");
@@ -1233,7 +2017,7 @@ void initializationStateProcessor()
 	//
 	if (!bAdapterConfigured)
 	{
-		Logger::info(SSTR << "Configuring BlueZ adapter '" << bluezGattManagerInterfaceName << "'");
+		Logger::info(SSTR << "Configuring BlueZ adapter(s), starting with '" << bluezGattManagerInterfaceName << "'");
 		configureAdapter();
 		return;
 	}
@@ -1267,7 +2051,11 @@ void initializationStateProcessor()
 	}
 
 	// Successful initialization - switch to running state
+	Logger::info(SSTR << "Initialization completed in " << ((g_get_monotonic_time() - startupTimeStart) / 1000) << "ms");
 	setServerRunState(ERunning);
+
+	// Now that we're running, start firing our events
+	startEventTimer();
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -1280,13 +2068,12 @@ void initializationStateProcessor()
 //
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-// Entry point for the asynchronous server thread
-//
-// This method should not be called directly, instead, direct your attention over to `ggkStart()`
-void runServerThread()
+// Begins initializing the server and adds our update queue source to the server's main context
+static void startServer()
 {
 	// Set the initialization state
 	setServerRunState(EInitializing);
+	startupTimeStart = g_get_monotonic_time();
 
 	// Start our state processor, which is really just a simplified state machine that steps us through an asynchronous
 	// initialization process.
@@ -1300,34 +2087,53 @@ void runServerThread()
 	// There are alternatives, but using async methods is the recommended way.
 	initializationStateProcessor();
 
-	Logger::info(SSTR << "Creating GLib main loop");
-	pMainLoop = g_main_loop_new(NULL, FALSE);
-
-	// Add the idle function
+	// Add our update queue source
 	//
-	// Note that we actually run the idle function from a lambda. This allows us to manage the inter-idle sleep so we don't
-	// soak up 100% of our CPU.
-	guint res = g_idle_add
-	(
-		[](gpointer pUserData) -> gboolean
-		{
-			// Try to process some data and if no data is processed, sleep for the requested frequency
-			if (!idleFunc(pUserData))
-			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(kIdleFrequencyMS));
-			}
+	// This source is attached to the server's main context (the same one our D-Bus callbacks and timers run on.) It wakes only
+	// when there are updates to process, so the server sits idle in poll() otherwise.
+	pUpdateQueueSource = g_source_new(&updateQueueSourceFuncs, sizeof(GSource));
+	g_source_set_name(pUpdateQueueSource, "ggk-update-queue");
+	if (0 == g_source_attach(pUpdateQueueSource, pServerContext))
+	{
+		Logger::error(SSTR << "Unable to add update queue source to main loop");
+	}
 
-			// Always return TRUE so our idle remains in tact
-			return TRUE;
-		},
-		nullptr
-	);
+	// If the data store is shared with producers in other processes, answer their doorbell on the main loop too
+	int doorbellFd = DataStore::getInstance().getDoorbellFd();
+	if (doorbellFd >= 0)
+	{
+		// As with G_SOURCE_FUNC(), the fd source's callback is cast through a generic function pointer
+		GSourceFunc func = reinterpret_cast<GSourceFunc>(reinterpret_cast<void (*)(void)>(onDataStoreDoorbell));
+		dataStoreDoorbellId = addServerSource(g_unix_fd_source_new(doorbellFd, G_IO_IN), func, nullptr);
+	}
+}
 
-	if (res == 0)
+// Gives up on an attached server that has not finished initializing in time (see `attachServer()`)
+static gboolean onAttachedInitTimeout(gpointer /*pUserData*/)
+{
+	attachedInitTimeoutId = 0;
+	if (ggkGetServerRunState() <= EInitializing)
 	{
-		Logger::error(SSTR << "Unable to add idle to main loop");
+		Logger::error("GGK server initialization timed out");
+		setServerHealth(EFailedInit);
+		shutdown();
 	}
 
+	return FALSE;
+}
+
+// Entry point for the asynchronous server thread
+//
+// This method should not be called directly, instead, direct your attention over to `ggkStart()`
+void runServerThread()
+{
+	// Our main loop runs on the global default context
+	setServerContext(g_main_context_default());
+	startServer();
+
+	Logger::info(SSTR << "Creating GLib main loop");
+	pMainLoop = g_main_loop_new(pServerContext, FALSE);
+
 	Logger::trace(SSTR << "Starting GLib main loop");
 	g_main_loop_run(pMainLoop);
 
@@ -1339,4 +2145,26 @@ void runServerThread()
 	uninit();
 }
 
+// Starts the server on the application's main context, rather than on our own server thread
+//
+// GLib's D-Bus calls reply to, and our registered objects are dispatched on, the thread-default main context at the time they
+// are made. We make our first calls here with `pContext` as the thread-default; from then on, our calls are made from callbacks
+// dispatched on `pContext`, so the application must run it as the thread-default context of its thread (or use the global
+// default context.)
+//
+// This method returns once initialization has begun; the rest happens as the application runs its main loop. If the server is
+// not running within `maxAsyncInitTimeoutMS` milliseconds, it is shut down.
+//
+// This method should not be called directly, instead, direct your attention over to `ggkAttach()`
+void attachServer(GMainContext *pContext, int maxAsyncInitTimeoutMS)
+{
+	setServerContext(nullptr != pContext ? pContext : g_main_context_default());
+	bServerAttached = true;
+
+	g_main_context_push_thread_default(pServerContext);
+	startServer();
+	attachedInitTimeoutId = addServerSource(g_timeout_source_new(maxAsyncInitTimeoutMS), onAttachedInitTimeout, nullptr);
+	g_main_context_pop_thread_default(pServerContext);
+}
+
 }; // namespace ggk
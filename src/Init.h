@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <glib.h>
+
 namespace ggk {
 
 // Trigger a graceful, asynchronous shutdown of the server
@@ -34,4 +36,29 @@ void shutdown();
 // This method should not be called directly, instead, direct your attention over to `ggkStart()`
 void runServerThread();
 
+// Starts the server on the application's main context, rather than on our own server thread
+//
+// This method should not be called directly, instead, direct your attention over to `ggkAttach()`
+void attachServer(GMainContext *pContext, int maxAsyncInitTimeoutMS);
+
+// Attaches `pSource` to the server's main context, calling `func` when it is dispatched, and returns its ID
+//
+// The context takes over our reference to the source. This method is thread-safe. If the server isn't started, the source is
+// released without being attached and 0 is returned.
+guint addServerSource(GSource *pSource, GSourceFunc func, gpointer pUserData);
+
+// Removes a source added with `addServerSource()`
+void removeServerSource(guint id);
+
+// Wakes the main loop so that any newly queued updates are dispatched immediately
+//
+// This method is thread-safe and is called by `ggkPushUpdateQueue()` and `ggkNotifyHandle()` after adding an entry. If the server
+// isn't started, this does nothing.
+void wakeUpdateQueue();
+
+// Applies changes to the application's advertising instances (see `Mgmt::setApplicationAdvertisingInstance()`)
+//
+// This method is thread-safe and is called by `ggkAdvertisingSetInstance()` and `ggkAdvertisingRemoveInstance()`.
+void updateAdvertising();
+
 }; // namespace ggk
\ No newline at end of file
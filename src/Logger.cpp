@@ -45,9 +45,29 @@
 // There is an additional macro (SSTR) which can simplify sending dynamic data to the logger via a string stream:
 //
 //    Logger::info(SSTR << "There were " << count << " entries in the list");
+//
+// Note that the string stream is built before the logger gets to decide whether anybody is listening. On hot paths, use the lazy
+// macros instead, which check first and only format the message if it will be logged:
+//
+//    GGK_LOG_INFO("There were " << count << " entries in the list");
+//
+// Log levels can also be stripped at compile time by defining GGK_LOG_MIN_LEVEL (see Logger.h.)
+//
+// By default, receivers are called on whichever thread is logging. An application whose receivers are slow (writing to flash or
+// a serial console, for example) can enable asynchronous delivery with `ggkLogSetAsync()`. Log entries are then copied into a
+// bounded, lock-free queue and a background thread calls the receivers. Logging never waits on a receiver in this mode (it only
+// takes a lock, briefly, to wake the background thread when it is idle); if the queue is full, the entry is dropped and counted
+// instead (see `ggkLogGetDroppedCount()`.)
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
 #include "Logger.h"
+#include "RingBuffer.h"
 
 namespace ggk {
 
@@ -79,6 +99,172 @@ GGKLogReceiver Logger::logReceiverAlways = nullptr;
 // The registered log receiver for TRACE logs - a nullptr will cause the logging for that receiver to be ignored
 GGKLogReceiver Logger::logReceiverTrace = nullptr;
 
+//
+// Asynchronous delivery
+//
+
+// A log entry waiting to be delivered by the async sink
+struct LogRecord
+{
+	GGKLogReceiver receiver;
+	char text[Logger::kMaxAsyncRecordLength];
+};
+
+// The async sink: a bounded queue of log records and the thread that delivers them to their receivers
+//
+// The sink is created the first time async delivery is enabled and lives until the process exits, so a thread that is logging
+// while the sink is being stopped never sees it disappear.
+struct AsyncLogSink
+{
+	RingBuffer<LogRecord, Logger::kAsyncQueueCapacity> records;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cvRecords;
+	bool stopping = false;
+
+	// True while our thread is waiting (or about to wait) on `cvRecords`, so that only a push that may need to wake it takes
+	// our mutex
+	std::atomic<bool> sleeping{false};
+
+	~AsyncLogSink() { stop(); }
+
+	void start()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = false;
+		if (!thread.joinable())
+		{
+			thread = std::thread(&AsyncLogSink::run, this);
+		}
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		cvRecords.notify_all();
+
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+
+		// Deliver anything that arrived while we were stopping
+		drain();
+	}
+
+	void drain()
+	{
+		LogRecord record;
+		while (records.pop(record))
+		{
+			record.receiver(record.text);
+		}
+	}
+
+	// Wakes our thread after a record has been pushed, if it is waiting for one
+	//
+	// This pairs with `run()`: our thread announces that it is about to sleep before its final check of the queue, and a
+	// producer checks for that announcement after its push, so between them one always sees the other. A producer that does
+	// need to wake us takes the mutex, so the notification can't arrive between our check and our wait.
+	void wake()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cvRecords.notify_one();
+		}
+	}
+
+	// Our delivery thread, which calls receivers on behalf of the threads that logged
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stopping)
+		{
+			lock.unlock();
+			drain();
+			lock.lock();
+
+			sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			cvRecords.wait(lock, [this]() { return stopping || !records.empty(); });
+			sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+};
+
+// Returns our async sink, creating it on first use
+static AsyncLogSink &getAsyncLogSink()
+{
+	static AsyncLogSink sink;
+	return sink;
+}
+
+static std::atomic<bool> asyncLogging(false);
+static std::atomic<unsigned long> droppedLogRecords(0);
+static std::mutex asyncLoggingMutex;
+
+// Delivers a log entry to a receiver, either directly or (in async mode) through the async sink
+void Logger::deliver(GGKLogReceiver receiver, const char *pText)
+{
+	if (!asyncLogging.load(std::memory_order_acquire))
+	{
+		receiver(pText);
+		return;
+	}
+
+	LogRecord record;
+	record.receiver = receiver;
+	strncpy(record.text, pText, sizeof(record.text) - 1);
+	record.text[sizeof(record.text) - 1] = 0;
+
+	AsyncLogSink &sink = getAsyncLogSink();
+	if (!sink.records.push(record))
+	{
+		droppedLogRecords.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	sink.wake();
+}
+
+// Enables or disables asynchronous log delivery
+//
+// When enabled, log entries are copied into a bounded queue and delivered to their receivers from a background thread, so
+// that a slow receiver never blocks the thread that is logging. If the queue is full, the entry is dropped and counted (see
+// `getDroppedCount()`.) Entries longer than `kMaxAsyncRecordLength - 1` characters are truncated.
+//
+// Disabling async delivery waits for the background thread to deliver any queued entries before receivers are called directly
+// again, so that entries reach them in order.
+void Logger::setAsync(bool enable)
+{
+	std::lock_guard<std::mutex> lock(asyncLoggingMutex);
+
+	if (enable)
+	{
+		getAsyncLogSink().start();
+		asyncLogging.store(true, std::memory_order_release);
+	}
+	else if (asyncLogging.load(std::memory_order_acquire))
+	{
+		// Deliver what is queued before anything is delivered directly, then whatever was pushed as we switched over
+		AsyncLogSink &sink = getAsyncLogSink();
+		sink.stop();
+		asyncLogging.store(false, std::memory_order_release);
+		sink.drain();
+	}
+}
+
+// Returns the number of log entries dropped because the async queue was full
+unsigned long Logger::getDroppedCount()
+{
+	return droppedLogRecords.load(std::memory_order_relaxed);
+}
+
 //
 // Registration
 //
@@ -120,75 +306,75 @@ void Logger::registerTraceReceiver(GGKLogReceiver receiver) { Logger::logReceive
 //
 
 // Log a DEBUG entry with a C string
-void Logger::debug(const char *pText) { if (nullptr != Logger::logReceiverDebug) { Logger::logReceiverDebug(pText); } }
+void Logger::debug(const char *pText) { if (isDebugEnabled()) { deliver(Logger::logReceiverDebug, pText); } }
 
 // Log a DEBUG entry with a string
-void Logger::debug(const std::string &text) { if (nullptr != Logger::logReceiverDebug) { debug(text.c_str()); } }
+void Logger::debug(const std::string &text) { if (isDebugEnabled()) { debug(text.c_str()); } }
 
 // Log a DEBUG entry using a stream
-void Logger::debug(const std::ostream &text) { if (nullptr != Logger::logReceiverDebug) { debug(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::debug(const std::ostream &text) { if (isDebugEnabled()) { debug(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 // Log a INFO entry with a C string
-void Logger::info(const char *pText) { if (nullptr != Logger::logReceiverInfo) { Logger::logReceiverInfo(pText); } }
+void Logger::info(const char *pText) { if (isInfoEnabled()) { deliver(Logger::logReceiverInfo, pText); } }
 
 // Log a INFO entry with a string
-void Logger::info(const std::string &text) { if (nullptr != Logger::logReceiverInfo) { info(text.c_str()); } }
+void Logger::info(const std::string &text) { if (isInfoEnabled()) { info(text.c_str()); } }
 
 // Log a INFO entry using a stream
-void Logger::info(const std::ostream &text) { if (nullptr != Logger::logReceiverInfo) { info(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::info(const std::ostream &text) { if (isInfoEnabled()) { info(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 // Log a STATUS entry with a C string
-void Logger::status(const char *pText) { if (nullptr != Logger::logReceiverStatus) { Logger::logReceiverStatus(pText); } }
+void Logger::status(const char *pText) { if (isStatusEnabled()) { deliver(Logger::logReceiverStatus, pText); } }
 
 // Log a STATUS entry with a string
-void Logger::status(const std::string &text) { if (nullptr != Logger::logReceiverStatus) { status(text.c_str()); } }
+void Logger::status(const std::string &text) { if (isStatusEnabled()) { status(text.c_str()); } }
 
 // Log a STATUS entry using a stream
-void Logger::status(const std::ostream &text) { if (nullptr != Logger::logReceiverStatus) { status(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::status(const std::ostream &text) { if (isStatusEnabled()) { status(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 // Log a WARN entry with a C string
-void Logger::warn(const char *pText) { if (nullptr != Logger::logReceiverWarn) { Logger::logReceiverWarn(pText); } }
+void Logger::warn(const char *pText) { if (isWarnEnabled()) { deliver(Logger::logReceiverWarn, pText); } }
 
 // Log a WARN entry with a string
-void Logger::warn(const std::string &text) { if (nullptr != Logger::logReceiverWarn) { warn(text.c_str()); } }
+void Logger::warn(const std::string &text) { if (isWarnEnabled()) { warn(text.c_str()); } }
 
 // Log a WARN entry using a stream
-void Logger::warn(const std::ostream &text) { if (nullptr != Logger::logReceiverWarn) { warn(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::warn(const std::ostream &text) { if (isWarnEnabled()) { warn(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 // Log a ERROR entry with a C string
-void Logger::error(const char *pText) { if (nullptr != Logger::logReceiverError) { Logger::logReceiverError(pText); } }
+void Logger::error(const char *pText) { if (isErrorEnabled()) { deliver(Logger::logReceiverError, pText); } }
 
 // Log a ERROR entry with a string
-void Logger::error(const std::string &text) { if (nullptr != Logger::logReceiverError) { error(text.c_str()); } }
+void Logger::error(const std::string &text) { if (isErrorEnabled()) { error(text.c_str()); } }
 
 // Log a ERROR entry using a stream
-void Logger::error(const std::ostream &text) { if (nullptr != Logger::logReceiverError) { error(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::error(const std::ostream &text) { if (isErrorEnabled()) { error(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 // Log a FATAL entry with a C string
-void Logger::fatal(const char *pText) { if (nullptr != Logger::logReceiverFatal) { Logger::logReceiverFatal(pText); } }
+void Logger::fatal(const char *pText) { if (isFatalEnabled()) { deliver(Logger::logReceiverFatal, pText); } }
 
 // Log a FATAL entry with a string
-void Logger::fatal(const std::string &text) { if (nullptr != Logger::logReceiverFatal) { fatal(text.c_str()); } }
+void Logger::fatal(const std::string &text) { if (isFatalEnabled()) { fatal(text.c_str()); } }
 
 // Log a FATAL entry using a stream
-void Logger::fatal(const std::ostream &text) { if (nullptr != Logger::logReceiverFatal) { fatal(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::fatal(const std::ostream &text) { if (isFatalEnabled()) { fatal(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 // Log a ALWAYS entry with a C string
-void Logger::always(const char *pText) { if (nullptr != Logger::logReceiverAlways) { Logger::logReceiverAlways(pText); } }
+void Logger::always(const char *pText) { if (isAlwaysEnabled()) { deliver(Logger::logReceiverAlways, pText); } }
 
 // Log a ALWAYS entry with a string
-void Logger::always(const std::string &text) { if (nullptr != Logger::logReceiverAlways) { always(text.c_str()); } }
+void Logger::always(const std::string &text) { if (isAlwaysEnabled()) { always(text.c_str()); } }
 
 // Log a ALWAYS entry using a stream
-void Logger::always(const std::ostream &text) { if (nullptr != Logger::logReceiverAlways) { always(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::always(const std::ostream &text) { if (isAlwaysEnabled()) { always(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 // Log a TRACE entry with a C string
-void Logger::trace(const char *pText) { if (nullptr != Logger::logReceiverTrace) { Logger::logReceiverTrace(pText); } }
+void Logger::trace(const char *pText) { if (isTraceEnabled()) { deliver(Logger::logReceiverTrace, pText); } }
 
 // Log a TRACE entry with a string
-void Logger::trace(const std::string &text) { if (nullptr != Logger::logReceiverTrace) { trace(text.c_str()); } }
+void Logger::trace(const std::string &text) { if (isTraceEnabled()) { trace(text.c_str()); } }
 
 // Log a TRACE entry using a stream
-void Logger::trace(const std::ostream &text) { if (nullptr != Logger::logReceiverTrace) { trace(static_cast<const std::ostringstream &>(text).str().c_str()); } }
+void Logger::trace(const std::ostream &text) { if (isTraceEnabled()) { trace(static_cast<const std::ostringstream &>(text).str().c_str()); } }
 
 }; // namespace ggk
\ No newline at end of file
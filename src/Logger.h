@@ -24,6 +24,7 @@
 #pragma once
 
 #include <sstream>
+#include <stddef.h>
 
 #include "../include/Gobbledegook.h"
 
@@ -32,6 +33,41 @@ namespace ggk {
 // Our handy stringstream macro
 #define SSTR std::ostringstream().flush()
 
+// Log levels, used to set a compile-time minimum logging level (see `GGK_LOG_MIN_LEVEL`)
+#define GGK_LOG_LEVEL_TRACE  0
+#define GGK_LOG_LEVEL_DEBUG  1
+#define GGK_LOG_LEVEL_INFO   2
+#define GGK_LOG_LEVEL_STATUS 3
+#define GGK_LOG_LEVEL_WARN   4
+#define GGK_LOG_LEVEL_ERROR  5
+#define GGK_LOG_LEVEL_FATAL  6
+
+// The minimum level of log entries compiled into the library
+//
+// Log entries below this level are discarded without being formatted, and those made through the `GGK_LOG_*` macros are removed
+// from the build entirely. For example, build with `-DGGK_LOG_MIN_LEVEL=GGK_LOG_LEVEL_INFO` to strip debug and trace logging from
+// release builds. ALWAYS entries are never stripped.
+#ifndef GGK_LOG_MIN_LEVEL
+#define GGK_LOG_MIN_LEVEL GGK_LOG_LEVEL_TRACE
+#endif
+
+// Lazy logging macros
+//
+// These accept a stream expression, as would follow `SSTR`, and only format it if the entry will be logged (its level is compiled
+// in and a receiver is registered for it.) Use these on hot paths in place of `Logger::info(SSTR << ...)`, which formats the
+// message before the receiver is checked:
+//
+//     GGK_LOG_INFO("Read " << count << " bytes");
+#define GGK_LOG(enabled, log, message) do { if (enabled) { log(SSTR << message); } } while (0)
+#define GGK_LOG_TRACE(message)  GGK_LOG(ggk::Logger::isTraceEnabled(), ggk::Logger::trace, message)
+#define GGK_LOG_DEBUG(message)  GGK_LOG(ggk::Logger::isDebugEnabled(), ggk::Logger::debug, message)
+#define GGK_LOG_INFO(message)   GGK_LOG(ggk::Logger::isInfoEnabled(), ggk::Logger::info, message)
+#define GGK_LOG_STATUS(message) GGK_LOG(ggk::Logger::isStatusEnabled(), ggk::Logger::status, message)
+#define GGK_LOG_WARN(message)   GGK_LOG(ggk::Logger::isWarnEnabled(), ggk::Logger::warn, message)
+#define GGK_LOG_ERROR(message)  GGK_LOG(ggk::Logger::isErrorEnabled(), ggk::Logger::error, message)
+#define GGK_LOG_FATAL(message)  GGK_LOG(ggk::Logger::isFatalEnabled(), ggk::Logger::fatal, message)
+#define GGK_LOG_ALWAYS(message) GGK_LOG(ggk::Logger::isAlwaysEnabled(), ggk::Logger::always, message)
+
 class Logger
 {
 public:
@@ -73,6 +109,45 @@ public:
 	static void registerTraceReceiver(GGKLogReceiver receiver);
 
 
+	//
+	// Asynchronous delivery
+	//
+
+	// The longest log entry (including the terminator) that async delivery carries; longer entries are truncated
+	static const int kMaxAsyncRecordLength = 512;
+
+	// The number of log entries that can be waiting for async delivery before new entries are dropped
+	static const size_t kAsyncQueueCapacity = 512;
+
+	// Enables or disables asynchronous log delivery
+	//
+	// When enabled, log entries are copied into a bounded, lock-free queue and delivered to their receivers from a background
+	// thread, so that a slow receiver never blocks the thread that is logging. If the queue is full, the entry is dropped and
+	// counted (see `getDroppedCount()`.)
+	//
+	// Disabling async delivery waits for the background thread to deliver any queued entries before receivers are called
+	// directly again, so that entries reach them in order.
+	static void setAsync(bool enable);
+
+	// Returns the number of log entries dropped because the async queue was full
+	static unsigned long getDroppedCount();
+
+	//
+	// Level checks
+	//
+	// Each returns true if entries at that level are compiled in and have a registered receiver. A level that is compiled out
+	// is a constant false, so code guarded by it is removed entirely.
+	//
+
+	static bool isTraceEnabled() { return GGK_LOG_MIN_LEVEL <= GGK_LOG_LEVEL_TRACE && nullptr != logReceiverTrace; }
+	static bool isDebugEnabled() { return GGK_LOG_MIN_LEVEL <= GGK_LOG_LEVEL_DEBUG && nullptr != logReceiverDebug; }
+	static bool isInfoEnabled() { return GGK_LOG_MIN_LEVEL <= GGK_LOG_LEVEL_INFO && nullptr != logReceiverInfo; }
+	static bool isStatusEnabled() { return GGK_LOG_MIN_LEVEL <= GGK_LOG_LEVEL_STATUS && nullptr != logReceiverStatus; }
+	static bool isWarnEnabled() { return GGK_LOG_MIN_LEVEL <= GGK_LOG_LEVEL_WARN && nullptr != logReceiverWarn; }
+	static bool isErrorEnabled() { return GGK_LOG_MIN_LEVEL <= GGK_LOG_LEVEL_ERROR && nullptr != logReceiverError; }
+	static bool isFatalEnabled() { return GGK_LOG_MIN_LEVEL <= GGK_LOG_LEVEL_FATAL && nullptr != logReceiverFatal; }
+	static bool isAlwaysEnabled() { return nullptr != logReceiverAlways; }
+
 	//
 	// Logging actions
 	//
@@ -151,6 +226,9 @@ public:
 
 private:
 
+	// Delivers a log entry to a receiver, either directly or (in async mode) through the async sink
+	static void deliver(GGKLogReceiver receiver, const char *pText);
+
 	// The registered log receiver for DEBUG logs - a nullptr will cause the logging for that receiver to be ignored
 	static GGKLogReceiver logReceiverDebug;
 
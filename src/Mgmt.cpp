@@ -24,6 +24,7 @@
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <string.h>
+#include <algorithm>
 
 #include "Mgmt.h"
 #include "Logger.h"
@@ -31,14 +32,158 @@
 
 namespace ggk {
 
+// AD types used in our advertising (see "Generic Access Profile" in the Bluetooth Assigned Numbers)
+static const uint8_t kAdTypeIncomplete128BitServices = 0x06;
+static const uint8_t kAdTypeShortenedLocalName = 0x08;
+static const uint8_t kAdTypeCompleteLocalName = 0x09;
+static const uint8_t kAdTypeClassOfDevice = 0x0D;
+
+// The bytes taken from our advertising data by each AD structure the controller adds itself (the flags and TX power)
+static const size_t kAutomaticAdStructureSize = 3;
+
+// The most advertising data an application's instance may have, leaving room for both of the controller's own AD structures
+static const size_t kMaxApplicationAdvertisingDataLength = Mgmt::AdvertisingData::kMaxLength - 2 * kAutomaticAdStructureSize;
+
+// The class of device we advertise
+static const uint8_t kAdvertisedClassOfDevice[] = { 0x20, 0x04, 0x14 };
+
+// The service listed in our scan response, 8e7934bd-f06d-48f6-8604-83c94e0ec8f9 (in the little-endian order used by AD data)
+static const uint8_t kAdvertisedServiceUuid[] =
+{
+	0xf9, 0xc8, 0x0e, 0x4e, 0xc9, 0x83, 0x04, 0x86, 0xf6, 0x48, 0x6d, 0xf0, 0xbd, 0x34, 0x79, 0x8e
+};
+
+std::map<uint16_t, Mgmt::AdvertisingState> Mgmt::advertisingStates;
+std::mutex Mgmt::advertisingStatesMutex;
+std::map<uint8_t, Mgmt::AdvertisingInstance> Mgmt::applicationInstances;
+std::mutex Mgmt::applicationInstancesMutex;
+
+// Adds an AD structure of the given type
+//
+// Returns true if it was added, or false if it doesn't fit
+bool Mgmt::AdvertisingData::add(uint8_t type, const void *pData, size_t size)
+{
+	if (bytes.size() + 2 + size > capacity)
+	{
+		return false;
+	}
+
+	const uint8_t *pBytes = static_cast<const uint8_t *>(pData);
+	bytes.push_back(static_cast<uint8_t>(size + 1));
+	bytes.push_back(type);
+	bytes.insert(bytes.end(), pBytes, pBytes + size);
+	return true;
+}
+
+// Adds the name as a complete local name, or as a shortened local name with as much of it as fits
+//
+// Returns true if any of the name was added, otherwise false
+bool Mgmt::AdvertisingData::addName(const std::string &name)
+{
+	if (name.empty())
+	{
+		return false;
+	}
+
+	if (add(kAdTypeCompleteLocalName, name.data(), name.length()))
+	{
+		return true;
+	}
+
+	size_t room = capacity > bytes.size() + 2 ? capacity - bytes.size() - 2 : 0;
+	return room > 0 && add(kAdTypeShortenedLocalName, name.data(), std::min(room, name.length()));
+}
+
 // Construct the Mgmt device
 //
 // Set `controllerIndex` to the zero-based index of the device as recognized by the OS. If this parameter is omitted, the index
 // of the first device (0) will be used.
-Mgmt::Mgmt(uint16_t controllerIndex)
-: controllerIndex(controllerIndex)
+Mgmt::Mgmt(uint16_t controllerIndex, bool syncController)
+: controllerIndex(controllerIndex), pipelined(false)
+{
+	if (syncController)
+	{
+		HciAdapter::getInstance().sync(controllerIndex);
+	}
+}
+
+// Begins pipelining the commands sent through this object
+//
+// Normally each command waits for the adapter's response before returning. While pipelining, the setting methods send their
+// command and return immediately, so a series of settings costs a single round-trip rather than one per command.
+//
+// Don't pipeline power changes. The kernel completes those asynchronously, and rejects other commands as busy (or a second
+// power change) while one is pending, so a power change should be sent on its own, waiting for its response, before or after
+// the pipeline.
+//
+// Because the setting methods can't report a failure that hasn't happened yet, call `endPipeline()` to wait for the results.
+void Mgmt::beginPipeline()
+{
+	pipelined = true;
+}
+
+// Waits for every command sent since `beginPipeline()` and ends pipelining
+//
+// Returns true if every one of them succeeded, otherwise false
+bool Mgmt::endPipeline()
+{
+	bool success = true;
+	for (std::future<HciAdapter::CommandResult> &future : inFlight)
+	{
+		if (!checkResult(future.get()))
+		{
+			success = false;
+		}
+	}
+
+	inFlight.clear();
+	pipelined = false;
+
+	// Our advertising instances are only recorded once the controller accepts them, but a failed command may have left the
+	// controller in a state we don't know, so it all needs to be sent again
+	if (!success)
+	{
+		invalidateAdvertising();
+	}
+
+	return success;
+}
+
+// Sends a command, either waiting for its response or (when pipelining) adding it to our in-flight commands
+//
+// `callback` (if any) receives the command's result once it arrives, from the adapter's event thread.
+//
+// Returns true on success (or, when pipelining, if the command was sent), otherwise false
+bool Mgmt::send(HciAdapter::HciHeader &request, HciAdapter::CommandCallback callback)
+{
+	std::future<HciAdapter::CommandResult> future = HciAdapter::getInstance().sendCommandAsync(request, callback);
+	if (!pipelined)
+	{
+		return checkResult(future.get());
+	}
+
+	inFlight.push_back(std::move(future));
+	return true;
+}
+
+// Returns true if a command succeeded, otherwise logs why it didn't and returns false
+bool Mgmt::checkResult(const HciAdapter::CommandResult &result)
 {
-	HciAdapter::getInstance().sync(controllerIndex);
+	const char *pCommandName = HciAdapter::getCommandCodeName(result.commandCode);
+	if (!result.responded)
+	{
+		Logger::warn(SSTR << "  + No response to " << pCommandName);
+		return false;
+	}
+
+	if (0 != result.status)
+	{
+		const char *pStatusName = result.status <= HciAdapter::kMaxStatusCode ? HciAdapter::kStatusCodes[result.status] : "Unknown";
+		Logger::warn(SSTR << "  + " << pCommandName << " failed with status " << Utils::hex(result.status) << " (" << pStatusName << ")");
+		return false;
+	}
+
+	return true;
 }
 
 // Set the adapter name and short name
@@ -71,7 +216,7 @@ bool Mgmt::setName(std::string name, std::string shortName)
 	memset(request.shortName, 0, sizeof(request.shortName));
 	snprintf(request.shortName, sizeof(request.shortName), "%s", shortName.c_str());
 
-	if (!HciAdapter::getInstance().sendCommand(request))
+	if (!send(request))
 	{
 		Logger::warn(SSTR << "  + Failed to set name");
 		return false;
@@ -100,7 +245,7 @@ bool Mgmt::setDiscoverable(uint8_t disc, uint16_t timeout)
 	request.disc = disc;
 	request.timeout = timeout;
 
-	if (!HciAdapter::getInstance().sendCommand(request))
+	if (!send(request))
 	{
 		Logger::warn(SSTR << "  + Failed to set discoverable");
 		return false;
@@ -127,7 +272,7 @@ bool Mgmt::setState(uint16_t commandCode, uint16_t controllerId, uint8_t newStat
 	request.dataSize = sizeof(SRequest) - sizeof(HciAdapter::HciHeader);
 	request.state = newState;
 
-	if (!HciAdapter::getInstance().sendCommand(request))
+	if (!send(request))
 	{
 		Logger::warn(SSTR << "  + Failed to set " << HciAdapter::kCommandCodeNames[commandCode] << " state to: " << static_cast<int>(newState));
 		return false;
@@ -141,6 +286,12 @@ bool Mgmt::setState(uint16_t commandCode, uint16_t controllerId, uint8_t newStat
 // Returns true on success, otherwise false
 bool Mgmt::setPowered(bool newState)
 {
+	// Our advertising doesn't survive the power cycle
+	if (!newState)
+	{
+		invalidateAdvertising();
+	}
+
 	return setState(Mgmt::ESetPoweredCommand, controllerIndex, newState ? 1 : 0);
 }
 
@@ -218,144 +369,194 @@ bool Mgmt::setFC(bool newState)
 
 // Sets a custom advertising using addAdvertising if newState > 0. otherwise calls delAdvertising and setAdvertising(0)
 //
+// The advertising data is cached per controller (see `setAdvertisingInstance()`), so calling this again with the same settings
+// sends nothing, and a change only updates the instances it affects.
+//
 // Returns true on success, otherwise false
 bool Mgmt::setAdvertising(bool newState, std::string name, std::string shortName)
 {
-    // addAdvertising only works if setAdvertising (the automatic advertiser) is turned off
-    if(!setState(Mgmt::ESetAdvertisingCommand, controllerIndex, 0)) {
-        Logger::error(SSTR << "Failed to setAdvertising to 0");
-        return false;
-    }
+	AdvertisingState *pState = getAdvertisingState();
+	if (nullptr == pState)
+	{
+		return false;
+	}
 
-    // Get the Advertising Features to see what we can do.
-    HciAdapter::HciHeader readAdvCmd;
-    readAdvCmd.code = Mgmt::EReadAdvertisingFeaturesCommand;
-    readAdvCmd.controllerId = controllerIndex;
-    readAdvCmd.dataSize = 0;
-    if(!HciAdapter::getInstance().sendCommand(readAdvCmd)) {
-        Logger::error(SSTR << "Failed to send ReadAdvertisingFeaturesCommand");
-        return false;
-    }
+	// addAdvertising only works if setAdvertising (the automatic advertiser) is turned off
+	bool automaticAdvertisingOff;
+	{
+		std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+		automaticAdvertisingOff = pState->automaticAdvertisingOff;
+	}
 
-    // TODO: this was the return from the previous command (not sure if this is synchronous here, i may have created an issue)
-    HciAdapter::AdvertisingFeatures availableFeatures = HciAdapter::getInstance().getAdvertisingFeatures();
-    Logger::warn(SSTR << "FEATURES FLAGS ARE " << Utils::hex(availableFeatures.supportedFlags.masks));
-
-    // if there were any previous addAdvertising pages, remove them
-    if( availableFeatures.numInstances != 0 ) {
-        struct RemRequest : HciAdapter::HciHeader
-        {
-            uint8_t instance;
-        } __attribute__((packed));
-
-        int numToRemove = availableFeatures.numInstances;
-        std::vector<uint8_t> instanceNums;
-        for(int i = 0; i < numToRemove; i++) {
-            instanceNums.push_back(availableFeatures.instanceRef[i]);
-        }
-        for(uint8_t instanceNum : instanceNums) {
-            RemRequest removeAdvCmd;
-            removeAdvCmd.code = Mgmt::ERemoveAdvertisingCommand;
-            removeAdvCmd.controllerId = controllerIndex;
-            removeAdvCmd.dataSize = 1;
-            removeAdvCmd.instance = instanceNum;
-            if(!HciAdapter::getInstance().sendCommand(removeAdvCmd)) {
-                Logger::error(SSTR << "Failed to send RemoveAdvertisingCommand");
-                return false;
-            }
-        }
-    }
+	if (!automaticAdvertisingOff)
+	{
+		if (!setState(Mgmt::ESetAdvertisingCommand, controllerIndex, 0))
+		{
+			Logger::error(SSTR << "Failed to setAdvertising to 0");
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+		pState->automaticAdvertisingOff = true;
+	}
 
-    // if any advertising was wanted, add custom attributes
-    if( newState ) {
-        HciAdapter::AdvertisingSettings wantedFeatures;
-        wantedFeatures.masks = HciAdapter::EAdvSwitchConnectable | HciAdapter::EAdvDiscoverable |
-               HciAdapter::EAdvAddFlags | HciAdapter::EAdvAddTX;
-        // Dont use HciAdapter::EAdvAddLocalName (automatic name adding) or this will fail below (we are manually putting names in)
-        // Dont use HciAdapter::EAdvAddAppearance (automatic appearance/CoD) or this will fail (we are manually adding CoD)
-
-        // 0x06 incomplete 128bit service list
-        // 0x09 full name
-        // 0x08 short name
-        // 0x0D class of device (3 bytes) (possibly sent in GAP appearance?)
-
-        // only turn on the features that are available
-        wantedFeatures.masks &= availableFeatures.supportedFlags.masks;
-        Logger::warn(SSTR << "ACTIVATED FEATURES FLAGS ARE " << Utils::hex(wantedFeatures.masks));
-        wantedFeatures.toNetwork();
-        // 18 bytes for full name "Doppler-12345678"
-        // 5 bytes for CoD
-        const int ADV_DATA_LEN = 23; //31 bytes max
-
-        // 9 bytes for short name "Doppler"
-        // 18 bytes for service list
-        const int SCAN_RESP_LEN = 27; //27 bytes max (4 of them were used for flags and tx)
-
-        struct SRequest : HciAdapter::HciHeader
-        {
-            uint8_t instance;
-            HciAdapter::AdvertisingSettings flags;
-            uint16_t duration;
-            uint16_t timeout;
-            uint8_t advDataLen;
-            uint8_t scanRespLen;
-            uint8_t advData[ADV_DATA_LEN];
-            uint8_t scanResp[SCAN_RESP_LEN];
-        } __attribute__((packed));
-
-        SRequest request;
-        request.code = Mgmt::EAddAdvertisingCommand;
-        request.controllerId = controllerIndex;
-        request.dataSize = sizeof(SRequest) - sizeof(HciAdapter::HciHeader);
-        // USE 1 for now, assume no other instances exist
-        request.instance = 1;
-        request.flags = wantedFeatures;
-        request.duration = 0;
-        request.timeout = 0;
-        request.advDataLen = ADV_DATA_LEN;
-        request.scanRespLen = SCAN_RESP_LEN;
-
-        request.advData[0] = 17;
-        request.advData[1] = 0x09; // full name
-        memcpy(request.advData + 2, name.c_str(), 16);
-
-        // TODO: this doesnt seem to work
-        request.advData[18] = 4;
-        request.advData[19] = 0x0D; // CoD
-        request.advData[20] = 0x20;
-        request.advData[21] = 0x04;
-        request.advData[22] = 0x14;
-
-        request.scanResp[0] = 17;
-        request.scanResp[1] = 0x06; // incomplete service list
-        // 0x8e7934bdf06d48f6860483c94e0ec8f9
-        request.scanResp[2] = 0xf9;
-        request.scanResp[3] = 0xc8;
-        request.scanResp[4] = 0x0e;
-        request.scanResp[5] = 0x4e;
-        request.scanResp[6] = 0xc9;
-        request.scanResp[7] = 0x83;
-        request.scanResp[8] = 0x04;
-        request.scanResp[9] = 0x86;
-        request.scanResp[10] = 0xf6;
-        request.scanResp[11] = 0x48;
-        request.scanResp[12] = 0x6d;
-        request.scanResp[13] = 0xf0;
-        request.scanResp[14] = 0xbd;
-        request.scanResp[15] = 0x34;
-        request.scanResp[16] = 0x79;
-        request.scanResp[17] = 0x8e;
-
-        request.scanResp[18] = 8;
-        request.scanResp[19] = 0x08; // short name
-        // note: the shortName string is not used because it must match EXACTLY the
-        //  first characters of the long name or it will be rejected
-        memcpy(request.scanResp + 20, name.c_str(), 7);
-
-        return(HciAdapter::getInstance().sendCommand(request));
-    }
+	// Take down all of our instances
+	if (!newState)
+	{
+		std::vector<uint8_t> instances;
+		{
+			std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+			for (const auto &entry : pState->instances)
+			{
+				instances.push_back(entry.first);
+			}
+		}
+
+		for (uint8_t instance : instances)
+		{
+			if (!removeAdvertising(instance)) { return false; }
+		}
+
+		return true;
+	}
+
+	// The class of device, followed by as much of our name as fits
+	//
+	// TODO: the class of device doesn't seem to work
+	AdvertisingData advertisingData(getAdvertisingCapacity(*pState));
+	advertisingData.add(kAdTypeClassOfDevice, kAdvertisedClassOfDevice, sizeof(kAdvertisedClassOfDevice));
+	advertisingData.addName(name);
+
+	// Our service, followed by our short name
+	//
+	// Note: the shortName string is not used because it must match EXACTLY the first characters of the long name or it will be
+	// rejected. Instead, we use that many characters from the start of the long name.
+	AdvertisingData scanResponse(pState->maxScanResponseLength);
+	scanResponse.add(kAdTypeIncomplete128BitServices, kAdvertisedServiceUuid, sizeof(kAdvertisedServiceUuid));
+	if (!shortName.empty())
+	{
+		scanResponse.add(kAdTypeShortenedLocalName, name.data(), std::min(name.length(), shortName.length()));
+	}
+
+	if (!setAdvertisingInstance(kServerAdvertisingInstance, advertisingData.getBytes(), scanResponse.getBytes()))
+	{
+		return false;
+	}
+
+	return applyApplicationAdvertising();
+}
+
+// Returns how much advertising data the controller described by `state` accepts from us
+//
+// The controller adds the flags and TX power to our advertising data itself (see `setAdvertisingInstance()`), which leaves less
+// room for ours. A controller reporting less room than those take leaves us none.
+size_t Mgmt::getAdvertisingCapacity(const AdvertisingState &state)
+{
+	size_t reserved = 0;
+	if (0 != (state.supportedFlags & HciAdapter::EAdvAddFlags)) { reserved += kAutomaticAdStructureSize; }
+	if (0 != (state.supportedFlags & HciAdapter::EAdvAddTX)) { reserved += kAutomaticAdStructureSize; }
+
+	return state.maxAdvertisingDataLength > reserved ? state.maxAdvertisingDataLength - reserved : 0;
+}
+
+// Adds an advertising instance to the controller, or updates it in place if it already exists
+//
+// The controller rotates between its instances, advertising each for `durationSeconds` (zero uses the controller's default.) If
+// the instance was last sent with exactly the same data, nothing is sent.
+//
+// Returns true on success, otherwise false
+bool Mgmt::setAdvertisingInstance(uint8_t instance, const std::vector<uint8_t> &advertisingData, const std::vector<uint8_t> &scanResponse, uint16_t durationSeconds)
+{
+	AdvertisingState *pState = getAdvertisingState();
+	if (nullptr == pState)
+	{
+		return false;
+	}
+
+	size_t advertisingCapacity = getAdvertisingCapacity(*pState);
+	if (advertisingData.size() > advertisingCapacity || scanResponse.size() > pState->maxScanResponseLength)
+	{
+		Logger::error(SSTR << "Advertising instance " << static_cast<int>(instance) << " has too much data for this controller (at most " << advertisingCapacity << " bytes of advertising data and " << static_cast<int>(pState->maxScanResponseLength) << " bytes of scan response)");
+		return false;
+	}
+
+	// Dont use HciAdapter::EAdvAddLocalName (automatic name adding) or this will fail (we are manually putting names in)
+	// Dont use HciAdapter::EAdvAddAppearance (automatic appearance/CoD) or this will fail (we are manually adding CoD)
+	//
+	// Only turn on the features that are available
+	HciAdapter::AdvertisingSettings flags;
+	flags.masks = HciAdapter::EAdvSwitchConnectable | HciAdapter::EAdvDiscoverable | HciAdapter::EAdvAddFlags | HciAdapter::EAdvAddTX;
+	flags.masks &= pState->supportedFlags;
+	flags.toNetwork();
+
+	struct SParameters
+	{
+		uint8_t instance;
+		HciAdapter::AdvertisingSettings flags;
+		uint16_t duration;
+		uint16_t timeout;
+		uint8_t advDataLen;
+		uint8_t scanRespLen;
+	} __attribute__((packed));
+
+	SParameters parameters;
+	parameters.instance = instance;
+	parameters.flags = flags;
+	parameters.duration = Utils::endianToHci(durationSeconds);
+	parameters.timeout = 0;
+	parameters.advDataLen = static_cast<uint8_t>(advertisingData.size());
+	parameters.scanRespLen = static_cast<uint8_t>(scanResponse.size());
+
+	// The command's parameters are followed by the data itself
+	const uint8_t *pParameters = reinterpret_cast<const uint8_t *>(&parameters);
+	std::vector<uint8_t> encoded(pParameters, pParameters + sizeof(parameters));
+	encoded.insert(encoded.end(), advertisingData.begin(), advertisingData.end());
+	encoded.insert(encoded.end(), scanResponse.begin(), scanResponse.end());
+
+	// Nothing to do if the controller already has exactly this
+	{
+		std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+		std::vector<uint8_t> &applied = pState->instances[instance];
+		if (applied == encoded)
+		{
+			GGK_LOG_DEBUG("  + Advertising instance " << static_cast<int>(instance) << " is unchanged");
+			return true;
+		}
+
+		// Until the controller accepts the new data, we don't know what it has
+		applied.clear();
+	}
 
-    return false;
+	std::vector<uint8_t> command(sizeof(HciAdapter::HciHeader) + encoded.size());
+	HciAdapter::HciHeader &request = *reinterpret_cast<HciAdapter::HciHeader *>(command.data());
+	request.code = Mgmt::EAddAdvertisingCommand;
+	request.controllerId = controllerIndex;
+	request.dataSize = static_cast<uint16_t>(encoded.size());
+	memcpy(command.data() + sizeof(HciAdapter::HciHeader), encoded.data(), encoded.size());
+
+	// Adding an instance that already exists replaces its data in place, without taking it (or any of our other instances) off
+	// the air
+	//
+	// The data is only recorded as applied once the controller reports success, which (when pipelining) arrives on the adapter's
+	// event thread after we have returned
+	uint16_t index = controllerIndex;
+	HciAdapter::CommandCallback recordApplied = [index, instance, encoded](const HciAdapter::CommandResult &result)
+	{
+		if (result.responded && 0 == result.status)
+		{
+			std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+			advertisingStates[index].instances[instance] = encoded;
+		}
+	};
+
+	Logger::info(SSTR << "  + Setting advertising instance " << static_cast<int>(instance));
+	if (!send(request, recordApplied))
+	{
+		Logger::error(SSTR << "Failed to send AddAdvertisingCommand");
+		return false;
+	}
+
+	return true;
 }
 
 bool Mgmt::removeAdvertising(uint8_t instance)
@@ -365,18 +566,183 @@ bool Mgmt::removeAdvertising(uint8_t instance)
                 uint8_t instance;
             } __attribute__((packed));
 
+    {
+        std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+        advertisingStates[controllerIndex].instances.erase(instance);
+    }
+
     SRequest removeAdvCmd;
     removeAdvCmd.code=ERemoveAdvertisingCommand;
     removeAdvCmd.controllerId = controllerIndex;
     removeAdvCmd.dataSize = 1;
     removeAdvCmd.instance = instance;
-    if(!HciAdapter::getInstance().sendCommand(removeAdvCmd)) {
+    if(!send(removeAdvCmd)) {
         Logger::error(SSTR << "Failed to send RemoveAdvertsingCommand");
         return false;
     }
     return true;
 }
 
+// Brings the controller's application advertising instances up to date with those requested through
+// `setApplicationAdvertisingInstance()`, sending only those that have changed
+//
+// Returns true on success, otherwise false
+bool Mgmt::applyApplicationAdvertising()
+{
+	std::map<uint8_t, AdvertisingInstance> requested;
+	{
+		std::lock_guard<std::mutex> lock(applicationInstancesMutex);
+		requested = applicationInstances;
+	}
+
+	AdvertisingState *pState = getAdvertisingState();
+	if (nullptr == pState)
+	{
+		return false;
+	}
+
+	// Take down any instances the application no longer wants
+	std::vector<uint8_t> unwanted;
+	{
+		std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+		for (const auto &entry : pState->instances)
+		{
+			if (kServerAdvertisingInstance != entry.first && requested.end() == requested.find(entry.first))
+			{
+				unwanted.push_back(entry.first);
+			}
+		}
+	}
+
+	for (uint8_t instance : unwanted)
+	{
+		if (!removeAdvertising(instance)) { return false; }
+	}
+
+	for (const auto &entry : requested)
+	{
+		const AdvertisingInstance &instance = entry.second;
+		if (!setAdvertisingInstance(entry.first, instance.advertisingData, instance.scanResponse, instance.durationSeconds))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Records an advertising instance of the application's own, to be advertised alongside the server's advertising
+//
+// This only records the instance; it is sent to each controller by `setAdvertising()` or `applyApplicationAdvertising()`. This
+// may be called from any thread.
+//
+// Returns false if `instance` is not available to the application
+bool Mgmt::setApplicationAdvertisingInstance(uint8_t instance, const std::vector<uint8_t> &advertisingData, const std::vector<uint8_t> &scanResponse, uint16_t durationSeconds)
+{
+	if (0 == instance || kServerAdvertisingInstance == instance)
+	{
+		Logger::error(SSTR << "Advertising instance " << static_cast<int>(instance) << " is not available to the application");
+		return false;
+	}
+
+	// The controller adds the flags and TX power to the advertising data (see `setAdvertisingInstance()`), so the application
+	// can't have all of it
+	if (advertisingData.size() > kMaxApplicationAdvertisingDataLength || scanResponse.size() > AdvertisingData::kMaxLength)
+	{
+		Logger::error(SSTR << "Advertising instance " << static_cast<int>(instance) << " has too much data (at most " << kMaxApplicationAdvertisingDataLength << " bytes of advertising data and " << AdvertisingData::kMaxLength << " bytes of scan response)");
+		return false;
+	}
+
+	AdvertisingInstance requested;
+	requested.advertisingData = advertisingData;
+	requested.scanResponse = scanResponse;
+	requested.durationSeconds = durationSeconds;
+
+	std::lock_guard<std::mutex> lock(applicationInstancesMutex);
+	applicationInstances[instance] = requested;
+	return true;
+}
+
+// Forgets an advertising instance recorded by `setApplicationAdvertisingInstance()`
+//
+// Returns false if there was no such instance
+bool Mgmt::removeApplicationAdvertisingInstance(uint8_t instance)
+{
+	std::lock_guard<std::mutex> lock(applicationInstancesMutex);
+	return applicationInstances.erase(instance) != 0;
+}
+
+// Returns our controller's advertising state, reading its advertising features (and removing any stale instances) if we haven't
+// already
+//
+// Returns nullptr on failure
+Mgmt::AdvertisingState *Mgmt::getAdvertisingState()
+{
+	AdvertisingState *pState;
+	{
+		std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+		pState = &advertisingStates[controllerIndex];
+		if (pState->featuresKnown)
+		{
+			return pState;
+		}
+	}
+
+	// Get the Advertising Features to see what we can do.
+	HciAdapter::HciHeader readAdvCmd;
+	readAdvCmd.code = Mgmt::EReadAdvertisingFeaturesCommand;
+	readAdvCmd.controllerId = controllerIndex;
+	readAdvCmd.dataSize = 0;
+	if(!HciAdapter::getInstance().sendCommand(readAdvCmd)) {
+		Logger::error(SSTR << "Failed to send ReadAdvertisingFeaturesCommand");
+		return nullptr;
+	}
+
+	// The adapter records the features before completing the command
+	HciAdapter::AdvertisingFeatures availableFeatures = HciAdapter::getInstance().getAdvertisingFeatures(controllerIndex);
+	Logger::info(SSTR << "Advertising feature flags are " << Utils::hex(availableFeatures.supportedFlags.masks));
+
+	bool staleInstancesRemoved;
+	{
+		std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+		pState->supportedFlags = availableFeatures.supportedFlags.masks;
+		pState->maxAdvertisingDataLength = std::min(static_cast<size_t>(availableFeatures.maxAdv), AdvertisingData::kMaxLength);
+		pState->maxScanResponseLength = std::min(static_cast<size_t>(availableFeatures.maxScanRsp), AdvertisingData::kMaxLength);
+		pState->featuresKnown = true;
+		staleInstancesRemoved = pState->staleInstancesRemoved;
+	}
+
+	// Remove any instances left over from before we started, which would otherwise be advertised alongside ours
+	if (!staleInstancesRemoved)
+	{
+		int count = std::min(static_cast<int>(availableFeatures.numInstances), static_cast<int>(sizeof(availableFeatures.instanceRef)));
+		for (int i = 0; i < count; ++i)
+		{
+			if (!removeAdvertising(availableFeatures.instanceRef[i])) { return nullptr; }
+		}
+
+		std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+		pState->staleInstancesRemoved = true;
+	}
+
+	return pState;
+}
+
+// Marks all of our controller's advertising as needing to be sent again, such as when the controller is powered off or a pipelined
+// command fails
+//
+// We keep track of which instances we added, so that they can still be removed.
+void Mgmt::invalidateAdvertising()
+{
+	std::lock_guard<std::mutex> lock(advertisingStatesMutex);
+	AdvertisingState &state = advertisingStates[controllerIndex];
+	state.automaticAdvertisingOff = false;
+	for (auto &entry : state.instances)
+	{
+		entry.second.clear();
+	}
+}
+
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Utilitarian
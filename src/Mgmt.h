@@ -27,6 +27,10 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
+#include <future>
+#include <map>
+#include <mutex>
 
 #include "HciAdapter.h"
 #include "Utils.h"
@@ -45,6 +49,11 @@ struct Mgmt
 	// The length of the controller's short name (not including null terminator)
 	static const int kMaxAdvertisingShortNameLength = 10;
 
+	// The advertising instance used for the server's own advertising (see `setAdvertising()`)
+	//
+	// Other instances are available to the application (see `setApplicationAdvertisingInstance()`.)
+	static const uint8_t kServerAdvertisingInstance = 1;
+
 	//
 	// Types
 	//
@@ -189,11 +198,60 @@ struct Mgmt
         EMGMT_STATUS_RFKILLED = 0x12
     };
 
+	// Advertising data (or a scan response), encoded as a series of AD structures
+	//
+	// Each AD structure is a length byte, a type byte and the data. Structures are only added if they fit in the capacity given
+	// at construction, which is the most the controller will accept for this data.
+	struct AdvertisingData
+	{
+		// The longest advertising data (or scan response) a legacy advertisement may carry
+		static const size_t kMaxLength = 31;
+
+		AdvertisingData(size_t capacity = kMaxLength) : capacity(capacity) {}
+
+		// Adds an AD structure of the given type
+		//
+		// Returns true if it was added, or false if it doesn't fit
+		bool add(uint8_t type, const void *pData, size_t size);
+
+		// Adds the name as a complete local name, or as a shortened local name with as much of it as fits
+		//
+		// Returns true if any of the name was added, otherwise false
+		bool addName(const std::string &name);
+
+		// Returns the encoded AD structures
+		const std::vector<uint8_t> &getBytes() const { return bytes; }
+
+	private:
+		size_t capacity;
+		std::vector<uint8_t> bytes;
+	};
+
 	// Construct the Mgmt device
 	//
 	// Set `controllerIndex` to the zero-based index of the device as recognized by the OS. If this parameter is omitted, the index
 	// of the first device (0) will be used.
-	Mgmt(uint16_t controllerIndex = kDefaultControllerIndex);
+	//
+	// Unless `syncController` is false, this reads the controller's current information from the adapter first, which costs
+	// a round-trip for each of a couple of commands.
+	Mgmt(uint16_t controllerIndex = kDefaultControllerIndex, bool syncController = true);
+
+	// Begins pipelining the commands sent through this object
+	//
+	// Normally each command waits for the adapter's response before returning. While pipelining, the setting methods send their
+	// command and return immediately, so a series of settings costs a single round-trip rather than one per command.
+	//
+	// Don't pipeline power changes. The kernel completes those asynchronously, and rejects other commands as busy (or a second
+	// power change) while one is pending, so a power change should be sent on its own, waiting for its response, before or
+	// after the pipeline.
+	//
+	// Because the setting methods can't report a failure that hasn't happened yet, call `endPipeline()` to wait for the results.
+	void beginPipeline();
+
+	// Waits for every command sent since `beginPipeline()` and ends pipelining
+	//
+	// Returns true if every one of them succeeded, otherwise false
+	bool endPipeline();
 
 	// Set the adapter name and short name
 	//
@@ -270,11 +328,43 @@ struct Mgmt
 
 	// Set the advertising state on or off and uses name/shortName if "on"
 	//
+	// When on, the server's advertising (see `kServerAdvertisingInstance`) and each of the application's advertising instances
+	// (see `setApplicationAdvertisingInstance()`) are added to the controller, which rotates between them. Only instances whose
+	// data has changed since they were last sent are sent again, and they are updated in place (so the others keep advertising.)
+	// When off, all of our instances are removed.
+	//
 	// Returns true on success, otherwise false
 	bool setAdvertising(bool newState, std::string name, std::string shortName);
 
-	//Calls the bluez API's remove advertising call
+	// Adds an advertising instance to the controller, or updates it in place if it already exists
+	//
+	// The controller rotates between its instances, advertising each for `durationSeconds` (zero uses the controller's
+	// default.) If the instance was last sent with exactly the same data, nothing is sent.
+	//
+	// Returns true on success, otherwise false
+	bool setAdvertisingInstance(uint8_t instance, const std::vector<uint8_t> &advertisingData, const std::vector<uint8_t> &scanResponse, uint16_t durationSeconds = 0);
+
+	// Calls the bluez API's remove advertising call
 	bool removeAdvertising(uint8_t instance);
+
+	// Brings the controller's application advertising instances up to date with those requested through
+	// `setApplicationAdvertisingInstance()`, sending only those that have changed
+	//
+	// Returns true on success, otherwise false
+	bool applyApplicationAdvertising();
+
+	// Records an advertising instance of the application's own, to be advertised alongside the server's advertising
+	//
+	// This only records the instance; it is sent to each controller by `setAdvertising()` or `applyApplicationAdvertising()`.
+	// This may be called from any thread.
+	//
+	// Returns false if `instance` is not available to the application
+	static bool setApplicationAdvertisingInstance(uint8_t instance, const std::vector<uint8_t> &advertisingData, const std::vector<uint8_t> &scanResponse, uint16_t durationSeconds);
+
+	// Forgets an advertising instance recorded by `setApplicationAdvertisingInstance()`
+	//
+	// Returns false if there was no such instance
+	static bool removeApplicationAdvertisingInstance(uint8_t instance);
 	//
 	// Utilitarian
 	//
@@ -296,6 +386,74 @@ private:
 	// The default controller index (the first device)
 	uint16_t controllerIndex;
 
+	// Pipelining state (see `beginPipeline()`)
+	bool pipelined;
+	std::vector<std::future<HciAdapter::CommandResult>> inFlight;
+
+	// An advertising instance, as requested by the application (see `setApplicationAdvertisingInstance()`)
+	struct AdvertisingInstance
+	{
+		std::vector<uint8_t> advertisingData;
+		std::vector<uint8_t> scanResponse;
+		uint16_t durationSeconds;
+	};
+
+	// What we know of a controller's advertising, kept from one `Mgmt` object to the next
+	//
+	// Mgmt objects are used from the server's thread and from the threads that update advertising, and our commands complete on
+	// the adapter's event thread, so every access goes through `advertisingStatesMutex`. The exception is the advertising
+	// features, which are written once (before `featuresKnown` is set, under the lock) and never change after that.
+	struct AdvertisingState
+	{
+		// The controller's advertising features, read once
+		bool featuresKnown = false;
+		uint32_t supportedFlags = 0;
+		uint8_t maxAdvertisingDataLength = 0;
+		uint8_t maxScanResponseLength = 0;
+
+		// True once we have removed any instances left over from before we started
+		bool staleInstancesRemoved = false;
+
+		// True once we have turned off the controller's own advertising (which custom instances require)
+		bool automaticAdvertisingOff = false;
+
+		// The parameters of the Add Advertising command we last sent for each of our instances (empty if it must be sent again)
+		std::map<uint8_t, std::vector<uint8_t>> instances;
+	};
+
+	// Marks all of our controller's advertising as needing to be sent again, such as when the controller is powered off or a
+	// pipelined command fails
+	void invalidateAdvertising();
+
+	// Returns our controller's advertising state, reading its advertising features (and removing any stale instances) if we
+	// haven't already
+	//
+	// The state stays where it is for as long as we run, but anything other than its features must only be touched with
+	// `advertisingStatesMutex` held. Returns nullptr on failure
+	AdvertisingState *getAdvertisingState();
+
+	// Returns how much advertising data the controller described by `state` accepts from us, after the AD structures it adds
+	// itself (zero if those take all of it)
+	static size_t getAdvertisingCapacity(const AdvertisingState &state);
+
+	// Our knowledge of each controller's advertising, by controller index
+	static std::map<uint16_t, AdvertisingState> advertisingStates;
+	static std::mutex advertisingStatesMutex;
+
+	// The application's advertising instances, by instance
+	static std::map<uint8_t, AdvertisingInstance> applicationInstances;
+	static std::mutex applicationInstancesMutex;
+
+	// Sends a command, either waiting for its response or (when pipelining) adding it to our in-flight commands
+	//
+	// `callback` (if any) receives the command's result once it arrives, from the adapter's event thread.
+	//
+	// Returns true on success (or, when pipelining, if the command was sent), otherwise false
+	bool send(HciAdapter::HciHeader &request, HciAdapter::CommandCallback callback = nullptr);
+
+	// Returns true if a command succeeded, otherwise logs why it didn't and returns false
+	static bool checkResult(const HciAdapter::CommandResult &result);
+
 	// Default controller index
 	static const uint16_t kDefaultControllerIndex = 0;
 };
@@ -0,0 +1,229 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A read-only table keyed by 64-bit hashes, laid out so that every key has a slot of its own
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// The server description never changes once it is frozen, so its lookup tables can be built once with all of their keys known up
+// front. That lets us build a perfect hash in the "hash and displace" style: keys are split into small buckets, and each bucket
+// is given a displacement that moves all of its keys into slots nobody else is using. A lookup is then a fixed sequence of steps
+// with no probing and no chains: read the bucket's displacement, compute the slot, and compare the one key stored there. There
+// are no branches that depend on how full the table is, which keeps lookups predictable on small CPUs.
+//
+// Keys are hashes rather than strings, so a match only means "this is the one candidate"; callers still compare the full names
+// to rule out a lookup for something that isn't in the table but happens to share a hash with something that is.
+//
+// `build()` fails if two different entries have the same 64-bit hash, since no displacement can separate them. Callers keep a
+// slower lookup to fall back on for that (vanishingly unlikely) case.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace ggk {
+
+template<typename T>
+struct PerfectHash
+{
+	// A key and its value, as handed to `build()`
+	typedef std::pair<uint64_t, T> Entry;
+
+	// Builds the table from a set of entries with distinct hashes
+	//
+	// Returns false (leaving the table empty) if two entries share a hash or no layout could be found
+	bool build(const std::vector<Entry> &entries)
+	{
+		clear();
+		if (entries.empty())
+		{
+			return true;
+		}
+
+		// No displacement can separate two entries with the same hash, so don't go looking for one
+		std::vector<uint64_t> hashes;
+		hashes.reserve(entries.size());
+		for (const Entry &entry : entries)
+		{
+			hashes.push_back(entry.first);
+		}
+		std::sort(hashes.begin(), hashes.end());
+		if (std::adjacent_find(hashes.begin(), hashes.end()) != hashes.end())
+		{
+			return false;
+		}
+
+		// Each attempt doubles the number of slots, which makes a layout easier to find
+		size_t slotCount = roundUpToPowerOfTwo(entries.size() * 2);
+		for (int attempt = 0; attempt < kMaxBuildAttempts; ++attempt, slotCount *= 2)
+		{
+			if (tryBuild(entries, slotCount))
+			{
+				return true;
+			}
+		}
+
+		clear();
+		return false;
+	}
+
+	// Returns the value stored under `hash`, or nullptr if there isn't one
+	const T *find(uint64_t hash) const
+	{
+		if (slots.empty())
+		{
+			return nullptr;
+		}
+
+		const Slot &slot = slots[slotIndex(hash, displacements[bucketIndex(hash)])];
+		return slot.used && slot.hash == hash ? &slot.value : nullptr;
+	}
+
+	// Returns the number of entries in the table
+	size_t size() const { return count; }
+
+	// Empties the table
+	void clear()
+	{
+		slots.clear();
+		displacements.clear();
+		count = 0;
+		slotMask = 0;
+		bucketMask = 0;
+	}
+
+private:
+
+	// The number of times `build()` grows the table before giving up
+	static const int kMaxBuildAttempts = 4;
+
+	// The most displacements tried for a single bucket before the table is grown
+	static const uint32_t kMaxDisplacement = 0xffff;
+
+	struct Slot
+	{
+		uint64_t hash = 0;
+		T value = T();
+		bool used = false;
+	};
+
+	// Buckets are chosen from the high bits of the hash, and slots from a mix of the whole hash with the bucket's displacement
+	size_t bucketIndex(uint64_t hash) const { return static_cast<size_t>(hash >> 32) & bucketMask; }
+
+	size_t slotIndex(uint64_t hash, uint32_t displacement) const
+	{
+		uint64_t mixed = (hash ^ (static_cast<uint64_t>(displacement) * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+		return static_cast<size_t>(mixed ^ (mixed >> 29)) & slotMask;
+	}
+
+	static size_t roundUpToPowerOfTwo(size_t value)
+	{
+		size_t result = 1;
+		while (result < value)
+		{
+			result *= 2;
+		}
+
+		return result;
+	}
+
+	// Attempts to lay out the entries in `slotCount` slots, largest buckets first
+	bool tryBuild(const std::vector<Entry> &entries, size_t slotCount)
+	{
+		slots.assign(slotCount, Slot());
+		slotMask = slotCount - 1;
+
+		// Aim for about two entries per bucket
+		size_t bucketCount = roundUpToPowerOfTwo((entries.size() + 1) / 2);
+		displacements.assign(bucketCount, 0);
+		bucketMask = bucketCount - 1;
+
+		std::vector<std::vector<size_t>> buckets(bucketCount);
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			buckets[bucketIndex(entries[i].first)].push_back(i);
+		}
+
+		std::vector<size_t> order(bucketCount);
+		for (size_t i = 0; i < bucketCount; ++i)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+		std::vector<size_t> placed;
+		for (size_t bucket : order)
+		{
+			const std::vector<size_t> &members = buckets[bucket];
+			if (members.empty())
+			{
+				break;
+			}
+
+			uint32_t displacement = 0;
+			for (;; ++displacement)
+			{
+				if (displacement > kMaxDisplacement)
+				{
+					return false;
+				}
+
+				// Every member must land in a free slot, and no two members in the same one
+				placed.clear();
+				bool fits = true;
+				for (size_t member : members)
+				{
+					size_t index = slotIndex(entries[member].first, displacement);
+					if (slots[index].used || std::find(placed.begin(), placed.end(), index) != placed.end())
+					{
+						fits = false;
+						break;
+					}
+					placed.push_back(index);
+				}
+
+				if (fits)
+				{
+					break;
+				}
+			}
+
+			displacements[bucket] = displacement;
+			for (size_t i = 0; i < members.size(); ++i)
+			{
+				Slot &slot = slots[placed[i]];
+				slot.hash = entries[members[i]].first;
+				slot.value = entries[members[i]].second;
+				slot.used = true;
+			}
+		}
+
+		count = entries.size();
+		return true;
+	}
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> displacements;
+	size_t count = 0;
+	size_t slotMask = 0;
+	size_t bucketMask = 0;
+};
+
+}; // namespace ggk
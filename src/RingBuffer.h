@@ -0,0 +1,150 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A fixed-capacity, lock-free ring buffer for passing small values between threads
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// This is a bounded multi-producer/multi-consumer queue in the style of Dmitry Vyukov's well-known design. Each slot carries a
+// sequence number that tells producers and consumers whether the slot is free to write or ready to read, so a push or pop is a
+// single compare-and-swap on the shared position plus a release store on the slot. No locks are taken and no memory is allocated
+// after construction.
+//
+// The capacity must be a power of two. Values are copied in and out, so `T` should be small and trivially copyable (an integer
+// handle is the typical use.)
+//
+// `push()` fails (returns false) when the buffer is full rather than blocking or overwriting; callers decide what to do about it.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ggk {
+
+template<typename T, size_t kCapacity>
+struct RingBuffer
+{
+	static_assert(kCapacity >= 2 && (kCapacity & (kCapacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+	RingBuffer()
+	: enqueuePos(0), dequeuePos(0)
+	{
+		for (size_t i = 0; i < kCapacity; ++i)
+		{
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Adds a value to the buffer
+	//
+	// Returns false if the buffer is full
+	bool push(const T &value)
+	{
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell &cell = cells[pos & kMask];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Removes the oldest value from the buffer and stores it in `value`
+	//
+	// Returns false if the buffer is empty
+	bool pop(T &value)
+	{
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell &cell = cells[pos & kMask];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					value = cell.value;
+					cell.sequence.store(pos + kMask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns true if the buffer appears to be empty
+	//
+	// With concurrent producers, this is only a snapshot and may be out of date by the time the caller acts on it.
+	bool empty() const
+	{
+		return enqueuePos.load(std::memory_order_acquire) == dequeuePos.load(std::memory_order_acquire);
+	}
+
+	// Returns the (approximate) number of values waiting in the buffer
+	size_t size() const
+	{
+		size_t enqueued = enqueuePos.load(std::memory_order_acquire);
+		size_t dequeued = dequeuePos.load(std::memory_order_acquire);
+		return enqueued > dequeued ? enqueued - dequeued : 0;
+	}
+
+	// Returns the fixed capacity of the buffer
+	static constexpr size_t capacity() { return kCapacity; }
+
+private:
+
+	static const size_t kMask = kCapacity - 1;
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	// Keep the producer and consumer positions on separate cache lines so they don't bounce between cores
+	alignas(64) Cell cells[kCapacity];
+	alignas(64) std::atomic<size_t> enqueuePos;
+	alignas(64) std::atomic<size_t> dequeuePos;
+};
+
+}; // namespace ggk
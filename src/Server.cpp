@@ -88,11 +88,7 @@
 //             })
 //
 //             .gattDescriptorBegin("description", "2901", {"read"})
-//                 .onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
-//                 {
-//                     self.methodReturnValue(pInvocation, "Returns a test string", true);
-//                 })
-//
+//                 .constantValue("Returns a test string")
 //             .gattDescriptorEnd()
 //         .gattCharacteristicEnd()
 //     .gattServiceEnd()
@@ -145,12 +141,25 @@
 //         (int, string, etc.) If you need to notify a custom return type, you can do so by building your own GVariant (which is a
 //         GLib construct) and using the `-Variant` form of the method.
 //
+//         For characteristics with the "notify" or "indicate" flag, notifications are only sent while a client is subscribed
+//         (see `GattCharacteristic::hasSubscribers()`.)
+//
+// A characteristic that is updated at a high rate can bound how often its updates are processed with `.notifyPolicy(maxHz)`. Updates
+// that arrive faster than that are merged, so that clients receive the latest value rather than a backlog (see
+// `GattCharacteristic::notifyPolicy()`.)
+//
+// A characteristic that moves a lot of data can let BlueZ carry it through a socket instead of D-Bus. With `.acquireNotify()`,
+// a subscribed client's byte array notifications are written to the socket (and `ggkStreamSend()` streams to it directly.) With
+// `.onAcquiredWrite(CHARACTERISTIC_ACQUIRED_WRITE_CALLBACK_LAMBDA { ... })`, writes without response ("write-without-response")
+// arrive at the callback from the socket rather than through `onWriteValue`. See AcquiredStream.cpp.
+//
 // For information about GVariants (what they are and how to work with them), see the GLib documentation at:
 //
 //     https://www.freedesktop.org/software/gstreamer-sdk/data/docs/latest/glib/glib-GVariantType.html
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <algorithm>
+#include <unordered_map>
 
 #include "Server.h"
 #include "ServerUtils.h"
@@ -263,6 +272,9 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 	enableSecureSimplePairing = dataMap.at("enableSecureSimplePairing") == "true";
 	enableHighspeedConnect = dataMap.at("enableHighspeedConnect") == "true";
 	enableFastConnect = dataMap.at("enableFastConnect") == "true";
+
+	// Optional: publish our services on every Bluetooth adapter, rather than only the first
+	enableAllAdapters = dataMap.count("enableAllAdapters") != 0 && dataMap.at("enableAllAdapters") == "true";
 	
 	const char *READ_SECURITY_SETTING=dataMap.at("readSecuritySetting").c_str();
 	const char *WRITE_SECURITY_SETTING=dataMap.at("writeSecuritySetting").c_str();
@@ -283,6 +295,10 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
     // This is included because iOS devices like to ping this.
     .gattServiceBegin("battery_service", "180F")
         .gattCharacteristicBegin("battery_level", "2A19", {"read"})
+            // This read doesn't call back into the application, so it can safely be answered on a worker thread if the
+            // application enables them (see `ggkEnableMethodWorkers()`)
+            .runMethodsOnWorkers()
+
             // Standard characteristic "ReadValue" method call
             .onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
             {
@@ -319,11 +335,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 		// See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.manufacturer_name_string.xml
 		.gattCharacteristicBegin("mfgr_name", "2A29", {"read"})
 
-			// Standard characteristic "ReadValue" method call
-			.onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
-			{
-				self.methodReturnValue(pInvocation, "Palo Alto Innovation", true);
-			})
+			// A constant value, read without calling back into the description
+			.constantValue("Palo Alto Innovation")
 
 		.gattCharacteristicEnd()
 
@@ -332,11 +345,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 		// See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.model_number_string.xml
 		.gattCharacteristicBegin("model_num", "2A24", {"read"})
 
-			// Standard characteristic "ReadValue" method call
-			.onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
-			{
-				self.methodReturnValue(pInvocation, gProdID, true);
-			})
+			// A constant value, read without calling back into the description
+			.constantValue(gProdID)
 
 		.gattCharacteristicEnd()
 
@@ -345,11 +355,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 		// See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.serial_number_string.xml
 		.gattCharacteristicBegin("serial_num", "2A25", {"read"})
 
-			// Standard characteristic "ReadValue" method call
-			.onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
-			{
-				self.methodReturnValue(pInvocation, gSerialNum, true);
-			})
+			// A constant value, read without calling back into the description
+			.constantValue(gSerialNum)
 
 		.gattCharacteristicEnd()
 
@@ -358,11 +365,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 		// See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.firmware_revision_string.xml
 		.gattCharacteristicBegin("firmware", "2A26", {"read"})
 
-			// Standard characteristic "ReadValue" method call
-			.onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
-			{
-				self.methodReturnValue(pInvocation, gFirmwareRev, true);
-			})
+			// A constant value, read without calling back into the description
+			.constantValue(gFirmwareRev)
 
 		.gattCharacteristicEnd()
 
@@ -371,11 +375,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 		// See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.hardware_revision_string.xml
 		.gattCharacteristicBegin("hardware", "2A27", {"read"})
 
-			// Standard characteristic "ReadValue" method call
-			.onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
-			{
-				self.methodReturnValue(pInvocation, gHardwareRev, true);
-			})
+			// A constant value, read without calling back into the description
+			.constantValue(gHardwareRev)
 
 		.gattCharacteristicEnd()
 
@@ -384,11 +385,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 		// See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.software_revision_string.xml
 		.gattCharacteristicBegin("software", "2A28", {"read"})
 
-			// Standard characteristic "ReadValue" method call
-			.onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
-			{
-				self.methodReturnValue(pInvocation, gSoftwareRev, true);
-			})
+			// A constant value, read without calling back into the description
+			.constantValue(gSoftwareRev)
 
 		.gattCharacteristicEnd()
 
@@ -425,12 +423,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
             // See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.characteristic_user_description.xml
             .gattDescriptorBegin("description", "2901", {"read"})
 
-                // Standard descriptor "ReadValue" method call
-                .onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
-                {
-                    const char *pDescription = "Causes the Server(Peripheral) to disconnect the current connection";
-                    self.methodReturnValue(pInvocation, pDescription, true);
-                })
+                // A constant value, read without calling back into the description
+                .constantValue("Causes the Server(Peripheral) to disconnect the current connection")
 
             .gattDescriptorEnd()
 
@@ -482,12 +476,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
             // See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.characteristic_user_description.xml
             .gattDescriptorBegin("description", "2901", {"read"})
 
-                // Standard descriptor "ReadValue" method call
-                .onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
-                {
-                    const char *pDescription = "utf-8 encoded json containing the field \"SSIDs\" which is an array of objects containing the fields \"SSID\", \"str\", and \"enc\"﻿";
-                    self.methodReturnValue(pInvocation, pDescription, true);
-                })
+                // A constant value, read without calling back into the description
+                .constantValue("utf-8 encoded json containing the field \"SSIDs\" which is an array of objects containing the fields \"SSID\", \"str\", and \"enc\"﻿")
 
             .gattDescriptorEnd()
 
@@ -523,12 +513,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
             // See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.characteristic_user_description.xml
             .gattDescriptorBegin("description", "2901", {"read"})
 
-                // Standard descriptor "ReadValue" method call
-                .onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
-                {
-                    const char *pDescription = "byte array of at least length 1. Byte 1 is the status, remaining bytes are a string of the SSID";
-                    self.methodReturnValue(pInvocation, pDescription, true);
-                })
+                // A constant value, read without calling back into the description
+                .constantValue("byte array of at least length 1. Byte 1 is the status, remaining bytes are a string of the SSID")
 
             .gattDescriptorEnd()
 
@@ -539,12 +525,15 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 
 
             // Standard characteristic "ReadValue" method call
+            //
+            // The key may be longer than the client's MTU, so clients read it in chunks. A long read serves those chunks from a
+            // single snapshot of the value.
             .onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
             {
-                const char *updateString = self.getDataPointer<const char *>("wifi/api_key", "");
-                uint16_t offset = ServerUtils::getOffsetFromParameters(pParameters, strlen(updateString));
-                updateString += offset;
-                self.methodReturnValue(pInvocation, updateString, true);
+                self.methodReturnLongValue(pInvocation, pParameters, CHARACTERISTIC_LONG_READ_VALUE_CALLBACK_LAMBDA
+                {
+                    return Utils::gvariantFromByteArray(self.getDataPointer<const char *>("wifi/api_key", ""));
+                }, pUserData);
             })
 
             // Here we use the onUpdatedValue to set a callback that isn't exposed to BlueZ, but rather allows us to manage
@@ -559,21 +548,18 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
             })
 
             // Standard characteristic "WriteValue" method call
-            .onWriteValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
+            //
+            // Just as the key is read in chunks, it is written in chunks. A long write collects them for us and calls back once
+            // with the whole key, then replies to each chunk's WriteValue call itself.
+            .onLongWriteValue(CHARACTERISTIC_LONG_WRITE_VALUE_CALLBACK_LAMBDA
             {
                 // Update the text string value
-                GVariant *pAyBuffer = g_variant_get_child_value(pParameters, 0);
-                self.setDataPointer("wifi/api_key", Utils::stringFromGVariantByteArray(pAyBuffer).c_str());
+                self.setDataPointer("wifi/api_key", std::string(reinterpret_cast<const char *>(pData), size).c_str());
 
-                // Since all of these methods (onReadValue, onWriteValue, onUpdateValue) are all part of the same
+                // Since all of these methods (onReadValue, onLongWriteValue, onUpdateValue) are all part of the same
                 // Characteristic interface (which just so happens to be the same interface passed into our self
                 // parameter) we can that parameter to call our own onUpdatedValue method
                 self.callOnUpdatedValue(pConnection, pUserData);
-
-                // Note: Even though the WriteValue method returns void, it's important to return like this, so that a
-                // dbus "method_return" is sent, otherwise the client gets an error (ATT error code 0x0e"unlikely").
-                // Only "write-without-response" works without this
-                self.methodReturnVariant(pInvocation, NULL);
             })
 
             // GATT Descriptor: Characteristic User Description (0x2901)
@@ -581,12 +567,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
             // See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.characteristic_user_description.xml
             .gattDescriptorBegin("description", "2901", {"read"})
 
-                // Standard descriptor "ReadValue" method call
-                .onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
-                {
-                    const char *pDescription = "string of the api key this doppler uses to access MQTT";
-                    self.methodReturnValue(pInvocation, pDescription, true);
-                })
+                // A constant value, read without calling back into the description
+                .constantValue("string of the api key this doppler uses to access MQTT")
 
             .gattDescriptorEnd()
 
@@ -618,12 +600,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
             // See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.characteristic_user_description.xml
             .gattDescriptorBegin("description", "2901", {"read"})
 
-                // Standard descriptor "ReadValue" method call
-                .onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
-                {
-                    const char *pDescription = "utf-8 encoded json containing the fields \"SSID\" and \"Pass\"";
-                    self.methodReturnValue(pInvocation, pDescription, true);
-                })
+                // A constant value, read without calling back into the description
+                .constantValue("utf-8 encoded json containing the fields \"SSID\" and \"Pass\"")
 
             .gattDescriptorEnd()
 
@@ -662,12 +640,8 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
             // See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.characteristic_user_description.xml
             .gattDescriptorBegin("description", "2901", {"read"})
 
-                // Standard descriptor "ReadValue" method call
-                .onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
-                {
-                    const char *pDescription = "uint32_t with data on each byte. First byte is the Doppler Status, second byte is the Alexa Status";
-                    self.methodReturnValue(pInvocation, pDescription, true);
-                })
+                // A constant value, read without calling back into the description
+                .constantValue("uint32_t with data on each byte. First byte is the Doppler Status, second byte is the Alexa Status")
 
             .gattDescriptorEnd()
         .gattCharacteristicEnd()
@@ -738,11 +712,16 @@ Server::Server(const std::map<const std::string, const std::string> &dataMap,
 // Find a D-Bus interface within the given D-Bus object
 //
 // If the interface was found, it is returned, otherwise nullptr is returned
-std::shared_ptr<const DBusInterface> Server::findInterface(const DBusObjectPath &objectPath, const std::string &interfaceName) const
+std::shared_ptr<const DBusInterface> Server::findInterface(const char *pObjectPath, const char *pInterfaceName) const
 {
+	if (indexed.load(std::memory_order_acquire))
+	{
+		return findIndexedInterface(pObjectPath, pInterfaceName);
+	}
+
 	for (const DBusObject &object : objects)
 	{
-		std::shared_ptr<const DBusInterface> pInterface = object.findInterface(objectPath, interfaceName);
+		std::shared_ptr<const DBusInterface> pInterface = object.findInterface(pObjectPath, pInterfaceName);
 		if (pInterface != nullptr)
 		{
 			return pInterface;
@@ -752,14 +731,34 @@ std::shared_ptr<const DBusInterface> Server::findInterface(const DBusObjectPath
 	return nullptr;
 }
 
+// Find a D-Bus interface within the given D-Bus object
+//
+// If the interface was found, it is returned, otherwise nullptr is returned
+std::shared_ptr<const DBusInterface> Server::findInterface(const DBusObjectPath &objectPath, const std::string &interfaceName) const
+{
+	return findInterface(objectPath.c_str(), interfaceName.c_str());
+}
+
 // Find and call a D-Bus method within the given D-Bus object on the given D-Bus interface
 //
 // If the method was called, this method returns true, otherwise false. There is no result from the method call itself.
-bool Server::callMethod(const DBusObjectPath &objectPath, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
+bool Server::callMethod(const char *pObjectPath, const char *pInterfaceName, const char *pMethodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
 {
+	if (indexed.load(std::memory_order_acquire))
+	{
+		const IndexedMethod *pIndexedMethod = findIndexedMethod(pObjectPath, pInterfaceName, pMethodName);
+		if (nullptr == pIndexedMethod)
+		{
+			return false;
+		}
+
+		pIndexedMethod->pInterface->invokeMethod(*pIndexedMethod->pMethod, pConnection, pParameters, pInvocation, pUserData);
+		return true;
+	}
+
 	for (const DBusObject &object : objects)
 	{
-		if (object.callMethod(objectPath, interfaceName, methodName, pConnection, pParameters, pInvocation, pUserData))
+		if (object.callMethod(pObjectPath, pInterfaceName, pMethodName, pConnection, pParameters, pInvocation, pUserData))
 		{
 			return true;
 		}
@@ -768,28 +767,251 @@ bool Server::callMethod(const DBusObjectPath &objectPath, const std::string &int
 	return false;
 }
 
-// Find a GATT Property within the given D-Bus object on the given D-Bus interface
+// Find and call a D-Bus method within the given D-Bus object on the given D-Bus interface
 //
-// If the property was found, it is returned, otherwise nullptr is returned
-const GattProperty *Server::findProperty(const DBusObjectPath &objectPath, const std::string &interfaceName, const std::string &propertyName) const
+// If the method was called, this method returns true, otherwise false. There is no result from the method call itself.
+bool Server::callMethod(const DBusObjectPath &objectPath, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
 {
-	std::shared_ptr<const DBusInterface> pInterface = findInterface(objectPath, interfaceName);
+	return callMethod(objectPath.c_str(), interfaceName.c_str(), methodName.c_str(), pConnection, pParameters, pInvocation, pUserData);
+}
 
-	// Try each of the GattInterface types that support properties?
+// Returns the interface as one of the GattInterface types that support properties, or nullptr if it isn't one
+static std::shared_ptr<const GattInterface> getPropertyInterface(const std::shared_ptr<const DBusInterface> &pInterface)
+{
 	if (std::shared_ptr<const GattInterface> pGattInterface = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattInterface))
 	{
-		return pGattInterface->findProperty(propertyName);
+		return pGattInterface;
 	}
 	else if (std::shared_ptr<const GattService> pGattInterface = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattService))
 	{
-		return pGattInterface->findProperty(propertyName);
+		return pGattInterface;
 	}
 	else if (std::shared_ptr<const GattCharacteristic> pGattInterface = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic))
 	{
-		return pGattInterface->findProperty(propertyName);
+		return pGattInterface;
 	}
 
 	return nullptr;
 }
 
+// Find a GATT Property within the given D-Bus object on the given D-Bus interface
+//
+// If the property was found, it is returned, otherwise nullptr is returned
+const GattProperty *Server::findProperty(const char *pObjectPath, const char *pInterfaceName, const char *pPropertyName) const
+{
+	if (indexed.load(std::memory_order_acquire))
+	{
+		return findIndexedProperty(pObjectPath, pInterfaceName, pPropertyName);
+	}
+
+	std::shared_ptr<const DBusInterface> pInterface = findInterface(pObjectPath, pInterfaceName);
+	if (nullptr == pInterface)
+	{
+		return nullptr;
+	}
+
+	std::shared_ptr<const GattInterface> pGattInterface = getPropertyInterface(pInterface);
+	return nullptr == pGattInterface ? nullptr : pGattInterface->findProperty(pPropertyName);
+}
+
+// Find a GATT Property within the given D-Bus object on the given D-Bus interface
+//
+// If the property was found, it is returned, otherwise nullptr is returned
+const GattProperty *Server::findProperty(const DBusObjectPath &objectPath, const std::string &interfaceName, const std::string &propertyName) const
+{
+	return findProperty(objectPath.c_str(), interfaceName.c_str(), propertyName.c_str());
+}
+
+// Removes entries that repeat an earlier entry's key, keeping the first (which is the one a walk of the tree would find)
+//
+// `sameKey` compares the full path and names of two entries whose hashes match. Returns false if two entries share a hash but
+// not a key, since they can't both go in the index.
+template<typename T, typename SameKey>
+static bool removeDuplicates(std::vector<std::pair<uint64_t, T>> &entries, SameKey sameKey)
+{
+	std::unordered_map<uint64_t, size_t> firstByHash;
+	std::vector<std::pair<uint64_t, T>> unique;
+	unique.reserve(entries.size());
+	for (const std::pair<uint64_t, T> &entry : entries)
+	{
+		auto it = firstByHash.find(entry.first);
+		if (firstByHash.end() == it)
+		{
+			firstByHash[entry.first] = unique.size();
+			unique.push_back(entry);
+		}
+		else if (!sameKey(unique[it->second].second, entry.second))
+		{
+			return false;
+		}
+	}
+
+	entries.swap(unique);
+	return true;
+}
+
+// Freezes the server description once it is complete
+//
+// Spare capacity is released throughout the object tree, then the tree is walked once to build the lookup index used by
+// `findInterface()`, `callMethod()` and `findProperty()`, recording each interface by its full path and name, each method by its
+// full path, interface name and method name, and each property by its full path, interface name and property name. The index is
+// laid out as a perfect hash (see PerfectHash.h), so each lookup is a single probe. Until the description is frozen, the lookups
+// fall back to walking the tree.
+//
+// The server description must not change after it is frozen. Calling this method again does nothing.
+void Server::freeze()
+{
+	if (frozen.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	// Nothing may hold a pointer into the tree's storage until this is done (the event schedule and the index are built after)
+	for (DBusObject &object : objects)
+	{
+		object.shrinkToFit();
+	}
+
+	std::vector<PerfectHash<std::shared_ptr<const DBusInterface>>::Entry> interfaces;
+	std::vector<PerfectHash<IndexedMethod>::Entry> methods;
+	std::vector<PerfectHash<IndexedProperty>::Entry> properties;
+	for (const DBusObject &object : objects)
+	{
+		indexObject(object, interfaces, methods, properties);
+	}
+
+	// If an object has more than one interface (or an interface more than one method or property) by the same name, the walk
+	// would find the first one, so we will too
+	bool distinct = removeDuplicates(interfaces, [](const std::shared_ptr<const DBusInterface> &a, const std::shared_ptr<const DBusInterface> &b)
+	{
+		return a->getName() == b->getName() && a->getPath() == b->getPath();
+	});
+	distinct = distinct && removeDuplicates(methods, [](const IndexedMethod &a, const IndexedMethod &b)
+	{
+		return a.pMethod->getName() == b.pMethod->getName() && a.pInterface->getName() == b.pInterface->getName()
+			&& a.pInterface->getPath() == b.pInterface->getPath();
+	});
+	distinct = distinct && removeDuplicates(properties, [](const IndexedProperty &a, const IndexedProperty &b)
+	{
+		return a.pProperty->getName() == b.pProperty->getName() && a.pInterface->getName() == b.pInterface->getName()
+			&& a.pInterface->getPath() == b.pInterface->getPath();
+	});
+
+	// The lookups only use the index once it is published, complete
+	bool built = distinct && interfaceIndex.build(interfaces) && methodIndex.build(methods) && propertyIndex.build(properties);
+	if (!built)
+	{
+		interfaceIndex.clear();
+		methodIndex.clear();
+		propertyIndex.clear();
+		Logger::warn(SSTR << "Unable to build the lookup index; lookups will walk the server description instead");
+	}
+
+	indexed.store(built, std::memory_order_release);
+	frozen.store(true, std::memory_order_release);
+	Logger::debug(SSTR << "Froze the server description; indexed " << interfaceIndex.size() << " interfaces, " << methodIndex.size() << " methods and " << propertyIndex.size() << " properties");
+}
+
+// Collects the interfaces, methods and properties of an object (and its children) for the lookup index
+//
+// Each object already knows its full path (see `DBusObject::getPath()`), so the index finds exactly what a walk would.
+void Server::indexObject(const DBusObject &object, std::vector<PerfectHash<std::shared_ptr<const DBusInterface>>::Entry> &interfaces,
+	std::vector<PerfectHash<IndexedMethod>::Entry> &methods, std::vector<PerfectHash<IndexedProperty>::Entry> &properties) const
+{
+	const char *pPath = object.getPath().c_str();
+
+	for (const std::shared_ptr<DBusInterface> &pInterface : object.getInterfaces())
+	{
+		const char *pInterfaceName = pInterface->getName().c_str();
+		interfaces.push_back(std::make_pair(indexHash(pPath, pInterfaceName), pInterface));
+
+		for (const DBusMethod &method : pInterface->getMethods())
+		{
+			IndexedMethod indexedMethod = { pInterface, &method };
+			methods.push_back(std::make_pair(indexHash(pPath, pInterfaceName, method.getName().c_str()), indexedMethod));
+		}
+
+		if (std::shared_ptr<const GattInterface> pGattInterface = getPropertyInterface(pInterface))
+		{
+			for (const GattProperty &property : pGattInterface->getProperties())
+			{
+				IndexedProperty indexedProperty = { pGattInterface, &property };
+				properties.push_back(std::make_pair(indexHash(pPath, pInterfaceName, property.getName().c_str()), indexedProperty));
+			}
+		}
+	}
+
+	for (const DBusObject &child : object.getChildren())
+	{
+		indexObject(child, interfaces, methods, properties);
+	}
+}
+
+// Returns the indexed interface with the given path and name, or nullptr if there isn't one
+std::shared_ptr<const DBusInterface> Server::findIndexedInterface(const char *pObjectPath, const char *pInterfaceName) const
+{
+	const std::shared_ptr<const DBusInterface> *ppInterface = interfaceIndex.find(indexHash(pObjectPath, pInterfaceName));
+	if (nullptr == ppInterface || (*ppInterface)->getName() != pInterfaceName || (*ppInterface)->getPath() != pObjectPath)
+	{
+		return nullptr;
+	}
+
+	return *ppInterface;
+}
+
+// Returns the indexed method with the given path, interface name and method name, or nullptr if there isn't one
+const Server::IndexedMethod *Server::findIndexedMethod(const char *pObjectPath, const char *pInterfaceName, const char *pMethodName) const
+{
+	const IndexedMethod *pIndexedMethod = methodIndex.find(indexHash(pObjectPath, pInterfaceName, pMethodName));
+	if (nullptr == pIndexedMethod
+		|| pIndexedMethod->pMethod->getName() != pMethodName
+		|| pIndexedMethod->pInterface->getName() != pInterfaceName
+		|| pIndexedMethod->pInterface->getPath() != pObjectPath)
+	{
+		return nullptr;
+	}
+
+	return pIndexedMethod;
+}
+
+// Returns the indexed property with the given path, interface name and property name, or nullptr if there isn't one
+const GattProperty *Server::findIndexedProperty(const char *pObjectPath, const char *pInterfaceName, const char *pPropertyName) const
+{
+	const IndexedProperty *pIndexedProperty = propertyIndex.find(indexHash(pObjectPath, pInterfaceName, pPropertyName));
+	if (nullptr == pIndexedProperty
+		|| pIndexedProperty->pProperty->getName() != pPropertyName
+		|| pIndexedProperty->pInterface->getName() != pInterfaceName
+		|| pIndexedProperty->pInterface->getPath() != pObjectPath)
+	{
+		return nullptr;
+	}
+
+	return pIndexedProperty->pProperty;
+}
+
+// Returns the hash used to key the lookup index, computed directly from the strings D-Bus hands us
+//
+// This is a 64-bit FNV-1a hash over the path, interface name and (optionally) method name. The separating zero byte keeps
+// "a" + "bc" from hashing the same as "ab" + "c".
+uint64_t Server::indexHash(const char *pObjectPath, const char *pInterfaceName, const char *pMethodName)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const char *strings[] = { pObjectPath, pInterfaceName, pMethodName };
+	for (const char *pString : strings)
+	{
+		if (nullptr == pString)
+		{
+			break;
+		}
+
+		for (const char *p = pString; *p; ++p)
+		{
+			hash = (hash ^ static_cast<uint8_t>(*p)) * 1099511628211ULL;
+		}
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
 }; // namespace ggk
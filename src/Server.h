@@ -31,9 +31,11 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <atomic>
 
 #include "../include/Gobbledegook.h"
 #include "DBusObject.h"
+#include "PerfectHash.h"
 
 namespace ggk {
 
@@ -42,8 +44,10 @@ namespace ggk {
 //
 
 struct GattProperty;
+struct GattInterface;
 struct GattCharacteristic;
 struct DBusInterface;
+struct DBusMethod;
 struct DBusObjectPath;
 
 //
@@ -66,6 +70,9 @@ struct Server
 	// Returns the set of objects that each represent the root of an object tree describing a group of services we are providing
 	const Objects &getObjects() const { return objects; }
 
+	// Returns true once the server description has been frozen (see `freeze()`)
+	bool isFrozen() const { return frozen.load(std::memory_order_acquire); }
+
 	// Returns the requested setting for BR/EDR (true = enabled, false = disabled)
 	bool getEnableBREDR() const { return enableBREDR; }
 
@@ -96,6 +103,9 @@ struct Server
 	// Returns the requested setting for Fast Connect (BR/EDR only) (true = enabled, false = disabled)
 	bool getEnableFastConnect() const { return enableFastConnect; }
 
+	// Returns true if our GATT application should be published on every adapter, or false to use only the first adapter
+	bool getEnableAllAdapters() const { return enableAllAdapters; }
+
 	// Returns our registered data getter
 	GGKServerDataGetter getDataGetter() const { return dataGetter; }
 
@@ -178,23 +188,82 @@ struct Server
 	// Utilitarian
 	//
 
-	// Find and call a D-Bus method within the given D-Bus object on the given D-Bus interface
+	// Find a D-Bus interface within the given D-Bus object
 	//
-	// If the method was called, this method returns true, otherwise false.  There is no result from the method call itself.
+	// If the interface was found, it is returned, otherwise nullptr is returned
+	std::shared_ptr<const DBusInterface> findInterface(const char *pObjectPath, const char *pInterfaceName) const;
 	std::shared_ptr<const DBusInterface> findInterface(const DBusObjectPath &objectPath, const std::string &interfaceName) const;
 
-	// Find a D-Bus method within the given D-Bus object on the given D-Bus interface
+	// Find and call a D-Bus method within the given D-Bus object on the given D-Bus interface
 	//
-	// If the method was found, it is returned, otherwise nullptr is returned
+	// If the method was called, this method returns true, otherwise false.  There is no result from the method call itself.
+	bool callMethod(const char *pObjectPath, const char *pInterfaceName, const char *pMethodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 	bool callMethod(const DBusObjectPath &objectPath, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 
 	// Find a GATT Property within the given D-Bus object on the given D-Bus interface
 	//
 	// If the property was found, it is returned, otherwise nullptr is returned
+	const GattProperty *findProperty(const char *pObjectPath, const char *pInterfaceName, const char *pPropertyName) const;
 	const GattProperty *findProperty(const DBusObjectPath &objectPath, const std::string &interfaceName, const std::string &propertyName) const;
 
+	// Freezes the server description once it is complete
+	//
+	// Spare capacity is released throughout the object tree, then the tree is walked once to build the lookup index used by
+	// `findInterface()`, `callMethod()` and `findProperty()`, recording each interface by its full path and name, each method
+	// by its full path, interface name and method name, and each property by its full path, interface name and property name.
+	// The index is laid out as a perfect hash (see PerfectHash.h), so each lookup is a single probe. Until the description is
+	// frozen, the lookups fall back to walking the tree.
+	//
+	// The server description must not change after it is frozen. Calling this method again does nothing.
+	void freeze();
+
 private:
 
+	// An indexed method, along with the interface that owns it
+	struct IndexedMethod
+	{
+		std::shared_ptr<const DBusInterface> pInterface;
+		const DBusMethod *pMethod;
+	};
+
+	// An indexed property, along with the interface that owns it
+	struct IndexedProperty
+	{
+		std::shared_ptr<const GattInterface> pInterface;
+		const GattProperty *pProperty;
+	};
+
+	// Collects the interfaces, methods and properties of an object (and its children) for the lookup index
+	void indexObject(const DBusObject &object, std::vector<PerfectHash<std::shared_ptr<const DBusInterface>>::Entry> &interfaces,
+		std::vector<PerfectHash<IndexedMethod>::Entry> &methods, std::vector<PerfectHash<IndexedProperty>::Entry> &properties) const;
+
+	// Returns the indexed interface with the given path and name, or nullptr if there isn't one
+	std::shared_ptr<const DBusInterface> findIndexedInterface(const char *pObjectPath, const char *pInterfaceName) const;
+
+	// Returns the indexed method with the given path, interface name and method name, or nullptr if there isn't one
+	const IndexedMethod *findIndexedMethod(const char *pObjectPath, const char *pInterfaceName, const char *pMethodName) const;
+
+	// Returns the indexed property with the given path, interface name and property name, or nullptr if there isn't one
+	const GattProperty *findIndexedProperty(const char *pObjectPath, const char *pInterfaceName, const char *pPropertyName) const;
+
+	// Returns the hash used to key the lookup index, computed directly from the strings D-Bus hands us
+	static uint64_t indexHash(const char *pObjectPath, const char *pInterfaceName, const char *pMethodName = nullptr);
+
+	// Set (see `freeze()`) with release ordering once the description is frozen and the index is complete, so a thread that sees
+	// it set also sees everything `freeze()` built
+	std::atomic<bool> frozen{false};
+
+	// Our lookup index (see `freeze()`)
+	//
+	// Entries are keyed by hash alone, so lookups don't need to build a key string; the one candidate a lookup finds is then
+	// compared against the full path and names, to rule out a lookup for something we don't have that shares a hash with
+	// something we do. If the index couldn't be built, `indexed` is false and the lookups keep walking the tree. It is set (with
+	// release ordering) only after the index is complete, and read with acquire ordering by the lookups.
+	std::atomic<bool> indexed{false};
+	PerfectHash<std::shared_ptr<const DBusInterface>> interfaceIndex;
+	PerfectHash<IndexedMethod> methodIndex;
+	PerfectHash<IndexedProperty> propertyIndex;
+
 	// Our server's objects
 	Objects objects;
 
@@ -235,6 +304,9 @@ private:
 	// Bondable requested state
 	bool enableBondable;
 
+	// Publish on every adapter (rather than only the first)
+	bool enableAllAdapters;
+
 	// The getter callback that is responsible for returning current server data that is shared over Bluetooth
 	GGKServerDataGetter dataGetter;
 
@@ -41,6 +41,9 @@
 
 namespace ggk {
 
+// Our cached response to `GetManagedObjects` (see `ServerUtils::getManagedObjects()`)
+static GVariant *pManagedObjectsCache = nullptr;
+
 // Adds an object to the tree of managed objects as returned from the `GetManagedObjects` method call from the D-Bus interface
 // `org.freedesktop.DBus.ObjectManager`.
 //
@@ -56,7 +59,7 @@ namespace ggk {
 //     the empty dict is returned.
 //
 //     (a{oa{sa{sv}}})
-static void addManagedObjectsNode(const DBusObject &object, const DBusObjectPath &basePath, GVariantBuilder *pObjectArray)
+static void addManagedObjectsNode(const DBusObject &object, GVariantBuilder *pObjectArray)
 {
 	if (!object.isPublished())
 	{
@@ -65,11 +68,11 @@ static void addManagedObjectsNode(const DBusObject &object, const DBusObjectPath
 
 	if (!object.getInterfaces().empty())
 	{
-		DBusObjectPath path = basePath + object.getPathNode();
+		const DBusObjectPath &path = object.getPath();
 		Logger::debug(SSTR << "  Object: " << path);
 
 		GVariantBuilder *pInterfaceArray = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
-		for (std::shared_ptr<const DBusInterface> pInterface : object.getInterfaces())
+		for (const std::shared_ptr<DBusInterface> &pInterface : object.getInterfaces())
 		{
 			Logger::debug(SSTR << "  + Interface (type: " << pInterface->getInterfaceType() << ")");
 
@@ -160,6 +163,7 @@ static void addManagedObjectsNode(const DBusObject &object, const DBusObjectPath
 			else
 			{
 				Logger::error(SSTR << "    Unknown interface type");
+				g_variant_builder_unref(pInterfaceArray);
 				return;
 			}
 		}
@@ -175,23 +179,47 @@ static void addManagedObjectsNode(const DBusObject &object, const DBusObjectPath
 
 	for (const DBusObject &child : object.getChildren())
 	{
-		addManagedObjectsNode(child, basePath + object.getPathNode(), pObjectArray);
+		addManagedObjectsNode(child, pObjectArray);
 	}
 }
 
 // Builds the response to the method call `GetManagedObjects` from the D-Bus interface `org.freedesktop.DBus.ObjectManager`
+//
+// The response is built once and cached, since the server description doesn't change once it is running. Subsequent calls
+// return the cached response until it is invalidated (see `invalidateManagedObjects()`.)
 void ServerUtils::getManagedObjects(GDBusMethodInvocation *pInvocation)
 {
+	if (nullptr == pManagedObjectsCache)
+	{
+		Logger::debug(SSTR << "Building managed objects");
+
+		GVariantBuilder *pObjectArray = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
+		for (const DBusObject &object : TheServer->getObjects())
+		{
+			addManagedObjectsNode(object, pObjectArray);
+		}
+
+		// Take ownership of the (floating) result so it outlives this call
+		pManagedObjectsCache = g_variant_ref_sink(g_variant_new("(a{oa{sa{sv}}})", pObjectArray));
+		g_variant_builder_unref(pObjectArray);
+	}
+
 	Logger::debug(SSTR << "Reporting managed objects");
 
-	GVariantBuilder *pObjectArray = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
-	for (const DBusObject &object : TheServer->getObjects())
+	// Our cached value is not floating, so the invocation takes its own reference rather than consuming ours
+	g_dbus_method_invocation_return_value(pInvocation, pManagedObjectsCache);
+}
+
+// Discards the cached response to `GetManagedObjects`, forcing it to be rebuilt on the next call
+//
+// This must be called (from the server's thread) whenever an object, interface or property in the server description changes.
+void ServerUtils::invalidateManagedObjects()
+{
+	if (nullptr != pManagedObjectsCache)
 	{
-		addManagedObjectsNode(object, DBusObjectPath(""), pObjectArray);
+		g_variant_unref(pManagedObjectsCache);
+		pManagedObjectsCache = nullptr;
 	}
-
-	GVariant *pParams = g_variant_new("(a{oa{sa{sv}}})", pObjectArray);
-	g_dbus_method_invocation_return_value(pInvocation, pParams);
 }
 
 // Sometimes you get an additional parameter back that the previous read was only partial and
@@ -32,8 +32,16 @@ namespace ggk {
 struct ServerUtils
 {
 	// Builds the response to the method call `GetManagedObjects` from the D-Bus interface `org.freedesktop.DBus.ObjectManager`
+	//
+	// The response is built once and cached, since the server description doesn't change once it is running. Subsequent calls
+	// return the cached response until it is invalidated (see `invalidateManagedObjects()`.)
 	static void getManagedObjects(GDBusMethodInvocation *pInvocation);
 
+	// Discards the cached response to `GetManagedObjects`, forcing it to be rebuilt on the next call
+	//
+	// This must be called (from the server's thread) whenever an object, interface or property in the server description changes.
+	static void invalidateManagedObjects();
+
 	// Devices will sometimes perform reads on long buffers in multiple chunks, this returns an offset if that occurs.
 	static uint16_t getOffsetFromParameters(GVariant *params, uint16_t dataLength);
 
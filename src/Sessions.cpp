@@ -0,0 +1,285 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A table of the clients connected to the server, with what we know about each of them
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// What we know about a client arrives from two directions. The adapter reports each connection and disconnection (see
+// HciAdapter.cpp), along with the client's address. BlueZ, in turn, passes options with most of the methods it calls on our
+// characteristics and descriptors: `device` (the client's object path, which contains its address) and, for reads, writes and
+// acquired sockets, `mtu`. Tying the two together by address gives us a session for each client, holding when it connected,
+// its MTU and the notification sockets it holds.
+//
+// The MTU matters most for notifications. A change notification larger than (MTU - 3) bytes is truncated by BlueZ, while one far
+// smaller wastes most of a packet. `getNotificationMtu()` gives the MTU a characteristic's notifications must fit, so that they
+// can be sized (and packed, see `GattCharacteristic::sendChangeNotificationPacked()`) to suit.
+//
+// Note that `StartNotify` doesn't say which client subscribed, so only subscriptions through acquired sockets are recorded here.
+// Those subscriptions end when the socket is released (by BlueZ or by us) or when the characteristic receives `StopNotify`.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <string.h>
+
+#include "Sessions.h"
+#include "Logger.h"
+#include "Utils.h"
+
+namespace ggk {
+
+// Returns the address named by the `device` option in a method call's options, or an empty string if there isn't one
+static std::string addressFromOptions(GVariant *pOptions)
+{
+	std::string address;
+	GVariant *pDevice = g_variant_lookup_value(pOptions, "device", G_VARIANT_TYPE_OBJECT_PATH);
+	if (nullptr != pDevice)
+	{
+		address = Sessions::addressFromDevicePath(g_variant_get_string(pDevice, nullptr));
+		g_variant_unref(pDevice);
+	}
+
+	return address;
+}
+
+// Starts a session for a client the adapter reports as connected
+//
+// `pAddress` is the address as the kernel reports it (least significant byte first.)
+void Sessions::connected(uint16_t controllerIndex, const uint8_t *pAddress, uint8_t addressType)
+{
+	std::string address = Utils::kernelBluetoothAddressString(pAddress);
+
+	std::lock_guard<std::mutex> lock(sessionsMutex);
+
+	// Anything left over from an earlier connection no longer applies
+	Session &session = sessions[address];
+	session = Session();
+	session.address = address;
+	session.addressType = addressType;
+	session.controllerIndex = controllerIndex;
+	session.connectTime = g_get_monotonic_time();
+
+	GGK_LOG_DEBUG("Session started for " << address << " (" << sessions.size() << " active)");
+}
+
+// Ends the session for a client the adapter reports as disconnected
+void Sessions::disconnected(const uint8_t *pAddress)
+{
+	std::string address = Utils::kernelBluetoothAddressString(pAddress);
+
+	std::lock_guard<std::mutex> lock(sessionsMutex);
+	if (sessions.erase(address) != 0)
+	{
+		GGK_LOG_DEBUG("Session ended for " << address << " (" << sessions.size() << " active)");
+	}
+}
+
+// Updates the session for the client that made a method call, from the `device` and `mtu` options BlueZ passes with it
+//
+// Returns the client's address, or an empty string if the method call doesn't identify one
+std::string Sessions::observeMethodCall(GVariant *pParameters)
+{
+	GVariant *pOptions = getOptions(pParameters);
+	if (nullptr == pOptions)
+	{
+		return std::string();
+	}
+
+	std::string address = addressFromOptions(pOptions);
+	if (!address.empty())
+	{
+		GVariant *pMtu = g_variant_lookup_value(pOptions, "mtu", G_VARIANT_TYPE_UINT16);
+
+		std::lock_guard<std::mutex> lock(sessionsMutex);
+		Session &session = findOrCreate(address);
+		if (nullptr != pMtu)
+		{
+			session.mtu = g_variant_get_uint16(pMtu);
+			g_variant_unref(pMtu);
+		}
+	}
+
+	g_variant_unref(pOptions);
+	return address;
+}
+
+// Records that the client at `address` holds the notification socket for the characteristic at `path`
+//
+// Only one client can hold a characteristic's socket, so this ends any other client's subscription to it.
+void Sessions::subscribe(const std::string &address, const std::string &path)
+{
+	std::lock_guard<std::mutex> lock(sessionsMutex);
+	for (auto &entry : sessions)
+	{
+		entry.second.subscriptions.erase(path);
+	}
+
+	if (!address.empty())
+	{
+		findOrCreate(address).subscriptions.insert(path);
+	}
+}
+
+// Records that no client holds the notification socket for the characteristic at `path` any longer
+void Sessions::unsubscribe(const std::string &path)
+{
+	std::lock_guard<std::mutex> lock(sessionsMutex);
+	for (auto &entry : sessions)
+	{
+		entry.second.subscriptions.erase(path);
+	}
+}
+
+// Returns a copy of the session for the client at `address` in `session`
+//
+// Returns true if there is such a session, otherwise false
+bool Sessions::getSession(const std::string &address, Session &session) const
+{
+	std::lock_guard<std::mutex> lock(sessionsMutex);
+	auto it = sessions.find(address);
+	if (sessions.end() == it)
+	{
+		return false;
+	}
+
+	session = it->second;
+	return true;
+}
+
+// Returns a copy of every session
+std::vector<Sessions::Session> Sessions::getSessions() const
+{
+	std::vector<Session> result;
+
+	std::lock_guard<std::mutex> lock(sessionsMutex);
+	result.reserve(sessions.size());
+	for (const auto &entry : sessions)
+	{
+		result.push_back(entry.second);
+	}
+
+	return result;
+}
+
+// Returns the MTU that notifications for the characteristic at `path` must fit
+uint16_t Sessions::getNotificationMtu(const std::string &path) const
+{
+	uint16_t subscribedMtu = 0;
+	uint16_t connectedMtu = 0;
+
+	std::lock_guard<std::mutex> lock(sessionsMutex);
+	for (const auto &entry : sessions)
+	{
+		const Session &session = entry.second;
+		uint16_t mtu = session.mtu < kMinimumMtu ? kMinimumMtu : session.mtu;
+		if (0 == connectedMtu || mtu < connectedMtu)
+		{
+			connectedMtu = mtu;
+		}
+
+		if (session.subscriptions.count(path) != 0 && (0 == subscribedMtu || mtu < subscribedMtu))
+		{
+			subscribedMtu = mtu;
+		}
+	}
+
+	if (0 != subscribedMtu) { return subscribedMtu; }
+	if (0 != connectedMtu) { return connectedMtu; }
+	return kMinimumMtu;
+}
+
+// Returns the address of the client named by a BlueZ device object path (such as "/org/bluez/hci0/dev_AA_BB_CC_DD_EE_FF"), or an
+// empty string if the path doesn't name one
+std::string Sessions::addressFromDevicePath(const char *pDevicePath)
+{
+	if (nullptr == pDevicePath)
+	{
+		return std::string();
+	}
+
+	const char *pName = strstr(pDevicePath, "/dev_");
+	if (nullptr == pName || strlen(pName + 5) < 17)
+	{
+		return std::string();
+	}
+
+	// The address follows, with underscores in place of the colons
+	std::string address(pName + 5, 17);
+	for (char &c : address)
+	{
+		if ('_' == c) { c = ':'; }
+	}
+
+	return address;
+}
+
+// Returns the address of the client that made a method call (from its `device` option), or an empty string if it doesn't name one
+std::string Sessions::addressFromParameters(GVariant *pParameters)
+{
+	GVariant *pOptions = getOptions(pParameters);
+	if (nullptr == pOptions)
+	{
+		return std::string();
+	}
+
+	std::string address = addressFromOptions(pOptions);
+	g_variant_unref(pOptions);
+	return address;
+}
+
+// Returns the options dictionary ("a{sv}") passed to a method call, which is always its last parameter, or nullptr
+//
+// The caller must unref the returned dictionary.
+GVariant *Sessions::getOptions(GVariant *pParameters)
+{
+	if (nullptr == pParameters || !g_variant_is_container(pParameters))
+	{
+		return nullptr;
+	}
+
+	gsize count = g_variant_n_children(pParameters);
+	if (0 == count)
+	{
+		return nullptr;
+	}
+
+	GVariant *pOptions = g_variant_get_child_value(pParameters, count - 1);
+	if (!g_variant_is_of_type(pOptions, G_VARIANT_TYPE_VARDICT))
+	{
+		g_variant_unref(pOptions);
+		return nullptr;
+	}
+
+	return pOptions;
+}
+
+// Returns the session for `address`, creating it if needed (the caller must hold `sessionsMutex`)
+//
+// A client we haven't seen connect (such as one that connected before the server started) is given a session when it first calls
+// one of our methods.
+Sessions::Session &Sessions::findOrCreate(const std::string &address)
+{
+	auto it = sessions.find(address);
+	if (sessions.end() != it)
+	{
+		return it->second;
+	}
+
+	Session &session = sessions[address];
+	session.address = address;
+	session.connectTime = g_get_monotonic_time();
+	return session;
+}
+
+}; // namespace ggk
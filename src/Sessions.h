@@ -0,0 +1,130 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A table of the clients connected to the server, with what we know about each of them
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of Sessions.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ggk {
+
+struct Sessions
+{
+	// The smallest MTU a connection may have, which we assume until a client tells us otherwise
+	static const uint16_t kMinimumMtu = 23;
+
+	// What we know about a connected client
+	struct Session
+	{
+		// The client's address (such as "AA:BB:CC:DD:EE:FF")
+		std::string address;
+
+		// The address type and controller reported when the client connected, or -1 if we have only seen the client over D-Bus
+		int addressType = -1;
+		int controllerIndex = -1;
+
+		// When the client connected (or we first saw it), from `g_get_monotonic_time()`
+		gint64 connectTime = 0;
+
+		// The client's MTU, from the most recent method call that reported one, or 0 if we haven't been told
+		uint16_t mtu = 0;
+
+		// The paths of the characteristics whose notification sockets the client holds (see `GattCharacteristic::acquireNotify()`)
+		std::set<std::string> subscriptions;
+	};
+
+	// Retrieve our singleton instance
+	static Sessions &getInstance()
+	{
+		static Sessions instance;
+		return instance;
+	}
+
+	// Starts a session for a client the adapter reports as connected
+	//
+	// `pAddress` is the address as the kernel reports it (least significant byte first.)
+	void connected(uint16_t controllerIndex, const uint8_t *pAddress, uint8_t addressType);
+
+	// Ends the session for a client the adapter reports as disconnected
+	void disconnected(const uint8_t *pAddress);
+
+	// Updates the session for the client that made a method call, from the `device` and `mtu` options BlueZ passes with it
+	//
+	// Returns the client's address, or an empty string if the method call doesn't identify one
+	std::string observeMethodCall(GVariant *pParameters);
+
+	// Records that the client at `address` holds the notification socket for the characteristic at `path`
+	//
+	// Only one client can hold a characteristic's socket, so this ends any other client's subscription to it.
+	void subscribe(const std::string &address, const std::string &path);
+
+	// Records that no client holds the notification socket for the characteristic at `path` any longer
+	void unsubscribe(const std::string &path);
+
+	// Returns a copy of the session for the client at `address` in `session`
+	//
+	// Returns true if there is such a session, otherwise false
+	bool getSession(const std::string &address, Session &session) const;
+
+	// Returns a copy of every session
+	std::vector<Session> getSessions() const;
+
+	// Returns the MTU that notifications for the characteristic at `path` must fit
+	//
+	// This is the smallest MTU of the clients holding the characteristic's notification socket. Failing that, it is the smallest
+	// MTU of any connected client, counting any client whose MTU we don't know as `kMinimumMtu`. With no clients at all, it is
+	// `kMinimumMtu`.
+	uint16_t getNotificationMtu(const std::string &path) const;
+
+	// Returns the address of the client named by a BlueZ device object path (such as "/org/bluez/hci0/dev_AA_BB_CC_DD_EE_FF"),
+	// or an empty string if the path doesn't name one
+	static std::string addressFromDevicePath(const char *pDevicePath);
+
+	// Returns the address of the client that made a method call (from its `device` option), or an empty string if it doesn't
+	// name one
+	static std::string addressFromParameters(GVariant *pParameters);
+
+private:
+
+	Sessions() {}
+
+	// Prevent copying
+	Sessions(Sessions const &) = delete;
+	void operator=(Sessions const &) = delete;
+
+	// Returns the options dictionary ("a{sv}") passed to a method call, which is always its last parameter, or nullptr
+	static GVariant *getOptions(GVariant *pParameters);
+
+	// Returns the session for `address`, creating it if needed (the caller must hold `sessionsMutex`)
+	Session &findOrCreate(const std::string &address);
+
+	// Our sessions, keyed by address
+	std::map<std::string, Session> sessions;
+	mutable std::mutex sessionsMutex;
+};
+
+}; // namespace ggk
@@ -0,0 +1,269 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Lightweight counters and latency histograms for the server's hot paths
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// The server keeps a small set of always-on statistics so that an application can see where time goes without attaching a
+// profiler: how long D-Bus methods and properties take to service, how deep the update queue gets, how many notifications are
+// sent (or suppressed because nobody is listening), how long HCI management commands wait on the adapter and how long the
+// adapter's event thread spends on each event.
+//
+// Counters are plain relaxed atomics. Latencies are recorded into log-linear histograms (in the spirit of HDR histograms):
+// each power of two is split into four linear sub-buckets, which bounds the error of any reported percentile to 25% while
+// keeping each histogram to a fixed, small array of counters. Recording a sample never locks or allocates.
+//
+// Applications retrieve a snapshot with `ggkGetStats()` and can clear the statistics with `ggkResetStats()`.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include "Stats.h"
+
+namespace ggk {
+
+//
+// LatencyHistogram
+//
+
+// Records a single sample
+void LatencyHistogram::record(uint64_t valueUS)
+{
+	if (valueUS > kMaxValueUS)
+	{
+		valueUS = kMaxValueUS;
+	}
+
+	count.fetch_add(1, std::memory_order_relaxed);
+	sumUS.fetch_add(valueUS, std::memory_order_relaxed);
+	buckets[bucketIndex(valueUS)].fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t currentMax = maxUS.load(std::memory_order_relaxed);
+	while (valueUS > currentMax && !maxUS.compare_exchange_weak(currentMax, valueUS, std::memory_order_relaxed))
+	{
+	}
+}
+
+// Clears all samples
+void LatencyHistogram::reset()
+{
+	count.store(0, std::memory_order_relaxed);
+	sumUS.store(0, std::memory_order_relaxed);
+	maxUS.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+// Summarizes the histogram into `stats`
+void LatencyHistogram::snapshot(GGKLatencyStats &stats) const
+{
+	// Work from a copy of the buckets so that the percentiles are consistent with each other
+	uint64_t counts[kBucketCount];
+	uint64_t total = 0;
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		counts[i] = buckets[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+
+	uint64_t max = maxUS.load(std::memory_order_relaxed);
+	uint64_t sum = sumUS.load(std::memory_order_relaxed);
+
+	stats.count = total;
+	stats.meanUS = 0 == total ? 0 : sum / total;
+	stats.p50US = percentile(counts, total, 50);
+	stats.p90US = percentile(counts, total, 90);
+	stats.p99US = percentile(counts, total, 99);
+	stats.maxUS = max;
+
+	// A bucket's upper bound may overshoot the largest sample we've actually seen
+	if (stats.p50US > max) { stats.p50US = max; }
+	if (stats.p90US > max) { stats.p90US = max; }
+	if (stats.p99US > max) { stats.p99US = max; }
+}
+
+// Returns the bucket index for a value
+//
+// Values below `kSubBuckets` each have their own bucket. Above that, a value's bucket is found from the position of its highest
+// set bit (its power of two) and the next two bits below it (its sub-bucket.)
+int LatencyHistogram::bucketIndex(uint64_t valueUS)
+{
+	if (valueUS < static_cast<uint64_t>(kSubBuckets))
+	{
+		return static_cast<int>(valueUS);
+	}
+
+	int msb = 63 - __builtin_clzll(valueUS);
+	int sub = static_cast<int>((valueUS >> (msb - 2)) & (kSubBuckets - 1));
+	return kSubBuckets + (msb - 2) * kSubBuckets + sub;
+}
+
+// Returns the largest value that lands in the given bucket
+uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+	if (index < kSubBuckets)
+	{
+		return index;
+	}
+
+	int shift = (index - kSubBuckets) / kSubBuckets;
+	uint64_t sub = (index - kSubBuckets) % kSubBuckets;
+	return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+// Returns the value at the given percentile (0-100) of the samples in `counts`, which total `total` samples
+uint64_t LatencyHistogram::percentile(const uint64_t *counts, uint64_t total, int percent)
+{
+	if (0 == total)
+	{
+		return 0;
+	}
+
+	// The rank of the sample we're looking for (rounded up, and at least the first sample)
+	uint64_t rank = (total * percent + 99) / 100;
+	if (0 == rank)
+	{
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			return bucketUpperBound(i);
+		}
+	}
+
+	return kMaxValueUS;
+}
+
+//
+// Stats
+//
+
+// Records the current depth of the update queue, tracking the deepest it has been
+void Stats::recordUpdateQueueDepth(uint64_t depth)
+{
+	updateQueueDepth.store(depth, std::memory_order_relaxed);
+
+	uint64_t currentMax = updateQueueMaxDepth.load(std::memory_order_relaxed);
+	while (depth > currentMax && !updateQueueMaxDepth.compare_exchange_weak(currentMax, depth, std::memory_order_relaxed))
+	{
+	}
+}
+
+// Records the time taken to parse and dispatch an HCI event
+void Stats::recordHciEvent(int eventCode, uint64_t latencyUS)
+{
+	increment(hciEvents);
+	hciEventLatency.record(latencyUS);
+
+	if (eventCode >= 0 && eventCode <= kMaxHciEventCode)
+	{
+		hciEventLatencyByCode[eventCode].record(latencyUS);
+	}
+}
+
+// Fills in `stats` with the current statistics
+void Stats::snapshot(GGKStats &stats) const
+{
+	stats.methodCalls = methodCalls.load(std::memory_order_relaxed);
+	methodLatency.snapshot(stats.methodLatency);
+
+	stats.workerMethodCalls = workerMethodCalls.load(std::memory_order_relaxed);
+	workerMethodLatency.snapshot(stats.workerMethodLatency);
+
+	stats.propertyCalls = propertyCalls.load(std::memory_order_relaxed);
+	propertyLatency.snapshot(stats.propertyLatency);
+
+	stats.updatesQueued = updatesQueued.load(std::memory_order_relaxed);
+	stats.updatesCoalesced = updatesCoalesced.load(std::memory_order_relaxed);
+	stats.updatesRejected = updatesRejected.load(std::memory_order_relaxed);
+	stats.updatesProcessed = updatesProcessed.load(std::memory_order_relaxed);
+	stats.updateQueueDepth = updateQueueDepth.load(std::memory_order_relaxed);
+	stats.updateQueueMaxDepth = updateQueueMaxDepth.load(std::memory_order_relaxed);
+
+	stats.notificationsSent = notificationsSent.load(std::memory_order_relaxed);
+	stats.notificationsSuppressed = notificationsSuppressed.load(std::memory_order_relaxed);
+	stats.notificationsDeferred = notificationsDeferred.load(std::memory_order_relaxed);
+	stats.notificationsCoalesced = notificationsCoalesced.load(std::memory_order_relaxed);
+	notificationLatency.snapshot(stats.notificationLatency);
+
+	stats.hciCommandsSent = hciCommandsSent.load(std::memory_order_relaxed);
+	stats.hciCommandTimeouts = hciCommandTimeouts.load(std::memory_order_relaxed);
+	hciCommandLatency.snapshot(stats.hciCommandLatency);
+
+	stats.hciEvents = hciEvents.load(std::memory_order_relaxed);
+	stats.hciEventsRejected = hciEventsRejected.load(std::memory_order_relaxed);
+	hciEventLatency.snapshot(stats.hciEventLatency);
+
+	stats.dataSetterCalls = dataSetterCalls.load(std::memory_order_relaxed);
+	dataSetterLatency.snapshot(stats.dataSetterLatency);
+
+	stats.streamPacketsReceived = streamPacketsReceived.load(std::memory_order_relaxed);
+	stats.streamPacketsSent = streamPacketsSent.load(std::memory_order_relaxed);
+	stats.streamPacketsDropped = streamPacketsDropped.load(std::memory_order_relaxed);
+}
+
+// Resets all statistics to zero
+void Stats::reset()
+{
+	methodCalls.store(0, std::memory_order_relaxed);
+	methodLatency.reset();
+
+	workerMethodCalls.store(0, std::memory_order_relaxed);
+	workerMethodLatency.reset();
+
+	propertyCalls.store(0, std::memory_order_relaxed);
+	propertyLatency.reset();
+
+	updatesQueued.store(0, std::memory_order_relaxed);
+	updatesCoalesced.store(0, std::memory_order_relaxed);
+	updatesRejected.store(0, std::memory_order_relaxed);
+	updatesProcessed.store(0, std::memory_order_relaxed);
+
+	// The depth is a measurement rather than a count, so only the high-water mark starts over
+	updateQueueMaxDepth.store(updateQueueDepth.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	notificationsSent.store(0, std::memory_order_relaxed);
+	notificationsSuppressed.store(0, std::memory_order_relaxed);
+	notificationsDeferred.store(0, std::memory_order_relaxed);
+	notificationsCoalesced.store(0, std::memory_order_relaxed);
+	notificationLatency.reset();
+
+	hciCommandsSent.store(0, std::memory_order_relaxed);
+	hciCommandTimeouts.store(0, std::memory_order_relaxed);
+	hciCommandLatency.reset();
+
+	hciEvents.store(0, std::memory_order_relaxed);
+	hciEventsRejected.store(0, std::memory_order_relaxed);
+	hciEventLatency.reset();
+	for (int i = 0; i <= kMaxHciEventCode; ++i)
+	{
+		hciEventLatencyByCode[i].reset();
+	}
+
+	dataSetterCalls.store(0, std::memory_order_relaxed);
+	dataSetterLatency.reset();
+
+	streamPacketsReceived.store(0, std::memory_order_relaxed);
+	streamPacketsSent.store(0, std::memory_order_relaxed);
+	streamPacketsDropped.store(0, std::memory_order_relaxed);
+}
+
+}; // namespace ggk
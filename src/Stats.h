@@ -0,0 +1,187 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Lightweight counters and latency histograms for the server's hot paths
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of Stats.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+#include "../include/Gobbledegook.h"
+
+namespace ggk {
+
+// A histogram of latencies, in microseconds
+//
+// Values are bucketed by their power of two, with each power of two split into `kSubBuckets` linear sub-buckets, so that any
+// reported percentile is within 25% of the true value. Recording a sample is a handful of relaxed atomic operations.
+struct LatencyHistogram
+{
+	// The number of linear sub-buckets within each power of two
+	static const int kSubBuckets = 4;
+
+	// Samples larger than this (a little over an hour) are recorded as this value
+	static const uint64_t kMaxValueUS = 0xffffffffULL;
+
+	// Enough buckets to cover values up to `kMaxValueUS`
+	static const int kBucketCount = kSubBuckets + 30 * kSubBuckets;
+
+	LatencyHistogram() { reset(); }
+
+	// Records a single sample
+	void record(uint64_t valueUS);
+
+	// Clears all samples
+	void reset();
+
+	// Summarizes the histogram into `stats`
+	void snapshot(GGKLatencyStats &stats) const;
+
+private:
+
+	// Prevent copying
+	LatencyHistogram(LatencyHistogram const &) = delete;
+	void operator=(LatencyHistogram const &) = delete;
+
+	// Returns the bucket index for a value
+	static int bucketIndex(uint64_t valueUS);
+
+	// Returns the largest value that lands in the given bucket
+	static uint64_t bucketUpperBound(int index);
+
+	// Returns the value at the given percentile (0-100) of the samples in `counts`, which total `total` samples
+	static uint64_t percentile(const uint64_t *counts, uint64_t total, int percent);
+
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sumUS;
+	std::atomic<uint64_t> maxUS;
+	std::atomic<uint64_t> buckets[kBucketCount];
+};
+
+// Our collection of server statistics
+//
+// Counters are updated with relaxed atomics from whichever thread does the work; none of them are used to synchronize
+// anything, so a snapshot may be very slightly out of step with itself.
+struct Stats
+{
+	// Retrieve our singleton instance
+	static Stats &getInstance()
+	{
+		static Stats instance;
+		return instance;
+	}
+
+	// Returns the current time in microseconds, for measuring latencies
+	static uint64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// The highest HCI event code we keep per-event statistics for (this matches `HciAdapter::kMaxEventType`)
+	static const int kMaxHciEventCode = 0x0025;
+
+	// Increments a counter
+	static void increment(std::atomic<uint64_t> &counter) { counter.fetch_add(1, std::memory_order_relaxed); }
+
+	// Records the current depth of the update queue, tracking the deepest it has been
+	void recordUpdateQueueDepth(uint64_t depth);
+
+	// Records the time taken to parse and dispatch an HCI event
+	void recordHciEvent(int eventCode, uint64_t latencyUS);
+
+	// Fills in `stats` with the current statistics
+	void snapshot(GGKStats &stats) const;
+
+	// Resets all statistics to zero
+	void reset();
+
+	// D-Bus method calls (from dispatch until the method handler returns)
+	std::atomic<uint64_t> methodCalls;
+	LatencyHistogram methodLatency;
+
+	// Method calls run on worker threads (from dispatch until the method handler returns, including the wait for a worker)
+	std::atomic<uint64_t> workerMethodCalls;
+	LatencyHistogram workerMethodLatency;
+
+	// D-Bus property gets and sets
+	std::atomic<uint64_t> propertyCalls;
+	LatencyHistogram propertyLatency;
+
+	// The update queue (and update handles)
+	std::atomic<uint64_t> updatesQueued;
+	std::atomic<uint64_t> updatesCoalesced;
+	std::atomic<uint64_t> updatesRejected;
+	std::atomic<uint64_t> updatesProcessed;
+	std::atomic<uint64_t> updateQueueDepth;
+	std::atomic<uint64_t> updateQueueMaxDepth;
+
+	// Change notifications
+	std::atomic<uint64_t> notificationsSent;
+	std::atomic<uint64_t> notificationsSuppressed;
+	std::atomic<uint64_t> notificationsDeferred;
+	std::atomic<uint64_t> notificationsCoalesced;
+	LatencyHistogram notificationLatency;
+
+	// HCI management commands (from being sent until their response arrives)
+	std::atomic<uint64_t> hciCommandsSent;
+	std::atomic<uint64_t> hciCommandTimeouts;
+	LatencyHistogram hciCommandLatency;
+
+	// HCI events read from the adapter (from being read until they have been dispatched), in total and by event code, as well
+	// as those rejected as malformed
+	std::atomic<uint64_t> hciEvents;
+	std::atomic<uint64_t> hciEventsRejected;
+	LatencyHistogram hciEventLatency;
+	LatencyHistogram hciEventLatencyByCode[kMaxHciEventCode + 1];
+
+	// Calls into the application's data setter to report adapter events (such as connections)
+	std::atomic<uint64_t> dataSetterCalls;
+	LatencyHistogram dataSetterLatency;
+
+	// Packets received from and sent to clients over acquired sockets (see `GattCharacteristic::onAcquiredWrite()` and
+	// `GattCharacteristic::acquireNotify()`), along with packets that could not be sent
+	std::atomic<uint64_t> streamPacketsReceived;
+	std::atomic<uint64_t> streamPacketsSent;
+	std::atomic<uint64_t> streamPacketsDropped;
+
+private:
+
+	Stats() : updateQueueDepth(0) { reset(); }
+
+	// Prevent copying
+	Stats(Stats const &) = delete;
+	void operator=(Stats const &) = delete;
+};
+
+// Measures the time from its construction until it goes out of scope, recording it in a histogram
+struct ScopedLatency
+{
+	ScopedLatency(LatencyHistogram &histogram) : histogram(histogram), startUS(Stats::now()) {}
+	~ScopedLatency() { histogram.record(Stats::now() - startUS); }
+
+private:
+
+	LatencyHistogram &histogram;
+	uint64_t startUS;
+};
+
+}; // namespace ggk
@@ -21,14 +21,13 @@
 // regular basis or performing other periodic tasks. One example usage might be checking the battery level every 60 seconds and if
 // it has changed since the last update, send out a notification to subscribers.
 //
-// The frequency at which events fire is dependent upon two values: the driving timer's tick frequency multiplied by the tick
-// freuency of the TickEvent itself.
+// Each event has a period, in milliseconds. An event added via the `onEvent()` method to the server description has a period of
+// its tick frequency multiplied by `kTickPeriodMS` (one second.) An event added via `onEventMS()` has its period given directly,
+// allowing for sub-second periodic events.
 //
-// The tick event's frequency is set when a tick event is added via the `onEvent()` method to the server description.
-//
-// The driving timer's frequency is a one-second-resolution low-frequency timer with a default of one second. To modify this, see
-// `kPeriodicTimerFrequencySeconds` at the top of Init.cpp. Note that the periodic timer (which drives tick events) is intentionally
-// a low-frequency timer. Higher frequency timers would lend themselves to using more battery on both, the server and client.
+// Events are not driven by walking the server description. Once the server is running, every event is placed in a schedule
+// (a min-heap ordered by each event's next deadline) and a single timer is armed for the earliest deadline (see the event timer
+// in Init.cpp.) A server with no events has no timer at all.
 //
 // When using a TickEvent, be careful not to demand too much of your client. Notifiations that are too frequent may place undue
 // stress on their battery to receive and process the updates.
@@ -63,13 +62,30 @@ struct TickEvent
 	// A tick event callback, which is called whenever the TickEvent fires
 	typedef void (*Callback)(const DBusInterface &self, const TickEvent &event, GDBusConnection *pConnection, void *pUserData);
 
+	// A callback of the owner's own type (such as `GattCharacteristic::EventCallback`), held as a generic function pointer
+	//
+	// An owner with its own callback type registers a `Callback` trampoline of its own, which converts this back to the real
+	// type before calling it, so that the callback is never called through the wrong type.
+	typedef void (*OwnerCallback)();
+
+	// The length of a single tick, in milliseconds
+	static const int kTickPeriodMS = 1000;
+
 	// Construct a TickEvent that will fire after a specified 'tickFrequency' number of ticks of the periodic timer.
 	//
 	// Note that the actual time between a callback's execution is the event's 'tickFrequency' multiplied by the time between each
 	// periodic timer tick.
 	TickEvent(const DBusInterface *pOwner, int tickFrequency, Callback callback, void *pUserData)
-	: pOwner(pOwner), elapsedTicks(0), tickFrequency(tickFrequency), callback(callback), pUserData(pUserData)
+	: pOwner(pOwner), elapsedTicks(0), tickFrequency(tickFrequency), periodMS(tickFrequency * kTickPeriodMS), callback(callback), ownerCallback(nullptr), pUserData(pUserData)
+	{
+	}
+
+	// Construct a TickEvent that will fire every `periodMS` milliseconds
+	static TickEvent fromPeriodMS(const DBusInterface *pOwner, int periodMS, Callback callback, void *pUserData)
 	{
+		TickEvent event(pOwner, 1, callback, pUserData);
+		event.periodMS = periodMS;
+		return event;
 	}
 
 	//
@@ -86,7 +102,13 @@ struct TickEvent
 	int getTickFrequency() const { return tickFrequency; }
 
 	// Sets the tick frequency between schedule tick events
-	void setTickFrequency(int frequency) { tickFrequency = frequency; }
+	void setTickFrequency(int frequency) { tickFrequency = frequency; periodMS = frequency * kTickPeriodMS; }
+
+	// Returns the time between firings of this event, in milliseconds
+	int getPeriodMS() const { return periodMS; }
+
+	// Returns the interface that owns this event
+	const DBusInterface *getOwner() const { return pOwner; }
 
 	// Returns the user data pointer associated to this TickEvent
 	void *getUserData() { return pUserData; }
@@ -100,6 +122,12 @@ struct TickEvent
 	// Sets the callback for the TickEvent
 	void setCallback(Callback callback) { this->callback = callback; }
 
+	// Gets the owner's own callback for the TickEvent (see `OwnerCallback`)
+	OwnerCallback getOwnerCallback() const { return ownerCallback; }
+
+	// Sets the owner's own callback for the TickEvent (see `OwnerCallback`)
+	void setOwnerCallback(OwnerCallback callback) { ownerCallback = callback; }
+
 	//
 	// Tick management
 	//
@@ -117,16 +145,24 @@ struct TickEvent
 		elapsedTicks += 1;
 		if (elapsedTicks >= tickFrequency)
 		{
-			if (nullptr != callback)
-			{
-				Logger::debug(SSTR << "Ticking at path '" << path << "'");
-				callback(*static_cast<const T *>(pOwner), *this, pConnection, pUserData);
-			}
-
+			fire<T>(path, pConnection, pUserData);
 			elapsedTicks = 0;
 		}
 	}
 
+	// Fires the event, calling its callback
+	//
+	// This is called by the event timer each time the event's period elapses.
+	template<typename T>
+	void fire(const DBusObjectPath &path, GDBusConnection *pConnection, void *pUserData) const
+	{
+		if (nullptr != callback)
+		{
+			GGK_LOG_DEBUG("Ticking at path '" << path << "'");
+			callback(*static_cast<const T *>(pOwner), *this, pConnection, pUserData);
+		}
+	}
+
 private:
 
 	//
@@ -136,7 +172,9 @@ private:
 	const DBusInterface *pOwner;
 	mutable int elapsedTicks;
 	int tickFrequency;
+	int periodMS;
 	Callback callback;
+	OwnerCallback ownerCallback;
 	void *pUserData;
 };
 
@@ -195,7 +195,7 @@ std::string Utils::hex(const uint8_t *pData, int count)
 // train at platform 9 3/4. You decide.
 //
 // This method returns a set of six zero-padded 8-bit hex values 8-bit in the format: 12:34:56:78:9A:BC
-std::string Utils::bluetoothAddressString(uint8_t *pAddress)
+std::string Utils::bluetoothAddressString(const uint8_t *pAddress)
 {
 	char hex[32];
 	snprintf(hex, sizeof(hex), "%02X:%02X:%02X:%02X:%02X:%02X", 
@@ -203,6 +203,18 @@ std::string Utils::bluetoothAddressString(uint8_t *pAddress)
 	return hex;
 }
 
+// Returns a Bluetooth address as the kernel reports it (six octets at `pAddress`, least significant first) in the order BlueZ
+// writes it, such as in device object paths
+//
+// As with `bluetoothAddressString()`, `pAddress` must point to an array of 6 bytes.
+std::string Utils::kernelBluetoothAddressString(const uint8_t *pAddress)
+{
+	char hex[32];
+	snprintf(hex, sizeof(hex), "%02X:%02X:%02X:%02X:%02X:%02X",
+		pAddress[5], pAddress[4], pAddress[3], pAddress[2], pAddress[1], pAddress[0]);
+	return hex;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // GVariant helper functions
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -354,14 +366,56 @@ GVariant *Utils::gvariantFromByteArray(const std::string &str)
 GVariant *Utils::gvariantFromByteArray(const guint8 *pBytes, int count)
 {
 	GBytes *pGbytes = g_bytes_new(pBytes, count);
-	return g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, pGbytes, count);
+	GVariant *pVariant = gvariantFromByteArray(pGbytes);
+	g_bytes_unref(pGbytes);
+	return pVariant;
 }
 
 // Returns an array of bytes ("ay") with the contents of the input array of unsigned 8-bit values
-GVariant *Utils::gvariantFromByteArray(const std::vector<guint8> bytes)
+GVariant *Utils::gvariantFromByteArray(const std::vector<guint8> &bytes)
+{
+	return gvariantFromByteArray(bytes.data(), bytes.size());
+}
+
+// Returns an array of bytes ("ay") that references the contents of a ref-counted GBytes buffer
+//
+// The data is not copied. The returned variant holds its own reference to `pBytes`; the caller keeps theirs.
+GVariant *Utils::gvariantFromByteArray(GBytes *pBytes)
+{
+	// Any sequence of bytes is a valid "ay", so the data is trusted
+	return g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, pBytes, TRUE);
+}
+
+// Returns an array of bytes ("ay") that references the contents of a shared buffer
+//
+// The data is not copied. The returned variant keeps the buffer alive (through a copy of the shared pointer) until GDBus is
+// done with it, so the buffer must not be modified after this call. A null pointer results in an empty array.
+GVariant *Utils::gvariantFromByteArray(const std::shared_ptr<const std::vector<guint8>> &pBuffer)
 {
-	GBytes *pGbytes = g_bytes_new(bytes.data(), bytes.size());
-	return g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, pGbytes, bytes.size());
+	if (nullptr == pBuffer)
+	{
+		return g_variant_new("ay", nullptr);
+	}
+
+	typedef std::shared_ptr<const std::vector<guint8>> SharedBuffer;
+	SharedBuffer *pHolder = new SharedBuffer(pBuffer);
+	return gvariantFromBuffer(pBuffer->data(), pBuffer->size(), [](gpointer pUserData)
+	{
+		delete static_cast<SharedBuffer *>(pUserData);
+	}, pHolder);
+}
+
+// Returns an array of bytes ("ay") that references an application-owned buffer
+//
+// The data is not copied. `freeFunc` is called with `pUserData` once the last reference to the returned variant is released
+// (which may happen on the server's thread, after the reply has been sent.) The buffer must remain valid and unmodified
+// until then. `freeFunc` may be nullptr for buffers that live forever.
+GVariant *Utils::gvariantFromBuffer(const void *pData, size_t size, GDestroyNotify freeFunc, gpointer pUserData)
+{
+	GBytes *pGbytes = g_bytes_new_with_free_func(pData, size, freeFunc, pUserData);
+	GVariant *pVariant = gvariantFromByteArray(pGbytes);
+	g_bytes_unref(pGbytes);
+	return pVariant;
 }
 
 // Returns an array of bytes ("ay") containing a single unsigned 8-bit value
@@ -34,6 +34,7 @@
 #include <gio/gio.h>
 #include <vector>
 #include <string>
+#include <memory>
 #include <endian.h>
 
 #include "DBusObjectPath.h"
@@ -87,7 +88,13 @@ struct Utils
 	// train at platform 9 3/4. You decide.
 	//
 	// This method returns a set of six zero-padded 8-bit hex values 8-bit in the format: 12:34:56:78:9A:BC
-	static std::string bluetoothAddressString(uint8_t *pAddress);
+	static std::string bluetoothAddressString(const uint8_t *pAddress);
+
+	// Returns a Bluetooth address as the kernel reports it (six octets at `pAddress`, least significant first) in the order
+	// BlueZ writes it, such as in device object paths
+	//
+	// As with `bluetoothAddressString()`, `pAddress` must point to an array of 6 bytes.
+	static std::string kernelBluetoothAddressString(const uint8_t *pAddress);
 
 	// -----------------------------------------------------------------------------------------------------------------------------
 	// A small collection of helper functions for generating various types of GVariants, which are needed when responding to BlueZ
@@ -141,7 +148,25 @@ struct Utils
 	static GVariant *gvariantFromByteArray(const guint8 *pBytes, int count);
 
 	// Returns an array of bytes ("ay") with the contents of the input array of unsigned 8-bit values
-	static GVariant *gvariantFromByteArray(const std::vector<guint8> bytes);
+	static GVariant *gvariantFromByteArray(const std::vector<guint8> &bytes);
+
+	// Returns an array of bytes ("ay") that references the contents of a ref-counted GBytes buffer
+	//
+	// The data is not copied. The returned variant holds its own reference to `pBytes`; the caller keeps theirs.
+	static GVariant *gvariantFromByteArray(GBytes *pBytes);
+
+	// Returns an array of bytes ("ay") that references the contents of a shared buffer
+	//
+	// The data is not copied. The returned variant keeps the buffer alive (through a copy of the shared pointer) until GDBus is
+	// done with it, so the buffer must not be modified after this call. A null pointer results in an empty array.
+	static GVariant *gvariantFromByteArray(const std::shared_ptr<const std::vector<guint8>> &pBuffer);
+
+	// Returns an array of bytes ("ay") that references an application-owned buffer
+	//
+	// The data is not copied. `freeFunc` is called with `pUserData` once the last reference to the returned variant is released
+	// (which may happen on the server's thread, after the reply has been sent.) The buffer must remain valid and unmodified
+	// until then. `freeFunc` may be nullptr for buffers that live forever.
+	static GVariant *gvariantFromBuffer(const void *pData, size_t size, GDestroyNotify freeFunc, gpointer pUserData);
 
 	// Returns an array of bytes ("ay") containing a single unsigned 8-bit value
 	static GVariant *gvariantFromByteArray(const guint8 data);
@@ -0,0 +1,136 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A small pool of worker threads for running method callbacks off the server's thread
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Method callbacks in the server description normally run on the server's thread, which also services every other client
+// request and sends all of the notifications. A callback that does slow work (such as connecting to a WiFi network) stalls all
+// of that until it returns.
+//
+// A characteristic can opt in to having its methods run on this pool instead (see `GattCharacteristic::runMethodsOnWorkers()`),
+// but only once the application has enabled the pool (see `ggkEnableMethodWorkers()`), since that moves its data getter and
+// setter calls off the server's thread. Until then, every method runs on the server's thread as usual.
+// The pool is started on first use with one worker per core (up to `kMaxWorkers`) and is stopped when the server shuts down,
+// after running any jobs still waiting so that every pending method call receives its reply.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include "WorkerPool.h"
+#include "Logger.h"
+
+namespace ggk {
+
+// Queues a job to be run on a worker thread, starting the workers if they aren't already running
+//
+// Jobs are started in the order they are posted, but may run concurrently and finish in any order. If the pool has been stopped,
+// the job is run immediately on the calling thread.
+void WorkerPool::post(Job job)
+{
+	std::unique_lock<std::mutex> lock(jobsMutex);
+	if (stopping)
+	{
+		lock.unlock();
+		job();
+		return;
+	}
+
+	if (workers.empty())
+	{
+		unsigned int count = std::thread::hardware_concurrency();
+		if (0 == count) { count = 1; }
+		if (count > kMaxWorkers) { count = kMaxWorkers; }
+
+		try
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				workers.push_back(std::thread(&WorkerPool::run, this));
+			}
+		}
+		catch(std::system_error &ex)
+		{
+			Logger::error(SSTR << "Unable to start a worker thread: " << ex.what());
+		}
+
+		// Without any workers, the best we can do is run the job here
+		if (workers.empty())
+		{
+			lock.unlock();
+			job();
+			return;
+		}
+
+		Logger::debug(SSTR << "Started " << workers.size() << " worker thread(s)");
+	}
+
+	jobs.push_back(std::move(job));
+	lock.unlock();
+	cvJobs.notify_one();
+}
+
+// Runs any jobs still waiting, then stops and joins the workers
+//
+// The pool starts again with the next call to `post()`.
+void WorkerPool::stop()
+{
+	std::vector<std::thread> stoppingWorkers;
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		stopping = true;
+		stoppingWorkers.swap(workers);
+	}
+	cvJobs.notify_all();
+
+	for (std::thread &worker : stoppingWorkers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(jobsMutex);
+	stopping = false;
+}
+
+// Runs jobs until we're asked to stop (runs on each worker thread)
+void WorkerPool::run()
+{
+	std::unique_lock<std::mutex> lock(jobsMutex);
+	for (;;)
+	{
+		if (jobs.empty())
+		{
+			if (stopping)
+			{
+				break;
+			}
+
+			cvJobs.wait(lock);
+			continue;
+		}
+
+		Job job = std::move(jobs.front());
+		jobs.pop_front();
+		lock.unlock();
+
+		job();
+
+		lock.lock();
+	}
+}
+
+}; // namespace ggk
@@ -0,0 +1,87 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A small pool of worker threads for running method callbacks off the server's thread
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of WorkerPool.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ggk {
+
+struct WorkerPool
+{
+	// A unit of work
+	typedef std::function<void()> Job;
+
+	// The most worker threads we'll start, regardless of how many cores are available
+	static const unsigned int kMaxWorkers = 8;
+
+	// Retrieve our singleton instance
+	static WorkerPool &getInstance()
+	{
+		static WorkerPool instance;
+		return instance;
+	}
+
+	// Queues a job to be run on a worker thread, starting the workers if they aren't already running
+	//
+	// Jobs are started in the order they are posted, but may run concurrently and finish in any order. If the pool has been
+	// stopped, the job is run immediately on the calling thread.
+	void post(Job job);
+
+	// Runs any jobs still waiting, then stops and joins the workers
+	//
+	// The pool starts again with the next call to `post()`.
+	void stop();
+
+	// Enables or disables running method calls on the pool (see `ggkEnableMethodWorkers()`.) It is disabled by default.
+	void setEnabled(bool enable) { enabled = enable; }
+
+	// Returns true if method calls may be run on the pool
+	bool isEnabled() const { return enabled; }
+
+private:
+
+	WorkerPool() {}
+	~WorkerPool() { stop(); }
+
+	// Prevent copying
+	WorkerPool(WorkerPool const &) = delete;
+	void operator=(WorkerPool const &) = delete;
+
+	// Runs jobs until we're asked to stop (runs on each worker thread)
+	void run();
+
+	std::mutex jobsMutex;
+	std::condition_variable cvJobs;
+	std::deque<Job> jobs;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+	std::atomic<bool> enabled{false};
+};
+
+}; // namespace ggk
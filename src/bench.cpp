@@ -0,0 +1,854 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A benchmark for the server's hot paths that runs without BlueZ or Bluetooth hardware
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// The standalone server needs a running bluetoothd and a real controller, which makes it a poor tool for measuring the server
+// itself. This benchmark replaces both ends:
+//
+//     * D-Bus: The server's object tree is registered on one end of a private, peer-to-peer D-Bus connection (over a socket
+//       pair) and the benchmark acts as the client on the other end. Method calls and property requests go through the same
+//       `onMethodCall()`/`onGetProperty()`/`onSetProperty()` handlers used by the real server. The server side is serviced by its
+//       own thread and main loop, much like the server thread started by `ggkStart()`.
+//
+//     * HCI: `HciAdapter` is started on one end of a `SOCK_SEQPACKET` socket pair, with a simulated controller on the other end
+//       that answers every management command with a Command Status event.
+//
+// The benchmark reports:
+//
+//     * Startup time (building the server description, indexing it, generating and parsing the introspection XML and
+//       registering the objects)
+//     * ReadValue and WriteValue round-trip latency, as seen by the client
+//     * Notification throughput, from `ggkNofifyUpdatedCharacteristic()` until the client receives the PropertiesChanged signal
+//     * The cost of finding an interface by walking object trees of increasing size, compared with the server's index
+//     * HCI management command round-trip latency
+//
+// followed by the server's own statistics (see `ggkGetStats()`.)
+//
+// Alternatively, the `-r` option replays the events from an HCI recording (see `ggkHciStartRecording()` and the standalone
+// server's `-r` option) into `HciAdapter`, with their original timing or, with `-m`, as fast as possible. This reports the cost
+// of parsing and dispatching each type of event and the time spent in the data setter.
+//
+// Usage:
+//
+//     bench [-n iterations] [-v]
+//     bench -r recording [-m] [-v]
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <gio/gio.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <deque>
+#include <tuple>
+#include <map>
+#include <memory>
+
+#include "../include/Gobbledegook.h"
+#include "Server.h"
+#include "DBusObject.h"
+#include "DBusInterface.h"
+#include "GattService.h"
+#include "GattCharacteristic.h"
+#include "HciAdapter.h"
+#include "Mgmt.h"
+#include "Stats.h"
+#include "Logger.h"
+#include "HciRecording.h"
+
+namespace ggk
+{
+	// Our D-Bus event handlers (see Init.cpp)
+	void onMethodCall(GDBusConnection *pConnection, const gchar *pSender, const gchar *pObjectPath, const gchar *pInterfaceName, const gchar *pMethodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData);
+	GVariant *onGetProperty(GDBusConnection *pConnection, const gchar *pSender, const gchar *pObjectPath, const gchar *pInterfaceName, const gchar *pPropertyName, GError **ppError, gpointer pUserData);
+	gboolean onSetProperty(GDBusConnection *pConnection, const gchar *pSender, const gchar *pObjectPath, const gchar *pInterfaceName, const gchar *pPropertyName, GVariant *pValue, GError **ppError, gpointer pUserData);
+
+	// Our update queue (see Gobbledegook.cpp)
+	int beginUpdatePass(GGKUpdatePriority *pOrder);
+	void endUpdatePass();
+	int popUpdateQueueBatch(GGKUpdatePriority priority, std::deque<std::tuple<std::string, std::string>> &batch, int &budget);
+}; // namespace ggk
+
+using namespace ggk;
+
+// The number of iterations for each measurement (see the `-n` option)
+static int iterations = 10000;
+
+// The object tree sizes used to measure lookups
+static const int kTreeSizes[] = { 1, 10, 100, 1000 };
+
+// How long we'll wait for notifications to arrive before giving up
+static const uint64_t kNotificationTimeoutUS = 10 * 1000 * 1000;
+
+// How long we'll wait for the adapter to work through replayed events once they have all been sent
+static const uint64_t kReplayDrainTimeoutUS = 10 * 1000 * 1000;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Server data
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static std::vector<guint8> serverDataWifiStatus = { '{', '}' };
+static std::vector<guint8> serverDataSsidList = { '[', ']' };
+static uint32_t serverDataSoftwareStatus = 0;
+static std::string serverDataApiKey = "0123456789abcdef";
+
+static const void *dataGetter(const char *pName)
+{
+	std::string name = nullptr == pName ? "" : pName;
+	if (name == "wifi/wifi_status") { return &serverDataWifiStatus; }
+	if (name == "wifi/ssid_list") { return &serverDataSsidList; }
+	if (name == "software/status") { return &serverDataSoftwareStatus; }
+	if (name == "wifi/api_key") { return serverDataApiKey.c_str(); }
+	return nullptr;
+}
+
+static int dataSetter(const char *pName, const void *pData)
+{
+	std::string name = nullptr == pName ? "" : pName;
+	if (name == "wifi/api_key" && nullptr != pData)
+	{
+		serverDataApiKey = static_cast<const char *>(pData);
+	}
+
+	return 1;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void logToStdout(const char *pText) { printf("    | %s\n", pText); }
+
+static void printLatency(const char *pName, const GGKLatencyStats &stats)
+{
+	printf("  %-34s %8llu samples  mean %6llu us  p50 %6llu us  p90 %6llu us  p99 %6llu us  max %6llu us\n", pName,
+		stats.count, stats.meanUS, stats.p50US, stats.p90US, stats.p99US, stats.maxUS);
+}
+
+static void printLatency(const char *pName, const LatencyHistogram &histogram)
+{
+	GGKLatencyStats stats;
+	histogram.snapshot(stats);
+	printLatency(pName, stats);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Simulated controller
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// A stand-in for the kernel's HCI control socket that answers every management command with a successful Command Status event
+struct FakeController
+{
+	// Creates our socket pair and starts answering commands
+	//
+	// Returns the adapter's end of the socket pair (to be passed to `HciAdapter::start(int)`), or -1 on failure
+	int start()
+	{
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+		{
+			perror("socketpair");
+			return -1;
+		}
+
+		fdController = fds[1];
+		thread = std::thread(&FakeController::run, this);
+		return fds[0];
+	}
+
+	// Stops answering commands
+	void stop()
+	{
+		if (fdController >= 0)
+		{
+			shutdown(fdController, SHUT_RDWR);
+		}
+
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+
+		if (fdController >= 0)
+		{
+			close(fdController);
+			fdController = -1;
+		}
+	}
+
+private:
+
+	void run()
+	{
+		uint8_t packet[1024];
+		for (;;)
+		{
+			ssize_t size = recv(fdController, packet, sizeof(packet), 0);
+			if (size <= 0)
+			{
+				break;
+			}
+
+			if (size < static_cast<ssize_t>(sizeof(HciAdapter::HciHeader)))
+			{
+				continue;
+			}
+
+			HciAdapter::HciHeader request = *reinterpret_cast<HciAdapter::HciHeader *>(packet);
+			request.toHost();
+
+			// Command Status: a header followed by the command code and a status
+			uint8_t response[sizeof(HciAdapter::HciHeader) + 3];
+			HciAdapter::HciHeader header;
+			header.code = Mgmt::ECommandStatusEvent;
+			header.controllerId = request.controllerId;
+			header.dataSize = 3;
+			header.toNetwork();
+			memcpy(response, &header, sizeof(header));
+
+			uint16_t commandCode = Utils::endianToHci(request.code);
+			memcpy(response + sizeof(header), &commandCode, sizeof(commandCode));
+			response[sizeof(header) + 2] = 0;
+
+			if (send(fdController, response, sizeof(response), 0) < 0)
+			{
+				break;
+			}
+		}
+	}
+
+	int fdController = -1;
+	std::thread thread;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Private D-Bus
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Our two ends of the private bus
+static GDBusConnection *pServerConnection = nullptr;
+static GDBusConnection *pClientConnection = nullptr;
+
+// The server side is serviced by its own main loop on its own thread
+static GMainContext *pServerContext = nullptr;
+static GMainLoop *pServerLoop = nullptr;
+static std::thread serverThread;
+
+// Our registered objects
+static std::vector<guint> registeredObjectIds;
+
+// Wraps one end of a socket pair in a stream for D-Bus
+static GIOStream *streamFromSocket(int fd)
+{
+	GError *pError = nullptr;
+	GSocket *pSocket = g_socket_new_from_fd(fd, &pError);
+	if (nullptr == pSocket)
+	{
+		fprintf(stderr, "Unable to create socket: %s\n", nullptr == pError ? "Unknown" : pError->message);
+		g_clear_error(&pError);
+		return nullptr;
+	}
+
+	GSocketConnection *pStream = g_socket_connection_factory_create_connection(pSocket);
+	g_object_unref(pSocket);
+	return G_IO_STREAM(pStream);
+}
+
+// Connects a peer-to-peer D-Bus connection between a server and a client over a socket pair
+//
+// Returns true on success, otherwise false
+static bool connectPrivateBus()
+{
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+	{
+		perror("socketpair");
+		return false;
+	}
+
+	GIOStream *pServerStream = streamFromSocket(fds[0]);
+	GIOStream *pClientStream = streamFromSocket(fds[1]);
+	if (nullptr == pServerStream || nullptr == pClientStream)
+	{
+		return false;
+	}
+
+	// Both ends authenticate at the same time, so the server side gets a thread of its own while it does
+	gchar *pGuid = g_dbus_generate_guid();
+	GError *pServerError = nullptr;
+	std::thread serverAuthentication([&]()
+	{
+		pServerConnection = g_dbus_connection_new_sync(pServerStream, pGuid, G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER, nullptr, nullptr, &pServerError);
+	});
+
+	GError *pClientError = nullptr;
+	pClientConnection = g_dbus_connection_new_sync(pClientStream, nullptr, G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, nullptr, nullptr, &pClientError);
+	serverAuthentication.join();
+
+	g_free(pGuid);
+	g_object_unref(pServerStream);
+	g_object_unref(pClientStream);
+
+	if (nullptr == pServerConnection || nullptr == pClientConnection)
+	{
+		GError *pError = nullptr != pServerError ? pServerError : pClientError;
+		fprintf(stderr, "Unable to connect the private bus: %s\n", nullptr == pError ? "Unknown" : pError->message);
+		g_clear_error(&pServerError);
+		g_clear_error(&pClientError);
+		return false;
+	}
+
+	return true;
+}
+
+// Registers a node's interfaces (and those of its children) on the server's end of the private bus
+static bool registerNode(GDBusNodeInfo *pNode, const DBusObjectPath &path)
+{
+	static GDBusInterfaceVTable interfaceVtable;
+	interfaceVtable.method_call = onMethodCall;
+	interfaceVtable.get_property = onGetProperty;
+	interfaceVtable.set_property = onSetProperty;
+
+	for (GDBusInterfaceInfo **ppInterface = pNode->interfaces; nullptr != *ppInterface; ++ppInterface)
+	{
+		GError *pError = nullptr;
+		guint id = g_dbus_connection_register_object(pServerConnection, path.c_str(), *ppInterface, &interfaceVtable, nullptr, nullptr, &pError);
+		if (0 == id)
+		{
+			fprintf(stderr, "Unable to register %s: %s\n", path.c_str(), nullptr == pError ? "Unknown" : pError->message);
+			g_clear_error(&pError);
+			return false;
+		}
+
+		registeredObjectIds.push_back(id);
+	}
+
+	for (GDBusNodeInfo **ppChild = pNode->nodes; nullptr != *ppChild; ++ppChild)
+	{
+		if (!registerNode(*ppChild, path + (*ppChild)->path))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Runs the server side of the private bus
+static void runServerThread()
+{
+	g_main_context_push_thread_default(pServerContext);
+	g_main_loop_run(pServerLoop);
+	g_main_context_pop_thread_default(pServerContext);
+}
+
+// Processes the update queue on the server's thread, as the server's own update source does
+static gboolean drainUpdateQueue(gpointer /*pUserData*/)
+{
+	static std::deque<std::tuple<std::string, std::string>> batch;
+	while (ggkUpdateQueueIsEmpty() == 0)
+	{
+		GGKUpdatePriority order[EUpdatePriorityLow + 1];
+		int budget = beginUpdatePass(order);
+		for (GGKUpdatePriority priority : order)
+		{
+			popUpdateQueueBatch(priority, batch, budget);
+			for (auto it = batch.rbegin(); it != batch.rend(); ++it)
+			{
+				std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(std::get<0>(*it).c_str(), std::get<1>(*it).c_str());
+				if (nullptr == pInterface)
+				{
+					continue;
+				}
+
+				if (std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic))
+				{
+					pCharacteristic->callOnUpdatedValue(pServerConnection, nullptr);
+				}
+			}
+		}
+		endUpdatePass();
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+// Calls a method on the server from the client's end of the private bus
+//
+// Returns true on success, otherwise false
+static bool callServer(const std::string &path, const char *pInterfaceName, const char *pMethodName, GVariant *pParameters, const GVariantType *pReplyType)
+{
+	GError *pError = nullptr;
+	GVariant *pResult = g_dbus_connection_call_sync(pClientConnection, nullptr, path.c_str(), pInterfaceName, pMethodName, pParameters, pReplyType, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &pError);
+	if (nullptr == pResult)
+	{
+		fprintf(stderr, "%s on %s failed: %s\n", pMethodName, path.c_str(), nullptr == pError ? "Unknown" : pError->message);
+		g_clear_error(&pError);
+		return false;
+	}
+
+	g_variant_unref(pResult);
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Benchmarks
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Builds, indexes and registers the server, reporting how long each step takes
+static bool benchStartup()
+{
+	std::map<const std::string, const std::string> dataMap =
+	{
+		{ "serviceName", "gobbledegook" },
+		{ "advertisingName", "Gobbledegook" },
+		{ "advertisingShortName", "Gobbledegook" },
+		{ "productID", "bench" },
+		{ "serialNumber", "0" },
+		{ "firmwareRevision", "0" },
+		{ "hardwareRevision", "0" },
+		{ "softwareRevision", "0" },
+		{ "enableBREDR", "false" },
+		{ "enableSecureConnection", "false" },
+		{ "enableLinkLayerSecurity", "false" },
+		{ "enableConnectable", "true" },
+		{ "enableDiscoverable", "true" },
+		{ "enableAdvertising", "true" },
+		{ "enableBondable", "false" },
+		{ "enableSecureSimplePairing", "false" },
+		{ "enableHighspeedConnect", "false" },
+		{ "enableFastConnect", "false" },
+		{ "readSecuritySetting", "read" },
+		{ "writeSecuritySetting", "write" },
+	};
+
+	printf("Startup\n");
+
+	uint64_t startUS = Stats::now();
+	TheServer = std::make_shared<Server>(dataMap, dataGetter, dataSetter);
+	uint64_t describeUS = Stats::now() - startUS;
+
+	startUS = Stats::now();
+	TheServer->freeze();
+	uint64_t indexUS = Stats::now() - startUS;
+
+	uint64_t generateUS = 0;
+	uint64_t parseUS = 0;
+	uint64_t registerUS = 0;
+
+	// Objects are registered with the server's context as the thread default, so that their handlers are called on its thread
+	g_main_context_push_thread_default(pServerContext);
+	bool registered = true;
+	for (const DBusObject &object : TheServer->getObjects())
+	{
+		startUS = Stats::now();
+		std::string xml = object.generateIntrospectionXML();
+		generateUS += Stats::now() - startUS;
+
+		startUS = Stats::now();
+		GError *pError = nullptr;
+		GDBusNodeInfo *pNode = g_dbus_node_info_new_for_xml(xml.c_str(), &pError);
+		parseUS += Stats::now() - startUS;
+
+		if (nullptr == pNode)
+		{
+			fprintf(stderr, "Unable to parse introspection XML: %s\n", nullptr == pError ? "Unknown" : pError->message);
+			g_clear_error(&pError);
+			registered = false;
+			break;
+		}
+
+		startUS = Stats::now();
+		registered = registerNode(pNode, DBusObjectPath(pNode->path));
+		registerUS += Stats::now() - startUS;
+
+		g_dbus_node_info_unref(pNode);
+		if (!registered)
+		{
+			break;
+		}
+	}
+	g_main_context_pop_thread_default(pServerContext);
+
+	printf("  %-34s %8llu us\n", "Build server description", static_cast<unsigned long long>(describeUS));
+	printf("  %-34s %8llu us\n", "Build lookup index", static_cast<unsigned long long>(indexUS));
+	printf("  %-34s %8llu us\n", "Generate introspection XML", static_cast<unsigned long long>(generateUS));
+	printf("  %-34s %8llu us\n", "Parse introspection XML", static_cast<unsigned long long>(parseUS));
+	printf("  %-34s %8llu us (%zu interfaces)\n", "Register objects", static_cast<unsigned long long>(registerUS), registeredObjectIds.size());
+	return registered;
+}
+
+// Measures ReadValue and WriteValue round trips from the client
+static bool benchMethodCalls()
+{
+	std::string readPath = "/com/" + TheServer->getServiceName() + "/device/mfgr_name";
+	std::string writePath = "/com/" + TheServer->getServiceName() + "/wifi/api_key";
+	static const guint8 kWriteData[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+
+	LatencyHistogram readLatency;
+	LatencyHistogram writeLatency;
+	for (int i = 0; i < iterations; ++i)
+	{
+		uint64_t startUS = Stats::now();
+		if (!callServer(readPath, "org.bluez.GattCharacteristic1", "ReadValue", g_variant_new("(a{sv})", nullptr), G_VARIANT_TYPE("(ay)")))
+		{
+			return false;
+		}
+		readLatency.record(Stats::now() - startUS);
+
+		startUS = Stats::now();
+		GVariant *pValue = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, kWriteData, sizeof(kWriteData), 1);
+		if (!callServer(writePath, "org.bluez.GattCharacteristic1", "WriteValue", g_variant_new("(@aya{sv})", pValue, nullptr), G_VARIANT_TYPE("()")))
+		{
+			return false;
+		}
+		writeLatency.record(Stats::now() - startUS);
+	}
+
+	printf("Method calls (client round trip)\n");
+	printLatency("ReadValue", readLatency);
+	printLatency("WriteValue", writeLatency);
+	return true;
+}
+
+// Counts PropertiesChanged signals received by the client
+static void onPropertiesChanged(GDBusConnection *, const gchar *, const gchar *, const gchar *, const gchar *, GVariant *, gpointer pUserData)
+{
+	++*static_cast<int *>(pUserData);
+}
+
+// Keeps the client's main loop waking up, so that we can give up on notifications that never arrive
+static gboolean onClientTimeout(gpointer /*pUserData*/)
+{
+	return G_SOURCE_CONTINUE;
+}
+
+// Measures notification throughput, from `ggkNofifyUpdatedCharacteristic()` until the client receives the change notification
+static bool benchNotifications()
+{
+	std::string path = "/com/" + TheServer->getServiceName() + "/wifi/wifi_status";
+
+	int received = 0;
+	guint subscriptionId = g_dbus_connection_signal_subscribe(pClientConnection, nullptr, "org.freedesktop.DBus.Properties", "PropertiesChanged",
+		path.c_str(), nullptr, G_DBUS_SIGNAL_FLAGS_NONE, onPropertiesChanged, &received, nullptr);
+	guint timeoutId = g_timeout_add(100, onClientTimeout, nullptr);
+
+	// Notifications are only sent to subscribers
+	bool result = callServer(path, "org.bluez.GattCharacteristic1", "StartNotify", nullptr, G_VARIANT_TYPE("()"));
+	if (result)
+	{
+		uint64_t startUS = Stats::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			ggkNofifyUpdatedCharacteristic(path.c_str());
+		}
+		uint64_t queuedUS = Stats::now() - startUS;
+
+		g_main_context_invoke(pServerContext, drainUpdateQueue, nullptr);
+
+		uint64_t deadline = Stats::now() + kNotificationTimeoutUS;
+		while (received < iterations && Stats::now() < deadline)
+		{
+			g_main_context_iteration(nullptr, TRUE);
+		}
+		uint64_t totalUS = Stats::now() - startUS;
+
+		printf("Notifications\n");
+		printf("  %-34s %8d of %d in %llu us (queued in %llu us)\n", "Received", received, iterations,
+			static_cast<unsigned long long>(totalUS), static_cast<unsigned long long>(queuedUS));
+		printf("  %-34s %8.0f per second\n", "Throughput", 0 == totalUS ? 0.0 : received * 1000000.0 / totalUS);
+
+		result = received == iterations;
+		callServer(path, "org.bluez.GattCharacteristic1", "StopNotify", nullptr, G_VARIANT_TYPE("()"));
+	}
+
+	g_source_remove(timeoutId);
+	g_dbus_connection_signal_unsubscribe(pClientConnection, subscriptionId);
+	return result;
+}
+
+// Measures the cost of finding an interface by walking object trees of increasing size, compared with the server's index
+static void benchLookups()
+{
+	printf("Interface lookup (deepest characteristic)\n");
+
+	for (int size : kTreeSizes)
+	{
+		DBusObject root(DBusObjectPath() + "bench");
+		for (int i = 0; i < size; ++i)
+		{
+			root.gattServiceBegin("service" + std::to_string(i), GattUuid(0x10000000 + i, 0x1000, 0x8000, 0x0080, 0x5f9b34fbULL))
+				.gattCharacteristicBegin("characteristic", GattUuid(0x20000000 + i, 0x1000, 0x8000, 0x0080, 0x5f9b34fbULL), {"read"})
+				.gattCharacteristicEnd()
+			.gattServiceEnd();
+		}
+
+		DBusObjectPath path = DBusObjectPath() + "bench" + ("service" + std::to_string(size - 1)) + "characteristic";
+		LatencyHistogram latency;
+		for (int i = 0; i < iterations; ++i)
+		{
+			uint64_t startUS = Stats::now();
+			if (nullptr == root.findInterface(path, "org.bluez.GattCharacteristic1"))
+			{
+				fprintf(stderr, "Unable to find %s\n", path.c_str());
+				return;
+			}
+			latency.record(Stats::now() - startUS);
+		}
+
+		std::string name = "Tree walk, " + std::to_string(size) + " service(s)";
+		printLatency(name.c_str(), latency);
+	}
+
+	DBusObjectPath path = DBusObjectPath() + "com" + TheServer->getServiceName() + "software" + "status";
+	LatencyHistogram latency;
+	for (int i = 0; i < iterations; ++i)
+	{
+		uint64_t startUS = Stats::now();
+		TheServer->findInterface(path, "org.bluez.GattCharacteristic1");
+		latency.record(Stats::now() - startUS);
+	}
+	printLatency("Server index", latency);
+}
+
+// Measures management command round trips through the simulated controller
+static bool benchHci()
+{
+	FakeController controller;
+	int fdAdapter = controller.start();
+	if (fdAdapter < 0 || !HciAdapter::getInstance().start(fdAdapter))
+	{
+		fprintf(stderr, "Unable to start the HCI adapter on the simulated controller\n");
+		controller.stop();
+		return false;
+	}
+
+	LatencyHistogram latency;
+	bool result = true;
+	for (int i = 0; i < iterations; ++i)
+	{
+		HciAdapter::HciHeader request;
+		request.code = Mgmt::EReadVersionInformationCommand;
+		request.controllerId = HciAdapter::kNonController;
+		request.dataSize = 0;
+
+		uint64_t startUS = Stats::now();
+		if (!HciAdapter::getInstance().sendCommand(request))
+		{
+			fprintf(stderr, "HCI command %d was not answered\n", i);
+			result = false;
+			break;
+		}
+		latency.record(Stats::now() - startUS);
+	}
+
+	HciAdapter::getInstance().stop();
+	controller.stop();
+
+	printf("HCI management commands (simulated controller)\n");
+	printLatency("Command round trip", latency);
+	return result;
+}
+
+// Replays an HCI recording into the adapter, reporting the cost of each type of event
+static bool benchReplay(const char *pFilename, bool maxSpeed)
+{
+	HciReplayer replayer;
+	if (!replayer.load(pFilename))
+	{
+		fprintf(stderr, "Unable to load the HCI recording '%s'\n", pFilename);
+		return false;
+	}
+
+	uint64_t eventCount = replayer.getPackets().size();
+	if (0 == eventCount)
+	{
+		fprintf(stderr, "The HCI recording '%s' contains no events\n", pFilename);
+		return false;
+	}
+
+	// Route adapter events through our data setter, so that we can see what it costs
+	HciAdapter::getInstance().registerEventListener(dataSetter);
+	ggkResetStats();
+
+	uint64_t startUS = Stats::now();
+	int fdAdapter = replayer.start(maxSpeed);
+	if (fdAdapter < 0 || !HciAdapter::getInstance().start(fdAdapter))
+	{
+		fprintf(stderr, "Unable to start the HCI adapter on the replayed recording\n");
+		replayer.stop();
+		return false;
+	}
+
+	// Wait for every event to be sent, and then for the adapter to work through them
+	Stats &stats = Stats::getInstance();
+	uint64_t drainStartUS = 0;
+	bool result = true;
+	for (;;)
+	{
+		uint64_t handled = stats.hciEvents.load() + stats.hciEventsRejected.load();
+		if (handled >= eventCount)
+		{
+			break;
+		}
+
+		if (replayer.isFinished())
+		{
+			if (0 == drainStartUS)
+			{
+				drainStartUS = Stats::now();
+			}
+			else if (Stats::now() - drainStartUS > kReplayDrainTimeoutUS)
+			{
+				fprintf(stderr, "Timed out with %llu of %llu events handled\n", static_cast<unsigned long long>(handled),
+					static_cast<unsigned long long>(eventCount));
+				result = false;
+				break;
+			}
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	uint64_t elapsedUS = Stats::now() - startUS;
+
+	HciAdapter::getInstance().stop();
+	replayer.stop();
+
+	printf("HCI replay of '%s' (%s)\n", pFilename, maxSpeed ? "maximum speed" : "original timing");
+	printf("  %-34s %8llu in %llu us (%.0f events/sec)\n", "Events", static_cast<unsigned long long>(eventCount),
+		static_cast<unsigned long long>(elapsedUS), 0 == elapsedUS ? 0.0 : eventCount * 1000000.0 / elapsedUS);
+	printf("  %-34s %8llu\n", "Rejected as malformed", static_cast<unsigned long long>(stats.hciEventsRejected.load()));
+	printLatency("All events", stats.hciEventLatency);
+	for (int code = HciAdapter::kMinEventType; code <= HciAdapter::kMaxEventType; ++code)
+	{
+		GGKLatencyStats eventStats;
+		stats.hciEventLatencyByCode[code].snapshot(eventStats);
+		if (eventStats.count > 0)
+		{
+			printLatency(HciAdapter::kEventTypeNames[code], eventStats);
+		}
+	}
+	printLatency("Data setter", stats.dataSetterLatency);
+
+	return result;
+}
+
+// Prints the server's own statistics
+static void printServerStats()
+{
+	GGKStats stats;
+	ggkGetStats(&stats);
+
+	printf("Server statistics\n");
+	printLatency("Method dispatch", stats.methodLatency);
+	printLatency("Property dispatch", stats.propertyLatency);
+	printLatency("Notification emit", stats.notificationLatency);
+	printLatency("HCI command", stats.hciCommandLatency);
+	printLatency("HCI event dispatch", stats.hciEventLatency);
+	printf("  %-34s %8llu (max depth %llu)\n", "Updates queued", stats.updatesQueued, stats.updateQueueMaxDepth);
+	printf("  %-34s %8llu sent, %llu suppressed, %llu deferred, %llu coalesced\n", "Notifications", stats.notificationsSent,
+		stats.notificationsSuppressed, stats.notificationsDeferred, stats.notificationsCoalesced);
+}
+
+int main(int argc, char **ppArgv)
+{
+	const char *pReplayFilename = nullptr;
+	bool replayMaxSpeed = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = ppArgv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			iterations = atoi(ppArgv[++i]);
+		}
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			pReplayFilename = ppArgv[++i];
+		}
+		else if (arg == "-m")
+		{
+			replayMaxSpeed = true;
+		}
+		else if (arg == "-v")
+		{
+			ggkLogRegisterWarn(logToStdout);
+			ggkLogRegisterError(logToStdout);
+			ggkLogRegisterFatal(logToStdout);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: bench [-n iterations] [-v]\n");
+			fprintf(stderr, "       bench -r recording [-m] [-v]\n");
+			return -1;
+		}
+	}
+
+	// Replaying a recording only involves the HCI adapter
+	if (nullptr != pReplayFilename)
+	{
+		return benchReplay(pReplayFilename, replayMaxSpeed) ? 0 : 1;
+	}
+
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "The number of iterations must be positive\n");
+		return -1;
+	}
+
+	pServerContext = g_main_context_new();
+	pServerLoop = g_main_loop_new(pServerContext, FALSE);
+
+	if (!connectPrivateBus())
+	{
+		return 1;
+	}
+
+	bool result = benchStartup();
+	if (result)
+	{
+		serverThread = std::thread(runServerThread);
+
+		ggkResetStats();
+		result = benchMethodCalls() && benchNotifications();
+		benchLookups();
+		result = benchHci() && result;
+		printServerStats();
+
+		g_main_loop_quit(pServerLoop);
+		serverThread.join();
+	}
+
+	for (guint id : registeredObjectIds)
+	{
+		g_dbus_connection_unregister_object(pServerConnection, id);
+	}
+
+	g_object_unref(pClientConnection);
+	g_object_unref(pServerConnection);
+	g_main_loop_unref(pServerLoop);
+	g_main_context_unref(pServerContext);
+	TheServer = nullptr;
+
+	return result ? 0 : 1;
+}
@@ -242,6 +242,9 @@ int dataSetter(const char *pName, const void *pData)
 
 int main(int argc, char **ppArgv)
 {
+	// If set (with `-r`), the HCI traffic is recorded here for replaying with the benchmark
+	const char *pRecordingFilename = nullptr;
+
 	// A basic command-line parser
 	for (int i = 1; i < argc; ++i)
 	{
@@ -258,11 +261,15 @@ int main(int argc, char **ppArgv)
 		{
 			logLevel = Debug;
 		}
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			pRecordingFilename = ppArgv[++i];
+		}
 		else
 		{
 			LogFatal((std::string("Unknown parameter: '") + arg + "'").c_str());
 			LogFatal("");
-			LogFatal("Usage: standalone [-q | -v | -d]");
+			LogFatal("Usage: standalone [-q | -v | -d] [-r recording]");
 			return -1;
 		}
 	}
@@ -281,6 +288,12 @@ int main(int argc, char **ppArgv)
 	ggkLogRegisterAlways(LogAlways);
 	ggkLogRegisterTrace(LogTrace);
 
+	// Start recording before the server starts, so that we capture the adapter's initialization
+	if (nullptr != pRecordingFilename && !ggkHciStartRecording(pRecordingFilename))
+	{
+		return -1;
+	}
+
 	// Start the server's ascync processing
 	//
 	// This starts the server on a thread and begins the initialization process
@@ -299,11 +312,10 @@ int main(int argc, char **ppArgv)
 
 	// Wait for the server to start the shutdown process
 	//
-	// While we wait, every 15 ticks, drop the battery level by one percent until we reach 0
-	while (ggkGetServerRunState() < EStopping)
+	// While we wait, every 15 seconds, drop the battery level by one percent until we reach 0 (the wait ends as soon as the
+	// shutdown begins)
+	while (!ggkWaitForRunState(EStopping, 15000))
 	{
-		std::this_thread::sleep_for(std::chrono::seconds(15));
-
 		serverDataBatteryLevel = std::max(serverDataBatteryLevel - 1, 0);
 		ggkNofifyUpdatedCharacteristic("/com/gobbledegook/battery/level");
 	}
@@ -314,6 +326,8 @@ int main(int argc, char **ppArgv)
 		return -1;
 	}
 
+	ggkHciStopRecording();
+
 	// Return the final server health status as a success (0) or error (-1)
   	return ggkGetServerHealth() == EOk ? 0 : 1;
 }
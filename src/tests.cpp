@@ -0,0 +1,351 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Tests of how the server starts and stops that run without BlueZ or Bluetooth hardware (see `make check`)
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Without BlueZ, the server never gets past initialization. That is enough to test how it starts and stops, as long as it stays
+// in EInitializing for as long as a test needs. To make sure it does, we point the system bus (see `DBUS_SYSTEM_BUS_ADDRESS`) at
+// a socket of our own that accepts connections but never answers, so the server's request for a bus connection never completes.
+//
+// Each test returns true if it passed. The run fails if any test fails, or if the tests don't finish within `kTimeoutSeconds`
+// (which is how a test that hangs is caught.)
+//
+// Usage:
+//
+//     tests [-v]
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "../include/Gobbledegook.h"
+
+// How long all of the tests together may take before the run is failed
+static const unsigned int kTimeoutSeconds = 60;
+
+// How long a call that should return at once may take
+static const int kPromptMS = 1000;
+
+// The initialization timeout used by tests that need the server to be started, and to then shut down by itself
+static const int kInitTimeoutMS = 200;
+
+// How long producers keep pushing once the server has stopped
+static const int kPushAfterStopMS = 50;
+
+// The number of threads pushing updates in the tests that need them, and the characteristic they update
+static const int kProducerCount = 4;
+static const char *kUpdatePath = "/com/gobbledegook/battery/level";
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Server data
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static const std::map<const std::string, const std::string> kDataMap =
+{
+	{ "serviceName", "gobbledegook" },
+	{ "advertisingName", "Gobbledegook" },
+	{ "advertisingShortName", "Gobbledegook" },
+	{ "productID", "tests" },
+	{ "serialNumber", "0" },
+	{ "firmwareRevision", "0" },
+	{ "hardwareRevision", "0" },
+	{ "softwareRevision", "0" },
+	{ "enableBREDR", "false" },
+	{ "enableSecureConnection", "false" },
+	{ "enableLinkLayerSecurity", "false" },
+	{ "enableConnectable", "true" },
+	{ "enableDiscoverable", "true" },
+	{ "enableAdvertising", "true" },
+	{ "enableBondable", "false" },
+	{ "enableSecureSimplePairing", "false" },
+	{ "enableHighspeedConnect", "false" },
+	{ "enableFastConnect", "false" },
+	{ "readSecuritySetting", "read" },
+	{ "writeSecuritySetting", "write" },
+};
+
+static const void *dataGetter(const char */*pName*/)
+{
+	return nullptr;
+}
+
+static int dataSetter(const char */*pName*/, const void */*pData*/)
+{
+	return 1;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static void logToStdout(const char *pText) { printf("    | %s\n", pText); }
+
+// Returns `condition`, reporting `pWhat` if it is false
+static bool expect(bool condition, const char *pWhat)
+{
+	if (!condition)
+	{
+		printf("    Expected: %s\n", pWhat);
+	}
+
+	return condition;
+}
+
+// Returns the milliseconds elapsed since `start`
+static long long elapsedMS(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Points the system bus at a listening socket that never answers, which holds the server in EInitializing (see the discussion at
+// the top of this file)
+//
+// The socket is in the abstract namespace, so there is no file to clean up. It stays open until we exit.
+static bool startSilentBus()
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		perror("socket");
+		return false;
+	}
+
+	std::string name = "ggk-tests-" + std::to_string(getpid());
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path + 1, name.data(), name.length());
+	socklen_t addressLength = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + 1 + name.length());
+
+	if (bind(fd, reinterpret_cast<struct sockaddr *>(&address), addressLength) < 0 || listen(fd, 16) < 0)
+	{
+		perror("bind");
+		close(fd);
+		return false;
+	}
+
+	setenv("DBUS_SYSTEM_BUS_ADDRESS", ("unix:abstract=" + name).c_str(), 1);
+	return true;
+}
+
+// Pushes updates from a few threads until stopped, as an application's producers would
+//
+// Coalescing is enabled while they run, which keeps the queue from growing while the server isn't there to process it.
+struct Producers
+{
+	void start()
+	{
+		ggkUpdateQueueSetCoalescing(1);
+		running = true;
+		for (int i = 0; i < kProducerCount; ++i)
+		{
+			threads.push_back(std::thread(&Producers::run, this));
+		}
+	}
+
+	void stop()
+	{
+		running = false;
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+		threads.clear();
+
+		ggkUpdateQueueClear();
+		ggkUpdateQueueSetCoalescing(0);
+	}
+
+	std::atomic<bool> running{false};
+	std::atomic<long long> pushes{0};
+
+private:
+	void run()
+	{
+		while (running)
+		{
+			ggkPushUpdateQueue(kUpdatePath, "org.bluez.GattCharacteristic1");
+			ggkNofifyUpdatedCharacteristic(kUpdatePath);
+			pushes += 1;
+		}
+	}
+
+	std::vector<std::thread> threads;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// `ggkStart()` with a timeout of zero or less fails at once, rather than waiting for initialization that will never complete
+static bool testStartWithoutTimeout()
+{
+	bool passed = true;
+	for (int timeoutMS : { -1, 0 })
+	{
+		auto start = std::chrono::steady_clock::now();
+		passed = expect(0 == ggkStart(kDataMap, dataGetter, dataSetter, timeoutMS), "ggkStart() to fail") && passed;
+		passed = expect(elapsedMS(start) < kPromptMS, "ggkStart() to return at once") && passed;
+		passed = expect(EStopped == ggkGetServerRunState(), "the server to be stopped") && passed;
+		passed = expect(EFailedInit == ggkGetServerHealth(), "the server to have failed initialization") && passed;
+	}
+
+	return passed;
+}
+
+// Updates pushed from other threads while the server shuts down (and after it has stopped) are safe
+//
+// The server fails to initialize in time, so `ggkStart()` shuts it down and waits for it to stop, just as `ggkShutdownAndWait()`
+// does, all while our producers push updates. Those updates wake the server's main context and add sources to it as the server
+// thread releases it.
+static bool testPushDuringShutdown()
+{
+	Producers producers;
+	producers.start();
+
+	bool passed = true;
+	passed = expect(0 == ggkStart(kDataMap, dataGetter, dataSetter, kInitTimeoutMS), "ggkStart() to time out") && passed;
+	passed = expect(0 != ggkShutdownAndWait(), "ggkShutdownAndWait() to succeed once the server has stopped") && passed;
+	passed = expect(EStopped == ggkGetServerRunState(), "the server to be stopped") && passed;
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(kPushAfterStopMS));
+	producers.stop();
+
+	return expect(producers.pushes > 0, "updates to have been pushed") && passed;
+}
+
+// Updates pushed from other threads while an attached server shuts down (and after it has stopped) are safe
+//
+// As with `testPushDuringShutdown()`, but the server runs on a main context of ours and finishes stopping as we run it, releasing
+// our context as it does.
+static bool testPushDuringAttachedShutdown()
+{
+	GMainContext *pContext = g_main_context_new();
+	g_main_context_push_thread_default(pContext);
+
+	Producers producers;
+	producers.start();
+
+	bool passed = expect(0 != ggkAttach(pContext, kDataMap, dataGetter, dataSetter, kInitTimeoutMS), "ggkAttach() to succeed");
+	while (passed && EStopped != ggkGetServerRunState())
+	{
+		g_main_context_iteration(pContext, TRUE);
+	}
+	passed = expect(0 != ggkWait(), "ggkWait() to succeed once the server has stopped") && passed;
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(kPushAfterStopMS));
+	producers.stop();
+
+	g_main_context_pop_thread_default(pContext);
+	g_main_context_unref(pContext);
+
+	return expect(producers.pushes > 0, "updates to have been pushed") && passed;
+}
+
+// Update handles can't be registered (from any thread) with a server that hasn't registered its objects
+//
+// Another thread tries to register a handle throughout, as `ggkStart()` replaces the server and then shuts it down.
+static bool testRegisterBeforeRunning()
+{
+	std::atomic<bool> running{true};
+	std::atomic<long long> registered{0};
+	std::thread registrar([&running, &registered]()
+	{
+		while (running)
+		{
+			registered += ggkRegisterUpdateHandle(kUpdatePath) >= 0 ? 1 : 0;
+		}
+	});
+
+	bool passed = true;
+	passed = expect(0 == ggkStart(kDataMap, dataGetter, dataSetter, kInitTimeoutMS), "ggkStart() to time out") && passed;
+	passed = expect(0 != ggkShutdownAndWait(), "ggkShutdownAndWait() to succeed once the server has stopped") && passed;
+
+	running = false;
+	registrar.join();
+
+	passed = expect(0 == registered, "no handle to have been registered") && passed;
+	return expect(ggkRegisterUpdateHandle(kUpdatePath) < 0, "registration to fail once the server has stopped") && passed;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Entry point
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+struct Test
+{
+	const char *pName;
+	bool (*run)();
+};
+
+static const Test kTests[] =
+{
+	{ "ggkStart() with a timeout of zero or less", testStartWithoutTimeout },
+	{ "Pushing updates while the server shuts down", testPushDuringShutdown },
+	{ "Pushing updates while an attached server shuts down", testPushDuringAttachedShutdown },
+	{ "Registering update handles before the server is running", testRegisterBeforeRunning },
+};
+
+int main(int argc, char **ppArgv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = ppArgv[i];
+		if (arg == "-v")
+		{
+			ggkLogRegisterWarn(logToStdout);
+			ggkLogRegisterError(logToStdout);
+			ggkLogRegisterFatal(logToStdout);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: tests [-v]\n");
+			return -1;
+		}
+	}
+
+	// SIGALRM's default action ends the run (as a failure) if a test hangs
+	alarm(kTimeoutSeconds);
+
+	if (!startSilentBus())
+	{
+		return 1;
+	}
+
+	int failures = 0;
+	for (const Test &test : kTests)
+	{
+		printf("%s\n", test.pName);
+		bool passed = test.run();
+		printf("  %s\n", passed ? "PASS" : "FAIL");
+		failures += passed ? 0 : 1;
+	}
+
+	return 0 == failures ? 0 : 1;
+}